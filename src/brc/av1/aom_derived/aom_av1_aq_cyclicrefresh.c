@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2016, Alliance for Open Media. All rights reserved
+ *  Copyright (c) 2020 Intel corporation. All Rights Reserved.
+ *
+ * This source code is subject to the terms of the BSD 2 Clause License and
+ * the Alliance for Open Media Patent License 1.0. If the BSD 2 Clause License
+ * was not distributed with this source code in the LICENSE file, you can
+ * obtain it at www.aomedia.org/license/software. If the Alliance for Open
+ * Media Patent License 1.0 was not distributed with this source code in the
+ * PATENTS file, you can obtain it at www.aomedia.org/license/patent.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aom_av1_aq_cyclicrefresh.h"
+#include "aom_av1_common.h"
+
+static inline int clamp(int value, int low, int high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+AV1_CYCLIC_REFRESH *av1_cyclic_refresh_alloc(int mi_rows, int mi_cols) {
+  AV1_CYCLIC_REFRESH *const cr = calloc(1, sizeof(*cr));
+  if (cr == NULL) return NULL;
+
+  cr->seg_map = calloc(mi_rows * mi_cols, sizeof(*cr->seg_map));
+  if (cr->seg_map == NULL) {
+    av1_cyclic_refresh_free(cr);
+    return NULL;
+  }
+  cr->map_mi_rows = mi_rows;
+  cr->map_mi_cols = mi_cols;
+  return cr;
+}
+
+void av1_cyclic_refresh_free(AV1_CYCLIC_REFRESH *cr) {
+  if (cr != NULL) {
+    free(cr->seg_map);
+    free(cr);
+  }
+}
+
+static int is_lossless_requested(const RateControlCfg *const rc_cfg) {
+  return rc_cfg->best_allowed_q == 0 && rc_cfg->worst_allowed_q == 0;
+}
+
+// Compute delta-q for the segment.
+static int compute_deltaq(const AV1_COMP *cpi, int q, double rate_factor) {
+  const AV1_CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  int deltaq = av1_compute_qdelta_by_rate(
+      cpi, cpi->common.current_frame.frame_type, q, rate_factor);
+  if ((-deltaq) > cr->max_qdelta_perc * q / 100) {
+    deltaq = -cr->max_qdelta_perc * q / 100;
+  }
+  return deltaq;
+}
+
+int av1_cyclic_refresh_estimate_bits_at_q(const AV1_COMP *cpi,
+                                          double correction_factor) {
+  const AV1_COMMON *const cm = &cpi->common;
+  const AV1_FRAME_TYPE frame_type = cm->current_frame.frame_type;
+  const int base_qindex = cm->quant_params.base_qindex;
+  const aom_bit_depth_t bit_depth = cm->seq_params.bit_depth;
+  const AV1_CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  const int mbs = cm->mi_params.MBs;
+  const int num4x4bl = mbs << 4;
+  // Weight for non-base segments: use actual number of blocks refreshed in
+  // previous/just encoded frame. Note number of blocks here is in 4x4 units.
+  const double weight_segment1 = (double)cr->actual_num_seg1_blocks / num4x4bl;
+  const double weight_segment2 = (double)cr->actual_num_seg2_blocks / num4x4bl;
+  // Take segment weighted average for estimated bits.
+  const int estimated_bits =
+      (int)((1.0 - weight_segment1 - weight_segment2) *
+                av1_estimate_bits_at_q(frame_type, base_qindex, mbs,
+                                       correction_factor, bit_depth,
+                                       cpi->is_screen_content_type) +
+            weight_segment1 * av1_estimate_bits_at_q(
+                                  frame_type, base_qindex + cr->qindex_delta[1],
+                                  mbs, correction_factor, bit_depth,
+                                  cpi->is_screen_content_type) +
+            weight_segment2 * av1_estimate_bits_at_q(
+                                  frame_type, base_qindex + cr->qindex_delta[2],
+                                  mbs, correction_factor, bit_depth,
+                                  cpi->is_screen_content_type));
+  return estimated_bits;
+}
+
+int av1_cyclic_refresh_rc_bits_per_mb(const AV1_COMP *cpi, int i,
+                                      const int *bits_per_mb) {
+  const AV1_CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  // Compute delta-q corresponding to qindex i.
+  int deltaq = compute_deltaq(cpi, i, cr->rate_ratio_qdelta);
+  // Take segment weighted average for bits per mb.
+  return (int)((1.0 - cr->weight_segment) * bits_per_mb[i] +
+               cr->weight_segment * bits_per_mb[i + deltaq]);
+}
+
+/*!\brief Update the segmentation map, and related quantities.
+ *
+ * Cycle through the superblocks, starting at cr->sb_index, and mark them
+ * for refresh until the target number of blocks for the frame is reached.
+ * There is no per-block feedback (coding mode, last coded q) from the
+ * encoder, so every block in the selected superblocks is a refresh
+ * candidate, and the map is assumed to be applied as-is by the encoder.
+ *
+ * \ingroup cyclic_refresh
+ * \callgraph
+ * \callergraph
+ *
+ * \param[in]       cpi          Top level encoder structure
+ *
+ * \return Update the segmentation map, and the CYCLIC_REFRESH structure.
+ */
+static void cyclic_refresh_update_map(AV1_COMP *const cpi) {
+  AV1_COMMON *const cm = &cpi->common;
+  const CommonModeInfoParams *const mi_params = &cm->mi_params;
+  AV1_CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  uint8_t *const seg_map = cr->seg_map;
+  // The real-time encoder uses 64x64 superblocks.
+  const int mib_size = 1 << MIN_MIB_SIZE_LOG2;
+  int i, block_count, bl_index, sb_rows, sb_cols, sbs_in_frame;
+  int xmis, ymis, x, y;
+  memset(seg_map, AV1_CR_SEGMENT_ID_BASE,
+         mi_params->mi_rows * mi_params->mi_cols);
+  sb_cols = (mi_params->mi_cols + mib_size - 1) / mib_size;
+  sb_rows = (mi_params->mi_rows + mib_size - 1) / mib_size;
+  sbs_in_frame = sb_cols * sb_rows;
+  // Number of target blocks to get the q delta (segment 1).
+  block_count =
+      cr->percent_refresh * mi_params->mi_rows * mi_params->mi_cols / 100;
+  // Set the segmentation map: cycle through the superblocks, starting at
+  // cr->mb_index, and stopping when either block_count blocks have been found
+  // to be refreshed, or we have passed through whole frame.
+  if (cr->sb_index >= sbs_in_frame) cr->sb_index = 0;
+  assert(cr->sb_index < sbs_in_frame);
+  i = cr->sb_index;
+  cr->target_num_seg_blocks = 0;
+  do {
+    // Get the mi_row/mi_col corresponding to superblock index i.
+    const int sb_row_index = (i / sb_cols);
+    const int sb_col_index = i - sb_row_index * sb_cols;
+    const int mi_row = sb_row_index * mib_size;
+    const int mi_col = sb_col_index * mib_size;
+    assert(mi_row >= 0 && mi_row < mi_params->mi_rows);
+    assert(mi_col >= 0 && mi_col < mi_params->mi_cols);
+    bl_index = mi_row * mi_params->mi_cols + mi_col;
+    // Loop through all MI blocks in superblock and update map.
+    xmis = AOMMIN(mi_params->mi_cols - mi_col, mib_size);
+    ymis = AOMMIN(mi_params->mi_rows - mi_row, mib_size);
+    for (y = 0; y < ymis; y++) {
+      for (x = 0; x < xmis; x++) {
+        seg_map[bl_index + y * mi_params->mi_cols + x] =
+            AV1_CR_SEGMENT_ID_BOOST1;
+      }
+    }
+    cr->target_num_seg_blocks += xmis * ymis;
+    i++;
+    if (i == sbs_in_frame) {
+      i = 0;
+    }
+  } while (cr->target_num_seg_blocks < block_count && i != cr->sb_index);
+  cr->sb_index = i;
+  // The encoder applies the map as-is, so the actual number of refreshed
+  // blocks is the target.
+  cr->actual_num_seg1_blocks = cr->target_num_seg_blocks;
+  cr->actual_num_seg2_blocks = 0;
+}
+
+void av1_cyclic_refresh_update_parameters(AV1_COMP *const cpi) {
+  const AV1_RATE_CONTROL *const rc = cpi->rc;
+  const AV1_COMMON *const cm = &cpi->common;
+  AV1_CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  const CommonModeInfoParams *const mi_params = &cm->mi_params;
+  int num4x4bl = mi_params->MBs << 4;
+  int target_refresh = 0;
+  double weight_segment_target = 0;
+  double weight_segment = 0;
+  int qp_thresh = AOMMIN(20, rc->best_quality << 1);
+  int qp_max_thresh = 118 * AV1_MAXQ >> 7;
+  cr->apply_cyclic_refresh = 1;
+  // Note: aom also disables the refresh on low motion content, the
+  // motion statistics are not available here.
+  // The regions of interest take precedence over the cyclic refresh.
+  if (av1_frame_is_intra_only(cm) || cpi->roi.apply ||
+      is_lossless_requested(&cpi->oxcf.rc_cfg) ||
+      cpi->svc.temporal_layer_id > 0 ||
+      rc->avg_frame_qindex[AV1_INTER_FRAME] < qp_thresh ||
+      (cpi->svc.number_spatial_layers > 1 &&
+       cpi->svc.layer_context[cpi->svc.temporal_layer_id].is_key_frame) ||
+      (rc->frames_since_key > 20 &&
+       rc->avg_frame_qindex[AV1_INTER_FRAME] > qp_max_thresh)) {
+    cr->apply_cyclic_refresh = 0;
+    return;
+  }
+  cr->percent_refresh = 10;
+  cr->max_qdelta_perc = 60;
+  cr->rate_boost_fac = 15;
+  // Use larger delta-qp (increase rate_ratio_qdelta) for first few (~4)
+  // periods of the refresh cycle, after a key frame.
+  // Account for larger interval on base layer for temporal layers.
+  if (cr->percent_refresh > 0 &&
+      rc->frames_since_key <
+          (4 * cpi->svc.number_temporal_layers) * (100 / cr->percent_refresh)) {
+    cr->rate_ratio_qdelta = 3.0;
+  } else {
+    cr->rate_ratio_qdelta = 2.0;
+  }
+  // Adjust some parameters for low resolutions.
+  if (cm->width * cm->height <= 352 * 288) {
+    if (rc->avg_frame_bandwidth < 3000) {
+      cr->rate_boost_fac = 13;
+    } else {
+      cr->max_qdelta_perc = 70;
+      cr->rate_ratio_qdelta = AOMMAX(cr->rate_ratio_qdelta, 2.5);
+    }
+  }
+  // Weight for segment prior to encoding: take the average of the target
+  // number for the frame to be encoded and the actual from the previous frame.
+  // Use the target if its less. To be used for setting the base qp for the
+  // frame in av1_rc_regulate_q.
+  target_refresh =
+      cr->percent_refresh * mi_params->mi_rows * mi_params->mi_cols / 100;
+  weight_segment_target = (double)(target_refresh) / num4x4bl;
+  weight_segment = (double)((target_refresh + cr->actual_num_seg1_blocks +
+                             cr->actual_num_seg2_blocks) >>
+                            1) /
+                   num4x4bl;
+  if (weight_segment_target < 7 * weight_segment / 8)
+    weight_segment = weight_segment_target;
+  cr->weight_segment = weight_segment;
+}
+
+void av1_cyclic_refresh_setup(AV1_COMP *const cpi) {
+  AV1_COMMON *const cm = &cpi->common;
+  const CommonModeInfoParams *const mi_params = &cm->mi_params;
+  AV1_CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+
+  if (!cr->apply_cyclic_refresh) {
+    // Set segmentation map to 0 and disable.
+    memset(cr->seg_map, 0, mi_params->mi_rows * mi_params->mi_cols);
+    cr->qindex_delta[1] = 0;
+    cr->qindex_delta[2] = 0;
+    cr->actual_num_seg1_blocks = 0;
+    cr->actual_num_seg2_blocks = 0;
+    if (cm->current_frame.frame_type == AV1_KEY_FRAME) cr->sb_index = 0;
+    return;
+  } else {
+    const int base_qindex = cm->quant_params.base_qindex;
+    int qindex_delta = 0;
+
+    // Segment BASE "Normal" has no q delta.
+    cr->qindex_delta[0] = 0;
+
+    // Set the q delta for segment BOOST1.
+    qindex_delta = compute_deltaq(cpi, base_qindex, cr->rate_ratio_qdelta);
+    cr->qindex_delta[1] =
+        clamp(base_qindex + qindex_delta, 0, AV1_MAXQ) - base_qindex;
+
+    // Set a more aggressive (higher) q delta for segment BOOST2.
+    qindex_delta = compute_deltaq(
+        cpi, base_qindex,
+        AOMMIN(AV1_CR_MAX_RATE_TARGET_RATIO,
+               0.1 * cr->rate_boost_fac * cr->rate_ratio_qdelta));
+    cr->qindex_delta[2] =
+        clamp(base_qindex + qindex_delta, 0, AV1_MAXQ) - base_qindex;
+
+    // Update the segmentation and refresh map.
+    cyclic_refresh_update_map(cpi);
+  }
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2016, Alliance for Open Media. All rights reserved
+ *  Copyright (c) 2020 Intel corporation. All Rights Reserved.
+ *
+ * This source code is subject to the terms of the BSD 2 Clause License and
+ * the Alliance for Open Media Patent License 1.0. If the BSD 2 Clause License
+ * was not distributed with this source code in the LICENSE file, you can
+ * obtain it at www.aomedia.org/license/software. If the Alliance for Open
+ * Media Patent License 1.0 was not distributed with this source code in the
+ * PATENTS file, you can obtain it at www.aomedia.org/license/patent.
+ */
+
+#ifndef AOM_AV1_ENCODER_AQ_CYCLICREFRESH_H_
+#define AOM_AV1_ENCODER_AQ_CYCLICREFRESH_H_
+
+#include "aom_av1_ratectrl.h"
+
+// The segment ids used in cyclic refresh: from base (no boost) to increasing
+// boost (higher delta-qp).
+#define AV1_CR_SEGMENT_ID_BASE 0
+#define AV1_CR_SEGMENT_ID_BOOST1 1
+#define AV1_CR_SEGMENT_ID_BOOST2 2
+
+// Maximum rate target ratio for setting segment delta-qp.
+#define AV1_CR_MAX_RATE_TARGET_RATIO 4.0
+
+/*!
+ * \brief The stucture of CYCLIC_REFRESH.
+ * \ingroup cyclic_refresh
+ */
+typedef struct AV1_CYCLIC_REFRESH {
+  /*!
+   * Percentage of blocks per frame that are targeted as candidates
+   * for cyclic refresh.
+   */
+  int percent_refresh;
+  /*!
+   * Maximum q-delta as percentage of base q.
+   */
+  int max_qdelta_perc;
+  /*!
+   *Superblock starting index for cycling through the frame.
+   */
+  int sb_index;
+  /*!
+   * Target number of (4x4) blocks that are set for delta-q.
+   */
+  int target_num_seg_blocks;
+  /*!
+   * Actual number of (4x4) blocks that were applied delta-q,
+   * for segment 1.
+   */
+  int actual_num_seg1_blocks;
+  /*!
+   * Actual number of (4x4) blocks that were applied delta-q,
+   * for segment 2.
+   */
+  int actual_num_seg2_blocks;
+  /*!
+   * Segment map of the current frame, one entry per 4x4 block.
+   */
+  uint8_t *seg_map;
+  /*!
+   * Allocated size of the segment map, in mi units.
+   */
+  int map_mi_rows;
+  int map_mi_cols;
+  /*!\cond */
+  double rate_ratio_qdelta;
+  int rate_boost_fac;
+  int qindex_delta[3];
+  double weight_segment;
+  int apply_cyclic_refresh;
+  /*!\endcond */
+} AV1_CYCLIC_REFRESH;
+
+struct AV1_COMP;
+
+AV1_CYCLIC_REFRESH *av1_cyclic_refresh_alloc(int mi_rows, int mi_cols);
+
+void av1_cyclic_refresh_free(AV1_CYCLIC_REFRESH *cr);
+
+/*!\brief Estimate the bits, incorporating the delta-q from the segments.
+ *
+ * For the just encoded frame, estimate the bits, incorporating the delta-q
+ * from non-base segment(s). Note this function is called in the postencode
+ * (called from rc_update_rate_correction_factors()).
+ *
+ * \ingroup cyclic_refresh
+ * \callgraph
+ * \callergraph
+ *
+ * \param[in]       cpi               Top level encoder structure
+ * \param[in]       correction_factor rate correction factor
+ *
+ * \return Return the estimated bits at given q.
+ */
+int av1_cyclic_refresh_estimate_bits_at_q(const struct AV1_COMP *cpi,
+                                          double correction_factor);
+
+/*!\brief Estimate the bits per mb, for given q = i and delta-q.
+ *
+ * Prior to encoding the frame, estimate the bits per mb, for a given q = i and
+ * a corresponding delta-q (for segment 1). This function is called in the
+ * rc_regulate_q() to set the base qp index. Note: the segment map is set to
+ * either 0/CR_SEGMENT_ID_BASE (no refresh) or to 1/CR_SEGMENT_ID_BOOST1
+ * (refresh) for each superblock, prior to encoding.
+ *
+ * \ingroup cyclic_refresh
+ * \callgraph
+ * \callergraph
+ *
+ * \param[in]       cpi               Top level encoder structure
+ * \param[in]       i                 q index
+ * \param[in]       bits_per_mb       bits per mb of the frame at each q
+ *
+ * \return Return the estimated bits for q = i and delta-q (segment 1).
+ */
+int av1_cyclic_refresh_rc_bits_per_mb(const struct AV1_COMP *cpi, int i,
+                                      const int *bits_per_mb);
+
+/*!\brief Update the cyclic refresh parameters.
+ *
+ * \ingroup cyclic_refresh
+ * \callgraph
+ * \callergraph
+ *
+ * \param[in]       cpi       Top level encoder structure
+ *
+ * \return Returns void. Updates the CYCLIC_REFRESH structure.
+ */
+void av1_cyclic_refresh_update_parameters(struct AV1_COMP *const cpi);
+
+/*!\brief Setup the cyclic background refresh.
+ *
+ * Set the delta q for the segment(s), and set the segmentation map.
+ *
+ * \ingroup cyclic_refresh
+ * \callgraph
+ * \callergraph
+ *
+ * \param[in]       cpi       Top level encoder structure
+ *
+ * \return Updates the segmentation map and the CYCLIC_REFRESH structure.
+ */
+void av1_cyclic_refresh_setup(struct AV1_COMP *const cpi);
+
+#endif  // AOM_AV1_ENCODER_AQ_CYCLICREFRESH_H_
@@ -12,7 +12,11 @@
 #ifndef AOM_AV1_COMMON_H_
 #define AOM_AV1_COMMON_H_
 
+#include "../../common/brc_ratectrl.h"
+#include "aom_av1_aq_cyclicrefresh.h"
+#include "aom_av1_picklpf.h"
 #include "aom_av1_ratectrl.h"
+#include "aom_av1_roi.h"
 #include "aom_av1_svc_layercontext.h"
 
 #define INVALID_IDX (-1)  // Invalid buffer index.
@@ -39,9 +43,6 @@ typedef struct AV1EncoderConfig {
   // Indicates the spped preset to be used.
   int speed;
 
-  // Indicates the target sequence level index for each operating point(OP).
-  AV1_LEVEL target_seq_level_idx[MAX_NUM_OPERATING_POINTS];
-
   // Indicates the bitstream profile to be used.
   AV1_BITSTREAM_PROFILE profile;
 
@@ -92,6 +93,14 @@ typedef struct AV1_COMMON {
    * frames in the video.
    */
   SequenceHeader seq_params;
+
+  /*!
+   * Loop filter, CDEF and loop restoration parameters of the current frame.
+   */
+  AV1_LOOPFILTER lf;
+  AV1_CDEF_INFO cdef_info;
+  AV1_RESTORATION_TYPE frame_restoration_type[AV1_MAX_MB_PLANE];
+
     /*!
    * Number of temporal layers: may be > 1 for SVC (scalable vector coding).
    */
@@ -118,26 +127,40 @@ typedef struct AV1_COMMON {
 typedef struct AV1_COMP {
   AV1_COMMON common;
   AV1EncoderConfig oxcf;
-  AV1_RATE_CONTROL rc;
+  /*!
+   * Rate control of the frame being coded: stream_rc, or the context of the
+   * current layer of a layered stream, used in place without a copy.
+   */
+  AV1_RATE_CONTROL *rc;
+  /*!
+   * Rate control of the stream.
+   */
+  AV1_RATE_CONTROL stream_rc;
 
   /*!
    * Frame rate of the video.
    */
   double framerate;
-   /*!
-   * Bitmask indicating which reference buffers may be referenced by this frame.
-   */
-  int ref_frame_flags;
-
   /*!
    * speed is passed as a per-frame parameter into the encoder.
    */
   int speed;
 
   /*!
-   * Information related to a gf group.
+   * Cyclic refresh state, only allocated when CYCLIC_REFRESH_AQ is enabled.
    */
-  GF_GROUP gf_group;
+  AV1_CYCLIC_REFRESH *cyclic_refresh;
+
+  /*!
+   * Regions of interest of each spatial layer, and their current frame map.
+   */
+  BrcRoi roi;
+
+  /*!
+   * Rate model of the key and of the other frames, at the bit depth and
+   * content type.
+   */
+  BrcRcRateCurve rate_curve[2];
 
   /*!
    * sf contains fine-grained config set internally based on speed.
@@ -175,6 +198,11 @@ typedef struct AV1_COMP {
    */
   int is_screen_content_type;
 
+  /*!
+   * The source of the current frame is the same as the previous one.
+   */
+  int frame_unchanged;
+
   /*!
    * Indicates whether to use SVC.
    */
@@ -184,11 +212,6 @@ typedef struct AV1_COMP {
    */
   AV1_SVC svc;
 
-  /*!
-   * Flag indicating whether look ahead processing (LAP) is enabled.
-   */
-  int lap_enabled;
-
   /*!
    * Frame type of the last frame. May be used in some heuristics for speeding
    * up the encoding.
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2016, Alliance for Open Media. All rights reserved
+ *  Copyright (c) 2020 Intel corporation. All Rights Reserved.
+ *
+ * This source code is subject to the terms of the BSD 2 Clause License and
+ * the Alliance for Open Media Patent License 1.0. If the BSD 2 Clause License
+ * was not distributed with this source code in the LICENSE file, you can
+ * obtain it at www.aomedia.org/license/software. If the Alliance for Open
+ * Media Patent License 1.0 was not distributed with this source code in the
+ * PATENTS file, you can obtain it at www.aomedia.org/license/patent.
+ */
+
+#include <assert.h>
+#include <math.h>
+
+#include "aom_av1_common.h"
+#include "aom_av1_picklpf.h"
+
+#define ROUND_POWER_OF_TWO(value, n) (((value) + (((1 << (n)) >> 1))) >> (n))
+
+static inline int clamp(int value, int low, int high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+static int is_lossless(const AV1_COMMON *const cm) {
+  return cm->quant_params.base_qindex == 0;
+}
+
+void av1_pick_filter_level_from_q(AV1_COMP *const cpi) {
+  AV1_COMMON *const cm = &cpi->common;
+  AV1_LOOPFILTER *const lf = &cm->lf;
+  const int min_filter_level = 0;
+  const int max_filter_level = AV1_MAX_LOOP_FILTER;
+  const int q = av1_ac_quant_QTX(cm->quant_params.base_qindex, 0,
+                                 cm->seq_params.bit_depth);
+  // Boosted strength, libaom uses it for every q of the real-time path.
+  const int inter_frame_multiplier = 12034;
+  int filt_guess;
+
+  lf->sharpness_level = 0;
+  if (is_lossless(cm)) {
+    lf->filter_level[0] = lf->filter_level[1] = 0;
+    lf->filter_level_u = lf->filter_level_v = 0;
+    return;
+  }
+
+  // These values were determined by linear fitting the result of the
+  // searched level for 8 bit depth:
+  // Keyframes: filt_guess = q * 0.06699 - 1.60817
+  // Other frames: filt_guess = q * inter_frame_multiplier + 2.48225
+  //
+  // And high bit depth separately:
+  // filt_guess = q * 0.316206 + 3.87252
+  switch (cm->seq_params.bit_depth) {
+    case AOM_BITS_8:
+      filt_guess =
+          (cm->current_frame.frame_type == AV1_KEY_FRAME)
+              ? ROUND_POWER_OF_TWO(q * 17563 - 421574, 18)
+              : ROUND_POWER_OF_TWO(q * inter_frame_multiplier + 650707, 18);
+      break;
+    case AOM_BITS_10:
+      filt_guess = ROUND_POWER_OF_TWO(q * 20723 + 4060632, 20);
+      break;
+    case AOM_BITS_12:
+      filt_guess = ROUND_POWER_OF_TWO(q * 20723 + 16242526, 22);
+      break;
+    default:
+      assert(0 && "bit_depth should be AOM_BITS_8, AOM_BITS_10 or AOM_BITS_12");
+      return;
+  }
+  if (cm->seq_params.bit_depth != AOM_BITS_8 &&
+      cm->current_frame.frame_type == AV1_KEY_FRAME)
+    filt_guess -= 4;
+
+  // The same model is used for the Y, U and V levels.
+  filt_guess = clamp(filt_guess, min_filter_level, max_filter_level);
+  lf->filter_level[0] = filt_guess;
+  lf->filter_level[1] = filt_guess;
+  lf->filter_level_u = filt_guess;
+  lf->filter_level_v = filt_guess;
+}
+
+void av1_pick_cdef_from_q(AV1_COMP *const cpi) {
+  AV1_COMMON *const cm = &cpi->common;
+  AV1_CDEF_INFO *const cdef_info = &cm->cdef_info;
+  const int bd = cm->seq_params.bit_depth;
+  const float q =
+      (float)(av1_ac_quant_QTX(cm->quant_params.base_qindex, 0, bd) >>
+              (bd - 8));
+  int predicted_y_f1, predicted_y_f2, predicted_uv_f1, predicted_uv_f2;
+
+  cdef_info->cdef_bits = 0;
+  cdef_info->nb_cdef_strengths = 1;
+  cdef_info->cdef_damping = 3 + (cm->quant_params.base_qindex >> 6);
+  if (is_lossless(cm)) {
+    cdef_info->cdef_strengths[0] = 0;
+    cdef_info->cdef_uv_strengths[0] = 0;
+    return;
+  }
+
+  // Quadratic fits of the searched primary (f1) and secondary (f2)
+  // strengths against the 8-bit ac quantizer.
+  if (cpi->is_screen_content_type) {
+    predicted_y_f1 =
+        (int)(5.88217781e-06 * q * q + 6.10391455e-03 * q + 9.95043102e-02);
+    predicted_y_f2 =
+        (int)(-7.79934857e-06 * q * q + 6.58957830e-03 * q + 8.81045025e-01);
+    predicted_uv_f1 =
+        (int)(-6.79500136e-06 * q * q + 1.00867439e-02 * q + 3.36249819e-01);
+    predicted_uv_f2 =
+        (int)(-9.99613695e-08 * q * q - 1.79361339e-05 * q + 1.17022324e+0);
+  } else if (!av1_frame_is_intra_only(cm)) {
+    predicted_y_f1 = (int)roundf(q * q * -0.0000023593946f +
+                                 q * 0.0068615186f + 0.02709886f);
+    predicted_y_f2 = (int)roundf(q * q * -0.00000057629734f +
+                                 q * 0.0013993345f + 0.03831067f);
+    predicted_uv_f1 = (int)roundf(q * q * -0.0000007095069f +
+                                  q * 0.0034628846f + 0.00887099f);
+    predicted_uv_f2 = (int)roundf(q * q * 0.00000023874085f +
+                                  q * 0.00028223585f + 0.05576307f);
+  } else {
+    predicted_y_f1 = (int)roundf(q * q * 0.0000033731974f +
+                                 q * 0.008070594f + 0.0187634f);
+    predicted_y_f2 = (int)roundf(q * q * 0.0000029167343f +
+                                 q * 0.0027798624f + 0.0079405f);
+    predicted_uv_f1 = (int)roundf(q * q * -0.0000130790995f +
+                                  q * 0.012892405f - 0.00748388f);
+    predicted_uv_f2 = (int)roundf(q * q * 0.0000032651783f +
+                                  q * 0.00035520183f + 0.00228092f);
+  }
+  predicted_y_f1 = clamp(predicted_y_f1, 0, 15);
+  predicted_y_f2 = clamp(predicted_y_f2, 0, 3);
+  predicted_uv_f1 = clamp(predicted_uv_f1, 0, 15);
+  predicted_uv_f2 = clamp(predicted_uv_f2, 0, 3);
+
+  cdef_info->cdef_strengths[0] =
+      predicted_y_f1 * AV1_CDEF_SEC_STRENGTHS + predicted_y_f2;
+  cdef_info->cdef_uv_strengths[0] =
+      predicted_uv_f1 * AV1_CDEF_SEC_STRENGTHS + predicted_uv_f2;
+}
+
+void av1_pick_restoration_type(AV1_COMP *const cpi) {
+  AV1_COMMON *const cm = &cpi->common;
+  int plane;
+
+  // libaom disables loop restoration for real-time encoding, its search
+  // needs the source and reconstructed frames and has no q based model.
+  for (plane = 0; plane < AV1_MAX_MB_PLANE; plane++)
+    cm->frame_restoration_type[plane] = AV1_RESTORE_NONE;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2016, Alliance for Open Media. All rights reserved
+ *  Copyright (c) 2020 Intel corporation. All Rights Reserved.
+ *
+ * This source code is subject to the terms of the BSD 2 Clause License and
+ * the Alliance for Open Media Patent License 1.0. If the BSD 2 Clause License
+ * was not distributed with this source code in the LICENSE file, you can
+ * obtain it at www.aomedia.org/license/software. If the Alliance for Open
+ * Media Patent License 1.0 was not distributed with this source code in the
+ * PATENTS file, you can obtain it at www.aomedia.org/license/patent.
+ */
+
+#ifndef AOM_AV1_ENCODER_PICKLPF_H_
+#define AOM_AV1_ENCODER_PICKLPF_H_
+
+#define AV1_MAX_LOOP_FILTER 63
+
+#define AV1_CDEF_SEC_STRENGTHS 4
+#define AV1_CDEF_MAX_STRENGTHS 16
+
+#define AV1_MAX_MB_PLANE 3
+
+typedef enum {
+  AV1_RESTORE_NONE,
+  AV1_RESTORE_WIENER,
+  AV1_RESTORE_SGRPROJ,
+  AV1_RESTORE_SWITCHABLE,
+} AV1_RESTORATION_TYPE;
+
+typedef struct AV1_LOOPFILTER {
+  // Luma levels of the vertical [0] and horizontal [1] edges.
+  int filter_level[2];
+  int filter_level_u;
+  int filter_level_v;
+  int sharpness_level;
+} AV1_LOOPFILTER;
+
+typedef struct AV1_CDEF_INFO {
+  int cdef_damping;
+  int nb_cdef_strengths;
+  // Strengths are coded as primary * AV1_CDEF_SEC_STRENGTHS + secondary.
+  int cdef_strengths[AV1_CDEF_MAX_STRENGTHS];
+  int cdef_uv_strengths[AV1_CDEF_MAX_STRENGTHS];
+  int cdef_bits;
+} AV1_CDEF_INFO;
+
+struct AV1_COMP;
+
+/*!\brief Estimate the deblocking levels of the current frame from its
+ * base_qindex, bit depth and frame type (libaom LPF_PICK_FROM_Q).
+ *
+ * \param[in]       cpi       Top level encoder structure
+ */
+void av1_pick_filter_level_from_q(struct AV1_COMP *const cpi);
+
+/*!\brief Estimate the CDEF strengths of the current frame from its
+ * base_qindex (libaom CDEF_PICK_FROM_Q).
+ *
+ * \param[in]       cpi       Top level encoder structure
+ */
+void av1_pick_cdef_from_q(struct AV1_COMP *const cpi);
+
+/*!\brief Select the loop restoration type of each plane.
+ *
+ * \param[in]       cpi       Top level encoder structure
+ */
+void av1_pick_restoration_type(struct AV1_COMP *const cpi);
+
+#endif  // AOM_AV1_ENCODER_PICKLPF_H_
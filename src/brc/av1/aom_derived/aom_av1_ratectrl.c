@@ -13,12 +13,14 @@
 #include <assert.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "aom_av1_ratectrl.h"
 #include "aom_av1_svc_layercontext.h"
 #include "aom_av1_common.h"
+#include "../../common/brc_ratectrl.h"
 
 #define USE_UNRESTRICTED_Q_IN_CQ_MODE 0
 
@@ -165,77 +167,6 @@ static const int16_t dc_qlookup_12_QTX[AV1_QINDEX_RANGE] = {
   13501, 13913, 14343, 14807, 15290, 15812, 16356, 16943, 17575, 18237, 18949,
   19718, 20521, 21387,
 };
-static const int16_t ac_qlookup_QTX[AV1_QINDEX_RANGE] = {
-  4,    8,    9,    10,   11,   12,   13,   14,   15,   16,   17,   18,   19,
-  20,   21,   22,   23,   24,   25,   26,   27,   28,   29,   30,   31,   32,
-  33,   34,   35,   36,   37,   38,   39,   40,   41,   42,   43,   44,   45,
-  46,   47,   48,   49,   50,   51,   52,   53,   54,   55,   56,   57,   58,
-  59,   60,   61,   62,   63,   64,   65,   66,   67,   68,   69,   70,   71,
-  72,   73,   74,   75,   76,   77,   78,   79,   80,   81,   82,   83,   84,
-  85,   86,   87,   88,   89,   90,   91,   92,   93,   94,   95,   96,   97,
-  98,   99,   100,  101,  102,  104,  106,  108,  110,  112,  114,  116,  118,
-  120,  122,  124,  126,  128,  130,  132,  134,  136,  138,  140,  142,  144,
-  146,  148,  150,  152,  155,  158,  161,  164,  167,  170,  173,  176,  179,
-  182,  185,  188,  191,  194,  197,  200,  203,  207,  211,  215,  219,  223,
-  227,  231,  235,  239,  243,  247,  251,  255,  260,  265,  270,  275,  280,
-  285,  290,  295,  300,  305,  311,  317,  323,  329,  335,  341,  347,  353,
-  359,  366,  373,  380,  387,  394,  401,  408,  416,  424,  432,  440,  448,
-  456,  465,  474,  483,  492,  501,  510,  520,  530,  540,  550,  560,  571,
-  582,  593,  604,  615,  627,  639,  651,  663,  676,  689,  702,  715,  729,
-  743,  757,  771,  786,  801,  816,  832,  848,  864,  881,  898,  915,  933,
-  951,  969,  988,  1007, 1026, 1046, 1066, 1087, 1108, 1129, 1151, 1173, 1196,
-  1219, 1243, 1267, 1292, 1317, 1343, 1369, 1396, 1423, 1451, 1479, 1508, 1537,
-  1567, 1597, 1628, 1660, 1692, 1725, 1759, 1793, 1828,
-};
-static const int16_t ac_qlookup_10_QTX[AV1_QINDEX_RANGE] = {
-  4,    9,    11,   13,   16,   18,   21,   24,   27,   30,   33,   37,   40,
-  44,   48,   51,   55,   59,   63,   67,   71,   75,   79,   83,   88,   92,
-  96,   100,  105,  109,  114,  118,  122,  127,  131,  136,  140,  145,  149,
-  154,  158,  163,  168,  172,  177,  181,  186,  190,  195,  199,  204,  208,
-  213,  217,  222,  226,  231,  235,  240,  244,  249,  253,  258,  262,  267,
-  271,  275,  280,  284,  289,  293,  297,  302,  306,  311,  315,  319,  324,
-  328,  332,  337,  341,  345,  349,  354,  358,  362,  367,  371,  375,  379,
-  384,  388,  392,  396,  401,  409,  417,  425,  433,  441,  449,  458,  466,
-  474,  482,  490,  498,  506,  514,  523,  531,  539,  547,  555,  563,  571,
-  579,  588,  596,  604,  616,  628,  640,  652,  664,  676,  688,  700,  713,
-  725,  737,  749,  761,  773,  785,  797,  809,  825,  841,  857,  873,  889,
-  905,  922,  938,  954,  970,  986,  1002, 1018, 1038, 1058, 1078, 1098, 1118,
-  1138, 1158, 1178, 1198, 1218, 1242, 1266, 1290, 1314, 1338, 1362, 1386, 1411,
-  1435, 1463, 1491, 1519, 1547, 1575, 1603, 1631, 1663, 1695, 1727, 1759, 1791,
-  1823, 1859, 1895, 1931, 1967, 2003, 2039, 2079, 2119, 2159, 2199, 2239, 2283,
-  2327, 2371, 2415, 2459, 2507, 2555, 2603, 2651, 2703, 2755, 2807, 2859, 2915,
-  2971, 3027, 3083, 3143, 3203, 3263, 3327, 3391, 3455, 3523, 3591, 3659, 3731,
-  3803, 3876, 3952, 4028, 4104, 4184, 4264, 4348, 4432, 4516, 4604, 4692, 4784,
-  4876, 4972, 5068, 5168, 5268, 5372, 5476, 5584, 5692, 5804, 5916, 6032, 6148,
-  6268, 6388, 6512, 6640, 6768, 6900, 7036, 7172, 7312,
-};
-static const int16_t ac_qlookup_12_QTX[AV1_QINDEX_RANGE] = {
-  4,     13,    19,    27,    35,    44,    54,    64,    75,    87,    99,
-  112,   126,   139,   154,   168,   183,   199,   214,   230,   247,   263,
-  280,   297,   314,   331,   349,   366,   384,   402,   420,   438,   456,
-  475,   493,   511,   530,   548,   567,   586,   604,   623,   642,   660,
-  679,   698,   716,   735,   753,   772,   791,   809,   828,   846,   865,
-  884,   902,   920,   939,   957,   976,   994,   1012,  1030,  1049,  1067,
-  1085,  1103,  1121,  1139,  1157,  1175,  1193,  1211,  1229,  1246,  1264,
-  1282,  1299,  1317,  1335,  1352,  1370,  1387,  1405,  1422,  1440,  1457,
-  1474,  1491,  1509,  1526,  1543,  1560,  1577,  1595,  1627,  1660,  1693,
-  1725,  1758,  1791,  1824,  1856,  1889,  1922,  1954,  1987,  2020,  2052,
-  2085,  2118,  2150,  2183,  2216,  2248,  2281,  2313,  2346,  2378,  2411,
-  2459,  2508,  2556,  2605,  2653,  2701,  2750,  2798,  2847,  2895,  2943,
-  2992,  3040,  3088,  3137,  3185,  3234,  3298,  3362,  3426,  3491,  3555,
-  3619,  3684,  3748,  3812,  3876,  3941,  4005,  4069,  4149,  4230,  4310,
-  4390,  4470,  4550,  4631,  4711,  4791,  4871,  4967,  5064,  5160,  5256,
-  5352,  5448,  5544,  5641,  5737,  5849,  5961,  6073,  6185,  6297,  6410,
-  6522,  6650,  6778,  6906,  7034,  7162,  7290,  7435,  7579,  7723,  7867,
-  8011,  8155,  8315,  8475,  8635,  8795,  8956,  9132,  9308,  9484,  9660,
-  9836,  10028, 10220, 10412, 10604, 10812, 11020, 11228, 11437, 11661, 11885,
-  12109, 12333, 12573, 12813, 13053, 13309, 13565, 13821, 14093, 14365, 14637,
-  14925, 15213, 15502, 15806, 16110, 16414, 16734, 17054, 17390, 17726, 18062,
-  18414, 18766, 19134, 19502, 19886, 20270, 20670, 21070, 21486, 21902, 22334,
-  22766, 23214, 23662, 24126, 24590, 25070, 25551, 26047, 26559, 27071, 27599,
-  28143, 28687, 29247,
-};
-
 // Table that converts 0-63 Q-range values passed in outside to the Qindex
 // range used internally.
 static const int quantizer_to_qindex[] = {
@@ -266,19 +197,22 @@ static double resize_rate_factor(const FrameDimensionCfg *const frm_dim_cfg,
   return (double)(frm_dim_cfg->width * frm_dim_cfg->height) / (width * height);
 }
 
+// Spatial layers keep their own correction factors in the layer context, at
+// the resolution of the layer, so only a resize of a single layer stream
+// scales them.
+static double rate_factor_resize_scale(const AV1_COMP *cpi, int width,
+                                       int height) {
+  if (cpi->svc.number_spatial_layers > 1) return 1.0;
+  return resize_rate_factor(&cpi->oxcf.frm_dim_cfg, width, height);
+}
+
 // Functions to compute the active minq lookup table entries based on a
 // formulaic approach to facilitate easier adjustment of the Q tables.
 // The formulae were derived from computing a 3rd order polynomial best
 // fit to the original data (after plotting real maxq vs minq (not q index))
 static int get_minq_index(double maxq, double x3, double x2, double x1,
                           aom_bit_depth_t bit_depth) {
-  const double minqtarget = AOMMIN(((x3 * maxq + x2) * maxq + x1) * maxq, maxq);
-
-  // Special case handling to deal with the step from q2.0
-  // down to lossless mode represented by q 1.0.
-  if (minqtarget <= 2.0) return 0;
-
-  return av1_find_qindex(minqtarget, bit_depth, 0, AV1_QINDEX_RANGE - 1);
+  return brc_rc_get_minq_index(maxq, x3, x2, x1, bit_depth);
 }
 
 static void init_minq_luts(int *kf_low_m, int *kf_high_m, int *arfgf_low,
@@ -296,7 +230,9 @@ static void init_minq_luts(int *kf_low_m, int *kf_high_m, int *arfgf_low,
   }
 }
 
-void av1_rc_init_minq_luts(void) {
+static pthread_once_t minq_luts_once = PTHREAD_ONCE_INIT;
+
+static void build_minq_luts(void) {
   init_minq_luts(kf_low_motion_minq_8, kf_high_motion_minq_8,
                  arfgf_low_motion_minq_8, arfgf_high_motion_minq_8,
                  inter_minq_8, rtc_minq_8, AOM_BITS_8);
@@ -308,6 +244,10 @@ void av1_rc_init_minq_luts(void) {
                  inter_minq_12, rtc_minq_12, AOM_BITS_12);
 }
 
+void av1_rc_init_minq_luts(void) {
+  pthread_once(&minq_luts_once, build_minq_luts);
+}
+
 int16_t av1_dc_quant_QTX(int qindex, int delta, aom_bit_depth_t bit_depth) {
   const int q_clamped = clamp(qindex + delta, 0, AV1_MAXQ);
   switch (bit_depth) {
@@ -320,16 +260,11 @@ int16_t av1_dc_quant_QTX(int qindex, int delta, aom_bit_depth_t bit_depth) {
   }
 }
 
+// The ac quantizers of AV1 are the ones of VP9.
 int16_t av1_ac_quant_QTX(int qindex, int delta, aom_bit_depth_t bit_depth) {
-  const int q_clamped = clamp(qindex + delta, 0, AV1_MAXQ);
-  switch (bit_depth) {
-    case AOM_BITS_8: return ac_qlookup_QTX[q_clamped];
-    case AOM_BITS_10: return ac_qlookup_10_QTX[q_clamped];
-    case AOM_BITS_12: return ac_qlookup_12_QTX[q_clamped];
-    default:
-      assert(0 && "bit_depth should be AOM_BITS_8, AOM_BITS_10 or AOM_BITS_12");
-      return -1;
-  }
+  assert(bit_depth == AOM_BITS_8 || bit_depth == AOM_BITS_10 ||
+         bit_depth == AOM_BITS_12);
+  return brc_rc_ac_quant(qindex, delta, bit_depth);
 }
 
 
@@ -338,14 +273,7 @@ int16_t av1_ac_quant_QTX(int qindex, int delta, aom_bit_depth_t bit_depth) {
 // tables if and when things settle down in the experimental bitstream
 double av1_convert_qindex_to_q(int qindex, aom_bit_depth_t bit_depth) {
   // Convert the index to a real Q value (scaled down to match old Q values)
-  switch (bit_depth) {
-    case AOM_BITS_8: return av1_ac_quant_QTX(qindex, 0, bit_depth) / 4.0;
-    case AOM_BITS_10: return av1_ac_quant_QTX(qindex, 0, bit_depth) / 16.0;
-    case AOM_BITS_12: return av1_ac_quant_QTX(qindex, 0, bit_depth) / 64.0;
-    default:
-      assert(0 && "bit_depth should be AOM_BITS_8, AOM_BITS_10 or AOM_BITS_12");
-      return -1.0;
-  }
+  return brc_rc_convert_qindex_to_q(qindex, bit_depth);
 }
 
 
@@ -362,20 +290,58 @@ int av1_qindex_to_quantizer(int qindex) {
   return 63;
 }
 
-int av1_rc_bits_per_mb(AV1_FRAME_TYPE frame_type, int qindex,
-                       double correction_factor, aom_bit_depth_t bit_depth,
-                       const int is_screen_content_type) {
-  const double q = av1_convert_qindex_to_q(qindex, bit_depth);
+// Bits per block of the rate model at qindex are
+// numerator * correction_factor / denominator.
+static void rate_model(AV1_FRAME_TYPE frame_type, int qindex,
+                       aom_bit_depth_t bit_depth,
+                       const int is_screen_content_type, int32_t *numerator,
+                       int32_t *denominator) {
+  // q is ac_quant / q_scale.
+  const int ac_quant = av1_ac_quant_QTX(qindex, 0, bit_depth);
+  const int q_scale = brc_rc_q_scale(bit_depth);
   int enumerator = frame_type == AV1_KEY_FRAME ? 2000000 : 1500000;
   if (is_screen_content_type) {
     enumerator = frame_type == AV1_KEY_FRAME ? 1000000 : 750000;
   }
 
+  *numerator = enumerator * q_scale;
+  *denominator = ac_quant;
+}
+
+int av1_rc_bits_per_mb(AV1_FRAME_TYPE frame_type, int qindex,
+                       double correction_factor, aom_bit_depth_t bit_depth,
+                       const int is_screen_content_type) {
+  int32_t numerator, denominator;
+
   assert(correction_factor <= MAX_BPB_FACTOR &&
          correction_factor >= MIN_BPB_FACTOR);
 
-  // q based adjustment to baseline enumerator
-  return (int)(enumerator * correction_factor / q);
+  rate_model(frame_type, qindex, bit_depth, is_screen_content_type,
+             &numerator, &denominator);
+  return brc_rc_model_bits_per_mb(numerator, denominator, 0,
+                                  correction_factor);
+}
+
+static const BrcRcRateCurve *rate_curve(const AV1_COMP *cpi,
+                                        AV1_FRAME_TYPE frame_type) {
+  return &cpi->rate_curve[frame_type == AV1_KEY_FRAME ? 0 : 1];
+}
+
+void av1_rc_init_rate_curves(AV1_COMP *cpi) {
+  static const AV1_FRAME_TYPE frame_types[2] = { AV1_KEY_FRAME,
+                                                 AV1_INTER_FRAME };
+  int i, qindex;
+
+  for (i = 0; i < 2; i++) {
+    BrcRcRateCurve *curve = &cpi->rate_curve[i];
+    for (qindex = 0; qindex < AV1_QINDEX_RANGE; qindex++)
+      rate_model(frame_types[i], qindex, cpi->common.seq_params.bit_depth,
+                 cpi->is_screen_content_type, &curve->numerator[qindex],
+                 &curve->denominator[qindex]);
+    curve->num_q = AV1_QINDEX_RANGE;
+    curve->round = 0;
+    brc_rc_init_rate_curve(curve);
+  }
 }
 
 int av1_estimate_bits_at_q(AV1_FRAME_TYPE frame_type, int q, int mbs,
@@ -384,12 +350,13 @@ int av1_estimate_bits_at_q(AV1_FRAME_TYPE frame_type, int q, int mbs,
   const int bpm = (int)(av1_rc_bits_per_mb(frame_type, q, correction_factor,
                                            bit_depth, is_screen_content_type));
   return AOMMAX(FRAME_OVERHEAD_BITS,
-                (int)((uint64_t)bpm * mbs) >> BPER_MB_NORMBITS);
+                (int)AOMMIN(((uint64_t)bpm * mbs) >> BPER_MB_NORMBITS,
+                            INT_MAX));
 }
 
 int av1_rc_clamp_pframe_target_size(const AV1_COMP *const cpi, int target,
                                     FRAME_UPDATE_TYPE frame_update_type) {
-  const AV1_RATE_CONTROL *rc = &cpi->rc;
+  const AV1_RATE_CONTROL *rc = cpi->rc;
   const AV1EncoderConfig *oxcf = &cpi->oxcf;
   const int min_frame_target =
       AOMMAX(rc->min_frame_bandwidth, rc->avg_frame_bandwidth >> 5);
@@ -417,7 +384,7 @@ int av1_rc_clamp_pframe_target_size(const AV1_COMP *const cpi, int target,
 }
 
 int av1_rc_clamp_iframe_target_size(const AV1_COMP *const cpi, int target) {
-  const AV1_RATE_CONTROL *rc = &cpi->rc;
+  const AV1_RATE_CONTROL *rc = cpi->rc;
   const RateControlCfg *const rc_cfg = &cpi->oxcf.rc_cfg;
   if (rc_cfg->max_intra_bitrate_pct) {
     const int max_rate =
@@ -449,7 +416,7 @@ static void update_layer_buffer_level(AV1_SVC *svc, int encoded_frame_size) {
 // Update the buffer level: leaky bucket model.
 static void update_buffer_level(AV1_COMP *cpi, int encoded_frame_size) {
   const AV1_COMMON *const cm = &cpi->common;
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *const rc = cpi->rc;
 
   // Non-viewable frames are a special case and are treated as pure overhead.
   if (!cm->show_frame)
@@ -480,6 +447,7 @@ void av1_rc_init(const AV1EncoderConfig *oxcf, int pass, AV1_RATE_CONTROL *rc) {
 
   rc->last_q[AV1_KEY_FRAME] = rc_cfg->best_allowed_q;
   rc->last_q[AV1_INTER_FRAME] = rc_cfg->worst_allowed_q;
+  rc->last_coded_qindex = rc_cfg->worst_allowed_q;
 
   rc->buffer_level = rc->starting_buffer_level;
   rc->bits_off_target = rc->starting_buffer_level;
@@ -501,7 +469,7 @@ void av1_rc_init(const AV1EncoderConfig *oxcf, int pass, AV1_RATE_CONTROL *rc) {
 
   rc->tot_q = 0.0;
   rc->avg_q = av1_convert_qindex_to_q(rc_cfg->worst_allowed_q,
-                                      AOM_BITS_8);//ToDo: Add dynamic control
+                                      oxcf->input_cfg.input_bit_depth);
 
   for (i = 0; i < AV1_RATE_FACTOR_LEVELS; ++i) {
     rc->rate_correction_factors[i] = 0.7;
@@ -517,7 +485,7 @@ void av1_rc_init(const AV1EncoderConfig *oxcf, int pass, AV1_RATE_CONTROL *rc) {
 
 int av1_rc_drop_frame(AV1_COMP *cpi) {
   const AV1EncoderConfig *oxcf = &cpi->oxcf;
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *const rc = cpi->rc;
 
   if (!oxcf->rc_cfg.drop_frames_water_mark) {
     return 0;
@@ -552,7 +520,7 @@ int av1_rc_drop_frame(AV1_COMP *cpi) {
 }
 
 static int adjust_q_cbr(const AV1_COMP *cpi, int q, int active_worst_quality) {
-  const AV1_RATE_CONTROL *const rc = &cpi->rc;
+  const AV1_RATE_CONTROL *const rc = cpi->rc;
   const AV1_COMMON *const cm = &cpi->common;
   const int max_delta = 16;
   const int change_avg_frame_bandwidth =
@@ -567,7 +535,8 @@ static int adjust_q_cbr(const AV1_COMP *cpi, int q, int active_worst_quality) {
   // Apply some control/clamp to QP under certain conditions.
   // ToDo (important): Add control to provide refresh_frame_flags
   if (cm->current_frame.frame_type != AV1_KEY_FRAME && !cpi->use_svc &&
-      rc->frames_since_key > 1 && !change_target_bits_mb /*&&
+      rc->frames_since_key > 1 && !change_target_bits_mb &&
+      !rc->high_source_sad /*&&
       (!cpi->oxcf.rc_cfg.gf_cbr_boost_pct ||
        !(refresh_frame_flags->alt_ref_frame ||
          refresh_frame_flags->golden_frame))*/) {
@@ -608,7 +577,7 @@ static int adjust_q_cbr(const AV1_COMP *cpi, int q, int active_worst_quality) {
       (cm->width * cm->height >
        1.5 * cm->prev_frame.width * cm->prev_frame.height))
     q = (q + active_worst_quality) >> 1;
-  return AOMMAX(AOMMIN(q, cpi->rc.worst_quality), cpi->rc.best_quality);
+  return AOMMAX(AOMMIN(q, cpi->rc->worst_quality), cpi->rc->best_quality);
 }
 
 /*!\brief Gets a rate vs Q correction factor
@@ -626,7 +595,7 @@ static int adjust_q_cbr(const AV1_COMP *cpi, int q, int active_worst_quality) {
  */
 static double get_rate_correction_factor(const AV1_COMP *cpi, int width,
                                          int height) {
-  const AV1_RATE_CONTROL *const rc = &cpi->rc;
+  const AV1_RATE_CONTROL *const rc = cpi->rc;
   double rcf;
 
   if (cpi->common.current_frame.frame_type == AV1_KEY_FRAME) {
@@ -637,7 +606,7 @@ static double get_rate_correction_factor(const AV1_COMP *cpi, int width,
     //ToDo: Add support for AV1_GF_ARF_STD case if gf_cbr_boost_pct >20
     rcf = rc->rate_correction_factors[AV1_INTER_NORMAL];
   }
-  rcf *= resize_rate_factor(&cpi->oxcf.frm_dim_cfg, width, height);
+  rcf *= rate_factor_resize_scale(cpi, width, height);
   return fclamp(rcf, MIN_BPB_FACTOR, MAX_BPB_FACTOR);
 }
 
@@ -658,10 +627,10 @@ static double get_rate_correction_factor(const AV1_COMP *cpi, int width,
  */
 static void set_rate_correction_factor(AV1_COMP *cpi, double factor, int width,
                                        int height) {
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *const rc = cpi->rc;
 
   // Normalize RCF to account for the size-dependent scaling factor.
-  factor /= resize_rate_factor(&cpi->oxcf.frm_dim_cfg, width, height);
+  factor /= rate_factor_resize_scale(cpi, width, height);
 
   factor = fclamp(factor, MIN_BPB_FACTOR, MAX_BPB_FACTOR);
 
@@ -675,7 +644,10 @@ static void set_rate_correction_factor(AV1_COMP *cpi, double factor, int width,
   }
 }
 
-static int av1_get_MBs(int width, int height) {
+// The MB count of the current frame is kept with its size, other sizes are
+// counted here.
+static int av1_get_MBs(const AV1_COMMON *cm, int width, int height) {
+  if (width == cm->width && height == cm->height) return cm->mi_params.MBs;
   const int aligned_width = ALIGN_POWER_OF_TWO(width, 3);
   const int aligned_height = ALIGN_POWER_OF_TWO(height, 3);
   const int mi_cols = aligned_width >> MI_SIZE_LOG2;
@@ -693,153 +665,111 @@ void av1_rc_update_rate_correction_factors(AV1_COMP *cpi, int width,
   double rate_correction_factor =
       get_rate_correction_factor(cpi, width, height);
   double adjustment_limit;
-  const int MBs = av1_get_MBs(width, height);
+  const int MBs = av1_get_MBs(&cpi->common, width, height);
 
   int projected_size_based_on_q = 0;
 
   // Do not update the rate factors for arf overlay frames.
-  if (cpi->rc.is_src_frame_alt_ref) return;
+  if (cpi->rc->is_src_frame_alt_ref) return;
 
   // Work out how big we would have expected the frame to be at this Q given
   // the current correction factor.
   // Stay in double to avoid int overflow when values are large
-  //ToDo: add support for CYCLIC_REFRESH_AQ
-  projected_size_based_on_q = av1_estimate_bits_at_q(
+  if (cpi->roi.apply) {
+    projected_size_based_on_q =
+        av1_roi_estimate_bits_at_q(cpi, rate_correction_factor);
+  } else if (cpi->oxcf.q_cfg.aq_mode == AV1_CYCLIC_REFRESH_AQ &&
+             cpi->cyclic_refresh->apply_cyclic_refresh) {
+    projected_size_based_on_q =
+        av1_cyclic_refresh_estimate_bits_at_q(cpi, rate_correction_factor);
+  } else {
+    projected_size_based_on_q = av1_estimate_bits_at_q(
         cm->current_frame.frame_type, cm->quant_params.base_qindex, MBs,
         rate_correction_factor, cm->seq_params.bit_depth,
         cpi->is_screen_content_type);
+  }
   // Work out a size correction factor.
-  if (projected_size_based_on_q > FRAME_OVERHEAD_BITS)
-    correction_factor = (int)((100 * (int64_t)cpi->rc.projected_frame_size) /
-                              projected_size_based_on_q);
+  correction_factor = brc_rc_size_correction_factor(
+      cpi->rc->projected_frame_size, projected_size_based_on_q,
+      FRAME_OVERHEAD_BITS);
 
-  // More heavily damped adjustment used if we have been oscillating either side
-  // of target.
-  if (correction_factor > 0) {
-    adjustment_limit =
-        0.25 + 0.5 * AOMMIN(1, fabs(log10(0.01 * correction_factor)));
-  } else {
-    adjustment_limit = 0.75;
-  }
+  if (brc_rc_is_scene_change_size(correction_factor))
+    cpi->rc->high_source_sad = 1;
 
-  cpi->rc.q_2_frame = cpi->rc.q_1_frame;
-  cpi->rc.q_1_frame = cm->quant_params.base_qindex;
-  cpi->rc.rc_2_frame = cpi->rc.rc_1_frame;
-  if (correction_factor > 110)
-    cpi->rc.rc_1_frame = -1;
-  else if (correction_factor < 90)
-    cpi->rc.rc_1_frame = 1;
+  // More heavily damped adjustment used if we have been oscillating either side
+  // of target. No damping on a scene change, the model of the previous scene
+  // is of no use.
+  if (cpi->rc->high_source_sad)
+    adjustment_limit = 1.0;
   else
-    cpi->rc.rc_1_frame = 0;
-
-  if (correction_factor > 102) {
-    // We are not already at the worst allowable quality
-    correction_factor =
-        (int)(100 + ((correction_factor - 100) * adjustment_limit));
-    rate_correction_factor = (rate_correction_factor * correction_factor) / 100;
-    // Keep rate_correction_factor within limits
-    if (rate_correction_factor > MAX_BPB_FACTOR)
-      rate_correction_factor = MAX_BPB_FACTOR;
-  } else if (correction_factor < 99) {
-    // We are not already at the best allowable quality
-    correction_factor =
-        (int)(100 - ((100 - correction_factor) * adjustment_limit));
-    rate_correction_factor = (rate_correction_factor * correction_factor) / 100;
-
-    // Keep rate_correction_factor within limits
-    if (rate_correction_factor < MIN_BPB_FACTOR)
-      rate_correction_factor = MIN_BPB_FACTOR;
-  }
+    adjustment_limit = brc_rc_adjustment_limit(correction_factor);
+
+  brc_rc_update_q_history(cm->quant_params.base_qindex, correction_factor,
+                          &cpi->rc->q_1_frame, &cpi->rc->q_2_frame,
+                          &cpi->rc->rc_1_frame, &cpi->rc->rc_2_frame);
+  // Turn off oscillation detection across a scene change.
+  if (cpi->rc->high_source_sad) cpi->rc->rc_2_frame = 0;
+
+  rate_correction_factor = brc_rc_correct_rate_factor(
+      rate_correction_factor, correction_factor, adjustment_limit);
 
   set_rate_correction_factor(cpi, rate_correction_factor, width, height);
 }
 
-// Calculate rate for the given 'q'.
-static int get_bits_per_mb(const AV1_COMP *cpi,
-                           double correction_factor, int q) {
-  const AV1_COMMON *const cm = &cpi->common;
-  //ToDo: add support for av1_cyclic_refresh_rc_bits_per_mb
-  return av1_rc_bits_per_mb(cm->current_frame.frame_type, q,
-                                  correction_factor, cm->seq_params.bit_depth,
-                                  cpi->is_screen_content_type);
+// Rate model of the segments of the current frame: the frame and the bits
+// per block of its frame type at each q.
+typedef struct {
+  const AV1_COMP *cpi;
+  const int *bits_per_mb;
+} Av1SegmentRateModel;
+
+static int roi_bits_per_mb(const void *model, int q,
+                           double correction_factor) {
+  const Av1SegmentRateModel *m = (const Av1SegmentRateModel *)model;
+  (void)correction_factor;
+  return av1_roi_rc_bits_per_mb(m->cpi, q, m->bits_per_mb);
 }
 
-/*!\brief Searches for a Q index value predicted to give an average macro
- * block rate closest to the target value.
- *
- * Similar to find_qindex_by_rate() function, but returns a q index with a
- * rate just above or below the desired rate, depending on which of the two
- * rates is closer to the desired rate.
- * Also, respects the selected aq_mode when computing the rate.
- *
- * \ingroup rate_control
- * \param[in]   desired_bits_per_mb   Target bits per mb
- * \param[in]   cpi                   Top level encoder instance structure
- * \param[in]   correction_factor     Current Q to rate correction factor
- * \param[in]   best_qindex           Min allowed Q value.
- * \param[in]   worst_qindex          Max allowed Q value.
- *
- * \return Returns a correction factor for the current frame
- */
-static int find_closest_qindex_by_rate(int desired_bits_per_mb,
-                                       const AV1_COMP *cpi,
-                                       double correction_factor,
-                                       int best_qindex, int worst_qindex) {
-  // Find 'qindex' based on 'desired_bits_per_mb'.
-  assert(best_qindex <= worst_qindex);
-  int low = best_qindex;
-  int high = worst_qindex;
-  while (low < high) {
-    const int mid = (low + high) >> 1;
-    const int mid_bits_per_mb =
-        get_bits_per_mb(cpi, correction_factor, mid);
-    if (mid_bits_per_mb > desired_bits_per_mb) {
-      low = mid + 1;
-    } else {
-      high = mid;
-    }
-  }
-  assert(low == high);
-
-  // Calculate rate difference of this q index from the desired rate.
-  const int curr_q = low;
-  const int curr_bits_per_mb =
-      get_bits_per_mb(cpi, correction_factor, curr_q);
-  const int curr_bit_diff = (curr_bits_per_mb <= desired_bits_per_mb)
-                                ? desired_bits_per_mb - curr_bits_per_mb
-                                : INT_MAX;
-  assert((curr_bit_diff != INT_MAX && curr_bit_diff >= 0) ||
-         curr_q == worst_qindex);
-
-  // Calculate rate difference for previous q index too.
-  const int prev_q = curr_q - 1;
-  int prev_bit_diff;
-  if (curr_bit_diff == INT_MAX || curr_q == best_qindex) {
-    prev_bit_diff = INT_MAX;
-  } else {
-    const int prev_bits_per_mb =
-        get_bits_per_mb(cpi, correction_factor, prev_q);
-    assert(prev_bits_per_mb > desired_bits_per_mb);
-    prev_bit_diff = prev_bits_per_mb - desired_bits_per_mb;
-  }
-
-  // Pick one of the two q indices, depending on which one has rate closer to
-  // the desired rate.
-  return (curr_bit_diff <= prev_bit_diff) ? curr_q : prev_q;
+static int cyclic_refresh_bits_per_mb(const void *model, int q,
+                                      double correction_factor) {
+  const Av1SegmentRateModel *m = (const Av1SegmentRateModel *)model;
+  (void)correction_factor;
+  return av1_cyclic_refresh_rc_bits_per_mb(m->cpi, q, m->bits_per_mb);
 }
 
 int av1_rc_regulate_q(const AV1_COMP *cpi, int target_bits_per_frame,
                       int active_best_quality, int active_worst_quality,
                       int width, int height) {
-  const int MBs = av1_get_MBs(width, height);
+  const int MBs = av1_get_MBs(&cpi->common, width, height);
   const double correction_factor =
       get_rate_correction_factor(cpi, width, height);
   const int target_bits_per_mb =
       (int)(((uint64_t)target_bits_per_frame << BPER_MB_NORMBITS) / MBs);
+  const BrcRcRateCurve *const curve =
+      rate_curve(cpi, cpi->common.current_frame.frame_type);
+  int bits_per_mb[AV1_QINDEX_RANGE];
+  const Av1SegmentRateModel segments = { cpi, bits_per_mb };
+  brc_rc_bits_per_mb_fn model_bits_per_mb = brc_rc_curve_bits_per_mb;
+  const void *model = curve;
+  int q;
 
-  int q =
-      find_closest_qindex_by_rate(target_bits_per_mb, cpi, correction_factor,
-                                  active_best_quality, active_worst_quality);
+  // Calculate rate for the given 'q', respecting the selected aq_mode. The
+  // segments evaluate the curve of the frame at several qs for each q of
+  // the search, they look them up in the whole curve evaluated at once.
+  if (cpi->roi.apply) {
+    model_bits_per_mb = roi_bits_per_mb;
+    model = &segments;
+  } else if (cpi->oxcf.q_cfg.aq_mode == AV1_CYCLIC_REFRESH_AQ &&
+             cpi->cyclic_refresh->apply_cyclic_refresh) {
+    model_bits_per_mb = cyclic_refresh_bits_per_mb;
+    model = &segments;
+  }
+  if (model == &segments)
+    brc_rc_rate_curve_bits_per_mb(curve, correction_factor, bits_per_mb);
+
+  q = brc_rc_find_closest_q_by_rate(target_bits_per_mb, model_bits_per_mb,
+                                    model, correction_factor,
+                                    active_best_quality, active_worst_quality);
   if (cpi->oxcf.rc_cfg.mode == AOM_CBR)
     return adjust_q_cbr(cpi, q, active_worst_quality);
 
@@ -879,7 +809,7 @@ static int calc_active_worst_quality_no_stats_cbr(const AV1_COMP *cpi) {
   // ambient Q (at buffer = optimal level) to worst_quality level
   // (at buffer = critical level).
   const AV1_COMMON *const cm = &cpi->common;
-  const AV1_RATE_CONTROL *rc = &cpi->rc;
+  const AV1_RATE_CONTROL *rc = cpi->rc;
   // Buffer level below which we push active_worst to worst_quality.
   int64_t critical_level = rc->optimal_buffer_level >> 3;
   int64_t buff_lvl_step = 0;
@@ -932,7 +862,7 @@ static int calc_active_best_quality_no_stats_cbr(const AV1_COMP *cpi,
                                                  int active_worst_quality,
                                                  int width, int height) {
   const AV1_COMMON *const cm = &cpi->common;
-  const AV1_RATE_CONTROL *const rc = &cpi->rc;
+  const AV1_RATE_CONTROL *const rc = cpi->rc;
   const CurrentFrame *const current_frame = &cm->current_frame;
   int *rtc_minq;
   const int bit_depth = cm->seq_params.bit_depth;
@@ -1001,10 +931,9 @@ static int rc_pick_q_and_bounds_no_stats_cbr(const AV1_COMP *cpi, int width,
                                              int height, int *bottom_index,
                                              int *top_index) {
   const AV1_COMMON *const cm = &cpi->common;
-  const AV1_RATE_CONTROL *const rc = &cpi->rc;
+  const AV1_RATE_CONTROL *const rc = cpi->rc;
   const CurrentFrame *const current_frame = &cm->current_frame;
   int q;
-  const int bit_depth = cm->seq_params.bit_depth;
   int active_worst_quality = calc_active_worst_quality_no_stats_cbr(cpi);
   int active_best_quality = calc_active_best_quality_no_stats_cbr(
       cpi, active_worst_quality, width, height);
@@ -1023,9 +952,8 @@ static int rc_pick_q_and_bounds_no_stats_cbr(const AV1_COMP *cpi, int width,
   if (current_frame->frame_type == AV1_KEY_FRAME && !rc->this_key_frame_forced &&
       current_frame->frame_number != 0) {
     int qdelta = 0;
-    qdelta = av1_compute_qdelta_by_rate(&cpi->rc, current_frame->frame_type,
-                                        active_worst_quality, 2.0,
-                                        cpi->is_screen_content_type, bit_depth);
+    qdelta = av1_compute_qdelta_by_rate(cpi, current_frame->frame_type,
+                                        active_worst_quality, 2.0);
     *top_index = active_worst_quality + qdelta;
     *top_index = AOMMAX(*top_index, *bottom_index);
   }
@@ -1095,29 +1023,36 @@ void av1_check_initial_width(AV1_COMP *cpi, int use_highbitdepth,
   }
 }
 
+#endif
+
+// The mode info geometry part of av1_set_mb_mi() of libaom, for a frame of
+// the given size.
+void av1_set_mb_mi(CommonModeInfoParams *mi_params, int width, int height) {
+  const int aligned_width = ALIGN_POWER_OF_TWO(width, 3);
+  const int aligned_height = ALIGN_POWER_OF_TWO(height, 3);
+
+  mi_params->mi_cols = aligned_width >> MI_SIZE_LOG2;
+  mi_params->mi_rows = aligned_height >> MI_SIZE_LOG2;
+
+  mi_params->mb_cols = (mi_params->mi_cols + 2) >> 2;
+  mi_params->mb_rows = (mi_params->mi_rows + 2) >> 2;
+  mi_params->MBs = mi_params->mb_rows * mi_params->mb_cols;
+}
+
 // Returns 1 if the assigned width or height was <= 0.
 int av1_set_size_literal(AV1_COMP *cpi, int width, int height) {
   AV1_COMMON *cm = &cpi->common;
-  InitialDimensions *const initial_dimensions = &cpi->initial_dimensions;
-  av1_check_initial_width(cpi, cm->seq_params.use_highbitdepth,
-                          cm->seq_params.subsampling_x,
-                          cm->seq_params.subsampling_y);
-  
+
   if (width <= 0 || height <= 0) return 1;
-  
-  cm->width = width;   
+
+  cm->width = width;
   cm->height = height;
-  
-  if (initial_dimensions->width && initial_dimensions->height &&
-      (cm->width > initial_dimensions->width ||
-       cm->height > initial_dimensions->height)) {
-    initial_dimensions->width = initial_dimensions->height = 0;
-  }
-  update_frame_size(cpi);
+  // Only the frame geometry of update_frame_size() is needed, the rate
+  // model works on the MB count of the frame.
+  av1_set_mb_mi(&cm->mi_params, width, height);
 
   return 0;
 }
-#endif
 void av1_rc_compute_frame_size_bounds(const AV1_COMP *cpi, int frame_target,
                                       int *frame_under_shoot_limit,
                                       int *frame_over_shoot_limit) {
@@ -1132,12 +1067,12 @@ void av1_rc_compute_frame_size_bounds(const AV1_COMP *cpi, int frame_target,
         100, ((int64_t)cpi->sf.hl_sf.recode_tolerance * frame_target) / 100);
     *frame_under_shoot_limit = AOMMAX(frame_target - tolerance, 0);
     *frame_over_shoot_limit =
-        AOMMIN(frame_target + tolerance, cpi->rc.max_frame_bandwidth);
+        AOMMIN(frame_target + tolerance, cpi->rc->max_frame_bandwidth);
   }
 }
 
 void av1_rc_set_frame_target(AV1_COMP *cpi, int target, int width, int height) {
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *const rc = cpi->rc;
 
   rc->this_frame_target = target;
 
@@ -1149,15 +1084,17 @@ void av1_rc_set_frame_target(AV1_COMP *cpi, int target, int width, int height) {
 void av1_rc_postencode_update(AV1_COMP *cpi, uint64_t bytes_used) {
   const AV1_COMMON *const cm = &cpi->common;
   const CurrentFrame *const current_frame = &cm->current_frame;
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *const rc = cpi->rc;
 
   const int qindex = cm->quant_params.base_qindex;
 
   // Update rate control heuristics
   rc->projected_frame_size = (int)(bytes_used << 3);
 
-  // Post encode loop adjustment of Q prediction.
-  av1_rc_update_rate_correction_factors(cpi, cm->width, cm->height);
+  // Post encode loop adjustment of Q prediction. An unchanged frame is
+  // mostly skipped blocks and says nothing about the rate at its q.
+  if (!cpi->frame_unchanged)
+    av1_rc_update_rate_correction_factors(cpi, cm->width, cm->height);
 
   //Fixme(Important): make else case default for all p frames in non-svc case???
   //
@@ -1200,6 +1137,18 @@ void av1_rc_postencode_update(AV1_COMP *cpi, uint64_t bytes_used) {
   }
   if (current_frame->frame_type == AV1_KEY_FRAME) rc->last_kf_qindex = qindex;
 
+  // The frame is a reference of the upper temporal layers as well.
+  rc->last_coded_qindex = qindex;
+  if (cpi->use_svc) {
+    AV1_SVC *const svc = &cpi->svc;
+    for (int tl = svc->temporal_layer_id + 1;
+         tl < svc->number_temporal_layers; ++tl) {
+      const int layer = LAYER_IDS_TO_IDX(svc->spatial_layer_id, tl,
+                                         svc->number_temporal_layers);
+      svc->layer_context[layer].rc.last_coded_qindex = qindex;
+    }
+  }
+
   update_buffer_level(cpi, rc->projected_frame_size);
   rc->prev_avg_frame_bandwidth = rc->avg_frame_bandwidth;
 
@@ -1233,30 +1182,15 @@ void av1_rc_postencode_update(AV1_COMP *cpi, uint64_t bytes_used) {
 void av1_rc_postencode_update_drop_frame(AV1_COMP *cpi) {
   // Update buffer level with zero size, update frame counters, and return.
   update_buffer_level(cpi, 0);
-  cpi->rc.frames_since_key++;
-  cpi->rc.frames_to_key--;
-  cpi->rc.rc_2_frame = 0;
-  cpi->rc.rc_1_frame = 0;
+  cpi->rc->frames_since_key++;
+  cpi->rc->frames_to_key--;
+  cpi->rc->rc_2_frame = 0;
+  cpi->rc->rc_1_frame = 0;
 }
 
 int av1_find_qindex(double desired_q, aom_bit_depth_t bit_depth,
                     int best_qindex, int worst_qindex) {
-  assert(best_qindex <= worst_qindex);
-  int low = best_qindex;
-  int high = worst_qindex;
-  while (low < high) {
-    const int mid = (low + high) >> 1;
-    const double mid_q = av1_convert_qindex_to_q(mid, bit_depth);
-    if (mid_q < desired_q) {
-      low = mid + 1;
-    } else {
-      high = mid;
-    }
-  }
-  assert(low == high);
-  assert(av1_convert_qindex_to_q(low, bit_depth) >= desired_q ||
-         low == worst_qindex);
-  return low;
+  return brc_rc_find_qindex(desired_q, bit_depth, best_qindex, worst_qindex);
 }
 
 int av1_compute_qdelta(const AV1_RATE_CONTROL *rc, double qstart, double qtarget,
@@ -1268,57 +1202,29 @@ int av1_compute_qdelta(const AV1_RATE_CONTROL *rc, double qstart, double qtarget
   return target_index - start_index;
 }
 
-// Find q_index for the desired_bits_per_mb, within [best_qindex, worst_qindex],
-// assuming 'correction_factor' is 1.0.
-// To be precise, 'q_index' is the smallest integer, for which the corresponding
-// bits per mb <= desired_bits_per_mb.
-// If no such q index is found, returns 'worst_qindex'.
-static int find_qindex_by_rate(int desired_bits_per_mb,
-                               aom_bit_depth_t bit_depth, AV1_FRAME_TYPE frame_type,
-                               const int is_screen_content_type,
-                               int best_qindex, int worst_qindex) {
-  assert(best_qindex <= worst_qindex);
-  int low = best_qindex;
-  int high = worst_qindex;
-  while (low < high) {
-    const int mid = (low + high) >> 1;
-    const int mid_bits_per_mb = av1_rc_bits_per_mb(
-        frame_type, mid, 1.0, bit_depth, is_screen_content_type);
-    if (mid_bits_per_mb > desired_bits_per_mb) {
-      low = mid + 1;
-    } else {
-      high = mid;
-    }
-  }
-  assert(low == high);
-  assert(av1_rc_bits_per_mb(frame_type, low, 1.0, bit_depth,
-                            is_screen_content_type) <= desired_bits_per_mb ||
-         low == worst_qindex);
-  return low;
-}
+int av1_compute_qdelta_by_rate(const AV1_COMP *cpi, AV1_FRAME_TYPE frame_type,
+                               int qindex, double rate_target_ratio) {
+  const AV1_RATE_CONTROL *const rc = cpi->rc;
+  const BrcRcRateCurve *const curve = rate_curve(cpi, frame_type);
 
-int av1_compute_qdelta_by_rate(const AV1_RATE_CONTROL *rc, AV1_FRAME_TYPE frame_type,
-                               int qindex, double rate_target_ratio,
-                               const int is_screen_content_type,
-                               aom_bit_depth_t bit_depth) {
   // Look up the current projected bits per block for the base index
-  const int base_bits_per_mb = av1_rc_bits_per_mb(
-      frame_type, qindex, 1.0, bit_depth, is_screen_content_type);
+  const int base_bits_per_mb = curve->unit_bits_per_mb[qindex];
 
   // Find the target bits per mb based on the base value and given ratio.
   const int target_bits_per_mb = (int)(rate_target_ratio * base_bits_per_mb);
 
-  const int target_index = find_qindex_by_rate(
-      target_bits_per_mb, bit_depth, frame_type, is_screen_content_type,
-      rc->best_quality, rc->worst_quality);
+  // The smallest qindex whose rate is at most the target one.
+  const int target_index = brc_rc_find_q_by_rate(
+      target_bits_per_mb, brc_rc_table_bits_per_mb, curve->unit_bits_per_mb,
+      1.0, rc->best_quality, rc->worst_quality);
   return target_index - qindex;
 }
 
 void av1_rc_update_framerate(AV1_COMP *cpi, int width, int height) {
   const AV1EncoderConfig *const oxcf = &cpi->oxcf;
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *const rc = cpi->rc;
   int vbr_max_bits;
-  const int MBs = av1_get_MBs(width, height);
+  const int MBs = av1_get_MBs(&cpi->common, width, height);
 
   rc->avg_frame_bandwidth =
       (int)(oxcf->rc_cfg.target_bandwidth / cpi->framerate);
@@ -1344,7 +1250,7 @@ void av1_rc_update_framerate(AV1_COMP *cpi, int width, int height) {
 }
 
 void av1_set_target_rate(AV1_COMP *cpi, int width, int height) {
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *const rc = cpi->rc;
   int target_rate = rc->base_frame_target;
 
   av1_rc_set_frame_target(cpi, target_rate, width, height);
@@ -1352,7 +1258,7 @@ void av1_set_target_rate(AV1_COMP *cpi, int width, int height) {
 
 int av1_calc_pframe_target_size_one_pass_cbr(const AV1_COMP *cpi) {
   const AV1EncoderConfig *oxcf = &cpi->oxcf;
-  const AV1_RATE_CONTROL *rc = &cpi->rc;
+  const AV1_RATE_CONTROL *rc = cpi->rc;
   const RateControlCfg *rc_cfg = &oxcf->rc_cfg;
   const int64_t diff = rc->optimal_buffer_level - rc->buffer_level;
   const int64_t one_pct_bits = 1 + rc->optimal_buffer_level / 100;
@@ -1392,35 +1298,85 @@ int av1_calc_pframe_target_size_one_pass_cbr(const AV1_COMP *cpi) {
   return AOMMAX(min_frame_target, target);
 }
 
-int av1_calc_iframe_target_size_one_pass_cbr(const AV1_COMP *cpi) {
-  const AV1_RATE_CONTROL *rc = &cpi->rc;
+// There is no coded frame to size the first key frame on: take the rate
+// model for the frame size, bit depth and content type at the q the inter
+// frames are expected to settle at, boosted like a later key frame so that
+// the quality does not pop after it. Screen content codes its key frame at
+// the cost of many static inter frames and gets twice the boost. An eighth
+// of the starting buffer is the floor and the whole buffer the upper bound.
+static int first_iframe_target_size(const AV1_COMP *cpi) {
+  const AV1_COMMON *const cm = &cpi->common;
+  const AV1_RATE_CONTROL *rc = cpi->rc;
+  const aom_bit_depth_t bit_depth = cm->seq_params.bit_depth;
+  const int mbs = cm->mi_params.MBs;
+  int kf_boost = AOMMAX(32, (int)(2 * cpi->framerate - 16));
+  int64_t prior;
+  int q = rc->best_quality;
+
+  if (cpi->is_screen_content_type) kf_boost *= 2;
+  while (q < rc->worst_quality &&
+         av1_estimate_bits_at_q(AV1_INTER_FRAME, q, mbs, 1.0, bit_depth,
+                                cpi->is_screen_content_type) >
+             rc->avg_frame_bandwidth)
+    q++;
+  prior = ((int64_t)av1_estimate_bits_at_q(AV1_KEY_FRAME, q, mbs, 1.0,
+                                           bit_depth,
+                                           cpi->is_screen_content_type) *
+           (16 + kf_boost)) >>
+          4;
+  prior = AOMMAX(prior, rc->starting_buffer_level / 8);
+  return (int)AOMMIN(AOMMIN(prior, rc->starting_buffer_level), INT_MAX);
+}
+
+// Target of a key frame coded frames_ahead frames after the next one.
+static int iframe_target_size_one_pass_cbr(const AV1_COMP *cpi,
+                                           int frames_ahead) {
+  const AV1_RATE_CONTROL *rc = cpi->rc;
+  const int frames_since_key = rc->frames_since_key + frames_ahead;
   int target;
-  if (cpi->common.current_frame.frame_number == 0) {
-    target = ((rc->starting_buffer_level / 2) > INT_MAX)
-                 ? INT_MAX
-                 : (int)(rc->starting_buffer_level / 2);
+  if (cpi->common.current_frame.frame_number + frames_ahead == 0) {
+    target = first_iframe_target_size(cpi);
   } else {
     int kf_boost = 32;
     double framerate = cpi->framerate;
 
     kf_boost = AOMMAX(kf_boost, (int)(2 * framerate - 16));
-    if (rc->frames_since_key < framerate / 2) {
-      kf_boost = (int)(kf_boost * rc->frames_since_key / (framerate / 2));
+    if (frames_since_key < framerate / 2) {
+      kf_boost = (int)(kf_boost * frames_since_key / (framerate / 2));
     }
     target = ((16 + kf_boost) * rc->avg_frame_bandwidth) >> 4;
   }
   return av1_rc_clamp_iframe_target_size(cpi, target);
 }
 
+int av1_calc_iframe_target_size_one_pass_cbr(const AV1_COMP *cpi) {
+  return iframe_target_size_one_pass_cbr(cpi, 0);
+}
+
+int av1_predict_key_frame_size(const AV1_COMP *cpi, int frames_ahead) {
+  const AV1_COMMON *const cm = &cpi->common;
+  const AV1_RATE_CONTROL *rc = cpi->rc;
+  const double rcf = fclamp(rc->rate_correction_factors[AV1_KF_STD],
+                            MIN_BPB_FACTOR, MAX_BPB_FACTOR);
+  // Whatever its target, the key frame is coded within the q range.
+  const int min_size = av1_estimate_bits_at_q(
+      AV1_KEY_FRAME, rc->worst_quality, cm->mi_params.MBs, rcf,
+      cm->seq_params.bit_depth, cpi->is_screen_content_type);
+  const int max_size = av1_estimate_bits_at_q(
+      AV1_KEY_FRAME, rc->best_quality, cm->mi_params.MBs, rcf,
+      cm->seq_params.bit_depth, cpi->is_screen_content_type);
+  const int target = iframe_target_size_one_pass_cbr(cpi, frames_ahead);
+  return AOMMAX(min_size, AOMMIN(target, max_size));
+}
+
 
 #define DEFAULT_KF_BOOST_RT 2300
 #define DEFAULT_GF_BOOST_RT 2000
 
 void av1_get_one_pass_rt_params(AV1_COMP *cpi,
 		                AV1_FRAME_TYPE frame_type) {
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *rc;
   AV1_COMMON *const cm = &cpi->common;
-  GF_GROUP *const gf_group = &cpi->gf_group;
   AV1_SVC *const svc = &cpi->svc;
   int target;
   const int layer =
@@ -1432,6 +1388,7 @@ void av1_get_one_pass_rt_params(AV1_COMP *cpi,
     av1_update_temporal_layer_framerate(cpi);
     av1_restore_layer_context(cpi);
   }
+  rc = cpi->rc;
   //Fixme(Important): evaluate the svc use case
   // Set frame type.
   //if ((!cpi->use_svc && rc->frames_to_key == 0) ||
@@ -1443,18 +1400,12 @@ void av1_get_one_pass_rt_params(AV1_COMP *cpi,
     //    cm->current_frame.frame_number != 0 && rc->frames_to_key == 0;
     rc->frames_to_key = cpi->oxcf.kf_cfg.key_freq_max;
     rc->kf_boost = DEFAULT_KF_BOOST_RT;
-    gf_group->update_type[gf_group->index] = KF_UPDATE;
-    gf_group->frame_type[gf_group->index] = AV1_KEY_FRAME;
-    gf_group->refbuf_state[gf_group->index] = REFBUF_RESET;
     if (cpi->use_svc) {
       if (cm->current_frame.frame_number > 0)
         av1_svc_reset_temporal_layers(cpi, 1);
       svc->layer_context[layer].is_key_frame = 1;
     }
   } else {
-    gf_group->update_type[gf_group->index] = LF_UPDATE;
-    gf_group->frame_type[gf_group->index] = AV1_INTER_FRAME;
-    gf_group->refbuf_state[gf_group->index] = REFBUF_UPDATE;
     //Fixme (Important): Fix the key-frame setting?
     if (cpi->use_svc) {
       AV1_LAYER_CONTEXT *lc = &svc->layer_context[layer];
@@ -1499,7 +1450,7 @@ void av1_get_one_pass_rt_params(AV1_COMP *cpi,
 
 int av1_encodedframe_overshoot_cbr(AV1_COMP *cpi, int *q) {
   AV1_COMMON *const cm = &cpi->common;
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *const rc = cpi->rc;
   AV1_SPEED_FEATURES *const sf = &cpi->sf;
   int thresh_qp = 7 * (rc->worst_quality >> 3);
   // Lower thresh_qp for video (more overshoot at lower Q) to be
@@ -1509,23 +1460,23 @@ int av1_encodedframe_overshoot_cbr(AV1_COMP *cpi, int *q) {
   if (sf->rt_sf.overshoot_detection_cbr == FAST_DETECTION_MAXQ &&
       cm->quant_params.base_qindex < thresh_qp) {
     double rate_correction_factor =
-        cpi->rc.rate_correction_factors[AV1_INTER_NORMAL];
-    const int target_size = cpi->rc.avg_frame_bandwidth;
+        cpi->rc->rate_correction_factors[AV1_INTER_NORMAL];
+    const int target_size = cpi->rc->avg_frame_bandwidth;
     double new_correction_factor;
     int target_bits_per_mb;
     double q2;
     int enumerator;
-    *q = (3 * cpi->rc.worst_quality + *q) >> 2;
+    *q = (3 * cpi->rc->worst_quality + *q) >> 2;
     // Adjust avg_frame_qindex, buffer_level, and rate correction factors, as
     // these parameters will affect QP selection for subsequent frames. If they
     // have settled down to a very different (low QP) state, then not adjusting
     // them may cause next frame to select low QP and overshoot again.
-    cpi->rc.avg_frame_qindex[AV1_INTER_FRAME] = *q;
+    cpi->rc->avg_frame_qindex[AV1_INTER_FRAME] = *q;
     rc->buffer_level = rc->optimal_buffer_level;
     rc->bits_off_target = rc->optimal_buffer_level;
     // Reset rate under/over-shoot flags.
-    cpi->rc.rc_1_frame = 0;
-    cpi->rc.rc_2_frame = 0;
+    cpi->rc->rc_1_frame = 0;
+    cpi->rc->rc_2_frame = 0;
     // Adjust rate correction factor.
     target_bits_per_mb =
         (int)(((uint64_t)target_size << BPER_MB_NORMBITS) / cm->mi_params.MBs);
@@ -1540,7 +1491,7 @@ int av1_encodedframe_overshoot_cbr(AV1_COMP *cpi, int *q) {
           AOMMIN(2.0 * rate_correction_factor, new_correction_factor);
       if (rate_correction_factor > MAX_BPB_FACTOR)
         rate_correction_factor = MAX_BPB_FACTOR;
-      cpi->rc.rate_correction_factors[AV1_INTER_NORMAL] = rate_correction_factor;
+      cpi->rc->rate_correction_factors[AV1_INTER_NORMAL] = rate_correction_factor;
     }
     return 1;
   } else {
@@ -122,9 +122,7 @@
 #define MAX_SEGMENTS 8
 
 #define MAX_MB_PLANE 3
-#define QM_TOTAL_SIZE 3344
 
-typedef uint8_t qm_val_t;
 #define AOM_QM_BITS 5
 
 typedef enum {
@@ -242,6 +240,8 @@ typedef enum {
 typedef struct {
   // Indicates the framerate of the input video.
   double init_framerate;
+  // Indicates the bit-depth of the input video.
+  aom_bit_depth_t input_bit_depth;
 } InputCfg;
 
 typedef struct {
@@ -396,11 +396,6 @@ typedef struct {
    * Indicates the percentage of rate boost for golden frame in CBR mode.
    */
   unsigned int gf_cbr_boost_pct;
-  /*!
-   * min_cr / 100 indicates the target minimum compression ratio for each
-   * frame.
-   */
-  unsigned int min_cr;
   /*!
    * Indicates the frame drop threshold.
    */
@@ -485,11 +480,6 @@ typedef enum {
  ENC_MODE_GOOD,
  ENC_MODE_REALTIME,
 } ENC_MODE;
-typedef struct {
-  int resize_width;
-  int resize_height;
-  uint8_t superres_denom;
-} size_params_type;
 
 typedef enum {
   AV1_INTER_NORMAL,
@@ -510,12 +500,6 @@ typedef enum {
   FRAME_UPDATE_TYPES
 } FRAME_UPDATE_TYPE;
 
-typedef enum {
-  REFBUF_RESET,   // Clear reference frame buffer
-  REFBUF_UPDATE,  // Refresh reference frame buffer
-  REFBUF_STATES
-} REFBUF_STATE;
-
 typedef enum {
   AV1_NO_RESIZE = 0,
   AV1_DOWN_THREEFOUR = 1,  // From orig to 3/4.
@@ -526,25 +510,6 @@ typedef enum {
 
 typedef enum { AV1_ORIG = 0, AV1_THREE_QUARTER = 1, AV1_ONE_HALF = 2 } AV1_RESIZE_STATE;
 
-#define MAX_FIRSTPASS_ANALYSIS_FRAMES 150
-typedef enum region_types {
-  STABLE_REGION = 0,
-  HIGH_VAR_REGION = 1,
-  SCENECUT_REGION = 2,
-  BLENDING_REGION = 3,
-} REGION_TYPES;
-
-typedef struct regions {
-  int start;
-  int last;
-  double avg_noise_var;
-  double avg_cor_coeff;
-  double avg_sr_fr_ratio;
-  double avg_intra_err;
-  double avg_coded_err;
-  REGION_TYPES type;
-} REGIONS;
-
 typedef enum {
   AV1_KEY_FRAME = 0,
   AV1_INTER_FRAME = 1,
@@ -572,98 +537,6 @@ typedef struct CommonQuantParams {
    * Base qindex of the frame in the range 0 to 255.
    */
   int base_qindex;
-
-  /*!
-   * Delta of qindex (from base_qindex) for Y plane DC coefficient.
-   * Note: y_ac_delta_q is implicitly 0.
-   */
-  int y_dc_delta_q;
-
-  /*!
-   * Delta of qindex (from base_qindex) for U plane DC coefficients.
-   */
-  int u_dc_delta_q;
-  /*!
-   * Delta of qindex (from base_qindex) for U plane AC coefficients.
-   */
-  int v_dc_delta_q;
-
-  /*!
-   * Delta of qindex (from base_qindex) for V plane DC coefficients.
-   * Same as those for U plane if cm->seq_params.separate_uv_delta_q == 0.
-   */
-  int u_ac_delta_q;
-  /*!
-   * Delta of qindex (from base_qindex) for V plane AC coefficients.
-   * Same as those for U plane if cm->seq_params.separate_uv_delta_q == 0.
-   */
-  int v_ac_delta_q;
-
-  /*
-   * Note: The qindex per superblock may have a delta from the qindex obtained
-   * at frame level from parameters above, based on 'cm->delta_q_info'.
-   */
-
-  /**
-   * \name True dequantizers.
-   * The dequantizers below are true dequantizers used only in the
-   * dequantization process.  They have the same coefficient
-   * shift/scale as TX.
-   */
-  /**@{*/
-  int16_t y_dequant_QTX[MAX_SEGMENTS][2]; /*!< Dequant for Y plane */
-  int16_t u_dequant_QTX[MAX_SEGMENTS][2]; /*!< Dequant for U plane */
-  int16_t v_dequant_QTX[MAX_SEGMENTS][2]; /*!< Dequant for V plane */
-  /**@}*/
-  /**
-   * \name Global quantization matrix tables.
-   */
-  /**@{*/
-  /*!
-   * Global dquantization matrix table.
-   */
-  const qm_val_t *giqmatrix[AV1_NUM_QM_LEVELS][3][TX_SIZES_ALL];
-  /*!
-   * Global quantization matrix table.
-   */
-  const qm_val_t *gqmatrix[AV1_NUM_QM_LEVELS][3][TX_SIZES_ALL];
-  /**@}*/
-
- /**
-   * \name Local dequantization matrix tables for each frame.
-   */
-  /**@{*/
-  /*!
-   * Local dequant matrix for Y plane.
-   */
-  const qm_val_t *y_iqmatrix[MAX_SEGMENTS][TX_SIZES_ALL];
-  /*!
-   * Local dequant matrix for U plane.
-   */
-  const qm_val_t *u_iqmatrix[MAX_SEGMENTS][TX_SIZES_ALL];
-  /*!
-   * Local dequant matrix for V plane.
-   */
-  const qm_val_t *v_iqmatrix[MAX_SEGMENTS][TX_SIZES_ALL];
-  /**@}*/
-
-  /*!
-   * Flag indicating whether quantization matrices are being used:
-   *  - If true, qm_level_y, qm_level_u and qm_level_v indicate the level
-   *    indices to be used to access appropriate global quant matrix tables.
-   *  - If false, we implicitly use level index 'AV1_NUM_QM_LEVELS - 1'.
-   */
-  unsigned int using_qmatrix;
- /**
-   * \name Valid only when using_qmatrix == true
-   * Indicate the level indices to be used to access appropriate global quant
-   * matrix tables.
-   */
-  /**@{*/
-  int qmatrix_level_y; /*!< Level index for Y plane */
-  int qmatrix_level_u; /*!< Level index for U plane */
-  int qmatrix_level_v; /*!< Level index for V plane */
-  /**@}*/
 }CommonQuantParams;
 
 
@@ -750,38 +623,6 @@ typedef struct {
 
 }KeyFrameCfg;
 
-/*!\endcond */
-/*!
- * \brief  Data related to the current GF/ARF group and the
- * individual frames within the group
- */
-typedef struct {
-  /*!\cond */
-  // The frame processing order within a GOP
-  unsigned char index;
-  // Frame update type, e.g. ARF/GF/LF/Overlay
-  FRAME_UPDATE_TYPE update_type[AV1_MAX_STATIC_GF_GROUP_LENGTH];
-  unsigned char arf_src_offset[AV1_MAX_STATIC_GF_GROUP_LENGTH];
-  // The number of frames displayed so far within the GOP at a given coding
-  // frame.
-  unsigned char cur_frame_idx[AV1_MAX_STATIC_GF_GROUP_LENGTH];
-  int layer_depth[AV1_MAX_STATIC_GF_GROUP_LENGTH];
-  int arf_boost[AV1_MAX_STATIC_GF_GROUP_LENGTH];
-  int max_layer_depth;
-  int max_layer_depth_allowed;
-  // This is currently only populated for AOM_Q mode
-  unsigned char q_val[AV1_MAX_STATIC_GF_GROUP_LENGTH];
-  int bit_allocation[AV1_MAX_STATIC_GF_GROUP_LENGTH];
-  // The frame coding type - inter/intra frame
-  AV1_FRAME_TYPE frame_type[AV1_MAX_STATIC_GF_GROUP_LENGTH];
-  // The reference frame buffer control - update or reset
-  REFBUF_STATE refbuf_state[AV1_MAX_STATIC_GF_GROUP_LENGTH];
-  int arf_index;  // the index in the gf group of ARF, if no arf, then -1
-  int size;       // The total length of a GOP
-  /*!\endcond */
-} GF_GROUP;
-/*!\cond */
-
 /*!\endcond */
 /*!
  * \brief  Rate Control parameters and status
@@ -799,21 +640,11 @@ typedef struct {
    */
   int this_frame_target;  // Actual frame target after rc adjustment.
 
-  /*!
-   * Target bit budget for the current GF / ARF group of frame.
-   */
-  int64_t gf_group_bits;
-
   /*!
    * Projected size for current frame
    */
   int projected_frame_size;
 
-  /*!
-   * Bit size of transform coefficient for current frame.
-   */
-  int coefficient_size;
-
   /*!
    * Super block rate target used with some adaptive quantization strategies.
    */
@@ -835,9 +666,10 @@ typedef struct {
   int last_kf_qindex;
 
   /*!
-   * Boost factor used to calculate the extra bits allocated to ARFs and GFs
+   * Q used for the last frame coded with this rate control (layer)
    */
-  int gfu_boost;
+  int last_coded_qindex;
+
   /*!
    * Boost factor used to calculate the extra bits allocated to the key frame
    */
@@ -849,38 +681,12 @@ typedef struct {
    */
   double rate_correction_factors[AV1_RATE_FACTOR_LEVELS];
 
-  /*!
-   * Number of frames since the last ARF / GF.
-   */
-  int frames_since_golden;
-
   /*!
    * Number of frames till the next ARF / GF is due.
    */
   int frames_till_gf_update_due;
 
-  /*!
-   * Number of determined gf groups left
-   */
-  int intervals_till_gf_calculate_due;
-
-  /*!
-   * Stores the determined gf group lengths for a set of gf groups
-   */
-  int gf_intervals[AV1_MAX_NUM_GF_INTERVALS];
-
-  /*!
-   * The current group's index into gf_intervals[]
-   */
-  int cur_gf_index;
-
   /*!\cond */
-  int num_regions;
-  REGIONS regions[MAX_FIRSTPASS_ANALYSIS_FRAMES];
-  double cor_coeff[MAX_FIRSTPASS_ANALYSIS_FRAMES];
-  int regions_offset;  // offset of regions from the last keyframe
-  int frames_till_regions_update;
-
   int constrained_gf_group;
   /*!\endcond */
   /*!
@@ -892,7 +698,6 @@ typedef struct {
   int this_key_frame_forced;
   int next_key_frame_forced;
   int is_src_frame_alt_ref;
-  int sframe_due;
 
   int high_source_sad;
   uint64_t avg_source_sad;
@@ -912,8 +717,6 @@ typedef struct {
 
   int64_t buffer_level;
   int64_t bits_off_target;
-  int64_t vbr_bits_off_target;
-  int64_t vbr_bits_off_target_fast;
 
   int decimation_factor;
   int decimation_count;
@@ -921,8 +724,6 @@ typedef struct {
   int rolling_target_bits;
   int rolling_actual_bits;
 
-  int rate_error_estimate;
-
   int64_t total_actual_bits;
   int64_t total_target_bits;
 
@@ -959,34 +760,6 @@ typedef struct {
   int q_1_frame;
   int q_2_frame;
 
-  float_t arf_boost_factor;
-
-  /*!\endcond */
-  /*!
-   * Q index used for ALT frame
-   */
-  int arf_q;
-  /*!
-   * Proposed maximum alloed Q for current frame
-   */
-  int active_worst_quality;
-  /*!
-   * Proposed minimum allowed Q different layers in a coding pyramid
-   */
-  int active_best_quality[AV1_MAX_ARF_LAYERS + 1];
-
-  /*!\cond */
-  int base_layer_qp;
-
-  // Total number of stats used only for kf_boost calculation.
-  int num_stats_used_for_kf_boost;
-  // Total number of stats used only for gfu_boost calculation.
-  int num_stats_used_for_gfu_boost;
-  // Total number of stats required by gfu_boost calculation.
-  int num_stats_required_for_gfu_boost;
-  int next_is_fwd_key;
-  int enable_scenecut_detection;
-  int use_arf_in_this_kf_group;
   // Track amount of low motion in scene
   int avg_frame_low_motion;
 
@@ -1011,8 +784,11 @@ int av1_estimate_bits_at_q(AV1_FRAME_TYPE frame_kind, int q, int mbs,
                            double correction_factor, aom_bit_depth_t bit_depth,
                            const int is_screen_content_type);
 
+int16_t av1_ac_quant_QTX(int qindex, int delta, aom_bit_depth_t bit_depth);
+
 double av1_convert_qindex_to_q(int qindex, aom_bit_depth_t bit_depth);
 
+// Builds the minq tables of the process on the first call.
 void av1_rc_init_minq_luts(void);
 
 int av1_rc_get_default_min_gf_interval(int width, int height, double framerate);
@@ -1117,6 +893,10 @@ int av1_rc_bits_per_mb(AV1_FRAME_TYPE frame_type, int qindex,
                        double correction_factor, aom_bit_depth_t bit_depth,
                        const int is_screen_content_type);
 
+// Builds the rate curves of the frame types at the bit depth and content
+// type of the stream.
+void av1_rc_init_rate_curves(AV1_COMP *cpi);
+
 // Clamping utilities for bitrate targets for iframes and pframes.
 int av1_rc_clamp_iframe_target_size(const AV1_COMP *const cpi,
                                     int target);
@@ -1137,10 +917,8 @@ int av1_compute_qdelta(const AV1_RATE_CONTROL *rc, double qstart, double qtarget
 
 // Computes a q delta (in "q index" terms) to get from a starting q value
 // to a value that should equate to the given rate ratio.
-int av1_compute_qdelta_by_rate(const AV1_RATE_CONTROL *rc, AV1_FRAME_TYPE frame_type,
-                               int qindex, double rate_target_ratio,
-                               const int is_screen_content_type,
-                               aom_bit_depth_t bit_depth);
+int av1_compute_qdelta_by_rate(const AV1_COMP *cpi, AV1_FRAME_TYPE frame_type,
+                               int qindex, double rate_target_ratio);
 
 int av1_frame_type_qdelta(const AV1_COMP *cpi, int q);
 
@@ -1181,11 +959,23 @@ int av1_calc_pframe_target_size_one_pass_cbr(const AV1_COMP *cpi);
  */
 int av1_calc_iframe_target_size_one_pass_cbr(const AV1_COMP *cpi);
 
+/*!\brief Predicts the size of a key frame in one pass cbr
+ *
+ * The size is the target the rate control would give the key frame,
+ * bounded by the rate model at the best and worst quality.
+ *
+ * \param[in]       cpi           Top level encoder structure
+ * \param[in]       frames_ahead  Frames coded before the key frame
+ *
+ * \return  Returns the predicted number of bits of the key frame.
+ */
+int av1_predict_key_frame_size(const AV1_COMP *cpi, int frames_ahead);
+
 
 /*!\brief Increase q on expected encoder overshoot, for CBR mode.
  *
  *  Handles the case when encoder is expected to create a large frame:
- *  - q is increased to value closer to \c cpi->rc.worst_quality
+ *  - q is increased to value closer to \c cpi->rc->worst_quality
  *  - avg_frame_qindex is reset
  *  - buffer levels are reset
  *  - rate correction factor is adjusted
@@ -1202,6 +992,8 @@ int av1_quantizer_to_qindex(int quantizer);
 
 int av1_frame_is_intra_only(const AV1_COMMON *cm);
 
+void av1_set_mb_mi(CommonModeInfoParams *mi_params, int width, int height);
+
 int av1_set_size_literal(AV1_COMP *cpi, int width, int height);
 
 void av1_get_one_pass_rt_params(AV1_COMP *cpi,
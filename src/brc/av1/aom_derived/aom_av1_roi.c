@@ -0,0 +1,71 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "aom_av1_common.h"
+#include "aom_av1_roi.h"
+
+static inline int clamp(int value, int low, int high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+static int compute_deltaq(const AV1_COMP *cpi, int q, int segment) {
+  const AV1_COMMON *const cm = &cpi->common;
+  const int deltaq = av1_compute_qdelta_by_rate(
+      cpi, cm->current_frame.frame_type, q, brc_roi_rate_ratio(segment));
+  return brc_roi_clamp_qdelta(q, deltaq);
+}
+
+int av1_roi_estimate_bits_at_q(const AV1_COMP *cpi,
+                               double correction_factor) {
+  const AV1_COMMON *const cm = &cpi->common;
+  const BrcRoi *const roi = &cpi->roi;
+  const int base_qindex = cm->quant_params.base_qindex;
+  double bits = 0.0;
+  int i;
+
+  for (i = 0; i < BRC_ROI_NUM_SEGMENTS; i++) {
+    if (roi->weight[i] == 0.0) continue;
+    bits += roi->weight[i] *
+            av1_estimate_bits_at_q(cm->current_frame.frame_type,
+                                   base_qindex + roi->qindex_delta[i],
+                                   cm->mi_params.MBs, correction_factor,
+                                   cm->seq_params.bit_depth,
+                                   cpi->is_screen_content_type);
+  }
+  return (int)bits;
+}
+
+int av1_roi_rc_bits_per_mb(const AV1_COMP *cpi, int i,
+                           const int *bits_per_mb) {
+  const BrcRoi *const roi = &cpi->roi;
+  double frame_bits_per_mb = 0.0;
+  int s;
+
+  for (s = 0; s < BRC_ROI_NUM_SEGMENTS; s++) {
+    int deltaq;
+    if (roi->weight[s] == 0.0) continue;
+    deltaq = s ? compute_deltaq(cpi, i, s) : 0;
+    frame_bits_per_mb += roi->weight[s] * bits_per_mb[i + deltaq];
+  }
+  return (int)frame_bits_per_mb;
+}
+
+void av1_roi_setup(AV1_COMP *const cpi) {
+  const AV1_COMMON *const cm = &cpi->common;
+  BrcRoi *const roi = &cpi->roi;
+  const int base_qindex = cm->quant_params.base_qindex;
+  int s;
+
+  for (s = 1; s < BRC_ROI_NUM_SEGMENTS; s++) {
+    const int deltaq = compute_deltaq(cpi, base_qindex, s);
+    roi->qindex_delta[s] =
+        clamp(base_qindex + deltaq, 0, AV1_MAXQ) - base_qindex;
+  }
+}
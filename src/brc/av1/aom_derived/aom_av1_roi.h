@@ -0,0 +1,47 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef AOM_AV1_ENCODER_ROI_H_
+#define AOM_AV1_ENCODER_ROI_H_
+
+#include "../../common/brc_roi.h"
+
+struct AV1_COMP;
+
+/*!\brief Estimate the bits, incorporating the delta-q of the regions of
+ * interest.
+ *
+ * \param[in]       cpi               Top level encoder structure
+ * \param[in]       correction_factor rate correction factor
+ *
+ * \return Return the estimated bits of the just encoded frame.
+ */
+int av1_roi_estimate_bits_at_q(const struct AV1_COMP *cpi,
+                               double correction_factor);
+
+/*!\brief Estimate the bits per mb, for given q = i and the delta-q of the
+ * regions of interest at that q.
+ *
+ * \param[in]       cpi               Top level encoder structure
+ * \param[in]       i                 q index
+ * \param[in]       bits_per_mb       bits per mb of the frame at each q
+ *
+ * \return Return the estimated bits per mb.
+ */
+int av1_roi_rc_bits_per_mb(const struct AV1_COMP *cpi, int i,
+                           const int *bits_per_mb);
+
+/*!\brief Set the delta-q of the regions of interest for the frame q.
+ *
+ * \param[in]       cpi       Top level encoder structure
+ */
+void av1_roi_setup(struct AV1_COMP *const cpi);
+
+#endif  // AOM_AV1_ENCODER_ROI_H_
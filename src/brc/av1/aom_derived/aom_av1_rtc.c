@@ -12,6 +12,7 @@
  */
 
 #include "aom_av1_rtc.h"
+#include "../../common/brc_keyframe.h"
 
 #undef ERROR
 #define ERROR(str)                  \
@@ -61,6 +62,10 @@ brc_av1_post_encode_update(BrcCodecEnginePtr engine_ptr, uint64_t encoded_frame_
   //taken from encode_frame_to_data_rate()
   if (cpi->svc.spatial_layer_id == cpi->svc.number_spatial_layers - 1)
     cpi->svc.num_encoded_top_layer++;
+  // Saved after the update so the next frame of the layer starts from its
+  // corrected rate factors and buffer level.
+  if (cpi->use_svc)
+    av1_save_layer_context(cpi);
   return LIBMEBO_STATUS_SUCCESS;
 }
 
@@ -74,24 +79,142 @@ brc_av1_get_qp(BrcCodecEnginePtr engine_ptr, int *qp) {
 
 LibMeboStatus
 brc_av1_get_loop_filter_level(BrcCodecEnginePtr engine_ptr, int *filter_level) {
-  if (!engine_ptr)
-          return LIBMEBO_STATUS_INVALID_PARAM;
-  fprintf(stderr, "%s \n", "Warning: Not supported");
-  *filter_level = 0;
-  return LIBMEBO_STATUS_UNIMPLEMENTED;
+  AV1RateControlRTC *rtc = (AV1RateControlRTC *) engine_ptr;
+  AV1_COMP *cpi = &rtc->cpi_;
+  av1_pick_filter_level_from_q(cpi);
+  *filter_level = cpi->common.lf.filter_level[0];
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_av1_get_loop_filter_params(BrcCodecEnginePtr engine_ptr,
+    LibMeboLoopFilterParams *params) {
+  AV1RateControlRTC *rtc = (AV1RateControlRTC *) engine_ptr;
+  AV1_COMP *cpi = &rtc->cpi_;
+  const AV1_COMMON *const cm = &cpi->common;
+  int plane;
+
+  av1_pick_filter_level_from_q(cpi);
+  av1_pick_cdef_from_q(cpi);
+  av1_pick_restoration_type(cpi);
+
+  params->filter_level[0] = cm->lf.filter_level[0];
+  params->filter_level[1] = cm->lf.filter_level[1];
+  params->filter_level_u = cm->lf.filter_level_u;
+  params->filter_level_v = cm->lf.filter_level_v;
+  params->sharpness = cm->lf.sharpness_level;
+  params->cdef_damping = cm->cdef_info.cdef_damping;
+  params->cdef_bits = cm->cdef_info.cdef_bits;
+  params->cdef_y_strength = cm->cdef_info.cdef_strengths[0];
+  params->cdef_uv_strength = cm->cdef_info.cdef_uv_strengths[0];
+  for (plane = 0; plane < AV1_MAX_MB_PLANE; plane++)
+    params->restoration_type[plane] =
+        (LibMeboRestorationType)cm->frame_restoration_type[plane];
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_av1_get_segmentation_map(BrcCodecEnginePtr engine_ptr,
+    LibMeboSegmentationMap *seg_map) {
+  AV1RateControlRTC *rtc = (AV1RateControlRTC *) engine_ptr;
+  AV1_COMP *cpi = &rtc->cpi_;
+  const CommonModeInfoParams *const mi_params = &cpi->common.mi_params;
+  const AV1_CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  const uint32_t map_size = (uint32_t)(mi_params->mi_rows * mi_params->mi_cols);
+  int i;
+
+  if (cpi->roi.apply)
+    return brc_roi_get_segmentation_map(&cpi->roi, seg_map);
+
+  seg_map->block_size = 1 << MI_SIZE_LOG2;
+  seg_map->cols = mi_params->mi_cols;
+  seg_map->rows = mi_params->mi_rows;
+  memset(seg_map->delta_qp, 0, sizeof(seg_map->delta_qp));
+  if (seg_map->map && seg_map->map_size < map_size)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+
+  if (cpi->oxcf.q_cfg.aq_mode != AV1_CYCLIC_REFRESH_AQ ||
+      !cr->apply_cyclic_refresh) {
+    seg_map->enabled = 0;
+    seg_map->num_segments = 1;
+    if (seg_map->map)
+      memset(seg_map->map, AV1_CR_SEGMENT_ID_BASE, map_size);
+    return LIBMEBO_STATUS_SUCCESS;
+  }
+
+  // Segment BOOST2 needs the per-block rate of the encoded frame, which is
+  // not available, so only BASE and BOOST1 are present in the map.
+  seg_map->enabled = 1;
+  seg_map->num_segments = AV1_CR_SEGMENT_ID_BOOST1 + 1;
+  for (i = 0; i < seg_map->num_segments; i++)
+    seg_map->delta_qp[i] = cr->qindex_delta[i];
+  if (seg_map->map)
+    memcpy(seg_map->map, cr->seg_map, map_size);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_av1_set_roi(BrcCodecEnginePtr engine_ptr, const LibMeboRoiConfig *roi) {
+  AV1RateControlRTC *rtc = (AV1RateControlRTC *) engine_ptr;
+  AV1_COMP *cpi = &rtc->cpi_;
+
+  if (roi->spatial_layer_id >= cpi->svc.number_spatial_layers)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+  return brc_roi_set(&cpi->roi, roi);
+}
+
+LibMeboStatus
+brc_av1_get_qdelta_by_rate(BrcCodecEnginePtr engine_ptr, double rate_ratio,
+    int *qdelta) {
+  AV1RateControlRTC *rtc = (AV1RateControlRTC *) engine_ptr;
+  AV1_COMP *cpi = &rtc->cpi_;
+  AV1_COMMON *const cm = &cpi->common;
+
+  if (!engine_ptr || !qdelta)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  *qdelta = av1_compute_qdelta_by_rate(cpi, cm->current_frame.frame_type,
+      cm->quant_params.base_qindex, rate_ratio);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+static int
+brc_av1_key_frame_size(BrcCodecEnginePtr engine_ptr, int frames_ahead) {
+  AV1RateControlRTC *rtc = (AV1RateControlRTC *) engine_ptr;
+  return av1_predict_key_frame_size(&rtc->cpi_, frames_ahead);
+}
+
+LibMeboStatus
+brc_av1_get_keyframe_advice(BrcCodecEnginePtr engine_ptr, int max_interval,
+    LibMeboKeyFrameAdvice *advice) {
+  AV1RateControlRTC *rtc = (AV1RateControlRTC *) engine_ptr;
+  AV1_COMP *cpi = &rtc->cpi_;
+  const AV1_RATE_CONTROL *const rc = cpi->rc;
+  const RateControlCfg *const rc_cfg = &cpi->oxcf.rc_cfg;
+  BrcKeyFrameState state;
+
+  state.buffer_level = rc->buffer_level;
+  state.optimal_buffer_level = rc->optimal_buffer_level;
+  state.maximum_buffer_size = rc->maximum_buffer_size;
+  state.avg_frame_bandwidth = rc->avg_frame_bandwidth;
+  state.undershoot_pct = rc_cfg->under_shoot_pct;
+  state.overshoot_pct = rc_cfg->over_shoot_pct;
+  state.target_bandwidth = rc_cfg->target_bandwidth;
+  return brc_keyframe_get_advice(engine_ptr, brc_av1_key_frame_size, &state,
+                                 max_interval, advice);
 }
 
 static inline void update_keyframe_counters(AV1_COMP *cpi) {
-  if (cpi->common.show_frame && cpi->rc.frames_to_key) {
-    cpi->rc.frames_since_key++;
-    cpi->rc.frames_to_key--;
+  if (cpi->common.show_frame && cpi->rc->frames_to_key) {
+    cpi->rc->frames_since_key++;
+    cpi->rc->frames_to_key--;
   }
 }
 
 static void adjust_frame_rate(AV1_COMP *cpi/*, int64_t ts_start, int64_t ts_end*/) {
   if (cpi->use_svc && cpi->svc.spatial_layer_id > 0) {
+    // The frame bandwidths of the layer come with its rate control, restored
+    // by av1_get_one_pass_rt_params().
     cpi->framerate = cpi->svc.base_framerate;
-    av1_rc_update_framerate(cpi, cpi->common.width, cpi->common.height);
     return;
   }
   //ToDo: Add fine tuning of framrate based on encode time
@@ -110,6 +233,16 @@ brc_av1_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_pa
   frame_type =
       (frame_params->frame_type == LIBMEBO_KEY_FRAME) ? AV1_KEY_FRAME : AV1_INTER_FRAME;
 
+  if (frame_params->spatial_layer_id < 0 ||
+      frame_params->spatial_layer_id >= cpi->svc.number_spatial_layers ||
+      frame_params->temporal_layer_id < 0 ||
+      frame_params->temporal_layer_id >= cpi->svc.number_temporal_layers)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+  cpi->svc.spatial_layer_id = frame_params->spatial_layer_id;
+  cpi->svc.temporal_layer_id = frame_params->temporal_layer_id;
+  cm->spatial_layer_id = cpi->svc.spatial_layer_id;
+  cm->temporal_layer_id = cpi->svc.temporal_layer_id;
+
   if (!cpi->initial_dimensions.width){
     cpi->initial_dimensions.width = cm->width;
     cpi->initial_dimensions.height = cm->height;
@@ -119,6 +252,7 @@ brc_av1_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_pa
   }
 
   //Taken from av1_get_compressed_data()
+  //Sets the dimensions and the MB count of the spatial layer.
   if (cpi->use_svc && cm->number_spatial_layers > 1) {
     av1_one_pass_cbr_svc_start_layer(cpi);
   }
@@ -127,6 +261,21 @@ brc_av1_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_pa
   adjust_frame_rate(cpi /*, source->ts_start, source->ts_end*/);
 
   av1_get_one_pass_rt_params(cpi, frame_type);
+
+  // The q history of the previous scene says nothing about this one.
+  cpi->rc->high_source_sad =
+      !!(frame_params->flags & LIBMEBO_FRAME_FLAG_SCENE_CHANGE);
+  if (cpi->rc->high_source_sad) {
+    cpi->rc->rc_1_frame = 0;
+    cpi->rc->rc_2_frame = 0;
+  }
+
+  if (brc_roi_setup_frame(&cpi->roi, cpi->svc.spatial_layer_id,
+          1 << MI_SIZE_LOG2, cm->mi_params.mi_cols, cm->mi_params.mi_rows) !=
+      LIBMEBO_STATUS_SUCCESS)
+    return LIBMEBO_STATUS_FAILED;
+  if (oxcf->q_cfg.aq_mode == AV1_CYCLIC_REFRESH_AQ)
+    av1_cyclic_refresh_update_parameters(cpi);
   //Not configured for CONFIG_REALTIME_ONLY, so the codepath
   //is derived from av1_get_second_pass_params()
   //Fixme:
@@ -146,11 +295,6 @@ brc_av1_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_pa
     //rc->active_worst_quality = 40;//oxcf->rc_cfg.cq_level;
   //}
 
-
-  //ToDo: Add show_existing_frame support
-  //if (!frame_params.show_existing_frame)
-  cm->quant_params.using_qmatrix = oxcf->q_cfg.using_qm;
-
   //We use the real_time mode for encode
   //denoise_and_encode()
   //ToDo: Add lf params: set_default_lf_deltas(&cm->lf);
@@ -188,8 +332,21 @@ brc_av1_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_pa
 
   //Derived from av1_set_size_dependent_vars(cpi, &q, &bottom_index, &top_index);
    // Decide q and q bounds.
-  q = av1_rc_pick_q_and_bounds(cpi, cm->width, cm->height,
-                                /* cpi->gf_group.index,*/ &bottom_index, &top_index);
+  cpi->frame_unchanged = frame_type != AV1_KEY_FRAME &&
+                         (frame_params->flags & LIBMEBO_FRAME_FLAG_UNCHANGED);
+  if (cpi->frame_unchanged) {
+    // Nothing to code but the skip flags: bank the bits of the frame and
+    // keep the q, the next change starts from the same quality. With layers
+    // the base_qindex is the q of whichever layer was coded last.
+    AV1_RATE_CONTROL *const rc = cpi->rc;
+    av1_rc_set_frame_target(cpi, rc->min_frame_bandwidth, cm->width,
+                            cm->height);
+    q = AOMMAX(AOMMIN(rc->last_coded_qindex, rc->worst_quality),
+               rc->best_quality);
+  } else {
+    q = av1_rc_pick_q_and_bounds(cpi, cm->width, cm->height,
+                                  /* cpi->gf_group.index,*/ &bottom_index, &top_index);
+  }
 
   cm->quant_params.base_qindex = q;
   //Fixme (Important):
@@ -206,17 +363,16 @@ brc_av1_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_pa
   //if (cpi->sf.rt_sf.overshoot_detection_cbr == FAST_DETECTION_MAXQ)
   //  av1_encodedframe_overshoot_cbr ()
 
-  //ToDo
-  //Add support for CYCLIC_REFRESH_AQ)
+  if (cpi->roi.apply)
+    av1_roi_setup(cpi);
+  if (oxcf->q_cfg.aq_mode == AV1_CYCLIC_REFRESH_AQ)
+    av1_cyclic_refresh_setup(cpi);
 
   //Derived from update_rc_counts()
   update_keyframe_counters(cpi);
   //ToDo: Add support for
   // update_frames_till_gf_update(cpi);
   // update_gf_group_index(cpi);
-  // Fixme: move to post_encode_update() ????
-  if (cpi->use_svc)
-    av1_save_layer_context(cpi);
   return LIBMEBO_STATUS_SUCCESS;
 }
 
@@ -253,55 +409,7 @@ static inline void init_frame_info(FRAME_INFO *frame_info,
   frame_info->bit_depth = seq_params->bit_depth;
 }
 
-static inline TX_SIZE av1_get_adjusted_tx_size(TX_SIZE tx_size) {
-  switch (tx_size) {
-    case TX_64X64:
-    case TX_64X32:
-    case TX_32X64: return TX_32X32;
-    case TX_64X16: return TX_32X16;
-    case TX_16X64: return TX_16X32;
-    default: return tx_size;
-  }
-}
-
-static const qm_val_t wt_matrix_ref[AV1_NUM_QM_LEVELS - 1][2][QM_TOTAL_SIZE];
-static const qm_val_t iwt_matrix_ref[AV1_NUM_QM_LEVELS - 1][2][QM_TOTAL_SIZE];
-static const int tx_size_2d[TX_SIZES_ALL + 1] = { 
-  16,  64,   256,  1024, 4096, 32,  32,  128,  128,  512,
-  512, 2048, 2048, 64,   64,   256, 256, 1024, 1024,
-};
-
-void av1_qm_init(CommonQuantParams *quant_params, int num_planes) {
-  for (int q = 0; q < AV1_NUM_QM_LEVELS; ++q) {
-    for (int c = 0; c < num_planes; ++c) {
-      int current = 0;
-      for (int t = 0; t < TX_SIZES_ALL; ++t) {
-        const int size = tx_size_2d[t];
-        const int qm_tx_size = av1_get_adjusted_tx_size(t);
-        if (q == AV1_NUM_QM_LEVELS - 1) {
-          quant_params->gqmatrix[q][c][t] = NULL;
-          quant_params->giqmatrix[q][c][t] = NULL;
-        } else if (t != qm_tx_size) {  // Reuse matrices for 'qm_tx_size'
-          assert(t > qm_tx_size);
-          quant_params->gqmatrix[q][c][t] =
-              quant_params->gqmatrix[q][c][qm_tx_size];
-          quant_params->giqmatrix[q][c][t] =
-              quant_params->giqmatrix[q][c][qm_tx_size];
-        } else {
-          assert(current + size <= QM_TOTAL_SIZE);
-          quant_params->gqmatrix[q][c][t] = &wt_matrix_ref[q][c >= 1][current];
-          quant_params->giqmatrix[q][c][t] =
-              &iwt_matrix_ref[q][c >= 1][current];
-          current += size;
-        }
-      }
-    }
-  }
-}
-
-static inline int av1_num_planes(const AV1_COMMON *cm) {
-  return cm->seq_params.monochrome ? 1 : MAX_MB_PLANE;
-}
+LibMeboStatus brc_av1_validate (LibMeboRateControllerConfig *cfg);
 
 LibMeboStatus
 brc_av1_update_rate_control(BrcCodecEnginePtr engine_ptr,
@@ -310,12 +418,26 @@ brc_av1_update_rate_control(BrcCodecEnginePtr engine_ptr,
   AV1_COMP *cpi = &rtc->cpi_;
   AV1_COMMON *cm = &cpi->common;
   AV1EncoderConfig *oxcf = &cpi->oxcf;
-  AV1_RATE_CONTROL *const rc = &cpi->rc;
+  AV1_RATE_CONTROL *rc;
+  LibMeboStatus status;
 
   RateControlCfg *const rc_cfg = &oxcf->rc_cfg;
   QuantizationCfg *const q_cfg = &oxcf->q_cfg;
   CommonModeInfoParams *mi_params = &cm->mi_params;
 
+  // A config update is validated like the config of the controller creation.
+  status = brc_av1_validate (input_rc_cfg);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+
+  // The layer contexts are rescaled from the stream rate control below, so
+  // it takes over the state of the last coded layer rather than alias it.
+  if (cpi->rc != &cpi->stream_rc) {
+    cpi->stream_rc = *cpi->rc;
+    cpi->rc = &cpi->stream_rc;
+  }
+  rc = cpi->rc;
+
   oxcf->frm_dim_cfg.width = input_rc_cfg->width;
   oxcf->frm_dim_cfg.height = input_rc_cfg->height;
 
@@ -356,7 +478,15 @@ brc_av1_update_rate_control(BrcCodecEnginePtr engine_ptr,
   q_cfg->qm_maxlevel = AV1_DEFAULT_QM_LAST;
   q_cfg->quant_b_adapt = 0;
   q_cfg->enable_chroma_deltaq = 0;
-  q_cfg->aq_mode = 0;
+  q_cfg->aq_mode = (input_rc_cfg->aq_mode == LIBMEBO_AQ_MODE_CYCLIC_REFRESH)
+                       ? AV1_CYCLIC_REFRESH_AQ
+                       : AV1_NO_AQ;
+  oxcf->tune_cfg.content =
+      (input_rc_cfg->content_type == LIBMEBO_CONTENT_SCREEN)
+          ? AOM_CONTENT_SCREEN
+          : AOM_CONTENT_DEFAULT;
+  cpi->is_screen_content_type =
+      (oxcf->tune_cfg.content == AOM_CONTENT_SCREEN);
   /*
    * 0:no deltaq
    * 1: Modulation to improve objective quality
@@ -374,15 +504,22 @@ brc_av1_update_rate_control(BrcCodecEnginePtr engine_ptr,
   cpi->superres_mode = AOM_SUPERRES_NONE;
   cpi->svc.number_spatial_layers = input_rc_cfg->ss_number_layers;
   cpi->svc.number_temporal_layers = input_rc_cfg->ts_number_layers;
+  cpi->use_svc = cpi->svc.number_spatial_layers > 1 ||
+                 cpi->svc.number_temporal_layers > 1;
 
   //Fill AV1_COMMON structure
   cm->prev_frame.width = cm->width;
   cm->prev_frame.height= cm->height;
   if (!cm->prev_frame.height || !cm->prev_frame.width)
     cm->prev_frame.has_prev_frame= 0;
-  cm->width = input_rc_cfg->width;
-  cm->height = input_rc_cfg->height;
-  cm->seq_params.bit_depth= AOM_BITS_8;
+  oxcf->input_cfg.input_bit_depth =
+      input_rc_cfg->bit_depth ? (aom_bit_depth_t)input_rc_cfg->bit_depth
+                              : AOM_BITS_8;
+  cm->seq_params.bit_depth = oxcf->input_cfg.input_bit_depth;
+  // Main profile covers 8 and 10 bits, 12 bits needs the Professional one.
+  oxcf->profile = (cm->seq_params.bit_depth == AOM_BITS_12) ? AV1_PROFILE_2
+                                                            : AV1_PROFILE_0;
+  av1_rc_init_rate_curves(cpi);
   cm->seq_params.monochrome = 0;
   cm->number_spatial_layers = cpi->svc.number_spatial_layers;
   cm->number_temporal_layers = cpi->svc.number_temporal_layers;
@@ -404,21 +541,48 @@ brc_av1_update_rate_control(BrcCodecEnginePtr engine_ptr,
   // if (initial_dimensions->width || sb_size != seq_params->sb_size)
   //
 
-  //We only need some part of update_frame_size(cpi)
-  {
-    const int aligned_width = ALIGN_POWER_OF_TWO(input_rc_cfg->width, 3);
-    const int aligned_height = ALIGN_POWER_OF_TWO(input_rc_cfg->height, 3);
-
-    mi_params->mi_cols = aligned_width >> MI_SIZE_LOG2;
-    mi_params->mi_rows = aligned_height >> MI_SIZE_LOG2;
-
-    mi_params->mb_cols = (mi_params->mi_cols + 2) >> 2;
-    mi_params->mb_rows = (mi_params->mi_rows + 2) >> 2;
-    mi_params->MBs = mi_params->mb_rows * mi_params->mb_cols;
+  // Spatial layers are scaled from the full resolution in ComputeQP().
+  av1_set_size_literal(cpi, input_rc_cfg->width, input_rc_cfg->height);
+
+  if (q_cfg->aq_mode == AV1_CYCLIC_REFRESH_AQ) {
+    AV1_CYCLIC_REFRESH *cr = cpi->cyclic_refresh;
+    if (!cr || cr->map_mi_rows != mi_params->mi_rows ||
+        cr->map_mi_cols != mi_params->mi_cols) {
+      av1_cyclic_refresh_free(cr);
+      cpi->cyclic_refresh =
+          av1_cyclic_refresh_alloc(mi_params->mi_rows, mi_params->mi_cols);
+      if (!cpi->cyclic_refresh) {
+        q_cfg->aq_mode = AV1_NO_AQ;
+        return LIBMEBO_STATUS_FAILED;
+      }
+    }
   }
 
-  if (cpi->use_svc)
-    av1_update_layer_context_change_config(cpi, input_rc_cfg->target_bandwidth);
+  if (cpi->use_svc) {
+    int64_t target_bandwidth_svc = 0;
+    for (int sl = 0; sl < cpi->svc.number_spatial_layers; ++sl) {
+      for (int tl = 0; tl < cpi->svc.number_temporal_layers; ++tl) {
+        const int layer =
+            LAYER_IDS_TO_IDX(sl, tl, cpi->svc.number_temporal_layers);
+        AV1_LAYER_CONTEXT *lc = &cpi->svc.layer_context[layer];
+        lc->layer_target_bitrate =
+            1000 * (int64_t)input_rc_cfg->layer_target_bitrate[layer];
+        lc->max_q = input_rc_cfg->max_quantizers[layer];
+        lc->min_q = input_rc_cfg->min_quantizers[layer];
+        lc->scaling_factor_num = input_rc_cfg->scaling_factor_num[sl];
+        lc->scaling_factor_den = input_rc_cfg->scaling_factor_den[sl];
+        lc->framerate_factor = cpi->svc.number_temporal_layers > 1
+                                   ? input_rc_cfg->ts_rate_decimator[tl]
+                                   : 1;
+        if (tl == cpi->svc.number_temporal_layers - 1)
+          target_bandwidth_svc += lc->layer_target_bitrate;
+      }
+    }
+    av1_svc_update_layer_geometry(cpi);
+    if (cm->current_frame.frame_number == 0)
+      av1_init_layer_context(cpi);
+    av1_update_layer_context_change_config(cpi, target_bandwidth_svc);
+  }
 
   av1_rc_init(oxcf, oxcf->pass, rc);
 
@@ -453,10 +617,10 @@ brc_init_rate_control(AV1RateControlRTC *rtc, LibMeboRateControllerConfig *rc_cf
   AV1_COMMON *cm = &cpi->common;
   AV1EncoderConfig *oxcf = &cpi->oxcf;
 
-  oxcf->profile = AV1_PROFILE_0;//Fixme: dynamic setting or bitdepth based calculation 
   oxcf->pass = 0; //Fixme: Add dynamic configuration option
   oxcf->mode = AOM_USAGE_GOOD_QUALITY;//Fixme: configure for REAL_TIME?
   oxcf->tune_cfg.content = AOM_CONTENT_DEFAULT;
+  cpi->rc = &cpi->stream_rc;
 
   cm->current_frame.frame_number = 0;
 
@@ -470,17 +634,12 @@ brc_init_rate_control(AV1RateControlRTC *rtc, LibMeboRateControllerConfig *rc_cf
   cm->number_temporal_layers = 1;
   cm->spatial_layer_id = 0;
   cm->temporal_layer_id = 0;
-  cm->seq_params.bit_depth = AOM_BITS_8;
   brc_av1_update_rate_control(rtc, rc_cfg);
 
   av1_rc_init_minq_luts(); //void av1_initialize_enc(void)
   //Fixme: Add if needed, encoder.c
   //av1_init_quantizer(&cpi->enc_quant_dequant_params, &cm->quant_params,
   //                   cm->seq_params.bit_depth); 
-  av1_qm_init(&cm->quant_params, av1_num_planes(cm));
-
-  //ToDo: Add loopfilter support
-  //av1_loop_filter_init ();//encoder.c
 }
 
 //Fixme: Use av1/av1_cx_iface.c  aom_codec_err_t validate_config
@@ -502,10 +661,21 @@ brc_av1_validate (LibMeboRateControllerConfig *cfg)
   RANGE_CHECK_HI(cfg, overshoot_pct, 100);
   RANGE_CHECK(cfg, ss_number_layers, 1, AOM_MAX_SS_LAYERS);
   RANGE_CHECK(cfg, ts_number_layers, 1, AOM_MAX_TS_LAYERS);
+  RANGE_CHECK_HI(cfg, aq_mode, LIBMEBO_AQ_MODE_CYCLIC_REFRESH);
+  RANGE_CHECK_HI(cfg, content_type, LIBMEBO_CONTENT_SCREEN);
+  if (cfg->bit_depth != 0 && cfg->bit_depth != AOM_BITS_8 &&
+      cfg->bit_depth != AOM_BITS_10 && cfg->bit_depth != AOM_BITS_12)
+    ERROR("bit_depth must be 8, 10 or 12");
 
   if (cfg->ss_number_layers * cfg->ts_number_layers > AOM_MAX_LAYERS)
     ERROR("ss_number_layers * ts_number_layers is out of range");
 
+  if (cfg->ss_number_layers > 1) {
+    int sl;
+    for (sl = 0; sl < cfg->ss_number_layers; ++sl)
+      RANGE_CHECK(cfg, scaling_factor_num[sl], 1, cfg->scaling_factor_den[sl]);
+  }
+
    if (cfg->ts_number_layers > 1) {
     int sl, tl;
     for (sl = 1; sl < cfg->ss_number_layers; ++sl) {
@@ -522,6 +692,19 @@ brc_av1_validate (LibMeboRateControllerConfig *cfg)
       if (cfg->ts_rate_decimator[tl - 1] != 2 * cfg->ts_rate_decimator[tl])
         ERROR("ts_rate_decimator factors are not powers of 2");
   }
+
+  // The layer quantizers index the quantizer to qindex table.
+  if (cfg->ss_number_layers * cfg->ts_number_layers > 1) {
+    int sl, tl;
+    for (sl = 0; sl < cfg->ss_number_layers; ++sl) {
+      for (tl = 0; tl < cfg->ts_number_layers; ++tl) {
+        const int layer = LAYER_IDS_TO_IDX(sl, tl, cfg->ts_number_layers);
+        RANGE_CHECK(cfg, max_quantizers[layer], 0, 63);
+        RANGE_CHECK(cfg, min_quantizers[layer], 0,
+                    cfg->max_quantizers[layer]);
+      }
+    }
+  }
   return status;
 }
 
@@ -541,6 +724,11 @@ brc_av1_rate_control_init (LibMeboRateControllerConfig *cfg,
 
   memset (&rtc->cpi_, 0, sizeof (rtc->cpi_));
   brc_init_rate_control (rtc, (BrcCodecEnginePtr)cfg);
+  if (cfg->aq_mode == LIBMEBO_AQ_MODE_CYCLIC_REFRESH &&
+      !rtc->cpi_.cyclic_refresh) {
+    free (rtc);
+    return LIBMEBO_STATUS_FAILED;
+  }
 
   *brc_codec_handler = (BrcCodecEnginePtr)rtc;
   return LIBMEBO_STATUS_SUCCESS;
@@ -549,6 +737,9 @@ brc_av1_rate_control_init (LibMeboRateControllerConfig *cfg,
 void
 brc_av1_rate_control_free (BrcCodecEnginePtr engine_ptr) {
   AV1RateControlRTC *rtc = (AV1RateControlRTC *) engine_ptr;	
-  if (rtc)
+  if (rtc) {
+    av1_cyclic_refresh_free(rtc->cpi_.cyclic_refresh);
+    brc_roi_free(&rtc->cpi_.roi);
     free(rtc);
+  }
 }
@@ -42,6 +42,7 @@ void av1_init_layer_context(AV1_COMP *const cpi) {
       }
       lc->target_bandwidth = lc->layer_target_bitrate;
       lrc->last_q[AV1_INTER_FRAME] = lrc->worst_quality;
+      lrc->last_coded_qindex = lrc->worst_quality;
       lrc->avg_frame_qindex[AV1_INTER_FRAME] = lrc->worst_quality;
       lrc->avg_frame_qindex[AV1_KEY_FRAME] = lrc->worst_quality;
       lrc->buffer_level =
@@ -52,6 +53,8 @@ void av1_init_layer_context(AV1_COMP *const cpi) {
       // layer. Cyclic refresh is only applied on base temporal layer.
       if (svc->number_spatial_layers > 1 && tl == 0) {
         lc->sb_index = 0;
+        lc->actual_num_seg1_blocks = 0;
+        lc->actual_num_seg2_blocks = 0;
         lc->counter_encode_maxq_scene_change = 0;
         assert(AV1_MAXQ <= 255);
       }
@@ -62,7 +65,7 @@ void av1_init_layer_context(AV1_COMP *const cpi) {
 // Update the layer context from a change_config() call.
 void av1_update_layer_context_change_config(AV1_COMP *const cpi,
                                             const int64_t target_bandwidth) {
-  const AV1_RATE_CONTROL *const rc = &cpi->rc;
+  const AV1_RATE_CONTROL *const rc = cpi->rc;
   AV1_SVC *const svc = &cpi->svc;
   int layer = 0;
   int64_t spatial_layer_target = 0;
@@ -119,7 +122,7 @@ void av1_update_temporal_layer_framerate(AV1_COMP *const cpi) {
   const int tl = svc->temporal_layer_id;
   lc->framerate = cpi->framerate / lc->framerate_factor;
   lrc->avg_frame_bandwidth = (int)(lc->target_bandwidth / lc->framerate);
-  lrc->max_frame_bandwidth = cpi->rc.max_frame_bandwidth;
+  lrc->max_frame_bandwidth = cpi->rc->max_frame_bandwidth;
   // Update the average layer frame size (non-cumulative per-frame-bw).
   if (tl == 0) {
     lc->avg_frame_size = lrc->avg_frame_bandwidth;
@@ -139,18 +142,25 @@ void av1_update_temporal_layer_framerate(AV1_COMP *const cpi) {
 void av1_restore_layer_context(AV1_COMP *const cpi) {
   AV1_SVC *const svc = &cpi->svc;
   AV1_LAYER_CONTEXT *const lc = get_layer_context(cpi);
-  const int old_frame_since_key = cpi->rc.frames_since_key;
-  const int old_frame_to_key = cpi->rc.frames_to_key;
+  const int old_frame_since_key = cpi->rc->frames_since_key;
+  const int old_frame_to_key = cpi->rc->frames_to_key;
   // Restore layer rate control.
-  cpi->rc = lc->rc;
+  cpi->rc = &lc->rc;
   cpi->oxcf.rc_cfg.target_bandwidth = lc->target_bandwidth;
   // Reset the frames_since_key and frames_to_key counters to their values
   // before the layer restore. Keep these defined for the stream (not layer).
-  cpi->rc.frames_since_key = old_frame_since_key;
-  cpi->rc.frames_to_key = old_frame_to_key;
-  
-  // ToDo: For spatial-svc, allow cyclic-refresh to be applied on the spatial layers,
+  cpi->rc->frames_since_key = old_frame_since_key;
+  cpi->rc->frames_to_key = old_frame_to_key;
+
+  // For spatial-svc, allow cyclic-refresh to be applied on the spatial layers,
   // for the base temporal layer.
+  if (cpi->oxcf.q_cfg.aq_mode == AV1_CYCLIC_REFRESH_AQ &&
+      svc->number_spatial_layers > 1 && svc->temporal_layer_id == 0) {
+    AV1_CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+    cr->sb_index = lc->sb_index;
+    cr->actual_num_seg1_blocks = lc->actual_num_seg1_blocks;
+    cr->actual_num_seg2_blocks = lc->actual_num_seg2_blocks;
+  }
 
   svc->skip_nonzeromv_last = 0;
   svc->skip_nonzeromv_gf = 0;
@@ -173,12 +183,19 @@ void av1_restore_layer_context(AV1_COMP *const cpi) {
 void av1_save_layer_context(AV1_COMP *const cpi) {
   AV1_SVC *const svc = &cpi->svc;
   AV1_LAYER_CONTEXT *lc = get_layer_context(cpi);
-  lc->rc = cpi->rc;
+  // cpi->rc points at lc->rc since the restore, there is nothing to copy.
   lc->target_bandwidth = (int)cpi->oxcf.rc_cfg.target_bandwidth;
   if (svc->spatial_layer_id == 0) svc->base_framerate = cpi->framerate;
 
-  // ToDo: For spatial-svc, allow cyclic-refresh to be applied on the spatial layers,
+  // For spatial-svc, allow cyclic-refresh to be applied on the spatial layers,
   // for the base temporal layer.
+  if (cpi->oxcf.q_cfg.aq_mode == AV1_CYCLIC_REFRESH_AQ &&
+      svc->number_spatial_layers > 1 && svc->temporal_layer_id == 0) {
+    AV1_CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+    lc->sb_index = cr->sb_index;
+    lc->actual_num_seg1_blocks = cr->actual_num_seg1_blocks;
+    lc->actual_num_seg2_blocks = cr->actual_num_seg2_blocks;
+  }
   // For any buffer slot that is refreshed, update it with
   // the spatial_layer_id and the current_superframe.
   if (cpi->common.current_frame.frame_type == AV1_KEY_FRAME) {
@@ -239,14 +256,31 @@ static void get_layer_resolution(const int width_org, const int height_org,
   *height_out = h;
 }
 
-void av1_one_pass_cbr_svc_start_layer(AV1_COMP *const cpi) {
+void av1_svc_update_layer_geometry(AV1_COMP *const cpi) {
   AV1_SVC *const svc = &cpi->svc;
-  AV1_LAYER_CONTEXT *lc = NULL;
-  int width = 0, height = 0;
-  lc = &svc->layer_context[svc->spatial_layer_id * svc->number_temporal_layers +
-                           svc->temporal_layer_id];
-  get_layer_resolution(cpi->oxcf.frm_dim_cfg.width,
-                       cpi->oxcf.frm_dim_cfg.height, lc->scaling_factor_num,
-                       lc->scaling_factor_den, &width, &height);
-  //av1_set_size_literal(cpi, width, height);
+  for (int sl = 0; sl < svc->number_spatial_layers; ++sl) {
+    const AV1_LAYER_CONTEXT *const lc =
+        &svc->layer_context[LAYER_IDS_TO_IDX(sl, 0,
+                                             svc->number_temporal_layers)];
+    AV1_LAYER_GEOMETRY *const geometry = &svc->layer_geometry[sl];
+    int width = 0, height = 0;
+    get_layer_resolution(cpi->oxcf.frm_dim_cfg.width,
+                         cpi->oxcf.frm_dim_cfg.height, lc->scaling_factor_num,
+                         lc->scaling_factor_den, &width, &height);
+    if (width == geometry->width && height == geometry->height) continue;
+    geometry->width = width;
+    geometry->height = height;
+    av1_set_mb_mi(&geometry->mi_params, width, height);
+  }
+}
+
+void av1_one_pass_cbr_svc_start_layer(AV1_COMP *const cpi) {
+  AV1_COMMON *const cm = &cpi->common;
+  const AV1_LAYER_GEOMETRY *const geometry =
+      &cpi->svc.layer_geometry[cpi->svc.spatial_layer_id];
+  // As av1_set_size_literal(), a layer without a size keeps the frame size.
+  if (geometry->width <= 0 || geometry->height <= 0) return;
+  cm->width = geometry->width;
+  cm->height = geometry->height;
+  cm->mi_params = geometry->mi_params;
 }
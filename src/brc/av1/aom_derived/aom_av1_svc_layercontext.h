@@ -39,6 +39,18 @@ typedef struct {
    */
   int sb_index;
 
+  /*!
+   * Actual number of (4x4) blocks that were applied delta-q,
+   * for segment 1.
+   */
+  int actual_num_seg1_blocks;
+
+  /*!
+   * Actual number of (4x4) blocks that were applied delta-q,
+   * for segment 2.
+   */
+  int actual_num_seg2_blocks;
+
   /*!
    * Counter used to detect scene change.
    */
@@ -48,20 +60,22 @@ typedef struct {
    * Speed settings for each layer.
    */
   uint8_t speed;
-  /*!
-   * GF group index.
-   */
-  unsigned char group_index;
   /*!
    * If current layer is key frame.
    */
   int is_key_frame;
-  /*!
-   * Maximum motion magnitude of previous encoded layer.
-   */
-  int max_mv_magnitude;
 } AV1_LAYER_CONTEXT;
 
+/*!
+ * \brief Frame size of a spatial layer and its mode info geometry.
+ * \ingroup SVC
+ */
+typedef struct {
+  int width;                       /*!< Frame width of the layer */
+  int height;                      /*!< Frame height of the layer */
+  CommonModeInfoParams mi_params;  /*!< MB and mode info counts */
+} AV1_LAYER_GEOMETRY;
+
 /*!
  * \brief The stucture of SVC.
  * \ingroup SVC
@@ -74,14 +88,6 @@ typedef struct AV1_SVC {
   int number_temporal_layers;
   int external_ref_frame_config;
   int non_reference_frame;
-  /*!\endcond */
-
-  /*!
-   * LAST_FRAME (0), LAST2_FRAME(1), LAST3_FRAME(2), GOLDEN_FRAME(3),
-   * BWDREF_FRAME(4), ALTREF2_FRAME(5), ALTREF_FRAME(6).
-   */
-  int reference[AV1_INTER_REFS_PER_FRAME];
-  /*!\cond */
   int ref_idx[AV1_INTER_REFS_PER_FRAME];
   int refresh[AV1_REF_FRAMES];
   double base_framerate;
@@ -90,8 +96,6 @@ typedef struct AV1_SVC {
   unsigned char buffer_spatial_layer[AV1_REF_FRAMES];
   int skip_nonzeromv_last;
   int skip_nonzeromv_gf;
-  int spatial_layer_fb[AV1_REF_FRAMES];
-  int temporal_layer_fb[AV1_REF_FRAMES];
   int num_encoded_top_layer;
   /*!\endcond */
 
@@ -100,6 +104,10 @@ typedef struct AV1_SVC {
    */
   AV1_LAYER_CONTEXT layer_context[AOM_MAX_LAYERS];
 
+  /*!
+   * Frame geometry of each spatial layer, computed when the config is set.
+   */
+  AV1_LAYER_GEOMETRY layer_geometry[AOM_MAX_SS_LAYERS];
 
   /*!
    * Force zero-mv in mode search for the spatial/inter-layer reference.
@@ -199,6 +207,19 @@ void av1_free_svc_cyclic_refresh(struct AV1_COMP *const cpi);
  */
 void av1_svc_reset_temporal_layers(struct AV1_COMP *const cpi, int is_key);
 
+/*!\brief Update the frame geometry of the spatial layers whose size changed
+ * with the config.
+ *
+ * \ingroup SVC
+ * \callgraph
+ * \callergraph
+ *
+ * \param[in]       cpi  Top level encoder structure
+ *
+ * \return  Nothing returned. Set cpi->svc.layer_geometry.
+ */
+void av1_svc_update_layer_geometry(struct AV1_COMP *const cpi);
+
 /*!\brief Before encoding, set resolutions and allocate compressor data.
  *
  * \ingroup SVC
@@ -0,0 +1,150 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "brc_activity_aq.h"
+
+// Change of the log2 rate between two consecutive activity levels, at
+// strength 1.0.
+#define ACTIVITY_LOG2_RATE_STEP 0.25
+#define ACTIVITY_MAX_STRENGTH 4.0
+
+static inline int clamp(int value, int low, int high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+// Fixed point log2(variance + 1). Must match the SIMD kernels bit-exactly,
+// so the rounding steps are the same: float conversion, quadratic mantissa
+// approximation and round-to-nearest-even of the scaled result.
+static inline int log2_fixed(uint32_t variance) {
+  union {
+    float f;
+    uint32_t i;
+  } v, m;
+  int e;
+  float p;
+
+  if (variance > INT32_MAX - 1) variance = INT32_MAX - 1;
+  v.f = (float)(int32_t)(variance + 1);
+  e = (int)(v.i >> 23) - 127;
+  m.i = (v.i & 0x7FFFFF) | 0x3F800000;
+  p = (BRC_ACTIVITY_LOG2_C2 * m.f + BRC_ACTIVITY_LOG2_C1) * m.f +
+      BRC_ACTIVITY_LOG2_C0;
+  return (int)lrintf(((float)e + p) * (float)(1 << BRC_ACTIVITY_LOG2_PREC_BITS));
+}
+
+int64_t brc_activity_sum_log2_c(const uint32_t *variance, int count) {
+  int64_t sum = 0;
+  int i;
+  for (i = 0; i < count; i++) sum += log2_fixed(variance[i]);
+  return sum;
+}
+
+void brc_activity_map_levels_c(const uint32_t *variance, int count,
+                               int avg_log2, uint8_t *map, int *hist) {
+  const int round = 1 << (BRC_ACTIVITY_LOG2_PREC_BITS - 1);
+  int i;
+  for (i = 0; i < count; i++) {
+    const int level =
+        (log2_fixed(variance[i]) - avg_log2 + round) >>
+        BRC_ACTIVITY_LOG2_PREC_BITS;
+    map[i] = (uint8_t)(clamp(level, BRC_ACTIVITY_LEVEL_MIN,
+                             BRC_ACTIVITY_LEVEL_MAX) -
+                       BRC_ACTIVITY_LEVEL_MIN);
+    hist[map[i]]++;
+  }
+}
+
+static brc_activity_sum_log2_fn sum_log2 = NULL;
+static brc_activity_map_levels_fn map_levels = NULL;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void setup_kernels(void) {
+  brc_activity_sum_log2_fn s = brc_activity_sum_log2_c;
+  brc_activity_map_levels_fn l = brc_activity_map_levels_c;
+#if BRC_ACTIVITY_HAVE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    s = brc_activity_sum_log2_avx2;
+    l = brc_activity_map_levels_avx2;
+  } else if (__builtin_cpu_supports("sse4.1")) {
+    s = brc_activity_sum_log2_sse4_1;
+    l = brc_activity_map_levels_sse4_1;
+  }
+#endif
+  map_levels = l;
+  sum_log2 = s;
+}
+
+LibMeboStatus brc_activity_aq_compute_map(BrcCodecEnginePtr handler,
+                                          brc_qdelta_by_rate_fn qdelta_by_rate,
+                                          const LibMeboActivityInfo *activity,
+                                          LibMeboSegmentationMap *seg_map) {
+  int hist[BRC_ACTIVITY_NUM_LEVELS] = { 0 };
+  double rate_ratio[BRC_ACTIVITY_NUM_LEVELS];
+  double strength, avg_rate_ratio = 0.0;
+  int64_t sum = 0;
+  int count, avg_log2, i;
+
+  if (!activity->variance || !seg_map->map || activity->cols <= 0 ||
+      activity->rows <= 0 || activity->cols > INT32_MAX / activity->rows)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+  count = activity->cols * activity->rows;
+  if (seg_map->map_size < (uint32_t)count)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+
+  pthread_once(&kernels_once, setup_kernels);
+
+  for (i = 0; i < count; i += BRC_ACTIVITY_CHUNK_SIZE) {
+    const int n = count - i < BRC_ACTIVITY_CHUNK_SIZE
+                      ? count - i
+                      : BRC_ACTIVITY_CHUNK_SIZE;
+    sum += sum_log2(activity->variance + i, n);
+  }
+  avg_log2 = (int)((sum + count / 2) / count);
+
+  for (i = 0; i < count; i += BRC_ACTIVITY_CHUNK_SIZE) {
+    const int n = count - i < BRC_ACTIVITY_CHUNK_SIZE
+                      ? count - i
+                      : BRC_ACTIVITY_CHUNK_SIZE;
+    map_levels(activity->variance + i, n, avg_log2, seg_map->map + i, hist);
+  }
+
+  // Flat blocks get more bits and busy blocks less. The ratios are then
+  // normalized by their block weighted average, so the frame rate at the
+  // frame qindex is unchanged.
+  strength = activity->strength > 0.0f ? activity->strength : 1.0;
+  if (strength > ACTIVITY_MAX_STRENGTH) strength = ACTIVITY_MAX_STRENGTH;
+  for (i = 0; i < BRC_ACTIVITY_NUM_LEVELS; i++) {
+    const int level = i + BRC_ACTIVITY_LEVEL_MIN;
+    rate_ratio[i] = pow(2.0, -strength * ACTIVITY_LOG2_RATE_STEP * level);
+    avg_rate_ratio += hist[i] * rate_ratio[i];
+  }
+  avg_rate_ratio /= count;
+
+  memset(seg_map->delta_qp, 0, sizeof(seg_map->delta_qp));
+  for (i = 0; i < BRC_ACTIVITY_NUM_LEVELS; i++) {
+    LibMeboStatus status;
+    if (!hist[i]) continue;
+    status = qdelta_by_rate(handler, rate_ratio[i] / avg_rate_ratio,
+                            &seg_map->delta_qp[i]);
+    if (status != LIBMEBO_STATUS_SUCCESS) return status;
+  }
+
+  seg_map->enabled = 1;
+  seg_map->block_size = activity->block_size;
+  seg_map->cols = activity->cols;
+  seg_map->rows = activity->rows;
+  seg_map->num_segments = BRC_ACTIVITY_NUM_LEVELS;
+  return LIBMEBO_STATUS_SUCCESS;
+}
@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef LIBMEBO_BRC_ACTIVITY_AQ_H
+#define LIBMEBO_BRC_ACTIVITY_AQ_H
+
+#include <stdint.h>
+
+#include "../../lib/libmebo.h"
+
+// Blocks are classified in activity levels relative to the frame average,
+// one level per doubling of the block variance. Each level is a segment of
+// the output map, segment id = level - BRC_ACTIVITY_LEVEL_MIN.
+#define BRC_ACTIVITY_LEVEL_MIN (-4)
+#define BRC_ACTIVITY_LEVEL_MAX 3
+#define BRC_ACTIVITY_NUM_LEVELS \
+  (BRC_ACTIVITY_LEVEL_MAX - BRC_ACTIVITY_LEVEL_MIN + 1)
+
+// Precision of the fixed point log2 of the variances.
+#define BRC_ACTIVITY_LOG2_PREC_BITS 10
+
+// log2(m) ~= (C2 * m + C1) * m + C0 for the mantissa m in [1, 2).
+#define BRC_ACTIVITY_LOG2_C2 (-0.34484843f)
+#define BRC_ACTIVITY_LOG2_C1 2.02466578f
+#define BRC_ACTIVITY_LOG2_C0 (-1.67487759f)
+
+// Kernels process the map in chunks of this many blocks so the per-lane
+// 32-bit sums of log2 values can not overflow.
+#define BRC_ACTIVITY_CHUNK_SIZE (1 << 16)
+
+// Returns the qindex delta that scales the rate of a block by rate_ratio,
+// relative to the qindex of the current frame.
+typedef LibMeboStatus (*brc_qdelta_by_rate_fn)(BrcCodecEnginePtr handler,
+                                               double rate_ratio, int *qdelta);
+
+// Sum of the fixed point log2(variance + 1) of count blocks,
+// count <= BRC_ACTIVITY_CHUNK_SIZE.
+typedef int64_t (*brc_activity_sum_log2_fn)(const uint32_t *variance,
+                                            int count);
+
+// Write the segment id of count blocks to map, given the fixed point
+// average log2 variance of the frame, and add the number of blocks of each
+// segment to hist.
+typedef void (*brc_activity_map_levels_fn)(const uint32_t *variance,
+                                           int count, int avg_log2,
+                                           uint8_t *map, int *hist);
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BRC_ACTIVITY_HAVE_X86 1
+#else
+#define BRC_ACTIVITY_HAVE_X86 0
+#endif
+
+int64_t brc_activity_sum_log2_c(const uint32_t *variance, int count);
+void brc_activity_map_levels_c(const uint32_t *variance, int count,
+                               int avg_log2, uint8_t *map, int *hist);
+
+#if BRC_ACTIVITY_HAVE_X86
+int64_t brc_activity_sum_log2_sse4_1(const uint32_t *variance, int count);
+void brc_activity_map_levels_sse4_1(const uint32_t *variance, int count,
+                                    int avg_log2, uint8_t *map, int *hist);
+int64_t brc_activity_sum_log2_avx2(const uint32_t *variance, int count);
+void brc_activity_map_levels_avx2(const uint32_t *variance, int count,
+                                  int avg_log2, uint8_t *map, int *hist);
+#endif
+
+// Compute the activity segmentation map of a frame from the per-block
+// variances, with per-segment delta-QPs that keep the rate of the frame
+// unchanged according to the rate model of the codec.
+LIBMEBO_API LibMeboStatus
+brc_activity_aq_compute_map(BrcCodecEnginePtr handler,
+                            brc_qdelta_by_rate_fn qdelta_by_rate,
+                            const LibMeboActivityInfo *activity,
+                            LibMeboSegmentationMap *seg_map);
+
+#endif  // LIBMEBO_BRC_ACTIVITY_AQ_H
@@ -0,0 +1,219 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "brc_activity_aq.h"
+
+#if BRC_ACTIVITY_HAVE_X86
+
+#include <immintrin.h>
+
+// The kernels are built with function level target attributes, and are only
+// selected at run time if the cpu supports them. The results are bit-exact
+// with the C kernels, the tails of the arrays are handled by the C kernels.
+
+#define SSE4_1 __attribute__((target("sse4.1")))
+#define AVX2 __attribute__((target("avx2")))
+
+static inline SSE4_1 __m128i log2_fixed_sse4_1(__m128i v) {
+  const __m128i max = _mm_set1_epi32(INT32_MAX - 1);
+  const __m128i mant_mask = _mm_set1_epi32(0x7FFFFF);
+  const __m128i one_bits = _mm_set1_epi32(0x3F800000);
+  __m128i bits, e;
+  __m128 m, p;
+
+  v = _mm_add_epi32(_mm_min_epu32(v, max), _mm_set1_epi32(1));
+  bits = _mm_castps_si128(_mm_cvtepi32_ps(v));
+  e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+  m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mant_mask), one_bits));
+  p = _mm_add_ps(
+      _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(BRC_ACTIVITY_LOG2_C2), m),
+                            _mm_set1_ps(BRC_ACTIVITY_LOG2_C1)),
+                 m),
+      _mm_set1_ps(BRC_ACTIVITY_LOG2_C0));
+  return _mm_cvtps_epi32(
+      _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(e), p),
+                 _mm_set1_ps((float)(1 << BRC_ACTIVITY_LOG2_PREC_BITS))));
+}
+
+static inline SSE4_1 __m128i level_sse4_1(__m128i log2, __m128i offset) {
+  const __m128i level = _mm_srai_epi32(_mm_add_epi32(log2, offset),
+                                       BRC_ACTIVITY_LOG2_PREC_BITS);
+  return _mm_sub_epi32(
+      _mm_min_epi32(_mm_max_epi32(level, _mm_set1_epi32(BRC_ACTIVITY_LEVEL_MIN)),
+                    _mm_set1_epi32(BRC_ACTIVITY_LEVEL_MAX)),
+      _mm_set1_epi32(BRC_ACTIVITY_LEVEL_MIN));
+}
+
+// Segment counts are accumulated in 8-bit lanes, one vector per segment,
+// and flushed before they can wrap.
+#define MAX_COUNT_ITERATIONS 255
+
+static inline SSE4_1 void flush_counts_sse4_1(__m128i *counts, int *hist) {
+  int k;
+  for (k = 0; k < BRC_ACTIVITY_NUM_LEVELS; k++) {
+    const __m128i sad = _mm_sad_epu8(counts[k], _mm_setzero_si128());
+    hist[k] += _mm_cvtsi128_si32(sad) + _mm_extract_epi32(sad, 2);
+    counts[k] = _mm_setzero_si128();
+  }
+}
+
+SSE4_1 int64_t brc_activity_sum_log2_sse4_1(const uint32_t *variance,
+                                            int count) {
+  __m128i sum = _mm_setzero_si128();
+  int64_t total;
+  int i;
+
+  for (i = 0; i + 4 <= count; i += 4) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(variance + i));
+    sum = _mm_add_epi32(sum, log2_fixed_sse4_1(v));
+  }
+  total = (int64_t)_mm_extract_epi32(sum, 0) + _mm_extract_epi32(sum, 1) +
+          _mm_extract_epi32(sum, 2) + _mm_extract_epi32(sum, 3);
+  return total + brc_activity_sum_log2_c(variance + i, count - i);
+}
+
+SSE4_1 void brc_activity_map_levels_sse4_1(const uint32_t *variance,
+                                           int count, int avg_log2,
+                                           uint8_t *map, int *hist) {
+  const __m128i offset = _mm_set1_epi32(
+      (1 << (BRC_ACTIVITY_LOG2_PREC_BITS - 1)) - avg_log2);
+  __m128i counts[BRC_ACTIVITY_NUM_LEVELS];
+  int i, k, iterations = 0;
+
+  for (k = 0; k < BRC_ACTIVITY_NUM_LEVELS; k++)
+    counts[k] = _mm_setzero_si128();
+
+  for (i = 0; i + 16 <= count; i += 16) {
+    const __m128i *src = (const __m128i *)(variance + i);
+    const __m128i l0 = level_sse4_1(log2_fixed_sse4_1(_mm_loadu_si128(src)),
+                                    offset);
+    const __m128i l1 =
+        level_sse4_1(log2_fixed_sse4_1(_mm_loadu_si128(src + 1)), offset);
+    const __m128i l2 =
+        level_sse4_1(log2_fixed_sse4_1(_mm_loadu_si128(src + 2)), offset);
+    const __m128i l3 =
+        level_sse4_1(log2_fixed_sse4_1(_mm_loadu_si128(src + 3)), offset);
+    const __m128i ids = _mm_packus_epi16(_mm_packs_epi32(l0, l1),
+                                         _mm_packs_epi32(l2, l3));
+    _mm_storeu_si128((__m128i *)(map + i), ids);
+    for (k = 0; k < BRC_ACTIVITY_NUM_LEVELS; k++)
+      counts[k] = _mm_sub_epi8(counts[k],
+                               _mm_cmpeq_epi8(ids, _mm_set1_epi8((char)k)));
+    if (++iterations == MAX_COUNT_ITERATIONS) {
+      flush_counts_sse4_1(counts, hist);
+      iterations = 0;
+    }
+  }
+  flush_counts_sse4_1(counts, hist);
+  brc_activity_map_levels_c(variance + i, count - i, avg_log2, map + i, hist);
+}
+
+static inline AVX2 __m256i log2_fixed_avx2(__m256i v) {
+  const __m256i max = _mm256_set1_epi32(INT32_MAX - 1);
+  const __m256i mant_mask = _mm256_set1_epi32(0x7FFFFF);
+  const __m256i one_bits = _mm256_set1_epi32(0x3F800000);
+  __m256i bits, e;
+  __m256 m, p;
+
+  v = _mm256_add_epi32(_mm256_min_epu32(v, max), _mm256_set1_epi32(1));
+  bits = _mm256_castps_si256(_mm256_cvtepi32_ps(v));
+  e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+  m = _mm256_castsi256_ps(
+      _mm256_or_si256(_mm256_and_si256(bits, mant_mask), one_bits));
+  p = _mm256_add_ps(
+      _mm256_mul_ps(
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(BRC_ACTIVITY_LOG2_C2), m),
+                        _mm256_set1_ps(BRC_ACTIVITY_LOG2_C1)),
+          m),
+      _mm256_set1_ps(BRC_ACTIVITY_LOG2_C0));
+  return _mm256_cvtps_epi32(
+      _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(e), p),
+                    _mm256_set1_ps((float)(1 << BRC_ACTIVITY_LOG2_PREC_BITS))));
+}
+
+static inline AVX2 __m256i level_avx2(__m256i log2, __m256i offset) {
+  const __m256i level = _mm256_srai_epi32(_mm256_add_epi32(log2, offset),
+                                          BRC_ACTIVITY_LOG2_PREC_BITS);
+  return _mm256_sub_epi32(
+      _mm256_min_epi32(
+          _mm256_max_epi32(level, _mm256_set1_epi32(BRC_ACTIVITY_LEVEL_MIN)),
+          _mm256_set1_epi32(BRC_ACTIVITY_LEVEL_MAX)),
+      _mm256_set1_epi32(BRC_ACTIVITY_LEVEL_MIN));
+}
+
+static inline AVX2 void flush_counts_avx2(__m256i *counts, int *hist) {
+  int k;
+  for (k = 0; k < BRC_ACTIVITY_NUM_LEVELS; k++) {
+    const __m256i sad = _mm256_sad_epu8(counts[k], _mm256_setzero_si256());
+    const __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sad),
+                                      _mm256_extracti128_si256(sad, 1));
+    hist[k] += _mm_cvtsi128_si32(sum) + _mm_extract_epi32(sum, 2);
+    counts[k] = _mm256_setzero_si256();
+  }
+}
+
+AVX2 int64_t brc_activity_sum_log2_avx2(const uint32_t *variance, int count) {
+  __m256i sum = _mm256_setzero_si256();
+  __m128i sum128;
+  int64_t total;
+  int i;
+
+  for (i = 0; i + 8 <= count; i += 8) {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)(variance + i));
+    sum = _mm256_add_epi32(sum, log2_fixed_avx2(v));
+  }
+  sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                         _mm256_extracti128_si256(sum, 1));
+  total = (int64_t)_mm_extract_epi32(sum128, 0) +
+          _mm_extract_epi32(sum128, 1) + _mm_extract_epi32(sum128, 2) +
+          _mm_extract_epi32(sum128, 3);
+  return total + brc_activity_sum_log2_c(variance + i, count - i);
+}
+
+AVX2 void brc_activity_map_levels_avx2(const uint32_t *variance, int count,
+                                       int avg_log2, uint8_t *map,
+                                       int *hist) {
+  const __m256i offset = _mm256_set1_epi32(
+      (1 << (BRC_ACTIVITY_LOG2_PREC_BITS - 1)) - avg_log2);
+  // The in-lane packs interleave the 4 byte groups of the 128-bit lanes.
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  __m256i counts[BRC_ACTIVITY_NUM_LEVELS];
+  int i, k, iterations = 0;
+
+  for (k = 0; k < BRC_ACTIVITY_NUM_LEVELS; k++)
+    counts[k] = _mm256_setzero_si256();
+
+  for (i = 0; i + 32 <= count; i += 32) {
+    const __m256i *src = (const __m256i *)(variance + i);
+    const __m256i l0 =
+        level_avx2(log2_fixed_avx2(_mm256_loadu_si256(src)), offset);
+    const __m256i l1 =
+        level_avx2(log2_fixed_avx2(_mm256_loadu_si256(src + 1)), offset);
+    const __m256i l2 =
+        level_avx2(log2_fixed_avx2(_mm256_loadu_si256(src + 2)), offset);
+    const __m256i l3 =
+        level_avx2(log2_fixed_avx2(_mm256_loadu_si256(src + 3)), offset);
+    const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(l0, l1),
+                                               _mm256_packs_epi32(l2, l3));
+    const __m256i ids = _mm256_permutevar8x32_epi32(packed, order);
+    _mm256_storeu_si256((__m256i *)(map + i), ids);
+    for (k = 0; k < BRC_ACTIVITY_NUM_LEVELS; k++)
+      counts[k] = _mm256_sub_epi8(
+          counts[k], _mm256_cmpeq_epi8(ids, _mm256_set1_epi8((char)k)));
+    if (++iterations == MAX_COUNT_ITERATIONS) {
+      flush_counts_avx2(counts, hist);
+      iterations = 0;
+    }
+  }
+  flush_counts_avx2(counts, hist);
+  brc_activity_map_levels_c(variance + i, count - i, avg_log2, map + i, hist);
+}
+
+#endif  // BRC_ACTIVITY_HAVE_X86
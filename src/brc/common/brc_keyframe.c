@@ -0,0 +1,84 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "brc_keyframe.h"
+
+// Inter frame target of one pass CBR: the rate control steers the buffer
+// back to the optimal level by at most half the under/overshoot percentage.
+static int inter_frame_target(const BrcKeyFrameState *state,
+                              int64_t buffer_level) {
+  const int64_t diff = state->optimal_buffer_level - buffer_level;
+  const int64_t one_pct_bits = 1 + state->optimal_buffer_level / 100;
+  int target = state->avg_frame_bandwidth;
+
+  if (diff > 0) {
+    int64_t pct_low = diff / one_pct_bits;
+    if (pct_low > state->undershoot_pct) pct_low = state->undershoot_pct;
+    target -= (int)(target * pct_low / 200);
+  } else if (diff < 0) {
+    int64_t pct_high = -diff / one_pct_bits;
+    if (pct_high > state->overshoot_pct) pct_high = state->overshoot_pct;
+    target += (int)(target * pct_high / 200);
+  }
+  return target;
+}
+
+static int64_t add_frame(const BrcKeyFrameState *state, int64_t buffer_level,
+                         int frame_size) {
+  buffer_level += state->avg_frame_bandwidth - frame_size;
+  if (buffer_level > state->maximum_buffer_size)
+    buffer_level = state->maximum_buffer_size;
+  return buffer_level;
+}
+
+LibMeboStatus brc_keyframe_get_advice(BrcCodecEnginePtr handler,
+                                      brc_key_frame_size_fn key_frame_size,
+                                      const BrcKeyFrameState *state,
+                                      int max_interval,
+                                      LibMeboKeyFrameAdvice *advice) {
+  // Below this level the rate control gives the following frames the
+  // worst quality, the key frame would stall the stream.
+  const int64_t critical_level = state->optimal_buffer_level >> 3;
+  int64_t buffer_level = state->buffer_level;
+  int64_t best_level = 0;
+  int best_size = 0, best_frame = -1, prev_size = -1;
+  int k;
+
+  if (max_interval < 0) return LIBMEBO_STATUS_INVALID_PARAM;
+
+  for (k = 0; k <= max_interval; k++) {
+    const int size = key_frame_size(handler, k);
+    const int64_t level = add_frame(state, buffer_level, size);
+    int64_t next_level;
+
+    if (best_frame < 0 || level > best_level) {
+      best_frame = k;
+      best_level = level;
+      best_size = size;
+    }
+    if (level >= critical_level) break;
+
+    next_level = add_frame(state, buffer_level,
+                           inter_frame_target(state, buffer_level));
+    // Once the buffer and the key frame size settle the later frames are
+    // no better.
+    if (next_level == buffer_level && size == prev_size) break;
+    buffer_level = next_level;
+    prev_size = size;
+  }
+
+  advice->frames_to_key = best_frame;
+  advice->predicted_size = (best_size + 7) >> 3;
+  advice->buffer_level_ms =
+      state->target_bandwidth > 0
+          ? (int)(best_level * 1000 / state->target_bandwidth)
+          : 0;
+  return LIBMEBO_STATUS_SUCCESS;
+}
@@ -0,0 +1,45 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef LIBMEBO_BRC_KEYFRAME_H
+#define LIBMEBO_BRC_KEYFRAME_H
+
+#include <stdint.h>
+
+#include "../../lib/libmebo.h"
+
+// Rate control state the buffer is projected from, levels in bits.
+typedef struct BrcKeyFrameState {
+  int64_t buffer_level;
+  int64_t optimal_buffer_level;
+  int64_t maximum_buffer_size;
+  // Bits added to the buffer per frame.
+  int avg_frame_bandwidth;
+  int undershoot_pct;
+  int overshoot_pct;
+  // Bits per second, to express the buffer level in time.
+  int64_t target_bandwidth;
+} BrcKeyFrameState;
+
+// Predicted size in bits of a key frame coded frames_ahead frames after
+// the next one.
+typedef int (*brc_key_frame_size_fn)(BrcCodecEnginePtr handler,
+                                     int frames_ahead);
+
+// Find the earliest of the next max_interval + 1 frames at which the buffer
+// can take a key frame, given the inter frames before it get the targets of
+// one pass CBR.
+LibMeboStatus brc_keyframe_get_advice(BrcCodecEnginePtr handler,
+                                      brc_key_frame_size_fn key_frame_size,
+                                      const BrcKeyFrameState *state,
+                                      int max_interval,
+                                      LibMeboKeyFrameAdvice *advice);
+
+#endif  // LIBMEBO_BRC_KEYFRAME_H
@@ -0,0 +1,665 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "brc_keyframe.h"
+#include "brc_qp_ratectrl.h"
+#include "brc_ratectrl.h"
+
+#define BRC_QP_MIN(x, y) (((x) < (y)) ? (x) : (y))
+#define BRC_QP_MAX(x, y) (((x) > (y)) ? (x) : (y))
+#define ROUND_POWER_OF_TWO(value, n) (((value) + (1 << ((n)-1))) >> (n))
+
+static inline int clamp(int value, int low, int high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+#undef ERROR
+#define ERROR(str)                  \
+  do {                              \
+    fprintf(stderr, "%s \n", str);	    \
+    return LIBMEBO_STATUS_INVALID_PARAM; \
+  } while (0)
+
+#define RANGE_CHECK(p, memb, lo, hi)                                     \
+  do {                                                                   \
+    if (!(((p)->memb == (lo) || (p)->memb > (lo)) && (p)->memb <= (hi))) \
+      ERROR(#memb " out of range [" #lo ".." #hi "]");                   \
+  } while (0)
+
+#define RANGE_CHECK_HI(p, memb, hi)                                     \
+  do {                                                                  \
+    if (!((p)->memb <= (hi))) ERROR(#memb " out of range [.." #hi "]"); \
+  } while (0)
+
+// Active best quality below the ambient QP: about a 2.5x finer step size for
+// key frames, 1.8x for inter frames.
+#define KF_ACTIVE_QP_DELTA 8
+#define INTER_ACTIVE_QP_DELTA 5
+
+// Number of the first frames whose ambient QP also weighs the key frame QP.
+#define NUM_FRAMES_WEIGHT_KEY 5
+
+// Step size of QP' in 1/64 units of the samples of the bit depth, which
+// are 1 << (bit_depth - 8) times finer than 8 bit samples.
+static int qp_to_qstep(const BrcQpRc *rc, int qp) {
+  qp = clamp(qp, BRC_QP_MIN_QP, BRC_QP_MAX_QP + rc->qp_bd_offset);
+  return rc->codec->level_scale[qp % 6] << (qp / 6);
+}
+
+// Bits per block at a step size of 1.0 in units of the bit depth.
+static int64_t qp_enumerator(const BrcQpRc *rc, BrcQpFrameType frame_type) {
+  return ((int64_t)rc->codec->enumerator[frame_type] * 64)
+         << (rc->qp_bd_offset / 6);
+}
+
+int brc_qp_rc_bits_per_mb(const BrcQpRc *rc, BrcQpFrameType frame_type,
+                          int qp, double correction_factor) {
+  return brc_rc_model_bits_per_mb(qp_enumerator(rc, frame_type),
+                                  qp_to_qstep(rc, qp), 0, correction_factor);
+}
+
+static void init_rate_curves(BrcQpRc *rc) {
+  int frame_type, qp;
+
+  for (frame_type = 0; frame_type < BRC_QP_FRAME_TYPES; frame_type++) {
+    BrcRcRateCurve *curve = &rc->rate_curve[frame_type];
+    for (qp = 0; qp < BRC_QP_RANGE + rc->qp_bd_offset; qp++) {
+      curve->numerator[qp] = (int32_t)qp_enumerator(rc, frame_type);
+      curve->denominator[qp] = qp_to_qstep(rc, qp);
+    }
+    curve->num_q = BRC_QP_RANGE + rc->qp_bd_offset;
+    curve->round = 0;
+    brc_rc_init_rate_curve(curve);
+  }
+}
+
+int brc_qp_estimate_bits_at_q(const BrcQpRc *rc, BrcQpFrameType frame_type,
+                              int qp, int mbs, double correction_factor) {
+  const int bpm = brc_qp_rc_bits_per_mb(rc, frame_type, qp, correction_factor);
+  return BRC_QP_MAX(BRC_QP_FRAME_OVERHEAD_BITS,
+                  (int)(((int64_t)bpm * mbs) >> BRC_RC_BPER_MB_NORMBITS));
+}
+
+static int64_t rescale_buffer(int64_t level_ms, int64_t bandwidth) {
+  return level_ms * bandwidth / 1000;
+}
+
+static void update_layers(BrcQpRc *cpi, int reset) {
+  const BrcQpRcConfig *oxcf = &cpi->oxcf;
+  const int layered = oxcf->ss_number_layers * oxcf->ts_number_layers > 1;
+  int sl, tl;
+
+  for (sl = 0; sl < oxcf->ss_number_layers; ++sl) {
+    for (tl = 0; tl < oxcf->ts_number_layers; ++tl) {
+      const int layer = sl * oxcf->ts_number_layers + tl;
+      BrcQpLayerRc *lrc = &cpi->layer[layer];
+      const int64_t bw =
+          layered ? oxcf->layer_target_bitrate[layer] : oxcf->target_bandwidth;
+
+      lrc->target_bandwidth = bw;
+      lrc->framerate = oxcf->ts_number_layers > 1
+                           ? oxcf->framerate / oxcf->ts_rate_decimator[tl]
+                           : oxcf->framerate;
+      lrc->avg_frame_bandwidth =
+          (int)BRC_QP_MIN(bw / lrc->framerate, INT_MAX);
+      if (tl == 0) {
+        lrc->avg_frame_size = lrc->avg_frame_bandwidth;
+      } else {
+        const BrcQpLayerRc *prev = &cpi->layer[layer - 1];
+        lrc->avg_frame_size =
+            (int)((bw - prev->target_bandwidth) /
+                  (lrc->framerate - prev->framerate));
+      }
+
+      lrc->starting_buffer_level =
+          rescale_buffer(oxcf->starting_buffer_level_ms, bw);
+      lrc->optimal_buffer_level =
+          oxcf->optimal_buffer_level_ms == 0
+              ? bw / 8
+              : rescale_buffer(oxcf->optimal_buffer_level_ms, bw);
+      lrc->maximum_buffer_size =
+          oxcf->maximum_buffer_size_ms == 0
+              ? bw / 8
+              : rescale_buffer(oxcf->maximum_buffer_size_ms, bw);
+      lrc->max_frame_bandwidth =
+          (int)BRC_QP_MIN(lrc->maximum_buffer_size / 2, INT_MAX);
+
+      if (oxcf->ss_number_layers > 1) {
+        lrc->width = oxcf->width * oxcf->scaling_factor_num[sl] /
+                     oxcf->scaling_factor_den[sl];
+        lrc->height = oxcf->height * oxcf->scaling_factor_num[sl] /
+                      oxcf->scaling_factor_den[sl];
+      } else {
+        lrc->width = oxcf->width;
+        lrc->height = oxcf->height;
+      }
+      lrc->mbs = ((lrc->width + 15) >> 4) * ((lrc->height + 15) >> 4);
+
+      lrc->worst_quality = oxcf->worst_allowed_qp[layer];
+      lrc->best_quality = oxcf->best_allowed_qp[layer];
+
+      if (reset) {
+        lrc->rate_correction_factors[BRC_QP_KEY_FRAME] = 1.0;
+        lrc->rate_correction_factors[BRC_QP_INTER_FRAME] = 1.0;
+        lrc->damped_adjustment[BRC_QP_KEY_FRAME] = 0;
+        lrc->damped_adjustment[BRC_QP_INTER_FRAME] = 0;
+        lrc->avg_frame_qp[BRC_QP_KEY_FRAME] = lrc->worst_quality;
+        lrc->avg_frame_qp[BRC_QP_INTER_FRAME] = lrc->worst_quality;
+        lrc->last_q[BRC_QP_KEY_FRAME] = lrc->worst_quality;
+        lrc->last_q[BRC_QP_INTER_FRAME] = lrc->worst_quality;
+        lrc->rc_1_frame = lrc->rc_2_frame = 0;
+        lrc->q_1_frame = lrc->q_2_frame = lrc->worst_quality;
+        lrc->bits_off_target = lrc->starting_buffer_level;
+        lrc->frames_since_key = 8;
+        lrc->frames_coded = 0;
+      }
+      // Keep the buffer level clipped to a smaller maximum buffer size.
+      if (lrc->bits_off_target > lrc->maximum_buffer_size)
+        lrc->bits_off_target = lrc->maximum_buffer_size;
+      lrc->buffer_level = lrc->bits_off_target;
+    }
+  }
+}
+
+static int clamp_iframe_target_size(const BrcQpRc *cpi,
+                                    const BrcQpLayerRc *lrc, int target) {
+  if (cpi->oxcf.max_intra_bitrate_pct) {
+    const int max_rate = (int)BRC_QP_MIN(
+        (int64_t)lrc->avg_frame_bandwidth * cpi->oxcf.max_intra_bitrate_pct /
+            100,
+        INT_MAX);
+    target = BRC_QP_MIN(target, max_rate);
+  }
+  return BRC_QP_MIN(target, lrc->max_frame_bandwidth);
+}
+
+// There is no coded frame to size the first key frame on: take the rate
+// model at the q the inter frames are expected to settle at, boosted like a
+// later key frame, twice for screen content whose key frame costs as much
+// as many static inter frames. An eighth of the starting buffer is the
+// floor and the whole buffer the upper bound.
+static int first_iframe_target_size(const BrcQpRc *cpi,
+                                    const BrcQpLayerRc *lrc) {
+  int kf_boost = BRC_QP_MAX(32, (int)(2 * lrc->framerate - 16));
+  int64_t prior;
+  int q = lrc->best_quality;
+
+  if (cpi->oxcf.screen_content) kf_boost *= 2;
+  while (q < lrc->worst_quality &&
+         brc_qp_estimate_bits_at_q(cpi, BRC_QP_INTER_FRAME, q, lrc->mbs, 1.0) >
+             lrc->avg_frame_size)
+    q++;
+  prior = ((int64_t)brc_qp_estimate_bits_at_q(cpi, BRC_QP_KEY_FRAME, q,
+                                              lrc->mbs, 1.0) *
+           (16 + kf_boost)) >>
+          4;
+  prior = BRC_QP_MAX(prior, lrc->starting_buffer_level / 8);
+  return (int)BRC_QP_MIN(BRC_QP_MIN(prior, lrc->starting_buffer_level),
+                         INT_MAX);
+}
+
+int brc_qp_rc_calc_iframe_target_size_one_pass_cbr(const BrcQpRc *cpi,
+                                                   int frames_ahead) {
+  const BrcQpLayerRc *lrc = &cpi->layer[brc_qp_layer_index(cpi)];
+  const int frames_since_key = lrc->frames_since_key + frames_ahead;
+  int target;
+
+  if (lrc->frames_coded == 0 && frames_ahead == 0) {
+    target = first_iframe_target_size(cpi, lrc);
+  } else {
+    int kf_boost = BRC_QP_MAX(32, (int)(2 * lrc->framerate - 16));
+    if (frames_since_key < lrc->framerate / 2)
+      kf_boost = (int)(kf_boost * frames_since_key / (lrc->framerate / 2));
+    target = (int)BRC_QP_MIN(
+        ((16 + kf_boost) * (int64_t)lrc->avg_frame_bandwidth) >> 4, INT_MAX);
+  }
+  return clamp_iframe_target_size(cpi, lrc, target);
+}
+
+int brc_qp_rc_calc_pframe_target_size_one_pass_cbr(const BrcQpRc *cpi) {
+  const BrcQpRcConfig *oxcf = &cpi->oxcf;
+  const BrcQpLayerRc *lrc = &cpi->layer[brc_qp_layer_index(cpi)];
+  const int64_t diff = lrc->optimal_buffer_level - lrc->buffer_level;
+  const int64_t one_pct_bits = 1 + lrc->optimal_buffer_level / 100;
+  // For layers avg_frame_bandwidth is cumulative over the lower temporal
+  // layers, the frame gets the average size of its own layer.
+  const int min_frame_target =
+      BRC_QP_MAX(lrc->avg_frame_size >> 4, BRC_QP_FRAME_OVERHEAD_BITS);
+  int target = lrc->avg_frame_size;
+
+  if (diff > 0) {
+    // Lower the target bandwidth for this frame.
+    const int pct_low =
+        (int)BRC_QP_MIN(diff / one_pct_bits, oxcf->under_shoot_pct);
+    target -= (int)((int64_t)target * pct_low / 200);
+  } else if (diff < 0) {
+    // Increase the target bandwidth for this frame.
+    const int pct_high =
+        (int)BRC_QP_MIN(-diff / one_pct_bits, oxcf->over_shoot_pct);
+    target += (int)((int64_t)target * pct_high / 200);
+  }
+  if (oxcf->max_inter_bitrate_pct) {
+    const int max_rate = (int)BRC_QP_MIN(
+        (int64_t)lrc->avg_frame_bandwidth * oxcf->max_inter_bitrate_pct / 100,
+        INT_MAX);
+    target = BRC_QP_MIN(target, max_rate);
+  }
+  return BRC_QP_MAX(min_frame_target, target);
+}
+
+static int calc_active_worst_quality_one_pass_cbr(const BrcQpRc *cpi,
+                                                  const BrcQpLayerRc *lrc) {
+  const int64_t critical_level = lrc->optimal_buffer_level >> 3;
+  int active_worst_quality;
+  int ambient_qp;
+
+  if (cpi->frame_type == BRC_QP_KEY_FRAME || cpi->scene_change)
+    return lrc->worst_quality;
+
+  ambient_qp = lrc->frames_coded < NUM_FRAMES_WEIGHT_KEY
+                   ? BRC_QP_MIN(lrc->avg_frame_qp[BRC_QP_INTER_FRAME],
+                                lrc->avg_frame_qp[BRC_QP_KEY_FRAME])
+                   : lrc->avg_frame_qp[BRC_QP_INTER_FRAME];
+  // About 25% above the ambient step size.
+  active_worst_quality = BRC_QP_MIN(lrc->worst_quality, ambient_qp + 2);
+
+  if (lrc->buffer_level > lrc->optimal_buffer_level) {
+    // Adjust down, by up to half the step size, less for screen content.
+    const int max_adjustment_down = cpi->oxcf.screen_content ? 2 : 6;
+    const int64_t buff_lvl_step =
+        (lrc->maximum_buffer_size - lrc->optimal_buffer_level) /
+        max_adjustment_down;
+    if (buff_lvl_step)
+      active_worst_quality -= (int)((lrc->buffer_level -
+                                     lrc->optimal_buffer_level) /
+                                    buff_lvl_step);
+  } else if (lrc->buffer_level > critical_level) {
+    // Adjust up from the ambient q.
+    const int64_t buff_lvl_step = lrc->optimal_buffer_level - critical_level;
+    if (buff_lvl_step)
+      active_worst_quality =
+          ambient_qp +
+          (int)((lrc->worst_quality - ambient_qp) *
+                (lrc->optimal_buffer_level - lrc->buffer_level) /
+                buff_lvl_step);
+  } else {
+    // Set to worst_quality if buffer is below critical level.
+    active_worst_quality = lrc->worst_quality;
+  }
+  return active_worst_quality;
+}
+
+static int regulate_q(const BrcQpRc *cpi, const BrcQpLayerRc *lrc,
+                      BrcQpFrameType frame_type, int target_bits_per_frame,
+                      int active_best_quality, int active_worst_quality) {
+  const double correction_factor = lrc->rate_correction_factors[frame_type];
+  const int target_bits_per_mb =
+      (int)(((uint64_t)target_bits_per_frame << BRC_RC_BPER_MB_NORMBITS) /
+            lrc->mbs);
+  int q = brc_rc_find_closest_q_by_rate(
+      target_bits_per_mb, brc_rc_curve_bits_per_mb,
+      &cpi->rate_curve[frame_type], correction_factor, active_best_quality,
+      active_worst_quality);
+
+  // Keep q between the oscillating qs to prevent resonance.
+  if (lrc->rc_1_frame * lrc->rc_2_frame == -1 &&
+      lrc->q_1_frame != lrc->q_2_frame)
+    q = clamp(q, BRC_QP_MIN(lrc->q_1_frame, lrc->q_2_frame),
+              BRC_QP_MAX(lrc->q_1_frame, lrc->q_2_frame));
+  return q;
+}
+
+static void pick_q(BrcQpRc *cpi) {
+  BrcQpLayerRc *lrc = &cpi->layer[brc_qp_layer_index(cpi)];
+  int active_worst_quality = calc_active_worst_quality_one_pass_cbr(cpi, lrc);
+  int active_best_quality;
+  int q;
+
+  if (cpi->scene_change) lrc->rc_1_frame = lrc->rc_2_frame = 0;
+
+  if (cpi->frame_type == BRC_QP_KEY_FRAME) {
+    active_best_quality = lrc->best_quality;
+    if (lrc->frames_coded > 0) {
+      active_best_quality =
+          lrc->avg_frame_qp[BRC_QP_KEY_FRAME] - KF_ACTIVE_QP_DELTA;
+      // Allow a somewhat lower key frame q with small image formats.
+      if (lrc->width * lrc->height <= 352 * 288) active_best_quality -= 2;
+    }
+  } else {
+    // Use the lower of active_worst_quality and recent/average q.
+    const int ambient_qp = lrc->frames_coded > 1
+                               ? lrc->avg_frame_qp[BRC_QP_INTER_FRAME]
+                               : lrc->avg_frame_qp[BRC_QP_KEY_FRAME];
+    active_best_quality =
+        BRC_QP_MIN(ambient_qp, active_worst_quality) - INTER_ACTIVE_QP_DELTA;
+  }
+
+  active_best_quality =
+      clamp(active_best_quality, lrc->best_quality, lrc->worst_quality);
+  active_worst_quality =
+      clamp(active_worst_quality, active_best_quality, lrc->worst_quality);
+
+  q = regulate_q(cpi, lrc, cpi->frame_type, lrc->this_frame_target,
+                 active_best_quality, active_worst_quality);
+  cpi->qp = clamp(q, active_best_quality, active_worst_quality);
+}
+
+// Keep the frame within the coded picture buffer of the HRD: the buffer
+// must hold the whole frame when it is removed, and a CBR stream cannot
+// leave more bits in it than its size, the encoder would have to pad the
+// frame with filler data.
+static int clamp_target_to_hrd(const BrcQpLayerRc *lrc, int target) {
+  const int64_t available = lrc->buffer_level + lrc->avg_frame_bandwidth;
+  const int64_t max_target =
+      BRC_QP_MAX(available, BRC_QP_FRAME_OVERHEAD_BITS);
+  const int64_t min_target = available - lrc->maximum_buffer_size;
+
+  if (target > max_target) return (int)max_target;
+  if (target < min_target) return (int)BRC_QP_MIN(min_target, max_target);
+  return target;
+}
+
+LibMeboStatus brc_qp_rc_compute_qp(BrcQpRc *cpi,
+                                   const LibMeboRCFrameParams *frame_params) {
+  BrcQpLayerRc *lrc;
+
+  if (frame_params->spatial_layer_id < 0 ||
+      frame_params->spatial_layer_id >= cpi->oxcf.ss_number_layers ||
+      frame_params->temporal_layer_id < 0 ||
+      frame_params->temporal_layer_id >= cpi->oxcf.ts_number_layers)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+
+  cpi->spatial_layer_id = frame_params->spatial_layer_id;
+  cpi->temporal_layer_id = frame_params->temporal_layer_id;
+  cpi->frame_type = (LIBMEBO_KEY_FRAME == frame_params->frame_type)
+                        ? BRC_QP_KEY_FRAME
+                        : BRC_QP_INTER_FRAME;
+  cpi->scene_change = !!(frame_params->flags & LIBMEBO_FRAME_FLAG_SCENE_CHANGE);
+  cpi->frame_unchanged = cpi->frame_type != BRC_QP_KEY_FRAME &&
+                         (frame_params->flags & LIBMEBO_FRAME_FLAG_UNCHANGED);
+  lrc = &cpi->layer[brc_qp_layer_index(cpi)];
+
+  if (cpi->frame_unchanged) {
+    // Nothing to code but the skipped blocks: bank the bits of the frame and
+    // keep the q of the layer, the next change starts from the same quality.
+    lrc->this_frame_target = BRC_QP_UNCHANGED_FRAME_BITS;
+    cpi->qp = clamp(lrc->q_1_frame, lrc->best_quality, lrc->worst_quality);
+  } else {
+    const int target =
+        cpi->frame_type == BRC_QP_KEY_FRAME
+            ? brc_qp_rc_calc_iframe_target_size_one_pass_cbr(cpi, 0)
+            : brc_qp_rc_calc_pframe_target_size_one_pass_cbr(cpi);
+    lrc->this_frame_target = cpi->codec->hrd_buffer_clamp
+                                 ? clamp_target_to_hrd(lrc, target)
+                                 : target;
+    pick_q(cpi);
+  }
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+static int predict_key_frame_size(BrcCodecEnginePtr handler,
+                                  int frames_ahead) {
+  const BrcQpRc *cpi = (const BrcQpRc *)handler;
+  const BrcQpLayerRc *lrc = &cpi->layer[brc_qp_layer_index(cpi)];
+  const double rcf = lrc->rate_correction_factors[BRC_QP_KEY_FRAME];
+  const int target =
+      brc_qp_rc_calc_iframe_target_size_one_pass_cbr(cpi, frames_ahead);
+  const int min_size =
+      brc_qp_estimate_bits_at_q(cpi, BRC_QP_KEY_FRAME, lrc->worst_quality,
+                                lrc->mbs, rcf);
+  const int max_size =
+      brc_qp_estimate_bits_at_q(cpi, BRC_QP_KEY_FRAME, lrc->best_quality,
+                                lrc->mbs, rcf);
+  return clamp(target, min_size, max_size);
+}
+
+LibMeboStatus brc_qp_rc_get_keyframe_advice(BrcQpRc *cpi, int max_interval,
+                                            LibMeboKeyFrameAdvice *advice) {
+  const BrcQpLayerRc *lrc = &cpi->layer[brc_qp_layer_index(cpi)];
+  BrcKeyFrameState state;
+
+  state.buffer_level = lrc->buffer_level;
+  state.optimal_buffer_level = lrc->optimal_buffer_level;
+  state.maximum_buffer_size = lrc->maximum_buffer_size;
+  state.avg_frame_bandwidth = lrc->avg_frame_bandwidth;
+  state.undershoot_pct = cpi->oxcf.under_shoot_pct;
+  state.overshoot_pct = cpi->oxcf.over_shoot_pct;
+  state.target_bandwidth = lrc->target_bandwidth;
+  return brc_keyframe_get_advice((BrcCodecEnginePtr)cpi,
+                                 predict_key_frame_size, &state, max_interval,
+                                 advice);
+}
+
+int brc_qp_compute_qdelta_by_rate(const BrcQpRc *cpi,
+                                  double rate_target_ratio) {
+  const BrcQpLayerRc *lrc = &cpi->layer[brc_qp_layer_index(cpi)];
+  const BrcRcRateCurve *curve = &cpi->rate_curve[cpi->frame_type];
+  const int qp = cpi->qp;
+  const int base_bits_per_mb = curve->unit_bits_per_mb[qp];
+  const int target_bits_per_mb = (int)(rate_target_ratio * base_bits_per_mb);
+  const int target_qp = brc_rc_find_q_by_rate(
+      target_bits_per_mb, brc_rc_table_bits_per_mb, curve->unit_bits_per_mb,
+      1.0, lrc->best_quality, lrc->worst_quality);
+
+  return target_qp - qp;
+}
+
+static void update_rate_correction_factors(BrcQpRc *cpi,
+                                           BrcQpLayerRc *lrc) {
+  const BrcQpFrameType frame_type = cpi->frame_type;
+  double rate_correction_factor = lrc->rate_correction_factors[frame_type];
+  double adjustment_limit;
+  const int projected_size_based_on_q = brc_qp_estimate_bits_at_q(
+      cpi, frame_type, cpi->qp, lrc->mbs, rate_correction_factor);
+  const int correction_factor = brc_rc_size_correction_factor(
+      lrc->projected_frame_size, projected_size_based_on_q,
+      BRC_QP_FRAME_OVERHEAD_BITS);
+
+  if (brc_rc_is_scene_change_size(correction_factor)) cpi->scene_change = 1;
+
+  // Do not use damped adjustment for the first frame of each frame type, nor
+  // on a scene change where the model of the previous scene is of no use.
+  if (!lrc->damped_adjustment[frame_type] || cpi->scene_change) {
+    adjustment_limit = 1.0;
+    lrc->damped_adjustment[frame_type] = 1;
+  } else {
+    adjustment_limit = brc_rc_adjustment_limit(correction_factor);
+  }
+
+  brc_rc_update_q_history(cpi->qp, correction_factor, &lrc->q_1_frame,
+                          &lrc->q_2_frame, &lrc->rc_1_frame,
+                          &lrc->rc_2_frame);
+
+  // Turn off oscilation detection in the case of massive overshoot, and
+  // across a scene change.
+  if ((lrc->rc_1_frame == -1 && lrc->rc_2_frame == 1 &&
+       correction_factor > 1000) ||
+      cpi->scene_change)
+    lrc->rc_2_frame = 0;
+
+  lrc->rate_correction_factors[frame_type] = brc_rc_correct_rate_factor(
+      rate_correction_factor, correction_factor, adjustment_limit);
+}
+
+static void update_buffer_level(BrcQpRc *cpi, int encoded_frame_size) {
+  const int layer = brc_qp_layer_index(cpi);
+  BrcQpLayerRc *lrc = &cpi->layer[layer];
+  int tl;
+
+  lrc->bits_off_target += lrc->avg_frame_bandwidth - encoded_frame_size;
+  lrc->bits_off_target =
+      BRC_QP_MIN(lrc->bits_off_target, lrc->maximum_buffer_size);
+  lrc->buffer_level = lrc->bits_off_target;
+
+  // The frame is also part of the sub-streams of the higher temporal layers.
+  for (tl = cpi->temporal_layer_id + 1; tl < cpi->oxcf.ts_number_layers;
+       ++tl) {
+    BrcQpLayerRc *hrc = &cpi->layer[layer - cpi->temporal_layer_id + tl];
+    hrc->bits_off_target += hrc->avg_frame_bandwidth - encoded_frame_size;
+    hrc->bits_off_target =
+        BRC_QP_MIN(hrc->bits_off_target, hrc->maximum_buffer_size);
+    hrc->buffer_level = hrc->bits_off_target;
+  }
+}
+
+void brc_qp_rc_postencode_update(BrcQpRc *cpi, uint64_t bytes_used) {
+  BrcQpLayerRc *lrc = &cpi->layer[brc_qp_layer_index(cpi)];
+  const int qp = cpi->qp;
+  int i;
+
+  lrc->projected_frame_size = (int)BRC_QP_MIN(bytes_used << 3, INT_MAX);
+
+  if (!cpi->frame_unchanged) {
+    // Post encode loop adjustment of the q prediction.
+    update_rate_correction_factors(cpi, lrc);
+
+    // Keep a record of last q and ambient average q.
+    lrc->last_q[cpi->frame_type] = qp;
+    if (cpi->frame_type == BRC_QP_KEY_FRAME && lrc->frames_coded == 0)
+      lrc->avg_frame_qp[BRC_QP_KEY_FRAME] = qp;
+    else
+      lrc->avg_frame_qp[cpi->frame_type] = ROUND_POWER_OF_TWO(
+          3 * lrc->avg_frame_qp[cpi->frame_type] + qp, 2);
+  }
+
+  update_buffer_level(cpi, lrc->projected_frame_size);
+
+  if (cpi->frame_type == BRC_QP_KEY_FRAME) {
+    for (i = 0; i < BRC_QP_MAX_LAYERS; ++i) cpi->layer[i].frames_since_key = 0;
+  }
+  lrc->frames_since_key++;
+  lrc->frames_coded++;
+  cpi->scene_change = 0;
+}
+
+// Scales the 0-63 quantizer of the config to the QP' range.
+static int quantizer_to_qp(int quantizer, int qp_bd_offset) {
+  return (quantizer * (BRC_QP_MAX_QP + qp_bd_offset) + 31) / 63;
+}
+
+void brc_qp_rc_update_config(BrcQpRc *cpi,
+                             const LibMeboRateControllerConfig *rc_cfg) {
+  BrcQpRcConfig *oxcf = &cpi->oxcf;
+  const int num_layers = rc_cfg->ss_number_layers * rc_cfg->ts_number_layers;
+  const int bit_depth = rc_cfg->bit_depth ? rc_cfg->bit_depth : 8;
+  // The QP' history of another bit depth is on another scale.
+  const int reset = oxcf->ss_number_layers != rc_cfg->ss_number_layers ||
+                    oxcf->ts_number_layers != rc_cfg->ts_number_layers ||
+                    oxcf->bit_depth != bit_depth;
+  int i;
+
+  oxcf->width = rc_cfg->width;
+  oxcf->height = rc_cfg->height;
+  if (oxcf->bit_depth != bit_depth) {
+    oxcf->bit_depth = bit_depth;
+    cpi->qp_bd_offset = 6 * (bit_depth - 8);
+    init_rate_curves(cpi);
+  }
+  oxcf->screen_content = rc_cfg->content_type == LIBMEBO_CONTENT_SCREEN;
+
+  oxcf->target_bandwidth = 1000 * rc_cfg->target_bandwidth;
+  oxcf->starting_buffer_level_ms = rc_cfg->buf_initial_sz;
+  oxcf->optimal_buffer_level_ms = rc_cfg->buf_optimal_sz;
+  oxcf->maximum_buffer_size_ms = rc_cfg->buf_sz;
+
+  oxcf->under_shoot_pct = rc_cfg->undershoot_pct;
+  oxcf->over_shoot_pct = rc_cfg->overshoot_pct;
+  oxcf->max_intra_bitrate_pct = rc_cfg->max_intra_bitrate_pct;
+  oxcf->max_inter_bitrate_pct = rc_cfg->max_inter_bitrate_pct;
+  oxcf->framerate = rc_cfg->framerate;
+
+  oxcf->ss_number_layers = rc_cfg->ss_number_layers;
+  oxcf->ts_number_layers = rc_cfg->ts_number_layers;
+  for (i = 0; i < rc_cfg->ss_number_layers; ++i) {
+    oxcf->scaling_factor_num[i] = rc_cfg->scaling_factor_num[i];
+    oxcf->scaling_factor_den[i] = rc_cfg->scaling_factor_den[i];
+  }
+  for (i = 0; i < rc_cfg->ts_number_layers; ++i)
+    oxcf->ts_rate_decimator[i] = rc_cfg->ts_rate_decimator[i];
+  for (i = 0; i < num_layers; ++i) {
+    if (num_layers > 1) {
+      oxcf->layer_target_bitrate[i] = 1000 * rc_cfg->layer_target_bitrate[i];
+      oxcf->worst_allowed_qp[i] =
+          quantizer_to_qp(rc_cfg->max_quantizers[i], cpi->qp_bd_offset);
+      oxcf->best_allowed_qp[i] =
+          quantizer_to_qp(rc_cfg->min_quantizers[i], cpi->qp_bd_offset);
+    } else {
+      oxcf->worst_allowed_qp[i] =
+          quantizer_to_qp(rc_cfg->max_quantizer, cpi->qp_bd_offset);
+      oxcf->best_allowed_qp[i] =
+          quantizer_to_qp(rc_cfg->min_quantizer, cpi->qp_bd_offset);
+    }
+  }
+
+  update_layers(cpi, reset);
+}
+
+void brc_qp_rc_init(BrcQpRc *cpi, const BrcQpCodec *codec,
+                    const LibMeboRateControllerConfig *cfg) {
+  memset(cpi, 0, sizeof(*cpi));
+  cpi->codec = codec;
+  brc_qp_rc_update_config(cpi, cfg);
+  cpi->qp = cpi->layer[0].worst_quality;
+}
+
+LibMeboStatus brc_qp_rc_validate(const LibMeboRateControllerConfig *cfg,
+                                 int max_ss_layers, int max_ts_layers) {
+  int sl, tl;
+
+  if (cfg->rc_mode != LIBMEBO_RC_CBR)
+    return LIBMEBO_STATUS_UNSUPPORTED_RC_MODE;
+
+  RANGE_CHECK_HI(cfg, max_quantizer, 63);
+  RANGE_CHECK_HI(cfg, min_quantizer, cfg->max_quantizer);
+  RANGE_CHECK_HI(cfg, undershoot_pct, 100);
+  RANGE_CHECK_HI(cfg, overshoot_pct, 100);
+  RANGE_CHECK(cfg, ss_number_layers, 1, max_ss_layers);
+  RANGE_CHECK(cfg, ts_number_layers, 1, max_ts_layers);
+  RANGE_CHECK(cfg, aq_mode, LIBMEBO_AQ_MODE_NONE, LIBMEBO_AQ_MODE_NONE);
+  RANGE_CHECK_HI(cfg, content_type, LIBMEBO_CONTENT_SCREEN);
+  if (!(cfg->framerate > 0))
+    ERROR("framerate must be positive");
+
+  if (cfg->ss_number_layers > 1) {
+    for (sl = 0; sl < cfg->ss_number_layers; ++sl) {
+      if (cfg->scaling_factor_num[sl] <= 0 ||
+          cfg->scaling_factor_den[sl] < cfg->scaling_factor_num[sl])
+        ERROR("scaling_factor_num/scaling_factor_den out of range");
+    }
+  }
+
+  if (cfg->ss_number_layers * cfg->ts_number_layers > 1) {
+    for (sl = 0; sl < cfg->ss_number_layers; ++sl) {
+      for (tl = 0; tl < cfg->ts_number_layers; ++tl) {
+        const int layer = sl * cfg->ts_number_layers + tl;
+        RANGE_CHECK_HI(cfg, max_quantizers[layer], 63);
+        RANGE_CHECK_HI(cfg, min_quantizers[layer], cfg->max_quantizers[layer]);
+        if (cfg->layer_target_bitrate[layer] <= 0)
+          ERROR("layer_target_bitrate entries must be positive");
+        if (tl > 0 && cfg->layer_target_bitrate[layer] <=
+                          cfg->layer_target_bitrate[layer - 1])
+          ERROR("ts_target_bitrate entries are not strictly increasing");
+      }
+    }
+  }
+
+  if (cfg->ts_number_layers > 1) {
+    RANGE_CHECK(cfg, ts_rate_decimator[cfg->ts_number_layers - 1], 1, 1);
+    for (tl = cfg->ts_number_layers - 1; tl > 0; --tl)
+      if (cfg->ts_rate_decimator[tl - 1] != 2 * cfg->ts_rate_decimator[tl])
+        ERROR("ts_rate_decimator factors are not powers of 2");
+  }
+  return LIBMEBO_STATUS_SUCCESS;
+}
@@ -0,0 +1,207 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef LIBMEBO_BRC_QP_RATECTRL_H
+#define LIBMEBO_BRC_QP_RATECTRL_H
+
+#include <stdint.h>
+
+#include "../../lib/libmebo.h"
+#include "brc_ratectrl.h"
+
+// One pass CBR rate control of the codecs with the H.264/HEVC QP scale.
+//
+// The controller follows the structure of the libvpx real-time rate
+// control: a per frame target from the buffer level, an active q range from
+// the buffer and the recent q, and a rate model, bits per 16x16 block
+// inversely proportional to the quantizer step size, that is corrected by
+// the size of every coded frame. With hrd_buffer_clamp the buffer is the
+// coded picture buffer of the HRD, the frame targets are kept within its
+// underflow and, CBR being filled up with filler data, overflow bounds.
+//
+// The QPs of the controller are the QP' of the specs, the QP plus the
+// QpBdOffset of the bit depth: 0 to 51 + qp_bd_offset. A QP' is worth the
+// same bits at every bit depth as the QP it is offset from at 8 bit.
+
+#define BRC_QP_MIN_QP 0
+#define BRC_QP_MAX_QP 51
+#define BRC_QP_RANGE (BRC_QP_MAX_QP + 1)
+
+#define BRC_QP_MAX_LAYERS (LIBMEBO_SS_MAX_LAYERS * LIBMEBO_TS_MAX_LAYERS)
+
+#define BRC_QP_FRAME_OVERHEAD_BITS 200
+
+// Target of a frame identical to the previous one: the slice headers and
+// the skipped blocks.
+#define BRC_QP_UNCHANGED_FRAME_BITS 256
+
+typedef enum {
+  BRC_QP_KEY_FRAME = 0,
+  BRC_QP_INTER_FRAME = 1,
+  BRC_QP_FRAME_TYPES,
+} BrcQpFrameType;
+
+// Codec specific constants of the rate model.
+typedef struct {
+  // Quantizer step size of QP 0 to 5 in 1/64 units, the step size doubles
+  // every 6 QPs.
+  int level_scale[6];
+  // Bits per 16x16 block at a step size of 1.0, in BPER_MB_NORMBITS units.
+  int enumerator[BRC_QP_FRAME_TYPES];
+  // Keep the frame targets within the HRD coded picture buffer.
+  int hrd_buffer_clamp;
+} BrcQpCodec;
+
+typedef struct {
+  int width;
+  int height;
+  int bit_depth;
+  int screen_content;
+
+  // Bits per second of the whole stream.
+  int64_t target_bandwidth;
+  int64_t starting_buffer_level_ms;
+  int64_t optimal_buffer_level_ms;
+  int64_t maximum_buffer_size_ms;
+
+  int under_shoot_pct;
+  int over_shoot_pct;
+  int max_intra_bitrate_pct;
+  int max_inter_bitrate_pct;
+
+  double framerate;
+
+  int ss_number_layers;
+  int ts_number_layers;
+  int scaling_factor_num[LIBMEBO_SS_MAX_LAYERS];
+  int scaling_factor_den[LIBMEBO_SS_MAX_LAYERS];
+  // Bits per second of each layer, cumulative over the lower temporal
+  // layers of its spatial layer.
+  int64_t layer_target_bitrate[BRC_QP_MAX_LAYERS];
+  int ts_rate_decimator[LIBMEBO_TS_MAX_LAYERS];
+  int worst_allowed_qp[BRC_QP_MAX_LAYERS];
+  int best_allowed_qp[BRC_QP_MAX_LAYERS];
+} BrcQpRcConfig;
+
+// Rate control state of one spatial/temporal layer. A single layer stream
+// only uses the first one.
+typedef struct {
+  int64_t target_bandwidth;
+  double framerate;
+  // Bits per frame of the sub-stream up to this temporal layer.
+  int avg_frame_bandwidth;
+  // Bits per frame of the frames of this temporal layer.
+  int avg_frame_size;
+  // Largest frame the buffer can take, half of its size.
+  int max_frame_bandwidth;
+
+  int64_t starting_buffer_level;
+  int64_t optimal_buffer_level;
+  int64_t maximum_buffer_size;
+  int64_t bits_off_target;
+  int64_t buffer_level;
+
+  int width;
+  int height;
+  // Number of 16x16 blocks of the layer.
+  int mbs;
+
+  int worst_quality;
+  int best_quality;
+
+  double rate_correction_factors[BRC_QP_FRAME_TYPES];
+  int damped_adjustment[BRC_QP_FRAME_TYPES];
+  int avg_frame_qp[BRC_QP_FRAME_TYPES];
+  int last_q[BRC_QP_FRAME_TYPES];
+  // Signs of the last two size errors, to damp oscillations.
+  int rc_1_frame;
+  int rc_2_frame;
+  int q_1_frame;
+  int q_2_frame;
+
+  int this_frame_target;
+  int projected_frame_size;
+  int frames_since_key;
+  int frames_coded;
+} BrcQpLayerRc;
+
+typedef struct {
+  const BrcQpCodec *codec;
+  BrcQpRcConfig oxcf;
+  BrcQpLayerRc layer[BRC_QP_MAX_LAYERS];
+
+  int spatial_layer_id;
+  int temporal_layer_id;
+  BrcQpFrameType frame_type;
+  int frame_unchanged;
+  // The caller signalled a scene change, or the last frame size was far
+  // off the rate model.
+  int scene_change;
+
+  // QP' of the current frame.
+  int qp;
+  // QpBdOffset, 6 * (bit_depth - 8).
+  int qp_bd_offset;
+
+  // Rate model of each frame type.
+  BrcRcRateCurve rate_curve[BRC_QP_FRAME_TYPES];
+} BrcQpRc;
+
+// Index in layer[] of the layer of the current frame.
+static inline int brc_qp_layer_index(const BrcQpRc *rc) {
+  return rc->spatial_layer_id * rc->oxcf.ts_number_layers +
+         rc->temporal_layer_id;
+}
+
+// QP of the current frame as signalled, -qp_bd_offset to 51.
+static inline int brc_qp_rc_get_qp(const BrcQpRc *rc) {
+  return rc->qp - rc->qp_bd_offset;
+}
+
+// Validates the parts of the config common to the codecs, with up to
+// max_ss_layers spatial and max_ts_layers temporal layers.
+LibMeboStatus brc_qp_rc_validate(const LibMeboRateControllerConfig *cfg,
+                                 int max_ss_layers, int max_ts_layers);
+
+// Sets up the rate control of a codec, rc is zeroed first.
+void brc_qp_rc_init(BrcQpRc *rc, const BrcQpCodec *codec,
+                    const LibMeboRateControllerConfig *cfg);
+
+// The buffers and rate models of the layers carry over a configuration
+// change, unless the number of layers or the bit depth changed. The codec
+// validates cfg first, on creation and on every update.
+void brc_qp_rc_update_config(BrcQpRc *rc,
+                             const LibMeboRateControllerConfig *cfg);
+
+LibMeboStatus brc_qp_rc_compute_qp(BrcQpRc *rc,
+                                   const LibMeboRCFrameParams *frame_params);
+
+void brc_qp_rc_postencode_update(BrcQpRc *rc, uint64_t bytes_used);
+
+int brc_qp_rc_bits_per_mb(const BrcQpRc *rc, BrcQpFrameType frame_type,
+                          int qp, double correction_factor);
+
+int brc_qp_estimate_bits_at_q(const BrcQpRc *rc, BrcQpFrameType frame_type,
+                              int qp, int mbs, double correction_factor);
+
+int brc_qp_rc_calc_iframe_target_size_one_pass_cbr(const BrcQpRc *rc,
+                                                   int frames_ahead);
+
+int brc_qp_rc_calc_pframe_target_size_one_pass_cbr(const BrcQpRc *rc);
+
+// Qp delta scaling the rate of a block of the current frame by
+// rate_target_ratio.
+int brc_qp_compute_qdelta_by_rate(const BrcQpRc *rc,
+                                  double rate_target_ratio);
+
+LibMeboStatus brc_qp_rc_get_keyframe_advice(BrcQpRc *rc, int max_interval,
+                                            LibMeboKeyFrameAdvice *advice);
+
+#endif  // LIBMEBO_BRC_QP_RATECTRL_H
@@ -0,0 +1,419 @@
+/*
+ *  Copyright (c) 2020 The WebM project authors. All Rights Reserved.
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+
+#include "brc_ratectrl.h"
+
+// The ac quantizers of AV1 are the ones of VP9.
+static const int16_t ac_qlookup[BRC_RC_QINDEX_RANGE] = {
+  4, 8, 9, 10, 11, 12, 13, 14,
+  15, 16, 17, 18, 19, 20, 21, 22,
+  23, 24, 25, 26, 27, 28, 29, 30,
+  31, 32, 33, 34, 35, 36, 37, 38,
+  39, 40, 41, 42, 43, 44, 45, 46,
+  47, 48, 49, 50, 51, 52, 53, 54,
+  55, 56, 57, 58, 59, 60, 61, 62,
+  63, 64, 65, 66, 67, 68, 69, 70,
+  71, 72, 73, 74, 75, 76, 77, 78,
+  79, 80, 81, 82, 83, 84, 85, 86,
+  87, 88, 89, 90, 91, 92, 93, 94,
+  95, 96, 97, 98, 99, 100, 101, 102,
+  104, 106, 108, 110, 112, 114, 116, 118,
+  120, 122, 124, 126, 128, 130, 132, 134,
+  136, 138, 140, 142, 144, 146, 148, 150,
+  152, 155, 158, 161, 164, 167, 170, 173,
+  176, 179, 182, 185, 188, 191, 194, 197,
+  200, 203, 207, 211, 215, 219, 223, 227,
+  231, 235, 239, 243, 247, 251, 255, 260,
+  265, 270, 275, 280, 285, 290, 295, 300,
+  305, 311, 317, 323, 329, 335, 341, 347,
+  353, 359, 366, 373, 380, 387, 394, 401,
+  408, 416, 424, 432, 440, 448, 456, 465,
+  474, 483, 492, 501, 510, 520, 530, 540,
+  550, 560, 571, 582, 593, 604, 615, 627,
+  639, 651, 663, 676, 689, 702, 715, 729,
+  743, 757, 771, 786, 801, 816, 832, 848,
+  864, 881, 898, 915, 933, 951, 969, 988,
+  1007, 1026, 1046, 1066, 1087, 1108, 1129, 1151,
+  1173, 1196, 1219, 1243, 1267, 1292, 1317, 1343,
+  1369, 1396, 1423, 1451, 1479, 1508, 1537, 1567,
+  1597, 1628, 1660, 1692, 1725, 1759, 1793, 1828,
+};
+
+static const int16_t ac_qlookup_10[BRC_RC_QINDEX_RANGE] = {
+  4, 9, 11, 13, 16, 18, 21, 24,
+  27, 30, 33, 37, 40, 44, 48, 51,
+  55, 59, 63, 67, 71, 75, 79, 83,
+  88, 92, 96, 100, 105, 109, 114, 118,
+  122, 127, 131, 136, 140, 145, 149, 154,
+  158, 163, 168, 172, 177, 181, 186, 190,
+  195, 199, 204, 208, 213, 217, 222, 226,
+  231, 235, 240, 244, 249, 253, 258, 262,
+  267, 271, 275, 280, 284, 289, 293, 297,
+  302, 306, 311, 315, 319, 324, 328, 332,
+  337, 341, 345, 349, 354, 358, 362, 367,
+  371, 375, 379, 384, 388, 392, 396, 401,
+  409, 417, 425, 433, 441, 449, 458, 466,
+  474, 482, 490, 498, 506, 514, 523, 531,
+  539, 547, 555, 563, 571, 579, 588, 596,
+  604, 616, 628, 640, 652, 664, 676, 688,
+  700, 713, 725, 737, 749, 761, 773, 785,
+  797, 809, 825, 841, 857, 873, 889, 905,
+  922, 938, 954, 970, 986, 1002, 1018, 1038,
+  1058, 1078, 1098, 1118, 1138, 1158, 1178, 1198,
+  1218, 1242, 1266, 1290, 1314, 1338, 1362, 1386,
+  1411, 1435, 1463, 1491, 1519, 1547, 1575, 1603,
+  1631, 1663, 1695, 1727, 1759, 1791, 1823, 1859,
+  1895, 1931, 1967, 2003, 2039, 2079, 2119, 2159,
+  2199, 2239, 2283, 2327, 2371, 2415, 2459, 2507,
+  2555, 2603, 2651, 2703, 2755, 2807, 2859, 2915,
+  2971, 3027, 3083, 3143, 3203, 3263, 3327, 3391,
+  3455, 3523, 3591, 3659, 3731, 3803, 3876, 3952,
+  4028, 4104, 4184, 4264, 4348, 4432, 4516, 4604,
+  4692, 4784, 4876, 4972, 5068, 5168, 5268, 5372,
+  5476, 5584, 5692, 5804, 5916, 6032, 6148, 6268,
+  6388, 6512, 6640, 6768, 6900, 7036, 7172, 7312,
+};
+
+static const int16_t ac_qlookup_12[BRC_RC_QINDEX_RANGE] = {
+  4, 13, 19, 27, 35, 44, 54, 64,
+  75, 87, 99, 112, 126, 139, 154, 168,
+  183, 199, 214, 230, 247, 263, 280, 297,
+  314, 331, 349, 366, 384, 402, 420, 438,
+  456, 475, 493, 511, 530, 548, 567, 586,
+  604, 623, 642, 660, 679, 698, 716, 735,
+  753, 772, 791, 809, 828, 846, 865, 884,
+  902, 920, 939, 957, 976, 994, 1012, 1030,
+  1049, 1067, 1085, 1103, 1121, 1139, 1157, 1175,
+  1193, 1211, 1229, 1246, 1264, 1282, 1299, 1317,
+  1335, 1352, 1370, 1387, 1405, 1422, 1440, 1457,
+  1474, 1491, 1509, 1526, 1543, 1560, 1577, 1595,
+  1627, 1660, 1693, 1725, 1758, 1791, 1824, 1856,
+  1889, 1922, 1954, 1987, 2020, 2052, 2085, 2118,
+  2150, 2183, 2216, 2248, 2281, 2313, 2346, 2378,
+  2411, 2459, 2508, 2556, 2605, 2653, 2701, 2750,
+  2798, 2847, 2895, 2943, 2992, 3040, 3088, 3137,
+  3185, 3234, 3298, 3362, 3426, 3491, 3555, 3619,
+  3684, 3748, 3812, 3876, 3941, 4005, 4069, 4149,
+  4230, 4310, 4390, 4470, 4550, 4631, 4711, 4791,
+  4871, 4967, 5064, 5160, 5256, 5352, 5448, 5544,
+  5641, 5737, 5849, 5961, 6073, 6185, 6297, 6410,
+  6522, 6650, 6778, 6906, 7034, 7162, 7290, 7435,
+  7579, 7723, 7867, 8011, 8155, 8315, 8475, 8635,
+  8795, 8956, 9132, 9308, 9484, 9660, 9836, 10028,
+  10220, 10412, 10604, 10812, 11020, 11228, 11437, 11661,
+  11885, 12109, 12333, 12573, 12813, 13053, 13309, 13565,
+  13821, 14093, 14365, 14637, 14925, 15213, 15502, 15806,
+  16110, 16414, 16734, 17054, 17390, 17726, 18062, 18414,
+  18766, 19134, 19502, 19886, 20270, 20670, 21070, 21486,
+  21902, 22334, 22766, 23214, 23662, 24126, 24590, 25070,
+  25551, 26047, 26559, 27071, 27599, 28143, 28687, 29247,
+};
+
+static inline int clamp(int value, int low, int high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+int16_t brc_rc_ac_quant(int qindex, int delta, int bit_depth) {
+  const int q_clamped = clamp(qindex + delta, 0, BRC_RC_MAXQ);
+
+  switch (bit_depth) {
+    case 8: return ac_qlookup[q_clamped];
+    case 10: return ac_qlookup_10[q_clamped];
+    case 12: return ac_qlookup_12[q_clamped];
+    default: return -1;
+  }
+}
+
+double brc_rc_convert_qindex_to_q(int qindex, int bit_depth) {
+  switch (bit_depth) {
+    case 8: return brc_rc_ac_quant(qindex, 0, bit_depth) / 4.0;
+    case 10: return brc_rc_ac_quant(qindex, 0, bit_depth) / 16.0;
+    case 12: return brc_rc_ac_quant(qindex, 0, bit_depth) / 64.0;
+    default:
+      assert(0 && "bit_depth should be 8, 10 or 12");
+      return -1.0;
+  }
+}
+
+int brc_rc_q_scale(int bit_depth) {
+  switch (bit_depth) {
+    case 8: return 4;
+    case 10: return 16;
+    case 12: return 64;
+    default:
+      assert(0 && "bit_depth should be 8, 10 or 12");
+      return 4;
+  }
+}
+
+int brc_rc_model_bits_per_mb(int64_t numerator, int64_t denominator,
+                             int round, double correction_factor) {
+#if LIBMEBO_FIXED_POINT_RC
+  return (int)((numerator * brc_rc_factor_to_fixed(correction_factor) /
+                    denominator +
+                (round ? BRC_RC_FACTOR_ONE >> 1 : 0)) >>
+               BRC_RC_FACTOR_BITS);
+#else
+  return (int)(numerator * correction_factor / denominator +
+               (round ? 0.5 : 0.0));
+#endif
+}
+
+void brc_rc_bits_per_mb_c(const int32_t *numerator, const int32_t *denominator,
+                          int count, double correction_factor, double round,
+                          int *bits_per_mb) {
+  int i;
+  for (i = 0; i < count; i++)
+    bits_per_mb[i] = brc_rc_model_bits_per_mb(
+        numerator[i], denominator[i], round != 0.0, correction_factor);
+}
+
+static brc_rc_bits_per_mb_kernel_fn bits_per_mb_kernel = NULL;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void setup_kernels(void) {
+  brc_rc_bits_per_mb_kernel_fn k = brc_rc_bits_per_mb_c;
+  // The fixed point models divide 64-bit integers, which the SIMD units
+  // do not.
+#if BRC_RC_HAVE_X86 && !LIBMEBO_FIXED_POINT_RC
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) k = brc_rc_bits_per_mb_avx2;
+#endif
+  bits_per_mb_kernel = k;
+}
+
+void brc_rc_rate_curve_bits_per_mb(const BrcRcRateCurve *curve,
+                                   double correction_factor,
+                                   int *bits_per_mb) {
+  pthread_once(&kernels_once, setup_kernels);
+  bits_per_mb_kernel(curve->numerator, curve->denominator, curve->num_q,
+                     correction_factor, curve->round ? 0.5 : 0.0,
+                     bits_per_mb);
+}
+
+void brc_rc_init_rate_curve(BrcRcRateCurve *curve) {
+  assert(curve->num_q > 0 && curve->num_q <= BRC_RC_QINDEX_RANGE);
+  brc_rc_rate_curve_bits_per_mb(curve, 1.0, curve->unit_bits_per_mb);
+}
+
+int brc_rc_curve_bits_per_mb(const void *curve, int q,
+                             double correction_factor) {
+  const BrcRcRateCurve *c = (const BrcRcRateCurve *)curve;
+  assert(q >= 0 && q < c->num_q);
+  return brc_rc_model_bits_per_mb(c->numerator[q], c->denominator[q],
+                                  c->round, correction_factor);
+}
+
+int brc_rc_table_bits_per_mb(const void *table, int q,
+                             double correction_factor) {
+  (void)correction_factor;
+  return ((const int *)table)[q];
+}
+
+int brc_rc_find_qindex(double desired_q, int bit_depth, int best_qindex,
+                       int worst_qindex) {
+  int low = best_qindex;
+  int high = worst_qindex;
+
+  assert(best_qindex <= worst_qindex);
+  while (low < high) {
+    const int mid = (low + high) >> 1;
+    if (brc_rc_convert_qindex_to_q(mid, bit_depth) < desired_q)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+// The formulae were derived from computing a 3rd order polynomial best fit
+// to the original data (after plotting real maxq vs minq (not q index)).
+int brc_rc_get_minq_index(double maxq, double x3, double x2, double x1,
+                          int bit_depth) {
+  double minqtarget = ((x3 * maxq + x2) * maxq + x1) * maxq;
+  if (minqtarget > maxq) minqtarget = maxq;
+
+  // Special case handling to deal with the step from q2.0
+  // down to lossless mode represented by q 1.0.
+  if (minqtarget <= 2.0) return 0;
+
+  return brc_rc_find_qindex(minqtarget, bit_depth, 0, BRC_RC_MAXQ);
+}
+
+int brc_rc_find_q_by_rate(int desired_bits_per_mb,
+                          brc_rc_bits_per_mb_fn bits_per_mb,
+                          const void *model, double correction_factor,
+                          int best_q, int worst_q) {
+  int low = best_q;
+  int high = worst_q;
+
+  assert(best_q <= worst_q);
+  while (low < high) {
+    const int mid = (low + high) >> 1;
+    if (bits_per_mb(model, mid, correction_factor) > desired_bits_per_mb)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+int brc_rc_find_closest_q_by_rate(int desired_bits_per_mb,
+                                  brc_rc_bits_per_mb_fn bits_per_mb,
+                                  const void *model, double correction_factor,
+                                  int best_q, int worst_q) {
+  const int curr_q =
+      brc_rc_find_q_by_rate(desired_bits_per_mb, bits_per_mb, model,
+                            correction_factor, best_q, worst_q);
+  const int curr_bits_per_mb = bits_per_mb(model, curr_q, correction_factor);
+  const int curr_bit_diff = (curr_bits_per_mb <= desired_bits_per_mb)
+                                ? desired_bits_per_mb - curr_bits_per_mb
+                                : INT_MAX;
+  int prev_bit_diff = INT_MAX;
+
+  // Rate difference of the previous q, just above the desired rate.
+  if (curr_bit_diff != INT_MAX && curr_q != best_q)
+    prev_bit_diff = bits_per_mb(model, curr_q - 1, correction_factor) -
+                    desired_bits_per_mb;
+
+  return (curr_bit_diff <= prev_bit_diff) ? curr_q : curr_q - 1;
+}
+
+int brc_rc_size_correction_factor(int projected_frame_size,
+                                  int projected_size_based_on_q,
+                                  int min_projected_size) {
+  if (projected_size_based_on_q <= min_projected_size) return 100;
+  return (int)((100 * (int64_t)projected_frame_size) /
+               projected_size_based_on_q);
+}
+
+int brc_rc_is_scene_change_size(int correction_factor) {
+  return correction_factor >= 100 * BRC_RC_SCENE_CHANGE_SIZE_RATIO ||
+         correction_factor * BRC_RC_SCENE_CHANGE_SIZE_RATIO <= 100;
+}
+
+#if LIBMEBO_FIXED_POINT_RC
+// Factor bounds, rounded inwards.
+#define MIN_BPB_FACTOR_FIXED \
+  ((int64_t)(BRC_RC_MIN_BPB_FACTOR * BRC_RC_FACTOR_ONE) + 1)
+#define MAX_BPB_FACTOR_FIXED \
+  ((int64_t)BRC_RC_MAX_BPB_FACTOR * BRC_RC_FACTOR_ONE)
+
+// log10(2) in BRC_RC_FACTOR_BITS units.
+#define LOG10_2_FIXED 19728
+
+// log2(x) in BRC_RC_FACTOR_BITS units, for x > 0.
+static int64_t log2_fixed(uint32_t x) {
+  int64_t result;
+  uint64_t m;
+  int msb = 0;
+  int i;
+
+  while (msb < 31 && (x >> (msb + 1))) ++msb;
+  result = (int64_t)msb << BRC_RC_FACTOR_BITS;
+  // Mantissa in [1, 2) with 30 fractional bits, each squaring yields a bit
+  // of the fraction.
+  m = ((uint64_t)x << 30) >> msb;
+  for (i = BRC_RC_FACTOR_BITS - 1; i >= 0; --i) {
+    m = (m * m) >> 30;
+    if (m >= (2ULL << 30)) {
+      m >>= 1;
+      result |= (int64_t)1 << i;
+    }
+  }
+  return result;
+}
+#endif
+
+double brc_rc_adjustment_limit(int correction_factor) {
+#if LIBMEBO_FIXED_POINT_RC
+  int64_t error;
+
+  if (correction_factor <= 0) return 0.75;
+  error = log2_fixed((uint32_t)correction_factor) - log2_fixed(100);
+  if (error < 0) error = -error;
+  error = (error * LOG10_2_FIXED) >> BRC_RC_FACTOR_BITS;
+  if (error > BRC_RC_FACTOR_ONE) error = BRC_RC_FACTOR_ONE;
+  return brc_rc_factor_from_fixed(BRC_RC_FACTOR_ONE / 4 + error / 2);
+#else
+  double error;
+
+  if (correction_factor <= 0) return 0.75;
+  error = fabs(log10(0.01 * correction_factor));
+  return 0.25 + 0.5 * (error < 1 ? error : 1);
+#endif
+}
+
+double brc_rc_scale_rate_factor(double rate_correction_factor, int percent) {
+#if LIBMEBO_FIXED_POINT_RC
+  return brc_rc_factor_from_fixed(
+      brc_rc_factor_to_fixed(rate_correction_factor) * percent / 100);
+#else
+  return (rate_correction_factor * percent) / 100;
+#endif
+}
+
+double brc_rc_correct_rate_factor(double rate_correction_factor,
+                                  int correction_factor,
+                                  double adjustment_limit) {
+  // With LIBMEBO_FIXED_POINT_RC, adjustment_limit is a multiple of
+  // 1 / (1 << BRC_RC_FACTOR_BITS) and the products below are exact.
+  if (correction_factor > 102) {
+    // We are not already at the worst allowable quality
+    correction_factor =
+        (int)(100 + ((correction_factor - 100) * adjustment_limit));
+    rate_correction_factor =
+        brc_rc_scale_rate_factor(rate_correction_factor, correction_factor);
+    // Keep rate_correction_factor within limits
+#if LIBMEBO_FIXED_POINT_RC
+    if (brc_rc_factor_to_fixed(rate_correction_factor) > MAX_BPB_FACTOR_FIXED)
+      rate_correction_factor = brc_rc_factor_from_fixed(MAX_BPB_FACTOR_FIXED);
+#else
+    if (rate_correction_factor > BRC_RC_MAX_BPB_FACTOR)
+      rate_correction_factor = BRC_RC_MAX_BPB_FACTOR;
+#endif
+  } else if (correction_factor < 99) {
+    // We are not already at the best allowable quality
+    correction_factor =
+        (int)(100 - ((100 - correction_factor) * adjustment_limit));
+    rate_correction_factor =
+        brc_rc_scale_rate_factor(rate_correction_factor, correction_factor);
+    // Keep rate_correction_factor within limits
+#if LIBMEBO_FIXED_POINT_RC
+    if (brc_rc_factor_to_fixed(rate_correction_factor) < MIN_BPB_FACTOR_FIXED)
+      rate_correction_factor = brc_rc_factor_from_fixed(MIN_BPB_FACTOR_FIXED);
+#else
+    if (rate_correction_factor < BRC_RC_MIN_BPB_FACTOR)
+      rate_correction_factor = BRC_RC_MIN_BPB_FACTOR;
+#endif
+  }
+  return rate_correction_factor;
+}
+
+void brc_rc_update_q_history(int q, int correction_factor, int *q_1_frame,
+                             int *q_2_frame, int *rc_1_frame,
+                             int *rc_2_frame) {
+  *q_2_frame = *q_1_frame;
+  *q_1_frame = q;
+  *rc_2_frame = *rc_1_frame;
+  if (correction_factor > 110)
+    *rc_1_frame = -1;
+  else if (correction_factor < 90)
+    *rc_1_frame = 1;
+  else
+    *rc_1_frame = 0;
+}
@@ -0,0 +1,187 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef LIBMEBO_BRC_RATECTRL_H
+#define LIBMEBO_BRC_RATECTRL_H
+
+#include <stdint.h>
+
+#ifdef HAVE_LIBMEBO_CONFIG_H
+#include "libmebo_config.h"
+#endif
+
+// Parts of the one pass rate control the engines have in common: the
+// qindex scale VP9 and AV1 share, the search of the q of a rate along the
+// bits per block curve of a codec, and the correction of that curve by the
+// size of the coded frames.
+
+#define BRC_RC_MAXQ 255
+#define BRC_RC_QINDEX_RANGE (BRC_RC_MAXQ + 1)
+
+// Bits per block of the rate models are stored in 1 << BPER_MB_NORMBITS
+// units.
+#define BRC_RC_BPER_MB_NORMBITS 9
+
+#define BRC_RC_MIN_BPB_FACTOR 0.005
+#define BRC_RC_MAX_BPB_FACTOR 50
+
+// Ratio of the coded to the predicted frame size beyond which the rate
+// model is re-estimated as on a scene change.
+#define BRC_RC_SCENE_CHANGE_SIZE_RATIO 4
+
+// With LIBMEBO_FIXED_POINT_RC the rate models and their correction use
+// integer arithmetic only, for QPs that are bit-exact across platforms and
+// compilers. The rate correction factors stay doubles in the engines, but
+// only take multiples of 1 / (1 << BRC_RC_FACTOR_BITS), which convert
+// exactly to and from the fixed point ones.
+#ifndef LIBMEBO_FIXED_POINT_RC
+#define LIBMEBO_FIXED_POINT_RC 0
+#endif
+
+#define BRC_RC_FACTOR_BITS 16
+#define BRC_RC_FACTOR_ONE (1 << BRC_RC_FACTOR_BITS)
+
+static inline int64_t brc_rc_factor_to_fixed(double factor) {
+  return (int64_t)(factor * BRC_RC_FACTOR_ONE);
+}
+
+static inline double brc_rc_factor_from_fixed(int64_t factor) {
+  return (double)factor / BRC_RC_FACTOR_ONE;
+}
+
+// Ac quantizer of the VP9 and AV1 qindex, for a bit depth of 8, 10 or 12.
+int16_t brc_rc_ac_quant(int qindex, int delta, int bit_depth);
+
+// Real q value of a VP9/AV1 qindex, scaled down to match the 8 bit one.
+double brc_rc_convert_qindex_to_q(int qindex, int bit_depth);
+
+// Divisor of the ac quantizer to the real q value of the bit depth.
+int brc_rc_q_scale(int bit_depth);
+
+// Smallest qindex within [best_qindex, worst_qindex] whose q is at least
+// desired_q, worst_qindex if there is none.
+int brc_rc_find_qindex(double desired_q, int bit_depth, int best_qindex,
+                       int worst_qindex);
+
+// Active min q entry of the 3rd order polynomial fit x3, x2, x1 at maxq.
+int brc_rc_get_minq_index(double maxq, double x3, double x2, double x1,
+                          int bit_depth);
+
+// numerator * correction_factor / denominator, truncated, or rounded to the
+// nearest integer if round is set: the bits per block of the rate models of
+// all the codecs.
+int brc_rc_model_bits_per_mb(int64_t numerator, int64_t denominator,
+                             int round, double correction_factor);
+
+// Rate model of a codec and frame type at each of its num_q qs, from the
+// enumerators and the quantizer step sizes of the codec: the bits per block
+// at q are brc_rc_model_bits_per_mb(numerator[q], denominator[q], round).
+typedef struct {
+  int32_t numerator[BRC_RC_QINDEX_RANGE];
+  int32_t denominator[BRC_RC_QINDEX_RANGE];
+  // Bits per block at a correction factor of 1.0.
+  int unit_bits_per_mb[BRC_RC_QINDEX_RANGE];
+  int num_q;
+  int round;
+} BrcRcRateCurve;
+
+// Evaluate the unit bits per block of a curve, once its numerators,
+// denominators, num_q and round are set.
+void brc_rc_init_rate_curve(BrcRcRateCurve *curve);
+
+// Bits per block of a curve at all of its qs, in one pass of the fastest
+// kernel the cpu supports.
+void brc_rc_rate_curve_bits_per_mb(const BrcRcRateCurve *curve,
+                                   double correction_factor,
+                                   int *bits_per_mb);
+
+// Batch kernels of brc_rc_rate_curve_bits_per_mb(), round is 0.0 or 0.5.
+// They are bit-exact with brc_rc_model_bits_per_mb().
+typedef void (*brc_rc_bits_per_mb_kernel_fn)(const int32_t *numerator,
+                                             const int32_t *denominator,
+                                             int count,
+                                             double correction_factor,
+                                             double round, int *bits_per_mb);
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BRC_RC_HAVE_X86 1
+#else
+#define BRC_RC_HAVE_X86 0
+#endif
+
+void brc_rc_bits_per_mb_c(const int32_t *numerator, const int32_t *denominator,
+                          int count, double correction_factor, double round,
+                          int *bits_per_mb);
+
+#if BRC_RC_HAVE_X86
+void brc_rc_bits_per_mb_avx2(const int32_t *numerator,
+                             const int32_t *denominator, int count,
+                             double correction_factor, double round,
+                             int *bits_per_mb);
+#endif
+
+// Bits per block of the rate model of a codec at q, in BPER_MB_NORMBITS
+// units. It must not increase with q.
+typedef int (*brc_rc_bits_per_mb_fn)(const void *model, int q,
+                                     double correction_factor);
+
+// brc_rc_bits_per_mb_fn of a BrcRcRateCurve.
+int brc_rc_curve_bits_per_mb(const void *curve, int q,
+                             double correction_factor);
+
+// brc_rc_bits_per_mb_fn of a table of bits per block indexed by q, already
+// evaluated at the correction factor.
+int brc_rc_table_bits_per_mb(const void *table, int q,
+                             double correction_factor);
+
+// Smallest q within [best_q, worst_q] whose rate is at most
+// desired_bits_per_mb, worst_q if there is none.
+int brc_rc_find_q_by_rate(int desired_bits_per_mb,
+                          brc_rc_bits_per_mb_fn bits_per_mb,
+                          const void *model, double correction_factor,
+                          int best_q, int worst_q);
+
+// q within [best_q, worst_q] whose rate is the closest to
+// desired_bits_per_mb, of the ones just above and below it.
+int brc_rc_find_closest_q_by_rate(int desired_bits_per_mb,
+                                  brc_rc_bits_per_mb_fn bits_per_mb,
+                                  const void *model, double correction_factor,
+                                  int best_q, int worst_q);
+
+// Size of the coded frame in percent of the size the rate model predicted,
+// 100 when the prediction is not above min_projected_size.
+int brc_rc_size_correction_factor(int projected_frame_size,
+                                  int projected_size_based_on_q,
+                                  int min_projected_size);
+
+// A size error the model cannot explain is a scene change the caller did
+// not signal.
+int brc_rc_is_scene_change_size(int correction_factor);
+
+// Damping of the rate model update, heavier as the size error grows.
+double brc_rc_adjustment_limit(int correction_factor);
+
+// rate_correction_factor * percent / 100, not clamped.
+double brc_rc_scale_rate_factor(double rate_correction_factor, int percent);
+
+// Moves the rate correction factor towards the size error by
+// adjustment_limit, within [BRC_RC_MIN_BPB_FACTOR, BRC_RC_MAX_BPB_FACTOR].
+double brc_rc_correct_rate_factor(double rate_correction_factor,
+                                  int correction_factor,
+                                  double adjustment_limit);
+
+// Keeps the q and the sign of the size error of the last two frames, to
+// detect the q oscillating around the target. The sign is -1 for an
+// overshoot, 1 for an undershoot.
+void brc_rc_update_q_history(int q, int correction_factor, int *q_1_frame,
+                             int *q_2_frame, int *rc_1_frame,
+                             int *rc_2_frame);
+
+#endif  // LIBMEBO_BRC_RATECTRL_H
@@ -0,0 +1,46 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "brc_ratectrl.h"
+
+#if BRC_RC_HAVE_X86
+
+#include <immintrin.h>
+
+// The kernel is built with a function level target attribute, and only
+// selected at run time if the cpu supports it. The multiplication, division
+// and addition are the ones of the C kernel in the same order, so the
+// results are bit-exact. An SSE kernel would be the SSE2 code compilers
+// already generate for the C kernel on x86-64.
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 void brc_rc_bits_per_mb_avx2(const int32_t *numerator,
+                                  const int32_t *denominator, int count,
+                                  double correction_factor, double round,
+                                  int *bits_per_mb) {
+  const __m256d factor = _mm256_set1_pd(correction_factor);
+  const __m256d rounding = _mm256_set1_pd(round);
+  int i;
+
+  for (i = 0; i + 4 <= count; i += 4) {
+    const __m256d num = _mm256_cvtepi32_pd(
+        _mm_loadu_si128((const __m128i *)(numerator + i)));
+    const __m256d den = _mm256_cvtepi32_pd(
+        _mm_loadu_si128((const __m128i *)(denominator + i)));
+    const __m256d bits = _mm256_add_pd(
+        _mm256_div_pd(_mm256_mul_pd(num, factor), den), rounding);
+    _mm_storeu_si128((__m128i *)(bits_per_mb + i), _mm256_cvttpd_epi32(bits));
+  }
+  brc_rc_bits_per_mb_c(numerator + i, denominator + i, count - i,
+                       correction_factor, round, bits_per_mb + i);
+}
+
+#endif  // BRC_RC_HAVE_X86
@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "brc_roi.h"
+
+// Rate of the blocks of each priority relative to the background, at the
+// same q. The frame q goes up to pay for them.
+static const double roi_rate_ratio[BRC_ROI_NUM_SEGMENTS] = { 1.0, 1.5, 2.0,
+                                                              3.0 };
+
+LibMeboStatus brc_roi_set(BrcRoi *roi, const LibMeboRoiConfig *cfg) {
+  int i;
+
+  if (cfg->spatial_layer_id < 0 ||
+      cfg->spatial_layer_id >= LIBMEBO_SS_MAX_LAYERS || cfg->num_rois < 0 ||
+      cfg->num_rois > LIBMEBO_MAX_ROIS)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+  for (i = 0; i < cfg->num_rois; i++) {
+    const LibMeboRoi *r = &cfg->rois[i];
+    if (r->x < 0 || r->y < 0 || r->width <= 0 || r->height <= 0 ||
+        r->priority < 1 || r->priority > LIBMEBO_MAX_ROI_PRIORITY)
+      return LIBMEBO_STATUS_INVALID_PARAM;
+  }
+
+  roi->num_rois[cfg->spatial_layer_id] = cfg->num_rois;
+  memcpy(roi->rois[cfg->spatial_layer_id], cfg->rois,
+         cfg->num_rois * sizeof(cfg->rois[0]));
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+void brc_roi_free(BrcRoi *roi) {
+  free(roi->seg_map);
+  roi->seg_map = NULL;
+  roi->map_capacity = 0;
+}
+
+LibMeboStatus brc_roi_setup_frame(BrcRoi *roi, int spatial_layer_id,
+                                  int block_size, int cols, int rows) {
+  const int num_rois = roi->num_rois[spatial_layer_id];
+  int counts[BRC_ROI_NUM_SEGMENTS] = { 0 };
+  int i, r, c, covered = 0;
+
+  roi->apply = 0;
+  memset(roi->qindex_delta, 0, sizeof(roi->qindex_delta));
+  if (!num_rois) return LIBMEBO_STATUS_SUCCESS;
+
+  if (cols * rows > roi->map_capacity) {
+    uint8_t *map = realloc(roi->seg_map, cols * rows);
+    if (!map) return LIBMEBO_STATUS_FAILED;
+    roi->seg_map = map;
+    roi->map_capacity = cols * rows;
+  }
+  roi->block_size = block_size;
+  roi->cols = cols;
+  roi->rows = rows;
+  memset(roi->seg_map, 0, cols * rows);
+
+  // A block belongs to a region if they overlap.
+  for (i = 0; i < num_rois; i++) {
+    const LibMeboRoi *roi_rect = &roi->rois[spatial_layer_id][i];
+    const int c0 = roi_rect->x / block_size;
+    const int r0 = roi_rect->y / block_size;
+    const int c1 = (roi_rect->x + roi_rect->width + block_size - 1) / block_size;
+    const int r1 =
+        (roi_rect->y + roi_rect->height + block_size - 1) / block_size;
+    for (r = r0; r < r1 && r < rows; r++) {
+      uint8_t *row = roi->seg_map + r * cols;
+      for (c = c0; c < c1 && c < cols; c++) {
+        if (row[c] < roi_rect->priority) row[c] = (uint8_t)roi_rect->priority;
+      }
+    }
+  }
+
+  for (i = 0; i < cols * rows; i++) counts[roi->seg_map[i]]++;
+  for (i = 0; i < BRC_ROI_NUM_SEGMENTS; i++) {
+    roi->weight[i] = (double)counts[i] / (cols * rows);
+    if (i > 0) covered += counts[i];
+  }
+  // Regions completely outside of the frame leave nothing to boost.
+  roi->apply = covered > 0;
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+double brc_roi_rate_ratio(int segment) { return roi_rate_ratio[segment]; }
+
+int brc_roi_clamp_qdelta(int q, int qdelta) {
+  if (-qdelta > BRC_ROI_MAX_QDELTA_PERC * q / 100)
+    qdelta = -BRC_ROI_MAX_QDELTA_PERC * q / 100;
+  return qdelta;
+}
+
+LibMeboStatus brc_roi_get_segmentation_map(const BrcRoi *roi,
+                                           LibMeboSegmentationMap *seg_map) {
+  const uint32_t map_size = (uint32_t)(roi->cols * roi->rows);
+  int i;
+
+  seg_map->block_size = roi->block_size;
+  seg_map->cols = roi->cols;
+  seg_map->rows = roi->rows;
+  if (seg_map->map && seg_map->map_size < map_size)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+
+  seg_map->enabled = 1;
+  seg_map->num_segments = BRC_ROI_NUM_SEGMENTS;
+  memset(seg_map->delta_qp, 0, sizeof(seg_map->delta_qp));
+  for (i = 0; i < BRC_ROI_NUM_SEGMENTS; i++)
+    seg_map->delta_qp[i] = roi->qindex_delta[i];
+  if (seg_map->map) memcpy(seg_map->map, roi->seg_map, map_size);
+  return LIBMEBO_STATUS_SUCCESS;
+}
@@ -0,0 +1,61 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef LIBMEBO_BRC_ROI_H
+#define LIBMEBO_BRC_ROI_H
+
+#include <stdint.h>
+
+#include "../../lib/libmebo.h"
+
+// Segment 0 is the background, segment i the regions of priority i.
+#define BRC_ROI_NUM_SEGMENTS (LIBMEBO_MAX_ROI_PRIORITY + 1)
+
+// Maximum q-delta of a region as percentage of the frame q.
+#define BRC_ROI_MAX_QDELTA_PERC 60
+
+typedef struct BrcRoi {
+  // Regions of each spatial layer, in the pixels of that layer.
+  int num_rois[LIBMEBO_SS_MAX_LAYERS];
+  LibMeboRoi rois[LIBMEBO_SS_MAX_LAYERS][LIBMEBO_MAX_ROIS];
+  // Segment map of the current frame, one entry per block_size block.
+  uint8_t *seg_map;
+  int map_capacity;
+  int block_size;
+  int cols;
+  int rows;
+  // Non-zero if the current frame has regions of interest.
+  int apply;
+  // Fraction of the blocks of the current frame in each segment.
+  double weight[BRC_ROI_NUM_SEGMENTS];
+  // Q delta of each segment for the current frame q.
+  int qindex_delta[BRC_ROI_NUM_SEGMENTS];
+} BrcRoi;
+
+LibMeboStatus brc_roi_set(BrcRoi *roi, const LibMeboRoiConfig *cfg);
+
+void brc_roi_free(BrcRoi *roi);
+
+// Rasterize the regions of the spatial layer on the block grid of the
+// current frame and update the segment weights.
+LibMeboStatus brc_roi_setup_frame(BrcRoi *roi, int spatial_layer_id,
+                                  int block_size, int cols, int rows);
+
+// Ratio of the rate of a segment block to the rate of a background block
+// at the same frame q.
+double brc_roi_rate_ratio(int segment);
+
+// Clamp the q delta of a segment to BRC_ROI_MAX_QDELTA_PERC of q.
+int brc_roi_clamp_qdelta(int q, int qdelta);
+
+LibMeboStatus brc_roi_get_segmentation_map(const BrcRoi *roi,
+                                           LibMeboSegmentationMap *seg_map);
+
+#endif  // LIBMEBO_BRC_ROI_H
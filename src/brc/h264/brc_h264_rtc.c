@@ -0,0 +1,204 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "brc_h264_rtc.h"
+
+// dependency_id and temporal_id of the SVC extension, the spatial layers
+// limited to the ones of the library.
+#define H264_SS_MAX_LAYERS LIBMEBO_SS_MAX_LAYERS
+#define H264_TS_MAX_LAYERS 8
+
+#undef ERROR
+#define ERROR(str)                  \
+  do {                              \
+    fprintf(stderr, "%s \n", str);	    \
+    return LIBMEBO_STATUS_INVALID_PARAM; \
+  } while (0)
+
+#define RANGE_CHECK(p, memb, lo, hi)                                     \
+  do {                                                                   \
+    if (!(((p)->memb == (lo) || (p)->memb > (lo)) && (p)->memb <= (hi))) \
+      ERROR(#memb " out of range [" #lo ".." #hi "]");                   \
+  } while (0)
+
+// Quantizer step sizes of the H.264 QP 0 to 5, 0.625 to 1.125: the step
+// size doubles every 6 QPs and is 1.0 at QP 4, as in HEVC. Without the
+// larger transforms and the better prediction of HEVC a block costs about
+// 40% more bits at the same step size. The targets follow the HRD buffer
+// of the stream.
+static const BrcQpCodec h264_codec = {
+  { 40, 44, 52, 56, 64, 72 },
+  { 1680000, 560000 },
+  1,
+};
+static void pick_deblock_offsets(H264RateControlRTC *rtc) {
+  const BrcQpRc *rc = &rtc->rc;
+  int offset;
+
+  // The deblocking strength already follows the QP through the alpha, beta
+  // and tC0 tables. The offsets weaken the filter at low QPs to keep the texture,
+  // and strengthen it on the inter frames of high QPs, where the skipped
+  // residual leaves the blocking. Text and graphics keep sharp edges.
+  if (rc->oxcf.screen_content) {
+    offset = -2;
+  } else {
+    offset = (brc_qp_rc_get_qp(rc) - 32) / 6;
+    if (offset < -2) offset = -2;
+    if (offset > 2) offset = 2;
+    if (rc->frame_type == BRC_QP_KEY_FRAME && offset > 0) offset = 0;
+  }
+  rtc->alpha_c0_offset_div2 = offset;
+  rtc->beta_offset_div2 = offset;
+}
+
+/*===== BRC functions exposed to libs implementation ========= */
+
+LibMeboStatus
+brc_h264_post_encode_update(BrcCodecEnginePtr engine_ptr, uint64_t encoded_frame_size) {
+  H264RateControlRTC *rtc = (H264RateControlRTC *) engine_ptr;
+  brc_qp_rc_postencode_update(&rtc->rc, encoded_frame_size);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_h264_get_qp(BrcCodecEnginePtr engine_ptr, int *qp) {
+  H264RateControlRTC *rtc = (H264RateControlRTC *) engine_ptr;
+  *qp = brc_qp_rc_get_qp(&rtc->rc);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_h264_get_loop_filter_level(BrcCodecEnginePtr engine_ptr, int *filter_level) {
+  if (!engine_ptr || !filter_level)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  // The H.264 deblocking has no level, only the offsets of the QP based
+  // strength returned by brc_h264_get_loop_filter_params().
+  *filter_level = 0;
+  return LIBMEBO_STATUS_UNIMPLEMENTED;
+}
+
+LibMeboStatus
+brc_h264_get_loop_filter_params(BrcCodecEnginePtr engine_ptr,
+    LibMeboLoopFilterParams *params) {
+  H264RateControlRTC *rtc = (H264RateControlRTC *) engine_ptr;
+  params->deblock_beta_offset = rtc->beta_offset_div2;
+  params->deblock_tc_offset = rtc->alpha_c0_offset_div2;
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_h264_get_segmentation_map(BrcCodecEnginePtr engine_ptr,
+    LibMeboSegmentationMap *seg_map) {
+  if (!engine_ptr || !seg_map)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  seg_map->enabled = 0;
+  return LIBMEBO_STATUS_UNIMPLEMENTED;
+}
+
+LibMeboStatus
+brc_h264_set_roi(BrcCodecEnginePtr engine_ptr, const LibMeboRoiConfig *roi) {
+  if (!engine_ptr || !roi)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  return LIBMEBO_STATUS_UNIMPLEMENTED;
+}
+
+LibMeboStatus
+brc_h264_get_qdelta_by_rate(BrcCodecEnginePtr engine_ptr, double rate_ratio,
+    int *qdelta) {
+  H264RateControlRTC *rtc = (H264RateControlRTC *) engine_ptr;
+  if (!engine_ptr || !qdelta)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  *qdelta = brc_qp_compute_qdelta_by_rate(&rtc->rc, rate_ratio);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_h264_get_keyframe_advice(BrcCodecEnginePtr engine_ptr, int max_interval,
+    LibMeboKeyFrameAdvice *advice) {
+  H264RateControlRTC *rtc = (H264RateControlRTC *) engine_ptr;
+  return brc_qp_rc_get_keyframe_advice(&rtc->rc, max_interval, advice);
+}
+
+LibMeboStatus
+brc_h264_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_params) {
+  H264RateControlRTC *rtc = (H264RateControlRTC *) engine_ptr;
+  LibMeboStatus status;
+
+  status = brc_qp_rc_compute_qp(&rtc->rc, frame_params);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+  pick_deblock_offsets(rtc);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus brc_h264_validate (LibMeboRateControllerConfig *cfg);
+
+LibMeboStatus
+brc_h264_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerConfig *rc_cfg) {
+  H264RateControlRTC *rtc = (H264RateControlRTC *) engine_ptr;
+  LibMeboStatus status;
+
+  // A config update is validated like the config of the controller creation.
+  status = brc_h264_validate (rc_cfg);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+  brc_qp_rc_update_config(&rtc->rc, rc_cfg);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_h264_validate (LibMeboRateControllerConfig *cfg)
+{
+  LibMeboStatus status;
+
+  status = brc_qp_rc_validate (cfg, H264_SS_MAX_LAYERS, H264_TS_MAX_LAYERS);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+
+  // Frame dimensions of level 6.2, sqrt(8 * MaxFS) macroblocks
+  RANGE_CHECK(cfg, width, 1, 16880);
+  RANGE_CHECK(cfg, height, 1, 16880);
+  // High and High 10 profiles
+  if (cfg->bit_depth != 0 && cfg->bit_depth != 8 && cfg->bit_depth != 10)
+    ERROR("bit_depth must be 8 or 10");
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_h264_rate_control_init (LibMeboRateControllerConfig *cfg,
+    BrcCodecEnginePtr *brc_codec_handler) {
+  LibMeboStatus status = LIBMEBO_STATUS_SUCCESS;
+  H264RateControlRTC *rtc = NULL;
+
+  status = brc_h264_validate (cfg);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+
+  rtc = (H264RateControlRTC*) malloc (sizeof (H264RateControlRTC));
+  if (!rtc)
+    return LIBMEBO_STATUS_FAILED;
+
+  memset (rtc, 0, sizeof (*rtc));
+  brc_qp_rc_init (&rtc->rc, &h264_codec, cfg);
+
+  *brc_codec_handler = (BrcCodecEnginePtr)rtc;
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+void
+brc_h264_rate_control_free (BrcCodecEnginePtr engine_ptr) {
+  H264RateControlRTC *rtc = (H264RateControlRTC *) engine_ptr;
+  if (rtc)
+    free(rtc);
+}
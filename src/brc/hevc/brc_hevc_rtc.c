@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "brc_hevc_rtc.h"
+
+// nuh_layer_id of the spatial layers and TemporalId of sps_max_sub_layers.
+#define HEVC_SS_MAX_LAYERS 4
+#define HEVC_TS_MAX_LAYERS 7
+
+#undef ERROR
+#define ERROR(str)                  \
+  do {                              \
+    fprintf(stderr, "%s \n", str);	    \
+    return LIBMEBO_STATUS_INVALID_PARAM; \
+  } while (0)
+
+#define RANGE_CHECK(p, memb, lo, hi)                                     \
+  do {                                                                   \
+    if (!(((p)->memb == (lo) || (p)->memb > (lo)) && (p)->memb <= (hi))) \
+      ERROR(#memb " out of range [" #lo ".." #hi "]");                   \
+  } while (0)
+
+// levelScale[] of the HEVC dequantization: the step size doubles every 6
+// QPs and is 1.0 at QP 4.
+static const BrcQpCodec hevc_codec = {
+  { 40, 45, 51, 57, 64, 72 },
+  { 1200000, 400000 },
+  0,
+};
+
+static void pick_deblock_offsets(HEVCRateControlRTC *rtc) {
+  const BrcQpRc *rc = &rtc->rc;
+  int offset;
+
+  // The deblocking strength already follows the QP through the beta and tc
+  // tables. The offsets weaken the filter at low QPs to keep the texture,
+  // and strengthen it on the inter frames of high QPs, where the skipped
+  // residual leaves the blocking. Text and graphics keep sharp edges.
+  if (rc->oxcf.screen_content) {
+    offset = -2;
+  } else {
+    offset = (brc_qp_rc_get_qp(rc) - 32) / 6;
+    if (offset < -2) offset = -2;
+    if (offset > 2) offset = 2;
+    if (rc->frame_type == BRC_QP_KEY_FRAME && offset > 0) offset = 0;
+  }
+  rtc->beta_offset_div2 = offset;
+  rtc->tc_offset_div2 = offset;
+}
+
+/*===== BRC functions exposed to libs implementation ========= */
+
+LibMeboStatus
+brc_hevc_post_encode_update(BrcCodecEnginePtr engine_ptr, uint64_t encoded_frame_size) {
+  HEVCRateControlRTC *rtc = (HEVCRateControlRTC *) engine_ptr;
+  brc_qp_rc_postencode_update(&rtc->rc, encoded_frame_size);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_hevc_get_qp(BrcCodecEnginePtr engine_ptr, int *qp) {
+  HEVCRateControlRTC *rtc = (HEVCRateControlRTC *) engine_ptr;
+  *qp = brc_qp_rc_get_qp(&rtc->rc);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_hevc_get_loop_filter_level(BrcCodecEnginePtr engine_ptr, int *filter_level) {
+  if (!engine_ptr || !filter_level)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  // The HEVC deblocking has no level, only the offsets of the QP based
+  // strength returned by brc_hevc_get_loop_filter_params().
+  *filter_level = 0;
+  return LIBMEBO_STATUS_UNIMPLEMENTED;
+}
+
+LibMeboStatus
+brc_hevc_get_loop_filter_params(BrcCodecEnginePtr engine_ptr,
+    LibMeboLoopFilterParams *params) {
+  HEVCRateControlRTC *rtc = (HEVCRateControlRTC *) engine_ptr;
+  params->deblock_beta_offset = rtc->beta_offset_div2;
+  params->deblock_tc_offset = rtc->tc_offset_div2;
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_hevc_get_segmentation_map(BrcCodecEnginePtr engine_ptr,
+    LibMeboSegmentationMap *seg_map) {
+  if (!engine_ptr || !seg_map)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  seg_map->enabled = 0;
+  return LIBMEBO_STATUS_UNIMPLEMENTED;
+}
+
+LibMeboStatus
+brc_hevc_set_roi(BrcCodecEnginePtr engine_ptr, const LibMeboRoiConfig *roi) {
+  if (!engine_ptr || !roi)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  return LIBMEBO_STATUS_UNIMPLEMENTED;
+}
+
+LibMeboStatus
+brc_hevc_get_qdelta_by_rate(BrcCodecEnginePtr engine_ptr, double rate_ratio,
+    int *qdelta) {
+  HEVCRateControlRTC *rtc = (HEVCRateControlRTC *) engine_ptr;
+  if (!engine_ptr || !qdelta)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  *qdelta = brc_qp_compute_qdelta_by_rate(&rtc->rc, rate_ratio);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_hevc_get_keyframe_advice(BrcCodecEnginePtr engine_ptr, int max_interval,
+    LibMeboKeyFrameAdvice *advice) {
+  HEVCRateControlRTC *rtc = (HEVCRateControlRTC *) engine_ptr;
+  return brc_qp_rc_get_keyframe_advice(&rtc->rc, max_interval, advice);
+}
+
+LibMeboStatus
+brc_hevc_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_params) {
+  HEVCRateControlRTC *rtc = (HEVCRateControlRTC *) engine_ptr;
+  LibMeboStatus status;
+
+  status = brc_qp_rc_compute_qp(&rtc->rc, frame_params);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+  pick_deblock_offsets(rtc);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus brc_hevc_validate (LibMeboRateControllerConfig *cfg);
+
+LibMeboStatus
+brc_hevc_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerConfig *rc_cfg) {
+  HEVCRateControlRTC *rtc = (HEVCRateControlRTC *) engine_ptr;
+  LibMeboStatus status;
+
+  // A config update is validated like the config of the controller creation.
+  status = brc_hevc_validate (rc_cfg);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+  brc_qp_rc_update_config(&rtc->rc, rc_cfg);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_hevc_validate (LibMeboRateControllerConfig *cfg)
+{
+  LibMeboStatus status;
+
+  status = brc_qp_rc_validate (cfg, HEVC_SS_MAX_LAYERS, HEVC_TS_MAX_LAYERS);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+
+  // pic_width/height_in_luma_samples of level 6.2
+  RANGE_CHECK(cfg, width, 1, 16888);
+  RANGE_CHECK(cfg, height, 1, 16888);
+  if (cfg->bit_depth != 0 && cfg->bit_depth != 8 && cfg->bit_depth != 10 &&
+      cfg->bit_depth != 12)
+    ERROR("bit_depth must be 8, 10 or 12");
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_hevc_rate_control_init (LibMeboRateControllerConfig *cfg,
+    BrcCodecEnginePtr *brc_codec_handler) {
+  LibMeboStatus status = LIBMEBO_STATUS_SUCCESS;
+  HEVCRateControlRTC *rtc = NULL;
+
+  status = brc_hevc_validate (cfg);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+
+  rtc = (HEVCRateControlRTC*) malloc (sizeof (HEVCRateControlRTC));
+  if (!rtc)
+    return LIBMEBO_STATUS_FAILED;
+
+  memset (rtc, 0, sizeof (*rtc));
+  brc_qp_rc_init (&rtc->rc, &hevc_codec, cfg);
+
+  *brc_codec_handler = (BrcCodecEnginePtr)rtc;
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+void
+brc_hevc_rate_control_free (BrcCodecEnginePtr engine_ptr) {
+  HEVCRateControlRTC *rtc = (HEVCRateControlRTC *) engine_ptr;
+  if (rtc)
+    free(rtc);
+}
@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef LIBMEBO_HEVC_RATECTRL_RTC_H
+#define LIBMEBO_HEVC_RATECTRL_RTC_H
+
+#include "../common/brc_qp_ratectrl.h"
+#include "../../lib/libmebo.h"
+
+// This interface allows using HEVC real-time rate control with any encoder
+// that takes a QP per frame, e.g. a hardware encoder in CQP mode.
+//
+// HEVCRateControlRTC *rc_api;
+// LibMeboRateControllerConfig cfg;
+// LibMeboRCFrameParams frame_params;
+//
+// YourFunctionToInitializeConfig(cfg);
+// brc_hevc_rate_control_init (&cfg, &rc_api);
+// // start encoding
+// while (frame_to_encode) {
+//   if (config_changed)
+//     brc_hevc_update_rate_control (rc_api, &cfg);
+//   YourFunctionToFillFrameParams(frame_params);
+//   brc_hevc_compute_qp(rc_api, &frame_params);
+//   YourFunctionToUseQP(brc_hevc_get_qp(rc_api));
+//   YourFunctionToUseDeblocking(brc_hevc_get_loop_filter_params(rc_api));
+//   // After encoding
+//   brc_hevc_post_encode_update(rc_api, encoded_frame_size);
+// }
+
+typedef struct _HEVCRateControlRTC {
+  BrcQpRc rc;
+  // slice_beta_offset_div2 and slice_tc_offset_div2 of the current frame.
+  int beta_offset_div2;
+  int tc_offset_div2;
+} HEVCRateControlRTC;
+
+LIBMEBO_API void
+brc_hevc_rate_control_free (BrcCodecEnginePtr rtc);
+
+LIBMEBO_API LibMeboStatus
+brc_hevc_update_rate_control(BrcCodecEnginePtr rtc_api, LibMeboRateControllerConfig *rc_cfg);
+
+LIBMEBO_API LibMeboStatus
+brc_hevc_compute_qp (BrcCodecEnginePtr rtc_api, LibMeboRCFrameParams *frame_params);
+
+// GetQP() needs to be called after ComputeQP() to get the latest QpY
+LIBMEBO_API LibMeboStatus
+brc_hevc_get_qp(BrcCodecEnginePtr rtc_api, int *qp);
+
+LIBMEBO_API LibMeboStatus
+brc_hevc_get_loop_filter_level(BrcCodecEnginePtr rtc_api, int *lf);
+
+// Deblocking offsets of the slice header
+LIBMEBO_API LibMeboStatus
+brc_hevc_get_loop_filter_params(BrcCodecEnginePtr rtc_api,
+    LibMeboLoopFilterParams *params);
+
+LIBMEBO_API LibMeboStatus
+brc_hevc_get_segmentation_map(BrcCodecEnginePtr rtc_api,
+    LibMeboSegmentationMap *seg_map);
+
+// Best frame for the next key frame within max_interval frames
+LIBMEBO_API LibMeboStatus
+brc_hevc_get_keyframe_advice(BrcCodecEnginePtr rtc_api, int max_interval,
+    LibMeboKeyFrameAdvice *advice);
+
+LIBMEBO_API LibMeboStatus
+brc_hevc_set_roi(BrcCodecEnginePtr rtc_api, const LibMeboRoiConfig *roi);
+
+// Qp delta (cu_qp_delta) scaling the rate of a block of the current frame
+// by rate_ratio
+LIBMEBO_API LibMeboStatus
+brc_hevc_get_qdelta_by_rate(BrcCodecEnginePtr rtc_api, double rate_ratio,
+    int *qdelta);
+
+// Feedback to rate control with the size of current encoded frame
+LIBMEBO_API LibMeboStatus
+brc_hevc_post_encode_update(BrcCodecEnginePtr rtc_api, uint64_t encoded_frame_size);
+
+LIBMEBO_API LibMeboStatus
+brc_hevc_rate_control_init (LibMeboRateControllerConfig *rc_cfg,
+    BrcCodecEnginePtr *brc_codec_handler);
+
+#endif  // LIBMEBO_HEVC_RATECTRL_RTC_H
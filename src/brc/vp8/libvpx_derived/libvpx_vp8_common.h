@@ -25,6 +25,9 @@
 
 #define KEY_FRAME_CONTEXT 5
 
+/* Target of a frame with no changes: the headers and the skip flags. */
+#define VP8_UNCHANGED_FRAME_BITS 200
+
 #define VP8_MINQ 0
 #define VP8_MAXQ 127
 #define VP8_QINDEX_RANGE (VP8_MAXQ + 1)
@@ -35,10 +38,10 @@
 #define VP8_TS_MAX_PERIODICITY 16
 
 /*! Temporal Scalability: Maximum number of coding layers */
-#define VP8_TS_MAX_LAYERS 1
+#define VP8_TS_MAX_LAYERS 5
 
 /*! Temporal+Spatial Scalability: Maximum number of coding layers */
-#define VP8_MAX_LAYERS 1  // 3 temporal + 4 spatial layers are allowed.
+#define VP8_MAX_LAYERS 5  // Only temporal layers are allowed.
 
 /*! Spatial Scalability: Maximum number of coding layers */
 #define VP8_SS_MAX_LAYERS 1
@@ -137,6 +140,53 @@ typedef struct {
 
 } VP8_CONFIG;
 
+typedef struct {
+  /* Layer configuration */
+  double framerate;
+  int target_bandwidth;
+
+  /* Layer specific coding parameters */
+  int64_t starting_buffer_level;
+  int64_t optimal_buffer_level;
+  int64_t maximum_buffer_size;
+  int64_t starting_buffer_level_in_ms;
+  int64_t optimal_buffer_level_in_ms;
+  int64_t maximum_buffer_size_in_ms;
+
+  int avg_frame_size_for_layer;
+
+  int64_t buffer_level;
+  int64_t bits_off_target;
+
+  int64_t total_actual_bits;
+  int total_target_vs_actual;
+
+  int worst_quality;
+  int active_worst_quality;
+  int best_quality;
+  int active_best_quality;
+
+  int ni_av_qi;
+  int ni_tot_qi;
+  int ni_frames;
+  int avg_frame_qindex;
+
+  double rate_correction_factor;
+  double key_frame_rate_correction_factor;
+  double gf_rate_correction_factor;
+
+  int inter_frame_target;
+  int64_t total_byte_count;
+
+  int filter_level;
+
+  int frames_since_last_drop_overshoot;
+
+  int last_frame_percent_intra;
+
+  int last_q[2];
+} VP8_LAYER_CONTEXT;
+
 typedef struct VP8_COMP {
   VP8_COMMON common;
   VP8_CONFIG oxcf;
@@ -266,5 +316,16 @@ typedef struct VP8_COMP {
   int initial_width;
   int initial_height;
 
+  /* Temporal scalability: rate control state of each layer, the state of
+   * current_layer lives in the fields above while its frame is coded.
+   */
+  VP8_LAYER_CONTEXT layer_context[VP8_TS_MAX_LAYERS];
+  int current_layer;
+
+  /* The source of the current frame is the same as the previous one. */
+  int frame_unchanged;
+  /* The current frame starts a new scene. */
+  int scene_change;
+
 } VP8_COMP;
 #endif
@@ -0,0 +1,63 @@
+/*
+ *  Copyright (c) 2010 The WebM project authors. All Rights Reserved.
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "libvpx_vp8_picklpf.h"
+
+static int get_min_filter_level(VP8_COMP *cpi, int base_qindex) {
+  int min_filter_level;
+
+  if (cpi->source_alt_ref_active && cpi->common.refresh_golden_frame &&
+      !cpi->common.refresh_alt_ref_frame) {
+    min_filter_level = 0;
+  } else {
+    if (base_qindex <= 6) {
+      min_filter_level = 0;
+    } else if (base_qindex <= 16) {
+      min_filter_level = 1;
+    } else {
+      min_filter_level = (base_qindex / 8);
+    }
+  }
+
+  return min_filter_level;
+}
+
+static int get_max_filter_level(VP8_COMP *cpi, int base_qindex) {
+  (void)cpi;
+  (void)base_qindex;
+  return VP8_MAX_LOOP_FILTER;
+}
+
+void libvpx_vp8_pick_filter_level(VP8_COMP *cpi) {
+  VP8_COMMON *const cm = &cpi->common;
+  const int q = cm->base_qindex;
+  const int min_filter_level = get_min_filter_level(cpi, q);
+  const int max_filter_level = get_max_filter_level(cpi, q);
+  int filt_guess;
+
+  if (cm->frame_type == VP8_KEY_FRAME) {
+    /* Same starting point as vp8_setup_key_frame() */
+    filt_guess = q * 3 / 8;
+  } else if (cm->Width * cm->Height <= 320 * 240) {
+    /* Linear fits of the searched level against base_qindex, per
+     * resolution class, from the libvpx VP8 real-time rate control.
+     */
+    filt_guess = (int)(0.352685 * q + 2.957774);
+  } else if (cm->Width * cm->Height <= 640 * 480) {
+    filt_guess = (int)(0.485069 * q - 0.534462);
+  } else {
+    filt_guess = (int)(0.314875 * q + 7.959003);
+  }
+
+  if (filt_guess < min_filter_level) filt_guess = min_filter_level;
+  if (filt_guess > max_filter_level) filt_guess = max_filter_level;
+  cm->filter_level = filt_guess;
+}
@@ -0,0 +1,24 @@
+/*
+ *  Copyright (c) 2010 The WebM project authors. All Rights Reserved.
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef VPX_VP8_ENCODER_PICKLPF_H_
+#define VPX_VP8_ENCODER_PICKLPF_H_
+
+#include "libvpx_vp8_common.h"
+
+#define VP8_MAX_LOOP_FILTER 63
+
+/* Estimate the loop filter level of the current frame from its base_qindex
+ * and frame type, without access to the source or reconstructed frame.
+ */
+void libvpx_vp8_pick_filter_level(VP8_COMP *cpi);
+
+#endif  // VPX_VP8_ENCODER_PICKLPF_H_
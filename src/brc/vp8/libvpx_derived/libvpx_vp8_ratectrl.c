@@ -11,6 +11,7 @@
  */
 
 #include "libvpx_vp8_ratectrl.h"
+#include "../../common/brc_ratectrl.h"
 
 #define MIN_BPB_FACTOR 0.01
 #define MAX_BPB_FACTOR 50
@@ -167,7 +168,10 @@ libvpx_vp8_rc_postencode_update (VP8_COMP *cpi, uint64_t size)
 
   //Fimxe: Add this field in cpi structure? in vp8 it is the code in encode routine
   //if (!active_worst_qchanged)
-  libvpx_vp8_update_rate_correction_factors(cpi, 2);
+  /* An unchanged frame is mostly skipped blocks and says nothing about the
+   * rate at its q.
+   */
+  if (!cpi->frame_unchanged) libvpx_vp8_update_rate_correction_factors(cpi, 2);
 
   cpi->last_q[cm->frame_type] = cm->base_qindex;
 
@@ -253,7 +257,27 @@ libvpx_vp8_rc_postencode_update (VP8_COMP *cpi, uint64_t size)
 
   cpi->buffer_level = cpi->bits_off_target;
 
-  //Fixme: temporal svc is not yet enabled
+  /* Propagate values to higher temporal layers */
+  if (cpi->oxcf.number_of_layers > 1) {
+    unsigned int i;
+
+    for (i = cpi->current_layer + 1; i < cpi->oxcf.number_of_layers; ++i) {
+      VP8_LAYER_CONTEXT *lc = &cpi->layer_context[i];
+      int bits_off_for_this_layer = (int)round(
+          lc->target_bandwidth / lc->framerate - cpi->projected_frame_size);
+
+      lc->bits_off_target += bits_off_for_this_layer;
+
+      /* Clip buffer level to maximum buffer size for the layer */
+      if (lc->bits_off_target > lc->maximum_buffer_size) {
+        lc->bits_off_target = lc->maximum_buffer_size;
+      }
+
+      lc->total_actual_bits += cpi->projected_frame_size;
+      lc->total_target_vs_actual += bits_off_for_this_layer;
+      lc->buffer_level = lc->bits_off_target;
+    }
+  }
 
   /* Dont increment frame counters if this was an altref buffer update
    * not a real frame
@@ -280,9 +304,188 @@ void libvpx_vp8_new_framerate(VP8_COMP *cpi, double framerate) {
   if (cpi->max_gf_interval < 12) cpi->max_gf_interval = 12;
 }
 
+int libvpx_vp8_rescale(int val, int num, int denom) {
+  int64_t llnum = num;
+  int64_t llden = denom;
+  int64_t llval = val;
+
+  return (int)(llval * llnum / llden);
+}
+
+void libvpx_vp8_init_temporal_layer_context(VP8_COMP *cpi, const int layer,
+                                            double prev_layer_framerate) {
+  VP8_CONFIG *oxcf = &cpi->oxcf;
+  VP8_LAYER_CONTEXT *lc = &cpi->layer_context[layer];
+
+  lc->framerate = cpi->ref_framerate / oxcf->rate_decimator[layer];
+  lc->target_bandwidth = oxcf->target_bitrate[layer] * 1000;
+
+  lc->starting_buffer_level_in_ms = oxcf->starting_buffer_level_in_ms;
+  lc->optimal_buffer_level_in_ms = oxcf->optimal_buffer_level_in_ms;
+  lc->maximum_buffer_size_in_ms = oxcf->maximum_buffer_size_in_ms;
+
+  lc->starting_buffer_level = libvpx_vp8_rescale(
+      (int)oxcf->starting_buffer_level_in_ms, lc->target_bandwidth, 1000);
+
+  if (oxcf->optimal_buffer_level_in_ms == 0) {
+    lc->optimal_buffer_level = lc->target_bandwidth / 8;
+  } else {
+    lc->optimal_buffer_level = libvpx_vp8_rescale(
+        (int)oxcf->optimal_buffer_level_in_ms, lc->target_bandwidth, 1000);
+  }
+
+  if (oxcf->maximum_buffer_size_in_ms == 0) {
+    lc->maximum_buffer_size = lc->target_bandwidth / 8;
+  } else {
+    lc->maximum_buffer_size = libvpx_vp8_rescale(
+        (int)oxcf->maximum_buffer_size_in_ms, lc->target_bandwidth, 1000);
+  }
+
+  /* Work out the average size of a frame within this layer */
+  if (layer > 0) {
+    lc->avg_frame_size_for_layer =
+        (int)round((oxcf->target_bitrate[layer] -
+                    oxcf->target_bitrate[layer - 1]) *
+                   1000 / (lc->framerate - prev_layer_framerate));
+  }
+
+  lc->active_worst_quality = oxcf->worst_allowed_q;
+  lc->active_best_quality = oxcf->best_allowed_q;
+  lc->avg_frame_qindex = oxcf->worst_allowed_q;
+
+  lc->buffer_level = lc->starting_buffer_level;
+  lc->bits_off_target = lc->starting_buffer_level;
+
+  lc->total_actual_bits = 0;
+  lc->total_target_vs_actual = 0;
+  lc->ni_av_qi = oxcf->worst_allowed_q;
+  lc->ni_tot_qi = 0;
+  lc->ni_frames = 0;
+  lc->rate_correction_factor = 1.0;
+  lc->key_frame_rate_correction_factor = 1.0;
+  lc->gf_rate_correction_factor = 1.0;
+  lc->inter_frame_target = 0;
+  lc->total_byte_count = 0;
+  lc->last_q[0] = lc->last_q[1] = 0;
+}
+
+void libvpx_vp8_update_layer_contexts(VP8_COMP *cpi) {
+  VP8_CONFIG *oxcf = &cpi->oxcf;
+  double prev_layer_framerate = 0;
+  unsigned int i;
+
+  /* Update snapshots of the layer contexts to reflect new parameters */
+  for (i = 0; i < oxcf->number_of_layers && i < VP8_TS_MAX_LAYERS; ++i) {
+    VP8_LAYER_CONTEXT *lc = &cpi->layer_context[i];
+
+    lc->framerate = cpi->ref_framerate / oxcf->rate_decimator[i];
+    lc->target_bandwidth = oxcf->target_bitrate[i] * 1000;
+
+    lc->starting_buffer_level = libvpx_vp8_rescale(
+        (int)oxcf->starting_buffer_level_in_ms, lc->target_bandwidth, 1000);
+
+    if (oxcf->optimal_buffer_level_in_ms == 0) {
+      lc->optimal_buffer_level = lc->target_bandwidth / 8;
+    } else {
+      lc->optimal_buffer_level = libvpx_vp8_rescale(
+          (int)oxcf->optimal_buffer_level_in_ms, lc->target_bandwidth, 1000);
+    }
+
+    if (oxcf->maximum_buffer_size_in_ms == 0) {
+      lc->maximum_buffer_size = lc->target_bandwidth / 8;
+    } else {
+      lc->maximum_buffer_size = libvpx_vp8_rescale(
+          (int)oxcf->maximum_buffer_size_in_ms, lc->target_bandwidth, 1000);
+    }
+
+    /* Work out the average size of a frame within this layer */
+    if (i > 0) {
+      lc->avg_frame_size_for_layer =
+          (int)round((oxcf->target_bitrate[i] - oxcf->target_bitrate[i - 1]) *
+                     1000 / (lc->framerate - prev_layer_framerate));
+    }
+
+    prev_layer_framerate = lc->framerate;
+  }
+}
+
+void libvpx_vp8_save_layer_context(VP8_COMP *cpi) {
+  VP8_LAYER_CONTEXT *lc = &cpi->layer_context[cpi->current_layer];
+
+  /* Save layer dependent coding state */
+  lc->target_bandwidth = cpi->target_bandwidth;
+  lc->starting_buffer_level = cpi->oxcf.starting_buffer_level;
+  lc->optimal_buffer_level = cpi->oxcf.optimal_buffer_level;
+  lc->maximum_buffer_size = cpi->oxcf.maximum_buffer_size;
+  lc->starting_buffer_level_in_ms = cpi->oxcf.starting_buffer_level_in_ms;
+  lc->optimal_buffer_level_in_ms = cpi->oxcf.optimal_buffer_level_in_ms;
+  lc->maximum_buffer_size_in_ms = cpi->oxcf.maximum_buffer_size_in_ms;
+  lc->buffer_level = cpi->buffer_level;
+  lc->bits_off_target = cpi->bits_off_target;
+  lc->total_actual_bits = cpi->total_actual_bits;
+  lc->worst_quality = cpi->worst_quality;
+  lc->active_worst_quality = cpi->active_worst_quality;
+  lc->best_quality = cpi->best_quality;
+  lc->active_best_quality = cpi->active_best_quality;
+  lc->ni_av_qi = cpi->ni_av_qi;
+  lc->ni_tot_qi = cpi->ni_tot_qi;
+  lc->ni_frames = cpi->ni_frames;
+  lc->avg_frame_qindex = cpi->avg_frame_qindex;
+  lc->rate_correction_factor = cpi->rate_correction_factor;
+  lc->key_frame_rate_correction_factor = cpi->key_frame_rate_correction_factor;
+  lc->gf_rate_correction_factor = cpi->gf_rate_correction_factor;
+  lc->inter_frame_target = cpi->inter_frame_target;
+  lc->total_byte_count = cpi->total_byte_count;
+  lc->filter_level = cpi->common.filter_level;
+  lc->frames_since_last_drop_overshoot = cpi->frames_since_last_drop_overshoot;
+  lc->last_frame_percent_intra = cpi->last_frame_percent_intra;
+  lc->last_q[0] = cpi->last_q[0];
+  lc->last_q[1] = cpi->last_q[1];
+}
+
+void libvpx_vp8_restore_layer_context(VP8_COMP *cpi, const int layer) {
+  VP8_LAYER_CONTEXT *lc = &cpi->layer_context[layer];
+
+  /* Restore layer dependent coding state */
+  cpi->current_layer = layer;
+  cpi->target_bandwidth = lc->target_bandwidth;
+  cpi->oxcf.target_bandwidth = lc->target_bandwidth;
+  cpi->oxcf.starting_buffer_level = lc->starting_buffer_level;
+  cpi->oxcf.optimal_buffer_level = lc->optimal_buffer_level;
+  cpi->oxcf.maximum_buffer_size = lc->maximum_buffer_size;
+  cpi->oxcf.starting_buffer_level_in_ms = lc->starting_buffer_level_in_ms;
+  cpi->oxcf.optimal_buffer_level_in_ms = lc->optimal_buffer_level_in_ms;
+  cpi->oxcf.maximum_buffer_size_in_ms = lc->maximum_buffer_size_in_ms;
+  cpi->buffer_level = lc->buffer_level;
+  cpi->bits_off_target = lc->bits_off_target;
+  cpi->total_actual_bits = lc->total_actual_bits;
+  cpi->active_worst_quality = lc->active_worst_quality;
+  cpi->active_best_quality = lc->active_best_quality;
+  cpi->ni_av_qi = lc->ni_av_qi;
+  cpi->ni_tot_qi = lc->ni_tot_qi;
+  cpi->ni_frames = lc->ni_frames;
+  cpi->avg_frame_qindex = lc->avg_frame_qindex;
+  cpi->rate_correction_factor = lc->rate_correction_factor;
+  cpi->key_frame_rate_correction_factor = lc->key_frame_rate_correction_factor;
+  cpi->gf_rate_correction_factor = lc->gf_rate_correction_factor;
+  cpi->inter_frame_target = lc->inter_frame_target;
+  cpi->total_byte_count = lc->total_byte_count;
+  cpi->common.filter_level = lc->filter_level;
+  cpi->frames_since_last_drop_overshoot = lc->frames_since_last_drop_overshoot;
+  cpi->last_frame_percent_intra = lc->last_frame_percent_intra;
+  cpi->last_q[0] = lc->last_q[0];
+  cpi->last_q[1] = lc->last_q[1];
+}
+
+/* Bits per macroblock of the rate model at Q, rounded */
+static int bits_per_mb(int frame_kind, int Q, double correction_factor) {
+  return brc_rc_model_bits_per_mb(vp8_bits_per_mb[frame_kind][Q], 1, 1,
+                                  correction_factor);
+}
+
 static int estimate_bits_at_q(int frame_kind, int Q, int MBs,
                               double correction_factor) {
-  int Bpm = (int)(.5 + correction_factor * vp8_bits_per_mb[frame_kind][Q]);
+  int Bpm = bits_per_mb(frame_kind, Q, correction_factor);
 
   /* Attempt to retain reasonable accuracy without overflow. The cutoff is
    * chosen such that the maximum product of Bpm and MBs fits 31 bits. The
@@ -295,19 +498,40 @@ static int estimate_bits_at_q(int frame_kind, int Q, int MBs,
   }
 }
 
-//Done
-static void calc_iframe_target_size(VP8_COMP *cpi) {
+/* Target of a key frame coded frames_ahead frames after the next one */
+static int iframe_target_size(const VP8_COMP *cpi, int frames_ahead) {
+  const int frames_since_key = (int)cpi->frames_since_key + frames_ahead;
   /* boost defaults to half second */
   int kf_boost;
   uint64_t target;
 
   /* First Frame is a special case */
-  if (cpi->common.current_video_frame == 0) {
+  if (cpi->common.current_video_frame + frames_ahead == 0) {
     /* 1 Pass there is no information on which to base size so use
-     * bandwidth per second * fraction of the initial buffer
-     * level
+     * the rate model at the Q the inter frames are expected to settle at,
+     * boosted like a later key frame, twice for screen content whose key
+     * frame costs as much as many static inter frames. At least an eighth
+     * and at most all of the initial buffer level
      */
-    target = cpi->oxcf.starting_buffer_level / 2;
+    int Q = cpi->best_quality;
+
+    kf_boost = VPXMAX(32, (int)(2 * cpi->output_framerate - 16));
+    if (cpi->oxcf.screen_content_mode) kf_boost *= 2;
+    while (Q < cpi->worst_quality &&
+           estimate_bits_at_q(VP8_INTER_FRAME, Q, cpi->common.MBs, 1.0) >
+               cpi->av_per_frame_bandwidth) {
+      Q++;
+    }
+    target = ((uint64_t)estimate_bits_at_q(VP8_KEY_FRAME, Q, cpi->common.MBs,
+                                           1.0) *
+              (16 + kf_boost)) >>
+             4;
+    if (target < (uint64_t)cpi->oxcf.starting_buffer_level / 8) {
+      target = cpi->oxcf.starting_buffer_level / 8;
+    }
+    if (target > (uint64_t)cpi->oxcf.starting_buffer_level) {
+      target = cpi->oxcf.starting_buffer_level;
+    }
 
     if (target > cpi->oxcf.target_bandwidth * 3 / 2) {
       target = cpi->oxcf.target_bandwidth * 3 / 2;
@@ -331,9 +555,9 @@ static void calc_iframe_target_size(VP8_COMP *cpi) {
     kf_boost = kf_boost * kf_boost_qadjustment[Q] / 100;
 
     /* frame separation adjustment ( down) */
-    if (cpi->frames_since_key < cpi->output_framerate / 2) {
+    if (frames_since_key < cpi->output_framerate / 2) {
       kf_boost =
-          (int)(kf_boost * cpi->frames_since_key / (cpi->output_framerate / 2));
+          (int)(kf_boost * frames_since_key / (cpi->output_framerate / 2));
     }
 
     /* Minimal target size is |2* per_frame_bandwidth|. */
@@ -349,7 +573,12 @@ static void calc_iframe_target_size(VP8_COMP *cpi) {
     if (target > max_rate) target = max_rate;
   }
 
-  cpi->this_frame_target = (int)target;
+  return (int)target;
+}
+
+//Done
+static void calc_iframe_target_size(VP8_COMP *cpi) {
+  cpi->this_frame_target = iframe_target_size(cpi, 0);
 
   /* TODO: if we separate rate targeting from Q targeting, move this.
    * Reset the active worst quality to the baseline value for key frames.
@@ -511,6 +740,11 @@ static void calc_pframe_target_size(VP8_COMP *cpi) {
   int min_frame_target;
   int old_per_frame_bandwidth = cpi->per_frame_bandwidth;
 
+  if (cpi->current_layer > 0) {
+    cpi->per_frame_bandwidth =
+        cpi->layer_context[cpi->current_layer].avg_frame_size_for_layer;
+  }
+
   min_frame_target = cpi->per_frame_bandwidth / 4;
 
   /* Normal frames (gf,and inter) */
@@ -876,23 +1110,35 @@ void libvpx_vp8_update_rate_correction_factors(VP8_COMP *cpi, int damp_var) {
   }
 
   /* Work out how big we would have expected the frame to be at this Q
-   * given the current correction factor. Stay in double to avoid int
-   * overflow when values are large
+   * given the current correction factor. Stay in double, or 64 bits, to
+   * avoid int overflow when values are large
    */
+#if LIBMEBO_FIXED_POINT_RC
+  projected_size_based_on_q =
+      (int)((((int64_t)vp8_bits_per_mb[cpi->common.frame_type][Q] *
+                  brc_rc_factor_to_fixed(rate_correction_factor) +
+              (BRC_RC_FACTOR_ONE >> 1)) *
+             cpi->common.MBs) >>
+            (BRC_RC_FACTOR_BITS + BPER_MB_NORMBITS));
+#else
   projected_size_based_on_q =
       (int)(((.5 + rate_correction_factor *
                        vp8_bits_per_mb[cpi->common.frame_type][Q]) *
              cpi->common.MBs) /
             (1 << BPER_MB_NORMBITS));
+#endif
 
   /* Work out a size correction factor. */
-  if (projected_size_based_on_q > 0) {
-    correction_factor =
-        (100 * cpi->projected_frame_size) / projected_size_based_on_q;
+  correction_factor = brc_rc_size_correction_factor(
+      cpi->projected_frame_size, projected_size_based_on_q, 0);
+
+  if (brc_rc_is_scene_change_size(correction_factor)) {
+    cpi->scene_change = 1;
   }
 
   /* More heavily damped adjustment used if we have been oscillating
-   * either side of target
+   * either side of target. No damping on a scene change, the model of the
+   * previous scene is of no use.
    */
   switch (damp_var) {
     case 0: adjustment_limit = 0.75; break;
@@ -900,13 +1146,14 @@ void libvpx_vp8_update_rate_correction_factors(VP8_COMP *cpi, int damp_var) {
     case 2:
     default: adjustment_limit = 0.25; break;
   }
+  if (cpi->scene_change) adjustment_limit = 1.0;
 
   if (correction_factor > 102) {
     /* We are not already at the worst allowable quality */
     correction_factor =
         (int)(100.5 + ((correction_factor - 100) * adjustment_limit));
     rate_correction_factor =
-        ((rate_correction_factor * correction_factor) / 100);
+        brc_rc_scale_rate_factor(rate_correction_factor, correction_factor);
 
     /* Keep rate_correction_factor within limits */
     if (rate_correction_factor > MAX_BPB_FACTOR) {
@@ -917,7 +1164,7 @@ void libvpx_vp8_update_rate_correction_factors(VP8_COMP *cpi, int damp_var) {
     correction_factor =
         (int)(100.5 - ((100 - correction_factor) * adjustment_limit));
     rate_correction_factor =
-        ((rate_correction_factor * correction_factor) / 100);
+        brc_rc_scale_rate_factor(rate_correction_factor, correction_factor);
 
     /* Keep rate_correction_factor within limits */
     if (rate_correction_factor < MIN_BPB_FACTOR) {
@@ -938,12 +1185,14 @@ void libvpx_vp8_update_rate_correction_factors(VP8_COMP *cpi, int damp_var) {
   }
 }
 
+static int frame_bits_per_mb(const void *model, int Q,
+                             double correction_factor) {
+  const VP8_COMP *cpi = (const VP8_COMP *)model;
+  return bits_per_mb(cpi->common.frame_type, Q, correction_factor);
+}
+
 int libvpx_vp8_regulate_q(VP8_COMP *cpi, int target_bits_per_frame) {
-  int Q = cpi->active_worst_quality;
-  int i;
-  int last_error = INT_MAX;
   int target_bits_per_mb;
-  int bits_per_mb_at_this_q;
   double correction_factor;
 
   /* Select the appropriate correction factor based upon type of frame. */
@@ -971,27 +1220,25 @@ int libvpx_vp8_regulate_q(VP8_COMP *cpi, int target_bits_per_frame) {
         (target_bits_per_frame << BPER_MB_NORMBITS) / cpi->common.MBs;
   }
 
-  i = cpi->active_best_quality;
-
-  do {
-     bits_per_mb_at_this_q =
-         (int)(.5 +
-              correction_factor * vp8_bits_per_mb[cpi->common.frame_type][i]);
-
-     if (bits_per_mb_at_this_q <= target_bits_per_mb) {
-       if ((target_bits_per_mb - bits_per_mb_at_this_q) <= last_error) {
-         Q = i;
-       } else {
-         Q = i - 1;
-       }
-
-       break;
-    } else {
-      last_error = bits_per_mb_at_this_q - target_bits_per_mb;
-    }
-  } while (++i <= cpi->active_worst_quality);
+  /* The rate does not increase with Q: the Q of the closest rate is the
+   * one of the first rate not above the target, or the one before it.
+   */
+  return brc_rc_find_closest_q_by_rate(
+      target_bits_per_mb, frame_bits_per_mb, cpi, correction_factor,
+      cpi->active_best_quality, cpi->active_worst_quality);
+}
 
-  return Q;
+int libvpx_vp8_predict_key_frame_size(const VP8_COMP *cpi, int frames_ahead) {
+  const int MBs = cpi->common.MBs;
+  const double rcf = cpi->key_frame_rate_correction_factor;
+  /* Whatever its target, the key frame is coded within the Q range */
+  const int min_size =
+      estimate_bits_at_q(VP8_KEY_FRAME, cpi->worst_quality, MBs, rcf);
+  const int max_size =
+      estimate_bits_at_q(VP8_KEY_FRAME, cpi->best_quality, MBs, rcf);
+  const int target = iframe_target_size(cpi, frames_ahead);
+
+  return VPXMAX(min_size, VPXMIN(target, max_size));
 }
 
 static int estimate_keyframe_frequency(VP8_COMP *cpi) {
@@ -1150,7 +1397,8 @@ int libvpx_vp8_pick_frame_size(VP8_COMP *cpi) {
 // TODO(marpan): Should do this exit condition during the encode_frame
 // (i.e., halfway during the encoding of the frame) to save cycles.
 //
-// LibMebo: We are netither using screen_content_mode nor allowing drop frames
+// LibMebo: We are neither using screen_content_mode = 2 nor allowing drop
+// frames
 int libvpx_vp8_drop_encodedframe_overshoot(VP8_COMP *cpi) {
   cpi->frames_since_last_drop_overshoot++;
   return 0;
@@ -34,9 +34,23 @@ int libvpx_vp8_pick_frame_size(VP8_COMP *cpi);
 
 int libvpx_vp8_drop_encodedframe_overshoot(VP8_COMP *cpi);
 
+/* Size in bits of a key frame coded frames_ahead frames after the next one,
+ * as targeted by the rate control and bounded by the rate model at the best
+ * and worst Q.
+ */
+int libvpx_vp8_predict_key_frame_size(const VP8_COMP *cpi, int frames_ahead);
+
 void libvpx_vp8_new_framerate(VP8_COMP *cpi, double framerate);
 
 void
 libvpx_vp8_rc_postencode_update (VP8_COMP *cpi_, uint64_t encoded_frame_size);
 
+int libvpx_vp8_rescale(int val, int num, int denom);
+
+void libvpx_vp8_init_temporal_layer_context(VP8_COMP *cpi, const int layer,
+                                            double prev_layer_framerate);
+void libvpx_vp8_update_layer_contexts(VP8_COMP *cpi);
+void libvpx_vp8_save_layer_context(VP8_COMP *cpi);
+void libvpx_vp8_restore_layer_context(VP8_COMP *cpi, const int layer);
+
 #endif  // LIBMEBO_BRC_VP8_RATECTRL_H
@@ -11,6 +11,8 @@
 
 #include "libvpx_vp8_rtc.h"
 #include "libvpx_vp8_ratectrl.h"
+#include "libvpx_vp8_picklpf.h"
+#include "../../common/brc_keyframe.h"
 #define LAYER_IDS_TO_IDX(sl, tl, num_tl) ((sl) * (num_tl) + (tl))
 
 #undef ERROR
@@ -76,6 +78,8 @@ brc_vp8_post_encode_update(BrcCodecEnginePtr engine_ptr, uint64_t encoded_frame_
   VP8RateControlRTC *rtc = (VP8RateControlRTC *) engine_ptr;
   VP8_COMP *cpi_ = &rtc->cpi_;
   libvpx_vp8_rc_postencode_update(cpi_, encoded_frame_size);
+  if (cpi_->oxcf.number_of_layers > 1)
+    libvpx_vp8_save_layer_context(cpi_);
   return LIBMEBO_STATUS_SUCCESS;
 }
 
@@ -89,13 +93,78 @@ brc_vp8_get_qp(BrcCodecEnginePtr engine_ptr, int *qp) {
 
 LibMeboStatus
 brc_vp8_get_loop_filter_level(BrcCodecEnginePtr engine_ptr, int *filter_level) {
-  if (!engine_ptr)
+  VP8RateControlRTC *rtc = (VP8RateControlRTC *) engine_ptr;
+  VP8_COMP *cpi_ = &rtc->cpi_;
+  libvpx_vp8_pick_filter_level(cpi_);
+  *filter_level = cpi_->common.filter_level;
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_vp8_get_loop_filter_params(BrcCodecEnginePtr engine_ptr,
+    LibMeboLoopFilterParams *params) {
+  int filter_level;
+  brc_vp8_get_loop_filter_level(engine_ptr, &filter_level);
+  params->filter_level[0] = params->filter_level[1] = filter_level;
+  params->filter_level_u = params->filter_level_v = filter_level;
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_vp8_get_segmentation_map(BrcCodecEnginePtr engine_ptr,
+    LibMeboSegmentationMap *seg_map) {
+  if (!engine_ptr || !seg_map)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  fprintf(stderr, "%s \n", "Warning: Not supported");
+  seg_map->enabled = 0;
+  return LIBMEBO_STATUS_UNIMPLEMENTED;
+}
+
+LibMeboStatus
+brc_vp8_set_roi(BrcCodecEnginePtr engine_ptr, const LibMeboRoiConfig *roi) {
+  if (!engine_ptr || !roi)
 	  return LIBMEBO_STATUS_INVALID_PARAM;
   fprintf(stderr, "%s \n", "Warning: Not supported");
-  *filter_level = 0;
   return LIBMEBO_STATUS_UNIMPLEMENTED;
 }
 
+LibMeboStatus
+brc_vp8_get_qdelta_by_rate(BrcCodecEnginePtr engine_ptr, double rate_ratio,
+    int *qdelta) {
+  (void)rate_ratio;
+  if (!engine_ptr || !qdelta)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  fprintf(stderr, "%s \n", "Warning: Not supported");
+  *qdelta = 0;
+  return LIBMEBO_STATUS_UNIMPLEMENTED;
+}
+
+static int
+brc_vp8_key_frame_size(BrcCodecEnginePtr engine_ptr, int frames_ahead) {
+  VP8RateControlRTC *rtc = (VP8RateControlRTC *) engine_ptr;
+  return libvpx_vp8_predict_key_frame_size(&rtc->cpi_, frames_ahead);
+}
+
+LibMeboStatus
+brc_vp8_get_keyframe_advice(BrcCodecEnginePtr engine_ptr, int max_interval,
+    LibMeboKeyFrameAdvice *advice) {
+  VP8RateControlRTC *rtc = (VP8RateControlRTC *) engine_ptr;
+  VP8_COMP *cpi_ = &rtc->cpi_;
+  BrcKeyFrameState state;
+
+  if (!engine_ptr)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  state.buffer_level = cpi_->buffer_level;
+  state.optimal_buffer_level = cpi_->oxcf.optimal_buffer_level;
+  state.maximum_buffer_size = cpi_->oxcf.maximum_buffer_size;
+  state.avg_frame_bandwidth = cpi_->av_per_frame_bandwidth;
+  state.undershoot_pct = cpi_->oxcf.under_shoot_pct;
+  state.overshoot_pct = cpi_->oxcf.over_shoot_pct;
+  state.target_bandwidth = cpi_->oxcf.target_bandwidth;
+  return brc_keyframe_get_advice(engine_ptr, brc_vp8_key_frame_size, &state,
+                                 max_interval, advice);
+}
+
 LibMeboStatus
 brc_vp8_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_params) {
   VP8RateControlRTC *rtc = (VP8RateControlRTC *) engine_ptr;
@@ -109,10 +178,38 @@ brc_vp8_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_pa
   //vp8_update_rate_correction_factors(cpi, 2);
   //int active_worst_qchanged = 0;
 
+  if (cpi_->oxcf.number_of_layers > 1) {
+    const int layer = frame_params->temporal_layer_id;
+    if (layer < 0 || layer >= (int)cpi_->oxcf.number_of_layers)
+      return LIBMEBO_STATUS_INVALID_PARAM;
+    libvpx_vp8_update_layer_contexts(cpi_);
+    /* Restore layer specific context & set frame rate */
+    libvpx_vp8_restore_layer_context(cpi_, layer);
+    libvpx_vp8_new_framerate(cpi_, cpi_->layer_context[layer].framerate);
+  }
+
   cm->frame_type = (LIBMEBO_KEY_FRAME == frame_params->frame_type) ? VP8_KEY_FRAME : VP8_INTER_FRAME;
+  cpi_->scene_change =
+      !!(frame_params->flags & LIBMEBO_FRAME_FLAG_SCENE_CHANGE);
 
   libvpx_vp8_pick_frame_size (cpi_);
 
+  cpi_->frame_unchanged = cm->frame_type != VP8_KEY_FRAME &&
+                          (frame_params->flags & LIBMEBO_FRAME_FLAG_UNCHANGED);
+  if (cpi_->frame_unchanged) {
+    /* Nothing to code but the skip flags: bank the bits of the frame and
+     * keep the q, the next change starts from the same quality.
+     */
+    cpi_->this_frame_target = VP8_UNCHANGED_FRAME_BITS;
+    if (cpi_->this_frame_target < cpi_->min_frame_bandwidth)
+      cpi_->this_frame_target = cpi_->min_frame_bandwidth;
+    Q = cm->base_qindex;
+    if (Q > cpi_->worst_quality) Q = cpi_->worst_quality;
+    if (Q < cpi_->best_quality) Q = cpi_->best_quality;
+    cm->base_qindex = Q;
+    return LIBMEBO_STATUS_SUCCESS;
+  }
+
   /* Reduce active_worst_allowed_q for CBR if our buffer is getting too full.
    * This has a knock on effect on active best quality as well.
    * For CBR if the buffer reaches its maximum level then we can no longer
@@ -239,13 +336,7 @@ brc_vp8_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_pa
   return LIBMEBO_STATUS_SUCCESS;
 }
 
-static int rescale(int val, int num, int denom) {
-  int64_t llnum = num;
-  int64_t llden = denom;
-  int64_t llval = val;
-
-  return (int)(llval * llnum / llden);
-}
+LibMeboStatus brc_vp8_validate (LibMeboRateControllerConfig *cfg);
 
 LibMeboStatus
 brc_vp8_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerConfig *rc_cfg) {
@@ -253,6 +344,13 @@ brc_vp8_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerC
   VP8_COMP *cpi_ = &rtc->cpi_;
   VP8_COMMON *cm = &cpi_->common;
   VP8_CONFIG *oxcf = &cpi_->oxcf;
+  const unsigned int prev_number_of_layers = oxcf->number_of_layers;
+  LibMeboStatus status;
+
+  // A config update is validated like the config of the controller creation.
+  status = brc_vp8_validate (rc_cfg);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
 
   //Fill VP8_COMMON (init_config())
   cm->Width = rc_cfg->width;
@@ -276,6 +374,8 @@ brc_vp8_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerC
 
   oxcf->under_shoot_pct = rc_cfg->undershoot_pct;
   oxcf->over_shoot_pct = rc_cfg->overshoot_pct;
+  oxcf->screen_content_mode =
+      (rc_cfg->content_type == LIBMEBO_CONTENT_SCREEN) ? 1 : 0;
 
   oxcf->fixed_q = -1;
   oxcf->worst_allowed_q = rc_cfg->max_quantizer;
@@ -303,20 +403,20 @@ brc_vp8_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerC
   oxcf->optimal_buffer_level = rc_cfg->buf_optimal_sz;
   oxcf->maximum_buffer_size = rc_cfg->buf_sz;
 
-  oxcf->starting_buffer_level = rescale(
+  oxcf->starting_buffer_level = libvpx_vp8_rescale(
       (int)oxcf->starting_buffer_level, oxcf->target_bandwidth, 1000);
 
   /* Set or reset optimal and maximum buffer levels. */
   if (oxcf->optimal_buffer_level == 0) {
     oxcf->optimal_buffer_level = oxcf->target_bandwidth / 8;
   } else {
-    oxcf->optimal_buffer_level = rescale(
+    oxcf->optimal_buffer_level = libvpx_vp8_rescale(
         (int)oxcf->optimal_buffer_level, oxcf->target_bandwidth, 1000);
   }
   if (oxcf->maximum_buffer_size == 0) {
     oxcf->maximum_buffer_size = oxcf->target_bandwidth / 8;
   } else {
-    oxcf->maximum_buffer_size = rescale((int)oxcf->maximum_buffer_size,
+    oxcf->maximum_buffer_size = libvpx_vp8_rescale((int)oxcf->maximum_buffer_size,
                                             oxcf->target_bandwidth, 1000);
   }
 
@@ -415,6 +515,27 @@ brc_vp8_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerC
   for (int i = 0; i < KEY_FRAME_CONTEXT; ++i) {
     cpi_->prior_key_frame_distance[i] = (int)cpi_->output_framerate;
   }
+
+  /* Temporal scalability: layer_target_bitrate is cumulative, in kbps */
+  oxcf->number_of_layers = rc_cfg->ts_number_layers;
+  if (oxcf->number_of_layers > 1) {
+    double prev_layer_framerate = 0;
+    for (unsigned int i = 0; i < oxcf->number_of_layers; ++i) {
+      oxcf->target_bitrate[i] = rc_cfg->layer_target_bitrate[i];
+      oxcf->rate_decimator[i] = rc_cfg->ts_rate_decimator[i];
+    }
+    /* The layer buffers carry over a configuration change, unless the
+     * number of layers changed.
+     */
+    if (cm->current_video_frame == 0 ||
+        oxcf->number_of_layers != prev_number_of_layers) {
+      for (unsigned int i = 0; i < oxcf->number_of_layers; ++i) {
+        libvpx_vp8_init_temporal_layer_context(cpi_, i, prev_layer_framerate);
+        prev_layer_framerate = cpi_->layer_context[i].framerate;
+      }
+      cpi_->current_layer = 0;
+    }
+  }
   return LIBMEBO_STATUS_SUCCESS;
 }
 
@@ -426,7 +547,6 @@ brc_init_rate_control(VP8RateControlRTC *rtc, LibMeboRateControllerConfig *rc_cf
   cpi_->baseline_gf_interval = DEFAULT_GF_INTERVAL;
 
   oxcf->cq_level = 10;//Fixme?
-  oxcf->number_of_layers = 1;
 
   brc_vp8_update_rate_control((BrcCodecEnginePtr)rtc, rc_cfg);
 }
@@ -446,25 +566,24 @@ brc_vp8_validate (LibMeboRateControllerConfig *cfg)
   RANGE_CHECK_HI(cfg, undershoot_pct, 1000);
   RANGE_CHECK_HI(cfg, overshoot_pct, 1000);
   RANGE_CHECK(cfg, ss_number_layers, 1, 1);
-  RANGE_CHECK(cfg, ts_number_layers, 1, 1);
+  RANGE_CHECK(cfg, ts_number_layers, 1, VP8_TS_MAX_LAYERS);
   RANGE_CHECK(cfg, max_inter_bitrate_pct, 0, 0);
+  RANGE_CHECK_HI(cfg, content_type, LIBMEBO_CONTENT_SCREEN);
+  if (cfg->bit_depth != 0 && cfg->bit_depth != 8)
+    ERROR("bit_depth must be 8");
 
   if (cfg->ss_number_layers * cfg->ts_number_layers > VP8_MAX_LAYERS)
     ERROR("ss_number_layers * ts_number_layers is out of range");
 
    if (cfg->ts_number_layers > 1) {
-    int sl, tl;
-    for (sl = 1; sl < cfg->ss_number_layers; ++sl) {
-      for (tl = 1; tl < cfg->ts_number_layers; ++tl) {
-        const int layer = LAYER_IDS_TO_IDX(sl, tl, cfg->ts_number_layers);
-        if (cfg->layer_target_bitrate[layer] <
-            cfg->layer_target_bitrate[layer - 1])
-          ERROR("ts_target_bitrate entries are not increasing");
-      }
+    int tl;
+    for (tl = 1; tl < cfg->ts_number_layers; ++tl) {
+      if (cfg->layer_target_bitrate[tl] <= cfg->layer_target_bitrate[tl - 1])
+        ERROR("ts_target_bitrate entries are not strictly increasing");
     }
 
     RANGE_CHECK(cfg, ts_rate_decimator[cfg->ts_number_layers - 1], 1, 1);
-    for (tl = cfg->ts_number_layers - 2; tl > 0; --tl)
+    for (tl = cfg->ts_number_layers - 1; tl > 0; --tl)
       if (cfg->ts_rate_decimator[tl - 1] != 2 * cfg->ts_rate_decimator[tl])
         ERROR("ts_rate_decimator factors are not powers of 2");
   }
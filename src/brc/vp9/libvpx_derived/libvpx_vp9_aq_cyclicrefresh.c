@@ -0,0 +1,277 @@
+/*
+ *  Copyright (c) 2014 The WebM project authors. All Rights Reserved.
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libvpx_vp9_aq_cyclicrefresh.h"
+#include "libvpx_vp9_common.h"
+
+// mi-units (8x8) per 64x64 superblock.
+#define MI_BLOCK_SIZE 8
+
+static int
+clamp (int value, int low, int high)
+{
+  return value < low ? low : (value > high ? high : value);
+}
+
+CYCLIC_REFRESH *brc_libvpx_vp9_cyclic_refresh_alloc(int mi_rows, int mi_cols) {
+  CYCLIC_REFRESH *const cr = calloc(1, sizeof(*cr));
+  if (cr == NULL) return NULL;
+
+  cr->seg_map = calloc(mi_rows * mi_cols, sizeof(*cr->seg_map));
+  if (cr->seg_map == NULL) {
+    brc_libvpx_vp9_cyclic_refresh_free(cr);
+    return NULL;
+  }
+  cr->map_mi_rows = mi_rows;
+  cr->map_mi_cols = mi_cols;
+  return cr;
+}
+
+void brc_libvpx_vp9_cyclic_refresh_free(CYCLIC_REFRESH *cr) {
+  if (cr != NULL) {
+    free(cr->seg_map);
+    free(cr);
+  }
+}
+
+static int is_lossless_requested(const VP9EncoderConfig *cfg) {
+  return cfg->best_allowed_q == 0 && cfg->worst_allowed_q == 0;
+}
+
+// Compute delta-q for the segment.
+static int compute_deltaq(const VP9_COMP *cpi, int q, double rate_factor) {
+  const CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  int deltaq = brc_libvpx_vp9_compute_qdelta_by_rate(
+      cpi, cpi->common.frame_type, q, rate_factor);
+  if ((-deltaq) > cr->max_qdelta_perc * q / 100) {
+    deltaq = -cr->max_qdelta_perc * q / 100;
+  }
+  return deltaq;
+}
+
+// For the just encoded frame, estimate the bits, incorporating the delta-q
+// from non-base segment. For now ignore effect of multiple segments
+// (with different delta-q). Note this function is called in the postencode
+// (called from rc_update_rate_correction_factors()).
+int brc_libvpx_vp9_cyclic_refresh_estimate_bits_at_q(
+    const VP9_COMP *cpi, double correction_factor) {
+  const VP9_COMMON *const cm = &cpi->common;
+  const CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  int estimated_bits;
+  int mbs = cm->MBs;
+  int num8x8bl = mbs << 2;
+  // Weight for non-base segments: use actual number of blocks refreshed in
+  // previous/just encoded frame. Note number of blocks here is in 8x8 units.
+  double weight_segment1 = (double)cr->actual_num_seg1_blocks / num8x8bl;
+  double weight_segment2 = (double)cr->actual_num_seg2_blocks / num8x8bl;
+  // Take segment weighted average for estimated bits.
+  estimated_bits =
+      (int)((1.0 - weight_segment1 - weight_segment2) *
+                brc_libvpx_vp9_estimate_bits_at_q(cm->frame_type,
+                                                  cm->base_qindex, mbs,
+                                                  correction_factor,
+                                                  cm->bit_depth) +
+            weight_segment1 *
+                brc_libvpx_vp9_estimate_bits_at_q(
+                    cm->frame_type, cm->base_qindex + cr->qindex_delta[1],
+                    mbs, correction_factor, cm->bit_depth) +
+            weight_segment2 *
+                brc_libvpx_vp9_estimate_bits_at_q(
+                    cm->frame_type, cm->base_qindex + cr->qindex_delta[2],
+                    mbs, correction_factor, cm->bit_depth));
+  return estimated_bits;
+}
+
+// Prior to encoding the frame, estimate the bits per mb, for a given q = i and
+// a corresponding delta-q (for segment 1), from the bits per mb of the frame
+// at each q. This function is called in the
+// rc_regulate_q() to set the base qp index.
+// Note: the segment map is set to either 0/CR_SEGMENT_ID_BASE (no refresh) or
+// to 1/CR_SEGMENT_ID_BOOST1 (refresh) for each superblock, prior to encoding.
+int brc_libvpx_vp9_cyclic_refresh_rc_bits_per_mb(const VP9_COMP *cpi, int i,
+                                                 const int *bits_per_mb) {
+  CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  int deltaq = compute_deltaq(cpi, i, cr->rate_ratio_qdelta);
+  // Take segment weighted average for bits per mb.
+  return (int)((1.0 - cr->weight_segment) * bits_per_mb[i] +
+               cr->weight_segment * bits_per_mb[i + deltaq]);
+}
+
+// Update the segmentation map, and related quantities: cycle through the
+// superblocks, starting at cr->sb_index, and mark them for refresh until
+// the target number of blocks for the frame is reached.
+// There is no per-block feedback (coding mode, last coded q) from the
+// encoder, so every block in the selected superblocks is a refresh
+// candidate, and the map is assumed to be applied as-is by the encoder.
+static void cyclic_refresh_update_map(VP9_COMP *const cpi) {
+  VP9_COMMON *const cm = &cpi->common;
+  CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  uint8_t *const seg_map = cr->seg_map;
+  int i, block_count, bl_index, sb_rows, sb_cols, sbs_in_frame;
+  int xmis, ymis, x, y;
+  memset(seg_map, CR_SEGMENT_ID_BASE, cm->mi_rows * cm->mi_cols);
+  sb_cols = (cm->mi_cols + MI_BLOCK_SIZE - 1) / MI_BLOCK_SIZE;
+  sb_rows = (cm->mi_rows + MI_BLOCK_SIZE - 1) / MI_BLOCK_SIZE;
+  sbs_in_frame = sb_cols * sb_rows;
+  // Number of target blocks to get the q delta (segment 1).
+  block_count = cr->percent_refresh * cm->mi_rows * cm->mi_cols / 100;
+  // Set the segmentation map: cycle through the superblocks, starting at
+  // cr->sb_index, and stopping when either block_count blocks have been found
+  // to be refreshed, or we have passed through whole frame.
+  if (cr->sb_index >= sbs_in_frame) cr->sb_index = 0;
+  assert(cr->sb_index < sbs_in_frame);
+  i = cr->sb_index;
+  cr->target_num_seg_blocks = 0;
+  do {
+    // Get the mi_row/mi_col corresponding to superblock index i.
+    int sb_row_index = (i / sb_cols);
+    int sb_col_index = i - sb_row_index * sb_cols;
+    int mi_row = sb_row_index * MI_BLOCK_SIZE;
+    int mi_col = sb_col_index * MI_BLOCK_SIZE;
+    assert(mi_row >= 0 && mi_row < cm->mi_rows);
+    assert(mi_col >= 0 && mi_col < cm->mi_cols);
+    bl_index = mi_row * cm->mi_cols + mi_col;
+    // Loop through all 8x8 blocks in superblock and update map.
+    xmis = VPXMIN(cm->mi_cols - mi_col, MI_BLOCK_SIZE);
+    ymis = VPXMIN(cm->mi_rows - mi_row, MI_BLOCK_SIZE);
+    for (y = 0; y < ymis; y++) {
+      for (x = 0; x < xmis; x++) {
+        seg_map[bl_index + y * cm->mi_cols + x] = CR_SEGMENT_ID_BOOST1;
+      }
+    }
+    cr->target_num_seg_blocks += xmis * ymis;
+    i++;
+    if (i == sbs_in_frame) {
+      i = 0;
+    }
+  } while (cr->target_num_seg_blocks < block_count && i != cr->sb_index);
+  cr->sb_index = i;
+  // The encoder applies the map as-is, so the actual number of refreshed
+  // blocks is the target.
+  cr->actual_num_seg1_blocks = cr->target_num_seg_blocks;
+  cr->actual_num_seg2_blocks = 0;
+}
+
+// Set cyclic refresh parameters.
+void brc_libvpx_vp9_cyclic_refresh_update_parameters(VP9_COMP *const cpi) {
+  const RATE_CONTROL *const rc = cpi->rc;
+  const VP9_COMMON *const cm = &cpi->common;
+  CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+  int num8x8bl = cm->MBs << 2;
+  int target_refresh = 0;
+  double weight_segment_target = 0;
+  double weight_segment = 0;
+  int qp_thresh = VPXMIN(
+      (cpi->oxcf.content == VP9E_CONTENT_SCREEN) ? 35 : 20,
+      rc->best_quality << 1);
+  int qp_max_thresh = 117 * MAXQ >> 7;
+  cr->apply_cyclic_refresh = 1;
+  // Note: libvpx also disables the refresh on low motion content, the
+  // motion statistics are not available here.
+  // The regions of interest take precedence over the cyclic refresh.
+  if (brc_libvpx_vp9_frame_is_intra_only(cm) || cpi->roi.apply ||
+      cpi->svc.temporal_layer_id > 0 || is_lossless_requested(&cpi->oxcf) ||
+      rc->avg_frame_qindex[INTER_FRAME] < qp_thresh ||
+      (cpi->use_svc &&
+       cpi->svc.layer_context[cpi->svc.temporal_layer_id].is_key_frame) ||
+      (!cpi->use_svc && rc->avg_frame_qindex[INTER_FRAME] > qp_max_thresh &&
+       rc->frames_since_key > 20)) {
+    cr->apply_cyclic_refresh = 0;
+    return;
+  }
+  cr->percent_refresh = 10;
+  cr->max_qdelta_perc = 60;
+  cr->rate_boost_fac = 15;
+  // Use larger delta-qp (increase rate_ratio_qdelta) for first few (~4)
+  // periods of the refresh cycle, after a key frame.
+  // Account for larger interval on base layer for temporal layers.
+  if (cr->percent_refresh > 0 &&
+      rc->frames_since_key <
+          (4 * cpi->svc.number_temporal_layers) * (100 / cr->percent_refresh)) {
+    cr->rate_ratio_qdelta = 3.0;
+  } else {
+    cr->rate_ratio_qdelta = 2.0;
+  }
+  // For screen-content: keep rate_ratio_qdelta to 2.0 (segment#1 boost) and
+  // percent_refresh (refresh rate) to 10. But reduce rate boost for segment#2
+  // (rate_boost_fac = 10 disables segment#2).
+  if (cpi->oxcf.content == VP9E_CONTENT_SCREEN) {
+    cr->percent_refresh = 10;
+    cr->rate_ratio_qdelta = 2.0;
+    cr->rate_boost_fac = 10;
+  }
+  // Adjust some parameters for low resolutions.
+  if (cm->width * cm->height <= 352 * 288) {
+    if (rc->avg_frame_bandwidth < 3000) {
+      cr->rate_boost_fac = 13;
+    } else {
+      cr->max_qdelta_perc = 70;
+      cr->rate_ratio_qdelta = VPXMAX(cr->rate_ratio_qdelta, 2.5);
+    }
+  }
+  // Weight for segment prior to encoding: take the average of the target
+  // number for the frame to be encoded and the actual from the previous frame.
+  // Use the target if its less. To be used for setting the base qp for the
+  // frame in vp9_rc_regulate_q.
+  target_refresh = cr->percent_refresh * cm->mi_rows * cm->mi_cols / 100;
+  weight_segment_target = (double)(target_refresh) / num8x8bl;
+  weight_segment = (double)((target_refresh + cr->actual_num_seg1_blocks +
+                             cr->actual_num_seg2_blocks) >>
+                            1) /
+                   num8x8bl;
+  if (weight_segment_target < 7 * weight_segment / 8)
+    weight_segment = weight_segment_target;
+  cr->weight_segment = weight_segment;
+}
+
+// Setup cyclic background refresh: set delta q and segmentation map.
+void brc_libvpx_vp9_cyclic_refresh_setup(VP9_COMP *const cpi) {
+  VP9_COMMON *const cm = &cpi->common;
+  CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+
+  if (!cr->apply_cyclic_refresh) {
+    // Set segmentation map to 0 and disable.
+    memset(cr->seg_map, 0, cm->mi_rows * cm->mi_cols);
+    cr->qindex_delta[1] = 0;
+    cr->qindex_delta[2] = 0;
+    cr->actual_num_seg1_blocks = 0;
+    cr->actual_num_seg2_blocks = 0;
+    if (cm->frame_type == KEY_FRAME) cr->sb_index = 0;
+    return;
+  } else {
+    int qindex_delta = 0;
+
+    // Segment BASE "Normal" has no q delta.
+    cr->qindex_delta[0] = 0;
+
+    // Set the q delta for segment BOOST1.
+    qindex_delta = compute_deltaq(cpi, cm->base_qindex, cr->rate_ratio_qdelta);
+    cr->qindex_delta[1] =
+        clamp(cm->base_qindex + qindex_delta, 0, MAXQ) - cm->base_qindex;
+
+    // Set a more aggressive (higher) q delta for segment BOOST2.
+    qindex_delta = compute_deltaq(
+        cpi, cm->base_qindex,
+        VPXMIN(CR_MAX_RATE_TARGET_RATIO,
+               0.1 * cr->rate_boost_fac * cr->rate_ratio_qdelta));
+    cr->qindex_delta[2] =
+        clamp(cm->base_qindex + qindex_delta, 0, MAXQ) - cm->base_qindex;
+
+    // Update the segmentation and refresh map.
+    cyclic_refresh_update_map(cpi);
+  }
+}
@@ -0,0 +1,75 @@
+/*
+ *  Copyright (c) 2014 The WebM project authors. All Rights Reserved.
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef VPX_VP9_ENCODER_VP9_AQ_CYCLICREFRESH_H_
+#define VPX_VP9_ENCODER_VP9_AQ_CYCLICREFRESH_H_
+
+#include "libvpx_vp9_ratectrl.h"
+
+// The segment ids used in cyclic refresh: from base (no boost) to increasing
+// boost (higher delta-qp).
+#define CR_SEGMENT_ID_BASE 0
+#define CR_SEGMENT_ID_BOOST1 1
+#define CR_SEGMENT_ID_BOOST2 2
+
+// Maximum rate target ratio for setting segment delta-qp.
+#define CR_MAX_RATE_TARGET_RATIO 4.0
+
+typedef struct CYCLIC_REFRESH {
+  // Percentage of blocks per frame that are targeted as candidates
+  // for cyclic refresh.
+  int percent_refresh;
+  // Maximum q-delta as percentage of base q.
+  int max_qdelta_perc;
+  // Superblock starting index for cycling through the frame.
+  int sb_index;
+  // Target number of (8x8) blocks that are set for delta-q.
+  int target_num_seg_blocks;
+  // Actual number of (8x8) blocks that were applied delta-q.
+  int actual_num_seg1_blocks;
+  int actual_num_seg2_blocks;
+  // Segment map of the current frame, one entry per 8x8 block.
+  uint8_t *seg_map;
+  // Allocated size of the segment map, in mi units.
+  int map_mi_rows;
+  int map_mi_cols;
+  double rate_ratio_qdelta;
+  int rate_boost_fac;
+  int qindex_delta[3];
+  double weight_segment;
+  int apply_cyclic_refresh;
+} CYCLIC_REFRESH;
+
+struct VP9_COMP;
+
+CYCLIC_REFRESH *brc_libvpx_vp9_cyclic_refresh_alloc(int mi_rows, int mi_cols);
+
+void brc_libvpx_vp9_cyclic_refresh_free(CYCLIC_REFRESH *cr);
+
+// Estimate the bits, incorporating the delta-q from segment 1, after encoding
+// the frame.
+int brc_libvpx_vp9_cyclic_refresh_estimate_bits_at_q(
+    const struct VP9_COMP *cpi, double correction_factor);
+
+// Estimate the bits per mb, for a given q = i and a corresponding delta-q
+// (for segment 1), prior to encoding the frame, from the bits per mb of the
+// frame at each q.
+int brc_libvpx_vp9_cyclic_refresh_rc_bits_per_mb(const struct VP9_COMP *cpi,
+                                                 int i,
+                                                 const int *bits_per_mb);
+
+// Update the parameters for cyclic refresh, prior to picking the frame q.
+void brc_libvpx_vp9_cyclic_refresh_update_parameters(struct VP9_COMP *const cpi);
+
+// Setup cyclic background refresh: set delta q and segmentation map.
+void brc_libvpx_vp9_cyclic_refresh_setup(struct VP9_COMP *const cpi);
+
+#endif  // VPX_VP9_ENCODER_VP9_AQ_CYCLICREFRESH_H_
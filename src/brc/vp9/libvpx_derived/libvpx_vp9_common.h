@@ -13,9 +13,12 @@
 #define VPX_VP9_ENCODER_VP9_ENCODER_H_
 
 #include <stdio.h>
+#include "../../common/brc_ratectrl.h"
 #include "libvpx_vp9_ratectrl.h"
 #include "libvpx_vp9_svc_layercontext.h"
 #include "libvpx_vp9_picklpf.h"
+#include "libvpx_vp9_aq_cyclicrefresh.h"
+#include "libvpx_vp9_roi.h"
 
 #define INVALID_IDX (-1)  // Invalid buffer index.
 
@@ -24,6 +27,8 @@ typedef struct VP9EncoderConfig {
   unsigned int rc_max_intra_bitrate_pct;
   // maximum allowed bitrate for any inter frame in % of bitrate target.
   unsigned int rc_max_inter_bitrate_pct;
+  // percent of rate boost for golden frame in CBR mode.
+  unsigned int gf_cbr_boost_pct;
   vp9e_tune_content content; //NotReq
   // Frame drop threshold.
   int drop_frames_water_mark; //NotReq
@@ -123,36 +128,43 @@ typedef struct SPEED_FEATURES {
   int use_nonrd_pick_mode;
 } SPEED_FEATURES;
 
+// The state read and written by every frame comes first, the frame header
+// and the rate control, then the configuration. The large and rarely used
+// parts, the layer contexts and the regions of interest, come last.
 typedef struct VP9_COMP {
   VP9_COMMON common;
-  VP9EncoderConfig oxcf;
-  RATE_CONTROL rc;
-
-  LevelConstraint level_constraint;
-  unsigned int target_level;
+  // The rate control of the frame being coded: stream_rc, or the context of
+  // the current layer of a layered stream, used in place without a copy.
+  RATE_CONTROL *rc;
+  RATE_CONTROL stream_rc;
 
   int refresh_golden_frame;
 
-  // If the last frame is dropped, we don't copy partition.
-  uint8_t last_frame_dropped;
+  // The source of the current frame is the same as the previous one.
+  int frame_unchanged;
 
-  int ext_refresh_frame_flags_pending;
+  int use_svc;
 
-  uint8_t *count_arf_frame_usage;
-  uint8_t *count_lastgolden_frame_usage;
+  SPEED_FEATURES sf;
 
   double framerate;
-  int frame_flags;
 
-  int lst_fb_idx;
-  int gld_fb_idx;
-  int alt_fb_idx;
+  // Cyclic refresh (aq-mode=3) state, allocated only when enabled.
+  CYCLIC_REFRESH *cyclic_refresh;
 
-  int use_svc;
-  SVC svc;
+  VP9EncoderConfig oxcf;
 
-  SPEED_FEATURES sf;
+  // Rate model of each frame type at the bit depth, shared by the
+  // controllers of the bit depth.
+  const BrcRcRateCurve *rate_curve;
+
+  unsigned int target_level;
 
   int external_resize;
+
+  SVC svc;
+
+  // Regions of interest of each spatial layer, and their current frame map.
+  BrcRoi roi;
 } VP9_COMP;
 #endif
@@ -61,9 +61,9 @@ void brc_vp9_pick_filter_level(VP9_COMP *cpi,
 #endif
     int filt_guess = ROUND_POWER_OF_TWO(q * 20723 + 1015158, 18);
 
-    //Fixme: no infra available to communicate the segmentation info
     if (cpi->oxcf.pass == 0 && cpi->oxcf.rc_mode == VPX_CBR &&
-        cpi->oxcf.aq_mode == CYCLIC_REFRESH_AQ && /*cm->seg.enabled && */
+        cpi->oxcf.aq_mode == CYCLIC_REFRESH_AQ &&
+        cpi->cyclic_refresh->apply_cyclic_refresh &&
         (cm->base_qindex < 200 || cm->width * cm->height > 320 * 240) &&
         cpi->oxcf.content != VP9E_CONTENT_SCREEN && cm->frame_type != KEY_FRAME)
       filt_guess = 5 * filt_guess >> 3;
@@ -10,9 +10,12 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <pthread.h>
+
 #include "libvpx_vp9_ratectrl.h"
 #include "libvpx_vp9_svc_layercontext.h"
 #include "libvpx_vp9_common.h"
+#include "../../common/brc_ratectrl.h"
 
 #define ASSIGN_MINQ_TABLE(bit_depth, name)       \
   do {                                           \
@@ -47,111 +50,6 @@ static const Vp9LevelSpec vp9_level_defs[VP9_LEVELS] = {
   { LEVEL_6_2, 4706009088u, 35651584, 16832, 480000, 360000, 8, 16, 10, 4 },
 };
 
-static const int16_t ac_qlookup[QINDEX_RANGE] = {
-  4, 8, 9, 10, 11, 12, 13, 14,
-  15, 16, 17, 18, 19, 20, 21, 22,
-  23, 24, 25, 26, 27, 28, 29, 30,
-  31, 32, 33, 34, 35, 36, 37, 38,
-  39, 40, 41, 42, 43, 44, 45, 46,
-  47, 48, 49, 50, 51, 52, 53, 54,
-  55, 56, 57, 58, 59, 60, 61, 62,
-  63, 64, 65, 66, 67, 68, 69, 70,
-  71, 72, 73, 74, 75, 76, 77, 78,
-  79, 80, 81, 82, 83, 84, 85, 86,
-  87, 88, 89, 90, 91, 92, 93, 94,
-  95, 96, 97, 98, 99, 100, 101, 102,
-  104, 106, 108, 110, 112, 114, 116, 118,
-  120, 122, 124, 126, 128, 130, 132, 134,
-  136, 138, 140, 142, 144, 146, 148, 150,
-  152, 155, 158, 161, 164, 167, 170, 173,
-  176, 179, 182, 185, 188, 191, 194, 197,
-  200, 203, 207, 211, 215, 219, 223, 227,
-  231, 235, 239, 243, 247, 251, 255, 260,
-  265, 270, 275, 280, 285, 290, 295, 300,
-  305, 311, 317, 323, 329, 335, 341, 347,
-  353, 359, 366, 373, 380, 387, 394, 401,
-  408, 416, 424, 432, 440, 448, 456, 465,
-  474, 483, 492, 501, 510, 520, 530, 540,
-  550, 560, 571, 582, 593, 604, 615, 627,
-  639, 651, 663, 676, 689, 702, 715, 729,
-  743, 757, 771, 786, 801, 816, 832, 848,
-  864, 881, 898, 915, 933, 951, 969, 988,
-  1007, 1026, 1046, 1066, 1087, 1108, 1129, 1151,
-  1173, 1196, 1219, 1243, 1267, 1292, 1317, 1343,
-  1369, 1396, 1423, 1451, 1479, 1508, 1537, 1567,
-  1597, 1628, 1660, 1692, 1725, 1759, 1793, 1828,
-};
-
-static const int16_t ac_qlookup_10[QINDEX_RANGE] = {
-  4, 9, 11, 13, 16, 18, 21, 24,
-  27, 30, 33, 37, 40, 44, 48, 51,
-  55, 59, 63, 67, 71, 75, 79, 83,
-  88, 92, 96, 100, 105, 109, 114, 118,
-  122, 127, 131, 136, 140, 145, 149, 154,
-  158, 163, 168, 172, 177, 181, 186, 190,
-  195, 199, 204, 208, 213, 217, 222, 226,
-  231, 235, 240, 244, 249, 253, 258, 262,
-  267, 271, 275, 280, 284, 289, 293, 297,
-  302, 306, 311, 315, 319, 324, 328, 332,
-  337, 341, 345, 349, 354, 358, 362, 367,
-  371, 375, 379, 384, 388, 392, 396, 401,
-  409, 417, 425, 433, 441, 449, 458, 466,
-  474, 482, 490, 498, 506, 514, 523, 531,
-  539, 547, 555, 563, 571, 579, 588, 596,
-  604, 616, 628, 640, 652, 664, 676, 688,
-  700, 713, 725, 737, 749, 761, 773, 785,
-  797, 809, 825, 841, 857, 873, 889, 905,
-  922, 938, 954, 970, 986, 1002, 1018, 1038,
-  1058, 1078, 1098, 1118, 1138, 1158, 1178, 1198,
-  1218, 1242, 1266, 1290, 1314, 1338, 1362, 1386,
-  1411, 1435, 1463, 1491, 1519, 1547, 1575, 1603,
-  1631, 1663, 1695, 1727, 1759, 1791, 1823, 1859,
-  1895, 1931, 1967, 2003, 2039, 2079, 2119, 2159,
-  2199, 2239, 2283, 2327, 2371, 2415, 2459, 2507,
-  2555, 2603, 2651, 2703, 2755, 2807, 2859, 2915,
-  2971, 3027, 3083, 3143, 3203, 3263, 3327, 3391,
-  3455, 3523, 3591, 3659, 3731, 3803, 3876, 3952,
-  4028, 4104, 4184, 4264, 4348, 4432, 4516, 4604,
-  4692, 4784, 4876, 4972, 5068, 5168, 5268, 5372,
-  5476, 5584, 5692, 5804, 5916, 6032, 6148, 6268,
-  6388, 6512, 6640, 6768, 6900, 7036, 7172, 7312,
-};
-
-static const int16_t ac_qlookup_12[QINDEX_RANGE] = {
-  4, 13, 19, 27, 35, 44, 54, 64,
-  75, 87, 99, 112, 126, 139, 154, 168,
-  183, 199, 214, 230, 247, 263, 280, 297,
-  314, 331, 349, 366, 384, 402, 420, 438,
-  456, 475, 493, 511, 530, 548, 567, 586,
-  604, 623, 642, 660, 679, 698, 716, 735,
-  753, 772, 791, 809, 828, 846, 865, 884,
-  902, 920, 939, 957, 976, 994, 1012, 1030,
-  1049, 1067, 1085, 1103, 1121, 1139, 1157, 1175,
-  1193, 1211, 1229, 1246, 1264, 1282, 1299, 1317,
-  1335, 1352, 1370, 1387, 1405, 1422, 1440, 1457,
-  1474, 1491, 1509, 1526, 1543, 1560, 1577, 1595,
-  1627, 1660, 1693, 1725, 1758, 1791, 1824, 1856,
-  1889, 1922, 1954, 1987, 2020, 2052, 2085, 2118,
-  2150, 2183, 2216, 2248, 2281, 2313, 2346, 2378,
-  2411, 2459, 2508, 2556, 2605, 2653, 2701, 2750,
-  2798, 2847, 2895, 2943, 2992, 3040, 3088, 3137,
-  3185, 3234, 3298, 3362, 3426, 3491, 3555, 3619,
-  3684, 3748, 3812, 3876, 3941, 4005, 4069, 4149,
-  4230, 4310, 4390, 4470, 4550, 4631, 4711, 4791,
-  4871, 4967, 5064, 5160, 5256, 5352, 5448, 5544,
-  5641, 5737, 5849, 5961, 6073, 6185, 6297, 6410,
-  6522, 6650, 6778, 6906, 7034, 7162, 7290, 7435,
-  7579, 7723, 7867, 8011, 8155, 8315, 8475, 8635,
-  8795, 8956, 9132, 9308, 9484, 9660, 9836, 10028,
-  10220, 10412, 10604, 10812, 11020, 11228, 11437, 11661,
-  11885, 12109, 12333, 12573, 12813, 13053, 13309, 13565,
-  13821, 14093, 14365, 14637, 14925, 15213, 15502, 15806,
-  16110, 16414, 16734, 17054, 17390, 17726, 18062, 18414,
-  18766, 19134, 19502, 19886, 20270, 20670, 21070, 21486,
-  21902, 22334, 22766, 23214, 23662, 24126, 24590, 25070,
-  25551, 26047, 26559, 27071, 27599, 28143, 28687, 29247,
-};
-
 static int vp9_compute_qdelta(const RATE_CONTROL *rc,
     double qstart, double qtarget, vpx_bit_depth_t bit_depth);
 
@@ -164,19 +62,7 @@ clamp (int value, int low, int high)
 int16_t
 brc_libvpx_vp9_ac_quant (int qindex, int delta, int bit_depth)
 {
-  const uint8_t q_table_idx = clamp (qindex + delta, 0, MAXQ);
-
-  switch (bit_depth) {
-    case 8:
-      return ac_qlookup[q_table_idx];
-    case 10:
-      return ac_qlookup_10[q_table_idx];
-    case 12:
-      return ac_qlookup_12[q_table_idx];
-    default:
-      return -1;
-  }
-  return -1;
+  return brc_rc_ac_quant (qindex, delta, bit_depth);
 }
 
 #define INLINE inline
@@ -232,10 +118,26 @@ static void vp9_set_mb_size(int *mb_rows, int *mb_cols, int *mb_num, int mi_rows
   *mb_num = (*mb_rows) * (*mb_cols);
 } 
 
-void brc_libvpx_vp9_set_mb_mi(VP9_COMMON *cm, int width, int height) {
-  vp9_set_mi_size(&cm->mi_rows, &cm->mi_cols, &cm->mi_stride, width, height);
-  vp9_set_mb_size(&cm->mb_rows, &cm->mb_cols, &cm->MBs, cm->mi_rows,
-                  cm->mi_cols); 
+void brc_libvpx_vp9_calc_frame_geometry(FRAME_GEOMETRY *geometry, int width,
+                                        int height) {
+  geometry->width = width;
+  geometry->height = height;
+  vp9_set_mi_size(&geometry->mi_rows, &geometry->mi_cols, &geometry->mi_stride,
+                  width, height);
+  vp9_set_mb_size(&geometry->mb_rows, &geometry->mb_cols, &geometry->MBs,
+                  geometry->mi_rows, geometry->mi_cols);
+}
+
+void brc_libvpx_vp9_set_frame_geometry(VP9_COMMON *cm,
+                                       const FRAME_GEOMETRY *geometry) {
+  cm->width = geometry->width;
+  cm->height = geometry->height;
+  cm->mi_rows = geometry->mi_rows;
+  cm->mi_cols = geometry->mi_cols;
+  cm->mi_stride = geometry->mi_stride;
+  cm->mb_rows = geometry->mb_rows;
+  cm->mb_cols = geometry->mb_cols;
+  cm->MBs = geometry->MBs;
 }
 
 // Table that converts 0-63 Q-range values passed in outside to the Qindex
@@ -273,6 +175,8 @@ static int arfgf_high_motion_minq_12[QINDEX_RANGE];
 static int inter_minq_12[QINDEX_RANGE];
 static int rtc_minq_12[QINDEX_RANGE];
 
+static int gf_high = 2000;
+static int gf_low = 400;
 static int kf_high = 4800;
 static int kf_low = 300;
 
@@ -299,7 +203,7 @@ void brc_libvpx_vp9_set_rc_buffer_sizes(RATE_CONTROL *rc,
 }
 
 void brc_libvpx_vp9_check_reset_rc_flag(VP9_COMP *cpi) {
-  RATE_CONTROL *rc = &cpi->rc;
+  RATE_CONTROL *rc = cpi->rc;
 
   if (cpi->common.current_video_frame >
       (unsigned int)cpi->svc.number_spatial_layers) {
@@ -321,7 +225,7 @@ void brc_libvpx_vp9_check_reset_rc_flag(VP9_COMP *cpi) {
 
 void brc_libvpx_vp9_change_config(struct VP9_COMP *cpi, const VP9EncoderConfig *oxcf) {
   VP9_COMMON *const cm = &cpi->common;
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
   int last_w = cpi->oxcf.width;
   int last_h = cpi->oxcf.height;
 
@@ -371,34 +275,15 @@ void brc_libvpx_vp9_change_config(struct VP9_COMP *cpi, const VP9EncoderConfig *
 // quantizer tables easier. If necessary they can be replaced by lookup
 // tables if and when things settle down in the experimental bitstream
 static double vp9_convert_qindex_to_q(int qindex, vpx_bit_depth_t bit_depth) {
-// Convert the index to a real Q value (scaled down to match old Q values)
-  switch (bit_depth) {
-    case VPX_BITS_8: return brc_libvpx_vp9_ac_quant(qindex, 0, bit_depth) / 4.0;
-    case VPX_BITS_10: return brc_libvpx_vp9_ac_quant(qindex, 0, bit_depth) / 16.0;
-    default:
-      //assert(bit_depth == VPX_BITS_12);
-      return brc_libvpx_vp9_ac_quant(qindex, 0, bit_depth) / 64.0;
-  }
+  // Convert the index to a real Q value (scaled down to match old Q values)
+  return brc_rc_convert_qindex_to_q(qindex, bit_depth);
 }
 
 // Functions to compute the active minq lookup table entries based on a
 // formulaic approach to facilitate easier adjustment of the Q tables.
-// The formulae were derived from computing a 3rd order polynomial best
-// fit to the original data (after plotting real maxq vs minq (not q index))
 static int get_minq_index(double maxq, double x3, double x2, double x1,
                           vpx_bit_depth_t bit_depth) {
-  int i;
-  const double minqtarget = VPXMIN(((x3 * maxq + x2) * maxq + x1) * maxq, maxq);
-
-  // Special case handling to deal with the step from q2.0
-  // down to lossless mode represented by q 1.0.
-  if (minqtarget <= 2.0) return 0;
-
-  for (i = 0; i < QINDEX_RANGE; i++) {
-    if (minqtarget <= vp9_convert_qindex_to_q(i, bit_depth)) return i;
-  }
-
-  return QINDEX_RANGE - 1;
+  return brc_rc_get_minq_index(maxq, x3, x2, x1, bit_depth);
 }
 
 static void init_minq_luts(int *kf_low_m, int *kf_high_m, int *arfgf_low,
@@ -416,7 +301,9 @@ static void init_minq_luts(int *kf_low_m, int *kf_high_m, int *arfgf_low,
   }
 }
 
-void brc_libvpx_vp9_rc_init_minq_luts(void) {
+static pthread_once_t minq_luts_once = PTHREAD_ONCE_INIT;
+
+static void build_minq_luts(void) {
   init_minq_luts(kf_low_motion_minq_8, kf_high_motion_minq_8,
                  arfgf_low_motion_minq_8, arfgf_high_motion_minq_8,
                  inter_minq_8, rtc_minq_8, VPX_BITS_8);
@@ -428,30 +315,84 @@ void brc_libvpx_vp9_rc_init_minq_luts(void) {
                  inter_minq_12, rtc_minq_12, VPX_BITS_12);
 }
 
-static int vp9_rc_bits_per_mb(FRAME_TYPE frame_type, int qindex,
-                       double correction_factor, vpx_bit_depth_t bit_depth) {
-  const double q = vp9_convert_qindex_to_q(qindex, bit_depth);
+void brc_libvpx_vp9_rc_init_minq_luts(void) {
+  pthread_once(&minq_luts_once, build_minq_luts);
+}
+
+// Bits per block of the rate model at qindex are
+// numerator * correction_factor / denominator.
+static void rate_model(FRAME_TYPE frame_type, int qindex,
+                       vpx_bit_depth_t bit_depth, int32_t *numerator,
+                       int32_t *denominator) {
+  // q is ac_quant / q_scale.
+  const int ac_quant = brc_libvpx_vp9_ac_quant(qindex, 0, bit_depth);
+  const int q_scale = brc_rc_q_scale(bit_depth);
   int enumerator = frame_type == KEY_FRAME ? 2700000 : 1800000;
 
+  // q based adjustment to baseline enumerator
+  enumerator += (int)((int64_t)enumerator * ac_quant / q_scale) >> 12;
+  *numerator = enumerator * q_scale;
+  *denominator = ac_quant;
+}
+
+int brc_libvpx_vp9_rc_bits_per_mb(FRAME_TYPE frame_type, int qindex,
+                       double correction_factor, vpx_bit_depth_t bit_depth) {
+  int32_t numerator, denominator;
+
   assert(correction_factor <= MAX_BPB_FACTOR &&
          correction_factor >= MIN_BPB_FACTOR);
 
-  // q based adjustment to baseline enumerator
-  enumerator += (int)(enumerator * q) >> 12;
-  return (int)(enumerator * correction_factor / q);
+  rate_model(frame_type, qindex, bit_depth, &numerator, &denominator);
+  return brc_rc_model_bits_per_mb(numerator, denominator, 0,
+                                  correction_factor);
+}
+
+// The rate curves only depend on the bit depth: all the controllers of a
+// bit depth share them, instead of 6 KB of copies in each VP9_COMP. The
+// controllers may be created from several threads, the curves of the 8, 10
+// and 12 bits are built once for the process.
+static BrcRcRateCurve rate_curves[3][FRAME_TYPES];
+static pthread_once_t rate_curves_once = PTHREAD_ONCE_INIT;
+
+static void build_rate_curves(void) {
+  int depth_index, frame_type, qindex;
+
+  for (depth_index = 0; depth_index < 3; depth_index++) {
+    const vpx_bit_depth_t bit_depth =
+        (vpx_bit_depth_t)(VPX_BITS_8 + 2 * depth_index);
+    for (frame_type = 0; frame_type < FRAME_TYPES; frame_type++) {
+      BrcRcRateCurve *curve = &rate_curves[depth_index][frame_type];
+      for (qindex = 0; qindex < QINDEX_RANGE; qindex++)
+        rate_model((FRAME_TYPE)frame_type, qindex, bit_depth,
+                   &curve->numerator[qindex], &curve->denominator[qindex]);
+      curve->num_q = QINDEX_RANGE;
+      curve->round = 0;
+      brc_rc_init_rate_curve(curve);
+    }
+  }
 }
 
-static int vp9_estimate_bits_at_q(FRAME_TYPE frame_type, int q, int mbs,
+void brc_libvpx_vp9_rc_init_rate_curves(VP9_COMP *cpi) {
+  // 8, 10 and 12 bits.
+  const int depth_index = (cpi->common.bit_depth - VPX_BITS_8) / 2;
+
+  assert(depth_index >= 0 && depth_index < 3);
+  pthread_once(&rate_curves_once, build_rate_curves);
+  cpi->rate_curve = rate_curves[depth_index];
+}
+
+int brc_libvpx_vp9_estimate_bits_at_q(FRAME_TYPE frame_type, int q, int mbs,
                            double correction_factor,
                            vpx_bit_depth_t bit_depth) {
   const int bpm =
-      (int)(vp9_rc_bits_per_mb(frame_type, q, correction_factor, bit_depth));
+      (int)(brc_libvpx_vp9_rc_bits_per_mb(frame_type, q, correction_factor,
+                                          bit_depth));
   return VPXMAX(FRAME_OVERHEAD_BITS,
                 (int)(((int64_t)bpm * mbs) >> BPER_MB_NORMBITS));
 }
 
 static int vp9_rc_clamp_iframe_target_size(const VP9_COMP *const cpi, int target) {
-  const RATE_CONTROL *rc = &cpi->rc;
+  const RATE_CONTROL *rc = cpi->rc;
   const VP9EncoderConfig *oxcf = &cpi->oxcf;
   if (oxcf->rc_max_intra_bitrate_pct) {
     const int max_rate =
@@ -467,7 +408,7 @@ static int vp9_rc_clamp_iframe_target_size(const VP9_COMP *const cpi, int target
 // of these (i.e., bits_off_target).
 // Update the buffer level before encoding with the per-frame-bandwidth,
 void brc_libvpx_update_buffer_level_preencode(VP9_COMP *cpi) {
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
   rc->bits_off_target += rc->avg_frame_bandwidth;
   // Clip the buffer level to the maximum specified buffer size.
   rc->bits_off_target = VPXMIN(rc->bits_off_target, rc->maximum_buffer_size);
@@ -493,8 +434,8 @@ static void update_buffer_level_svc_preencode(VP9_COMP *cpi) {
         VPXMIN(lrc->bits_off_target, lrc->maximum_buffer_size);
     lrc->buffer_level = lrc->bits_off_target;
     if (i == svc->temporal_layer_id) {
-      cpi->rc.bits_off_target = lrc->bits_off_target;
-      cpi->rc.buffer_level = lrc->buffer_level;
+      cpi->rc->bits_off_target = lrc->bits_off_target;
+      cpi->rc->buffer_level = lrc->buffer_level;
     }
   }
 }
@@ -521,7 +462,7 @@ static void update_layer_buffer_level_postencode(SVC *svc,
 // Update the buffer level after encoding with encoded frame size.
 static void update_buffer_level_postencode(VP9_COMP *cpi,
                                            int encoded_frame_size) {
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
   rc->bits_off_target -= encoded_frame_size;
   // Clip the buffer level to the maximum specified buffer size.
   rc->bits_off_target = VPXMIN(rc->bits_off_target, rc->maximum_buffer_size);
@@ -578,6 +519,7 @@ void brc_libvpx_vp9_rc_init(const VP9EncoderConfig *oxcf, int pass, RATE_CONTROL
 
   rc->last_q[KEY_FRAME] = oxcf->best_allowed_q;
   rc->last_q[INTER_FRAME] = oxcf->worst_allowed_q;
+  rc->last_coded_qindex = oxcf->worst_allowed_q;
 
   rc->buffer_level = rc->starting_buffer_level;
   rc->bits_off_target = rc->starting_buffer_level;
@@ -638,28 +580,31 @@ void brc_libvpx_vp9_rc_init(const VP9EncoderConfig *oxcf, int pass, RATE_CONTROL
 
 static int adjust_q_cbr(const VP9_COMP *cpi, int q) {
   // This makes sure q is between oscillating Qs to prevent resonance.
-  if ((cpi->rc.rc_1_frame * cpi->rc.rc_2_frame == -1) &&
-      cpi->rc.q_1_frame != cpi->rc.q_2_frame) {
-    int qclamp = clamp(q, VPXMIN(cpi->rc.q_1_frame, cpi->rc.q_2_frame),
-                       VPXMAX(cpi->rc.q_1_frame, cpi->rc.q_2_frame));
+  if ((cpi->rc->rc_1_frame * cpi->rc->rc_2_frame == -1) &&
+      cpi->rc->q_1_frame != cpi->rc->q_2_frame) {
+    int qclamp = clamp(q, VPXMIN(cpi->rc->q_1_frame, cpi->rc->q_2_frame),
+                       VPXMAX(cpi->rc->q_1_frame, cpi->rc->q_2_frame));
     // If the previous frame had overshoot and the current q needs to increase
     // above the clamped value, reduce the clamp for faster reaction to
     // overshoot.
-    if (cpi->rc.rc_1_frame == -1 && q > qclamp)
+    if (cpi->rc->rc_1_frame == -1 && q > qclamp)
       q = (q + qclamp) >> 1;
     else
       q = qclamp;
   }
-  return VPXMAX(VPXMIN(q, cpi->rc.worst_quality), cpi->rc.best_quality);
+  return VPXMAX(VPXMIN(q, cpi->rc->worst_quality), cpi->rc->best_quality);
 }
 
 static double get_rate_correction_factor(const VP9_COMP *cpi) {
-  const RATE_CONTROL *const rc = &cpi->rc;
+  const RATE_CONTROL *const rc = cpi->rc;
   const VP9_COMMON *const cm = &cpi->common;
   double rcf;
 
   if (brc_libvpx_vp9_frame_is_intra_only(cm)) {
     rcf = rc->rate_correction_factors[KF_STD];
+  } else if (cpi->refresh_golden_frame && !cpi->use_svc &&
+             cpi->oxcf.gf_cbr_boost_pct > 20) {
+    rcf = rc->rate_correction_factors[GF_ARF_STD];
   } else {
       rcf = rc->rate_correction_factors[INTER_NORMAL];
   }
@@ -668,7 +613,7 @@ static double get_rate_correction_factor(const VP9_COMP *cpi) {
 }
 
 static void set_rate_correction_factor(VP9_COMP *cpi, double factor) {
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
   const VP9_COMMON *const cm = &cpi->common;
 
   // Normalize RCF to account for the size-dependent scaling factor.
@@ -678,8 +623,10 @@ static void set_rate_correction_factor(VP9_COMP *cpi, double factor) {
 
   if (brc_libvpx_vp9_frame_is_intra_only(cm)) {
     rc->rate_correction_factors[KF_STD] = factor;
-  } 
-  else {
+  } else if (cpi->refresh_golden_frame && !cpi->use_svc &&
+             cpi->oxcf.gf_cbr_boost_pct > 20) {
+    rc->rate_correction_factors[GF_ARF_STD] = factor;
+  } else {
       rc->rate_correction_factors[INTER_NORMAL] = factor;
   }
 }
@@ -693,70 +640,90 @@ static void vp9_rc_update_rate_correction_factors(VP9_COMP *cpi) {
   int projected_size_based_on_q = 0;
 
   FRAME_TYPE frame_type = cm->intra_only ? KEY_FRAME : cm->frame_type;
-  projected_size_based_on_q =
-      vp9_estimate_bits_at_q(frame_type, cm->base_qindex, cm->MBs,
-                               rate_correction_factor, cm->bit_depth);
+  if (cpi->roi.apply) {
+    projected_size_based_on_q =
+        brc_libvpx_vp9_roi_estimate_bits_at_q(cpi, rate_correction_factor);
+  } else if (cpi->oxcf.aq_mode == CYCLIC_REFRESH_AQ &&
+             cpi->cyclic_refresh->apply_cyclic_refresh) {
+    projected_size_based_on_q =
+        brc_libvpx_vp9_cyclic_refresh_estimate_bits_at_q(cpi,
+                                                         rate_correction_factor);
+  } else {
+    projected_size_based_on_q =
+        brc_libvpx_vp9_estimate_bits_at_q(frame_type, cm->base_qindex,
+                                          cm->MBs, rate_correction_factor,
+                                          cm->bit_depth);
+  }
 
   // Work out a size correction factor.
-  if (projected_size_based_on_q > FRAME_OVERHEAD_BITS)
-    correction_factor = (int)((100 * (int64_t)cpi->rc.projected_frame_size) /
-                              projected_size_based_on_q);
+  correction_factor = brc_rc_size_correction_factor(
+      cpi->rc->projected_frame_size, projected_size_based_on_q,
+      FRAME_OVERHEAD_BITS);
 
-  // Do not use damped adjustment for the first frame of each frame type
-  if (!cpi->rc.damped_adjustment[rf_lvl]) {
+  if (brc_rc_is_scene_change_size(correction_factor))
+    cpi->rc->high_source_sad = 1;
+
+  // Do not use damped adjustment for the first frame of each frame type, nor
+  // on a scene change where the model of the previous scene is of no use.
+  if (!cpi->rc->damped_adjustment[rf_lvl] || cpi->rc->high_source_sad) {
     adjustment_limit = 1.0;
-    cpi->rc.damped_adjustment[rf_lvl] = 1;
+    cpi->rc->damped_adjustment[rf_lvl] = 1;
   } else {
     // More heavily damped adjustment used if we have been oscillating either
     // side of target.
-    adjustment_limit =
-        0.25 + 0.5 * VPXMIN(1, fabs(log10(0.01 * correction_factor)));
+    adjustment_limit = brc_rc_adjustment_limit(correction_factor);
   }
 
-  cpi->rc.q_2_frame = cpi->rc.q_1_frame;
-  cpi->rc.q_1_frame = cm->base_qindex;
-  cpi->rc.rc_2_frame = cpi->rc.rc_1_frame;
-  if (correction_factor > 110)
-    cpi->rc.rc_1_frame = -1;
-  else if (correction_factor < 90)
-    cpi->rc.rc_1_frame = 1;
-  else
-    cpi->rc.rc_1_frame = 0;
+  brc_rc_update_q_history(cm->base_qindex, correction_factor,
+                          &cpi->rc->q_1_frame, &cpi->rc->q_2_frame,
+                          &cpi->rc->rc_1_frame, &cpi->rc->rc_2_frame);
 
-  // Turn off oscilation detection in the case of massive overshoot.
-  if (cpi->rc.rc_1_frame == -1 && cpi->rc.rc_2_frame == 1 &&
-      correction_factor > 1000) {
-    cpi->rc.rc_2_frame = 0;
+  // Turn off oscilation detection in the case of massive overshoot, and
+  // across a scene change.
+  if ((cpi->rc->rc_1_frame == -1 && cpi->rc->rc_2_frame == 1 &&
+       correction_factor > 1000) ||
+      cpi->rc->high_source_sad) {
+    cpi->rc->rc_2_frame = 0;
   }
 
-  if (correction_factor > 102) {
-    // We are not already at the worst allowable quality
-    correction_factor =
-        (int)(100 + ((correction_factor - 100) * adjustment_limit));
-    rate_correction_factor = (rate_correction_factor * correction_factor) / 100;
-    // Keep rate_correction_factor within limits
-    if (rate_correction_factor > MAX_BPB_FACTOR)
-      rate_correction_factor = MAX_BPB_FACTOR;
-  } else if (correction_factor < 99) {
-    // We are not already at the best allowable quality
-    correction_factor =
-        (int)(100 - ((100 - correction_factor) * adjustment_limit));
-    rate_correction_factor = (rate_correction_factor * correction_factor) / 100;
-
-    // Keep rate_correction_factor within limits
-    if (rate_correction_factor < MIN_BPB_FACTOR)
-      rate_correction_factor = MIN_BPB_FACTOR;
-  }
+  rate_correction_factor = brc_rc_correct_rate_factor(
+      rate_correction_factor, correction_factor, adjustment_limit);
 
   set_rate_correction_factor(cpi, rate_correction_factor);
 }
 
+// Rate model of the segments of the current frame: the frame and the bits
+// per block of its frame type at each q.
+typedef struct {
+  const VP9_COMP *cpi;
+  const int *bits_per_mb;
+} Vp9SegmentRateModel;
+
+static int roi_bits_per_mb(const void *model, int q,
+                           double correction_factor) {
+  const Vp9SegmentRateModel *m = (const Vp9SegmentRateModel *)model;
+  (void)correction_factor;
+  return brc_libvpx_vp9_roi_rc_bits_per_mb(m->cpi, q, m->bits_per_mb);
+}
+
+static int cyclic_refresh_bits_per_mb(const void *model, int q,
+                                      double correction_factor) {
+  const Vp9SegmentRateModel *m = (const Vp9SegmentRateModel *)model;
+  (void)correction_factor;
+  return brc_libvpx_vp9_cyclic_refresh_rc_bits_per_mb(m->cpi, q,
+                                                      m->bits_per_mb);
+}
+
 static int vp9_rc_regulate_q(const VP9_COMP *cpi, int target_bits_per_frame,
                       int active_best_quality, int active_worst_quality) {
   const VP9_COMMON *const cm = &cpi->common;
-  int q = active_worst_quality;
-  int last_error = INT_MAX;
-  int i, target_bits_per_mb, bits_per_mb_at_this_q;
+  const FRAME_TYPE frame_type = cm->intra_only ? KEY_FRAME : cm->frame_type;
+  const BrcRcRateCurve *const curve = &cpi->rate_curve[frame_type];
+  int bits_per_mb[QINDEX_RANGE];
+  const Vp9SegmentRateModel segments = { cpi, bits_per_mb };
+  brc_rc_bits_per_mb_fn model_bits_per_mb = brc_rc_curve_bits_per_mb;
+  const void *model = curve;
+  int q, target_bits_per_mb;
   const double correction_factor = get_rate_correction_factor(cpi);
 
   // Calculate required scaling factor based on target frame size and size of
@@ -764,26 +731,24 @@ static int vp9_rc_regulate_q(const VP9_COMP *cpi, int target_bits_per_frame,
   target_bits_per_mb =
       (int)(((int64_t)target_bits_per_frame << BPER_MB_NORMBITS) / cm->MBs);
 
-  i = active_best_quality;
-
-  do {
-    {
-      FRAME_TYPE frame_type = cm->intra_only ? KEY_FRAME : cm->frame_type;
-      bits_per_mb_at_this_q = (int)vp9_rc_bits_per_mb(
-          frame_type, i, correction_factor, cm->bit_depth);
-    }
-
-    if (bits_per_mb_at_this_q <= target_bits_per_mb) {
-      if ((target_bits_per_mb - bits_per_mb_at_this_q) <= last_error)
-        q = i;
-      else
-        q = i - 1;
+  // The segments evaluate the curve of the frame at several qs for each q
+  // of the search, they look them up in the whole curve evaluated at once.
+  if (cpi->roi.apply) {
+    model_bits_per_mb = roi_bits_per_mb;
+    model = &segments;
+  } else if (cpi->oxcf.aq_mode == CYCLIC_REFRESH_AQ &&
+             cpi->cyclic_refresh->apply_cyclic_refresh) {
+    model_bits_per_mb = cyclic_refresh_bits_per_mb;
+    model = &segments;
+  }
+  if (model == &segments)
+    brc_rc_rate_curve_bits_per_mb(curve, correction_factor, bits_per_mb);
 
-      break;
-    } else {
-      last_error = bits_per_mb_at_this_q - target_bits_per_mb;
-    }
-  } while (++i <= active_worst_quality);
+  // The rate does not increase with q: the q of the closest rate is the one
+  // of the first rate not above the target, or the one before it.
+  q = brc_rc_find_closest_q_by_rate(target_bits_per_mb, model_bits_per_mb,
+                                    model, correction_factor,
+                                    active_best_quality, active_worst_quality);
 
   // Adjustment to q for CBR mode.
   if (cpi->oxcf.rc_mode == VPX_CBR) return adjust_q_cbr(cpi, q);
@@ -816,6 +781,16 @@ static int get_kf_active_quality(const RATE_CONTROL *const rc, int q,
                             kf_low_motion_minq, kf_high_motion_minq);
 }
 
+static int get_gf_active_quality(const RATE_CONTROL *const rc, int q,
+                                 vpx_bit_depth_t bit_depth) {
+  int *arfgf_low_motion_minq;
+  int *arfgf_high_motion_minq;
+  ASSIGN_MINQ_TABLE(bit_depth, arfgf_low_motion_minq);
+  ASSIGN_MINQ_TABLE(bit_depth, arfgf_high_motion_minq);
+  return get_active_quality(q, rc->gfu_boost, gf_low, gf_high,
+                            arfgf_low_motion_minq, arfgf_high_motion_minq);
+}
+
 // Adjust active_worst_quality level based on buffer level.
 static int calc_active_worst_quality_one_pass_cbr(const VP9_COMP *cpi) {
   // Adjust active_worst_quality: If buffer is above the optimal/target level,
@@ -824,7 +799,7 @@ static int calc_active_worst_quality_one_pass_cbr(const VP9_COMP *cpi) {
   // ambient Q (at buffer = optimal level) to worst_quality level
   // (at buffer = critical level).
   const VP9_COMMON *const cm = &cpi->common;
-  const RATE_CONTROL *rc = &cpi->rc;
+  const RATE_CONTROL *rc = cpi->rc;
   // Buffer level below which we push active_worst to worst_quality.
   int64_t critical_level = rc->optimal_buffer_level >> 3;
   int64_t buff_lvl_step = 0;
@@ -892,7 +867,7 @@ static int rc_pick_q_and_bounds_one_pass_cbr(const VP9_COMP *cpi,
                                              int *bottom_index,
                                              int *top_index) {
   const VP9_COMMON *const cm = &cpi->common;
-  const RATE_CONTROL *const rc = &cpi->rc;
+  const RATE_CONTROL *const rc = cpi->rc;
   int active_best_quality = 0;
   int active_worst_quality = calc_active_worst_quality_one_pass_cbr(cpi);
   int q;
@@ -929,6 +904,18 @@ static int rc_pick_q_and_bounds_one_pass_cbr(const VP9_COMP *cpi,
       active_best_quality +=
           vp9_compute_qdelta(rc, q_val, q_val * q_adj_factor, cm->bit_depth);
     }
+  } else if (!cpi->use_svc && cpi->oxcf.gf_cbr_boost_pct &&
+             cpi->refresh_golden_frame) {
+    // Use the lower of active_worst_quality and recent
+    // average Q as basis for GF/ARF best Q limit unless last frame was
+    // a key frame.
+    if (rc->frames_since_key > 1 &&
+        rc->avg_frame_qindex[INTER_FRAME] < active_worst_quality) {
+      q = rc->avg_frame_qindex[INTER_FRAME];
+    } else {
+      q = active_worst_quality;
+    }
+    active_best_quality = get_gf_active_quality(rc, q, cm->bit_depth);
   } else {
     // Use the lower of active_worst_quality and recent/average Q.
     if (cm->current_video_frame > 1) {
@@ -1000,7 +987,7 @@ int brc_libvpx_vp9_rc_pick_q_and_bounds(const VP9_COMP *cpi, int *bottom_index,
 
 void brc_libvpx_vp9_rc_set_frame_target(VP9_COMP *cpi, int target) {
   const VP9_COMMON *const cm = &cpi->common;
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
 
   rc->this_frame_target = target;
 
@@ -1010,7 +997,7 @@ void brc_libvpx_vp9_rc_set_frame_target(VP9_COMP *cpi, int target) {
 }
 
 static void update_golden_frame_stats(VP9_COMP *cpi) {
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
 
   // Update the Golden frame usage counts.
   if (cpi->refresh_golden_frame) {
@@ -1019,19 +1006,21 @@ static void update_golden_frame_stats(VP9_COMP *cpi) {
   } else {
     rc->frames_since_golden++;
   }
+  if (rc->frames_till_gf_update_due > 0) rc->frames_till_gf_update_due--;
 }
 
 void brc_libvpx_vp9_rc_postencode_update(VP9_COMP *cpi, int64_t bytes_used) {
   const VP9_COMMON *const cm = &cpi->common;
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
   SVC *const svc = &cpi->svc;
   const int qindex = cm->base_qindex;
 
   // Update rate control heuristics
   rc->projected_frame_size = (int)(bytes_used << 3);
 
-  // Post encode loop adjustment of Q prediction.
-  vp9_rc_update_rate_correction_factors(cpi);
+  // Post encode loop adjustment of Q prediction. An unchanged frame is
+  // mostly skipped blocks and says nothing about the rate at its q.
+  if (!cpi->frame_unchanged) vp9_rc_update_rate_correction_factors(cpi);
 
   // Keep a record of last Q and ambient average Q.
   if (brc_libvpx_vp9_frame_is_intra_only(cm)) {
@@ -1078,6 +1067,18 @@ void brc_libvpx_vp9_rc_postencode_update(VP9_COMP *cpi, int64_t bytes_used) {
 
   if (brc_libvpx_vp9_frame_is_intra_only(cm)) rc->last_kf_qindex = qindex;
 
+  // The frame is a reference of the upper temporal layers as well.
+  rc->last_coded_qindex = qindex;
+  if (cpi->use_svc) {
+    int tl;
+    for (tl = svc->temporal_layer_id + 1; tl < svc->number_temporal_layers;
+         ++tl) {
+      const int layer = LAYER_IDS_TO_IDX(svc->spatial_layer_id, tl,
+                                         svc->number_temporal_layers);
+      svc->layer_context[layer].rc.last_coded_qindex = qindex;
+    }
+  }
+
   update_buffer_level_postencode(cpi, rc->projected_frame_size);
 
   // Rolling monitors of whether we are over or underspending used to help
@@ -1117,7 +1118,7 @@ void brc_libvpx_vp9_rc_postencode_update(VP9_COMP *cpi, int64_t bytes_used) {
 
 int brc_libvpx_vp9_calc_pframe_target_size_one_pass_cbr(const VP9_COMP *cpi) {
   const VP9EncoderConfig *oxcf = &cpi->oxcf;
-  const RATE_CONTROL *rc = &cpi->rc;
+  const RATE_CONTROL *rc = cpi->rc;
   const SVC *const svc = &cpi->svc;
   const int64_t diff = rc->optimal_buffer_level - rc->buffer_level;
   const int64_t one_pct_bits = 1 + rc->optimal_buffer_level / 100;
@@ -1125,7 +1126,18 @@ int brc_libvpx_vp9_calc_pframe_target_size_one_pass_cbr(const VP9_COMP *cpi) {
       VPXMAX(rc->avg_frame_bandwidth >> 4, FRAME_OVERHEAD_BITS);
   int target;
 
-  target = rc->avg_frame_bandwidth;
+  if (oxcf->gf_cbr_boost_pct && !cpi->use_svc) {
+    // Share the bits of the interval between the golden frame, weighted by
+    // af_ratio_pct, and the other frames, weighted by 100.
+    const int af_ratio_pct = oxcf->gf_cbr_boost_pct + 100;
+    const int64_t interval_bits =
+        (int64_t)rc->avg_frame_bandwidth * rc->baseline_gf_interval;
+    const int chunks = rc->baseline_gf_interval * 100 + af_ratio_pct - 100;
+    target = (int)(interval_bits *
+                   (cpi->refresh_golden_frame ? af_ratio_pct : 100) / chunks);
+  } else {
+    target = rc->avg_frame_bandwidth;
+  }
 
   if (brc_libvpx_is_one_pass_cbr_svc(cpi)) {
     // Note that for layers, avg_frame_bandwidth is the cumulative
@@ -1156,15 +1168,43 @@ int brc_libvpx_vp9_calc_pframe_target_size_one_pass_cbr(const VP9_COMP *cpi) {
   return VPXMAX(min_frame_target, target);
 }
 
-int brc_libvpx_vp9_calc_iframe_target_size_one_pass_cbr(VP9_COMP *cpi) {
-  RATE_CONTROL *rc = &cpi->rc;
+// There is no coded frame to size the first key frame on: take the rate
+// model for the frame size and bit depth at the q the inter frames are
+// expected to settle at, boosted like a later key frame so that the quality
+// does not pop after it. Screen content codes its key frame at the cost of
+// many static inter frames and gets twice the boost. An eighth of the
+// starting buffer is the floor and the whole buffer the upper bound.
+static int first_iframe_target_size(const VP9_COMP *cpi) {
+  const VP9_COMMON *const cm = &cpi->common;
+  const RATE_CONTROL *rc = cpi->rc;
+  int kf_boost = VPXMAX(32, (int)(2 * cpi->framerate - 16));
+  int64_t prior;
+  int q = rc->best_quality;
+
+  if (cpi->oxcf.content == VP9E_CONTENT_SCREEN) kf_boost *= 2;
+  while (q < rc->worst_quality &&
+         brc_libvpx_vp9_estimate_bits_at_q(INTER_FRAME, q, cm->MBs, 1.0,
+                                           cm->bit_depth) >
+             rc->avg_frame_bandwidth)
+    q++;
+  prior = ((int64_t)brc_libvpx_vp9_estimate_bits_at_q(
+               KEY_FRAME, q, cm->MBs, 1.0, cm->bit_depth) *
+           (16 + kf_boost)) >>
+          4;
+  prior = VPXMAX(prior, rc->starting_buffer_level / 8);
+  return (int)VPXMIN(VPXMIN(prior, rc->starting_buffer_level), INT_MAX);
+}
+
+// Target of a key frame coded frames_ahead frames after the next one.
+static int iframe_target_size_one_pass_cbr(const VP9_COMP *cpi,
+                                           int frames_ahead) {
+  const RATE_CONTROL *rc = cpi->rc;
   const VP9EncoderConfig *oxcf = &cpi->oxcf;
   const SVC *const svc = &cpi->svc;
+  const int frames_since_key = rc->frames_since_key + frames_ahead;
   int target;
-  if (cpi->common.current_video_frame == 0) {
-    target = ((rc->starting_buffer_level / 2) > INT_MAX)
-                 ? INT_MAX
-                 : (int)(rc->starting_buffer_level / 2);
+  if (cpi->common.current_video_frame + frames_ahead == 0) {
+    target = first_iframe_target_size(cpi);
   } else {
     int kf_boost = 32;
     double framerate = cpi->framerate;
@@ -1179,17 +1219,65 @@ int brc_libvpx_vp9_calc_iframe_target_size_one_pass_cbr(VP9_COMP *cpi) {
     }
 
     kf_boost = VPXMAX(kf_boost, (int)(2 * framerate - 16));
-    if (rc->frames_since_key < framerate / 2) {
-      kf_boost = (int)(kf_boost * rc->frames_since_key / (framerate / 2));
+    if (frames_since_key < framerate / 2) {
+      kf_boost = (int)(kf_boost * frames_since_key / (framerate / 2));
     }
     target = ((16 + kf_boost) * rc->avg_frame_bandwidth) >> 4;
   }
   return vp9_rc_clamp_iframe_target_size(cpi, target);
 }
 
+int brc_libvpx_vp9_calc_iframe_target_size_one_pass_cbr(VP9_COMP *cpi) {
+  return iframe_target_size_one_pass_cbr(cpi, 0);
+}
+
+int brc_libvpx_vp9_predict_key_frame_size(const VP9_COMP *cpi,
+                                          int frames_ahead) {
+  const VP9_COMMON *const cm = &cpi->common;
+  const RATE_CONTROL *rc = cpi->rc;
+  const double rcf =
+      fclamp(rc->rate_correction_factors[KF_STD] * rcf_mult[0],
+             MIN_BPB_FACTOR, MAX_BPB_FACTOR);
+  // Whatever its target, the key frame is coded within the q range.
+  const int min_size = brc_libvpx_vp9_estimate_bits_at_q(
+      KEY_FRAME, rc->worst_quality, cm->MBs, rcf, cm->bit_depth);
+  const int max_size = brc_libvpx_vp9_estimate_bits_at_q(
+      KEY_FRAME, rc->best_quality, cm->MBs, rcf, cm->bit_depth);
+  const int target = iframe_target_size_one_pass_cbr(cpi, frames_ahead);
+  return VPXMAX(min_size, VPXMIN(target, max_size));
+}
+
+void brc_libvpx_vp9_rc_set_golden_update(VP9_COMP *cpi, int scene_change) {
+  const VP9_COMMON *const cm = &cpi->common;
+  RATE_CONTROL *const rc = cpi->rc;
+  const CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+
+  // A key frame refreshes the golden frame and starts a new interval, and
+  // after a scene change the golden frame only holds the previous scene.
+  if (brc_libvpx_vp9_frame_is_intra_only(cm) || scene_change)
+    rc->frames_till_gf_update_due = 0;
+  // A copy of the previous frame adds nothing to the golden frame, the
+  // refresh waits for the next change.
+  if (rc->frames_till_gf_update_due > 0 || cpi->frame_unchanged) return;
+
+  if (cpi->oxcf.aq_mode == CYCLIC_REFRESH_AQ) {
+    // Refresh once the cyclic refresh went over the frame a few times.
+    if (cr->percent_refresh > 0)
+      rc->baseline_gf_interval =
+          VPXMIN(4 * (100 / cr->percent_refresh), MAX_CBR_GF_INTERVAL);
+    else
+      rc->baseline_gf_interval = MAX_CBR_GF_INTERVAL;
+  } else {
+    rc->baseline_gf_interval = (rc->min_gf_interval + rc->max_gf_interval) / 2;
+  }
+  rc->frames_till_gf_update_due = rc->baseline_gf_interval;
+  rc->gfu_boost = DEFAULT_GF_BOOST;
+  cpi->refresh_golden_frame = 1;
+}
+
 void brc_libvpx_vp9_rc_get_svc_params(VP9_COMP *cpi) {
   VP9_COMMON *const cm = &cpi->common;
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
   SVC *const svc = &cpi->svc;
   int target = rc->avg_frame_bandwidth;
   int layer = LAYER_IDS_TO_IDX(svc->spatial_layer_id, svc->temporal_layer_id,
@@ -1241,23 +1329,39 @@ static int vp9_compute_qdelta(const RATE_CONTROL *rc, double qstart, double qtar
                        vpx_bit_depth_t bit_depth) {
   int start_index = rc->worst_quality;
   int target_index = rc->worst_quality;
-  int i;
-
-  // Convert the average q value to an index.
-  for (i = rc->best_quality; i < rc->worst_quality; ++i) {
-    start_index = i;
-    if (vp9_convert_qindex_to_q(i, bit_depth) >= qstart) break;
-  }
 
-  // Convert the q target to an index
-  for (i = rc->best_quality; i < rc->worst_quality; ++i) {
-    target_index = i;
-    if (vp9_convert_qindex_to_q(i, bit_depth) >= qtarget) break;
+  // Convert the average q value and the q target to indexes, below
+  // worst_quality.
+  if (rc->best_quality < rc->worst_quality) {
+    start_index = brc_rc_find_qindex(qstart, bit_depth, rc->best_quality,
+                                     rc->worst_quality - 1);
+    target_index = brc_rc_find_qindex(qtarget, bit_depth, rc->best_quality,
+                                      rc->worst_quality - 1);
   }
 
   return target_index - start_index;
 }
 
+int brc_libvpx_vp9_compute_qdelta_by_rate(const VP9_COMP *cpi,
+                                          FRAME_TYPE frame_type, int qindex,
+                                          double rate_target_ratio) {
+  const RATE_CONTROL *const rc = cpi->rc;
+  const BrcRcRateCurve *const curve = &cpi->rate_curve[frame_type];
+  int target_index;
+
+  // Look up the current projected bits per block for the base index
+  const int base_bits_per_mb = curve->unit_bits_per_mb[qindex];
+
+  // Find the target bits per mb based on the base value and given ratio.
+  const int target_bits_per_mb = (int)(rate_target_ratio * base_bits_per_mb);
+
+  // Convert the q target to an index
+  target_index = brc_rc_find_q_by_rate(
+      target_bits_per_mb, brc_rc_table_bits_per_mb, curve->unit_bits_per_mb,
+      1.0, rc->best_quality, rc->worst_quality);
+  return target_index - qindex;
+}
+
 void brc_libvpx_vp9_rc_set_gf_interval_range(const VP9_COMP *const cpi,
                                   RATE_CONTROL *const rc) {
   const VP9EncoderConfig *const oxcf = &cpi->oxcf;
@@ -1285,7 +1389,7 @@ void brc_libvpx_vp9_rc_set_gf_interval_range(const VP9_COMP *const cpi,
 static void vp9_rc_update_framerate(VP9_COMP *cpi) {
   const VP9_COMMON *const cm = &cpi->common;
   const VP9EncoderConfig *const oxcf = &cpi->oxcf;
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
   int vbr_max_bits;
 
   rc->avg_frame_bandwidth = (int)(oxcf->target_bandwidth / cpi->framerate);
@@ -58,6 +58,9 @@
 #define FIXED_GF_INTERVAL 8  // Used in some testing modes only
 
 #define FRAME_OVERHEAD_BITS 200
+#define DEFAULT_GF_BOOST 2000
+// Longest golden frame interval of the one pass CBR plan.
+#define MAX_CBR_GF_INTERVAL 40
 // The maximum duration of a GF group that is static (for example a slide show).
 #define MAX_STATIC_GF_GROUP_LENGTH 250
 #define VP9_LEVELS 14
@@ -130,13 +133,6 @@ typedef struct {
   uint8_t max_ref_frame_buffers;
 } Vp9LevelSpec;
 
-typedef struct {
-  int8_t level_index;
-  uint8_t fail_flag;
-  int max_frame_size;   // in bits
-  double max_cpb_size;  // in bits
-} LevelConstraint;
-
 typedef enum {
   INTER_NORMAL = 0,
   INTER_HIGH = 1,
@@ -241,85 +237,83 @@ typedef enum vp9e_temporal_layering_mode {
   VP9E_TEMPORAL_LAYERING_MODE_0212 = 3
 } VP9E_TEMPORAL_LAYERING_MODE;
 
+// The fields are grouped by how often the one pass CBR controller touches
+// them, so that a frame of a controller among many others touches few
+// cache lines. The first 128 bytes hold the buffer model and the q loop,
+// read and written by every compute_qp and post_encode_update. The frame
+// statistics and the key/golden frame plan follow, the setup only state
+// comes last.
 typedef struct {
-  // Rate targetting variables
-  int base_frame_target;  // A baseline frame target before adjustment
-                          // for previous under or over shoot.
+  // Buffer model and q loop of every frame.
+  int64_t buffer_level;
+  int64_t bits_off_target;
+  int64_t optimal_buffer_level;
+  int64_t maximum_buffer_size;
+  double rate_correction_factors[RATE_FACTOR_LEVELS];
   int this_frame_target;  // Actual frame target after rc adjustment.
   int projected_frame_size;
-  int sb64_target_rate;
-  int last_q[FRAME_TYPES];  // Separate values for Intra/Inter
-  int last_boosted_qindex;  // Last boosted GF/KF/ARF q
-  int last_kf_qindex;       // Q index of the last key frame coded.
-
-  int gfu_boost;
-  int last_boost;
-  int kf_boost;
-  double rate_correction_factors[RATE_FACTOR_LEVELS];
-
-  int frames_since_golden;
-  int frames_till_gf_update_due;
-  int min_gf_interval;
-  int max_gf_interval;
-  int static_scene_max_gf_interval;
-  int baseline_gf_interval;
-  int constrained_gf_group;
-  int frames_to_key;
-  int frames_since_key;
-  int this_key_frame_forced;
-  int next_key_frame_forced;
-  int source_alt_ref_pending;
-  int source_alt_ref_active;
-  int is_src_frame_alt_ref;
-
   int avg_frame_bandwidth;  // Average frame size target for clip
   int min_frame_bandwidth;  // Minimum allocation used for any frame
   int max_frame_bandwidth;  // Maximum burst rate allowed for a frame.
+  int worst_quality;
+  int best_quality;
+  int last_q[FRAME_TYPES];  // Separate values for Intra/Inter
+  // rate control history for last frame(1) and the frame before(2).
+  // -1: undershot
+  //  1: overshoot
+  //  0: not initialized.
+  int rc_1_frame;
+  int rc_2_frame;
+  int q_1_frame;
+  int q_2_frame;
+  // The current frame starts a new scene.
+  int high_source_sad;
 
+  // Statistics updated after every frame.
+  int damped_adjustment[RATE_FACTOR_LEVELS];
+  int avg_frame_qindex[FRAME_TYPES];
   int ni_av_qi;
   int ni_tot_qi;
   int ni_frames;
-  int avg_frame_qindex[FRAME_TYPES];
   double tot_q;
   double avg_q;
 
-  int64_t buffer_level;
-  int64_t bits_off_target;
-  int64_t vbr_bits_off_target;
-  int64_t vbr_bits_off_target_fast;
-
-  int decimation_factor;
-  int decimation_count;
-
   int rolling_target_bits;
   int rolling_actual_bits;
 
   int long_rolling_target_bits;
   int long_rolling_actual_bits;
 
-  int rate_error_estimate;
-
   int64_t total_actual_bits;
   int64_t total_target_bits;
   int64_t total_target_vs_actual;
 
-  int worst_quality;
-  int best_quality;
+  // Key and golden frame plan.
+  int last_boosted_qindex;  // Last boosted GF/KF/ARF q
+  int last_kf_qindex;       // Q index of the last key frame coded.
+  int last_coded_qindex;    // Q index of the last frame coded in this layer.
+  int gfu_boost;
+  int kf_boost;
+  int frames_since_golden;
+  int frames_till_gf_update_due;
+  int min_gf_interval;
+  int max_gf_interval;
+  int baseline_gf_interval;
+  int frames_to_key;
+  int frames_since_key;
+  int this_key_frame_forced;
+  int sb64_target_rate;
+  // Keep track of the last target average frame bandwidth.
+  int last_avg_frame_bandwidth;
+  int force_max_q;
 
+  // Set up on init and on configuration changes.
   int64_t starting_buffer_level;
-  int64_t optimal_buffer_level;
-  int64_t maximum_buffer_size;
+  int static_scene_max_gf_interval;
+  int next_key_frame_forced;
 
-  // rate control history for last frame(1) and the frame before(2).
-  // -1: undershot
-  //  1: overshoot
-  //  0: not initialized.
-  int rc_1_frame;
-  int rc_2_frame;
-  int q_1_frame;
-  int q_2_frame;
-  // Keep track of the last target average frame bandwidth.
-  int last_avg_frame_bandwidth;
+  int decimation_factor;
+  int decimation_count;
 
   int fac_active_worst_inter;
   int fac_active_worst_gf;
@@ -331,18 +325,14 @@ typedef struct {
   int avg_frame_low_motion;
   int af_ratio_onepass_vbr;
   int force_qpmin;
-  double perc_arf_usage;
-  int force_max_q;
   // Last frame was dropped post encode on scene change.
   int last_post_encode_dropped_scene_change;
 
-  int damped_adjustment[RATE_FACTOR_LEVELS];
   double arf_active_best_quality_adjustment_factor;
   int arf_increase_active_best_quality;
 
   int preserve_arf_as_gld;
   int preserve_next_arf_as_gld;
-  int show_arf_as_gld;
 } RATE_CONTROL;
 
 typedef struct VP9_COMP VP9_COMP;
@@ -353,6 +343,12 @@ int brc_libvpx_vp9_frame_is_intra_only(const VP9_COMMON *const cm);
 
 int brc_libvpx_vp9_calc_iframe_target_size_one_pass_cbr(VP9_COMP *cpi);
 
+// Size in bits of a key frame coded frames_ahead frames after the next
+// one, as targeted by the rate control and bounded by the rate model at
+// the best and worst quality.
+int brc_libvpx_vp9_predict_key_frame_size(const VP9_COMP *cpi,
+                                          int frames_ahead);
+
 int brc_libvpx_vp9_calc_pframe_target_size_one_pass_cbr(const VP9_COMP *cpi);
 
 void brc_libvpx_vp9_rc_set_frame_target(VP9_COMP *cpi, int target);
@@ -380,6 +376,7 @@ brc_libvpx_vp9_new_framerate (VP9_COMP * cpi, double framerate);
 void brc_libvpx_vp9_rc_init(const struct VP9EncoderConfig *oxcf, int pass,
                  RATE_CONTROL *rc);
 
+// Builds the minq tables of the process on the first call.
 void brc_libvpx_vp9_rc_init_minq_luts(void);
 
 int brc_libvpx_is_one_pass_cbr_svc(const struct VP9_COMP *const cpi);
@@ -408,11 +405,46 @@ int brc_libvpx_is_one_pass_cbr_svc(const struct VP9_COMP *const cpi);
 
 void brc_libvpx_vp9_rc_get_svc_params(struct VP9_COMP *cpi);
 
+// Golden frame plan of one pass CBR without layers: sets
+// refresh_golden_frame and the interval to the next refresh.
+void brc_libvpx_vp9_rc_set_golden_update(struct VP9_COMP *cpi,
+                                         int scene_change);
+
 // Post encode update of the rate control parameters based
 // on bytes used
 void brc_libvpx_vp9_rc_postencode_update(VP9_COMP *cpi, int64_t bytes_used);
 
-void brc_libvpx_vp9_set_mb_mi(VP9_COMMON *cm, int width, int height);
+// Frame size in pixels, in MODE_INFO (8-pixel) and in MB (16-pixel) units.
+typedef struct {
+  int width;
+  int height;
+  int mi_rows, mi_cols, mi_stride;
+  int mb_rows, mb_cols, MBs;
+} FRAME_GEOMETRY;
+
+void brc_libvpx_vp9_calc_frame_geometry(FRAME_GEOMETRY *geometry, int width,
+                                        int height);
+
+void brc_libvpx_vp9_set_frame_geometry(VP9_COMMON *cm,
+                                       const FRAME_GEOMETRY *geometry);
 
 int16_t brc_libvpx_vp9_ac_quant (int qindex, int delta, int bit_depth);
+
+int brc_libvpx_vp9_rc_bits_per_mb(FRAME_TYPE frame_type, int qindex,
+                                  double correction_factor,
+                                  vpx_bit_depth_t bit_depth);
+
+// Point the controller at the rate curves of the frame types at the bit
+// depth of the stream, built on the first call of the process.
+void brc_libvpx_vp9_rc_init_rate_curves(VP9_COMP *cpi);
+
+int brc_libvpx_vp9_estimate_bits_at_q(FRAME_TYPE frame_type, int q, int mbs,
+                                      double correction_factor,
+                                      vpx_bit_depth_t bit_depth);
+
+// Computes a q delta (in "q index" terms) to get from a starting q value
+// to a value that should equate to the given rate ratio.
+int brc_libvpx_vp9_compute_qdelta_by_rate(const VP9_COMP *cpi,
+                                          FRAME_TYPE frame_type, int qindex,
+                                          double rate_target_ratio);
 #endif  // LIBMEBO_BRC_VP9_RATECTRL_H
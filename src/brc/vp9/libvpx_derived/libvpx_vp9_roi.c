@@ -0,0 +1,67 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "libvpx_vp9_common.h"
+#include "libvpx_vp9_roi.h"
+
+static inline int clamp(int value, int low, int high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+static int compute_deltaq(const VP9_COMP *cpi, int q, int segment) {
+  const VP9_COMMON *const cm = &cpi->common;
+  const int deltaq = brc_libvpx_vp9_compute_qdelta_by_rate(
+      cpi, cm->frame_type, q, brc_roi_rate_ratio(segment));
+  return brc_roi_clamp_qdelta(q, deltaq);
+}
+
+int brc_libvpx_vp9_roi_estimate_bits_at_q(const VP9_COMP *cpi,
+                                          double correction_factor) {
+  const VP9_COMMON *const cm = &cpi->common;
+  const BrcRoi *const roi = &cpi->roi;
+  double bits = 0.0;
+  int i;
+
+  for (i = 0; i < BRC_ROI_NUM_SEGMENTS; i++) {
+    if (roi->weight[i] == 0.0) continue;
+    bits += roi->weight[i] *
+            brc_libvpx_vp9_estimate_bits_at_q(
+                cm->frame_type, cm->base_qindex + roi->qindex_delta[i],
+                cm->MBs, correction_factor, cm->bit_depth);
+  }
+  return (int)bits;
+}
+
+int brc_libvpx_vp9_roi_rc_bits_per_mb(const VP9_COMP *cpi, int i,
+                                      const int *bits_per_mb) {
+  const BrcRoi *const roi = &cpi->roi;
+  double frame_bits_per_mb = 0.0;
+  int s;
+
+  for (s = 0; s < BRC_ROI_NUM_SEGMENTS; s++) {
+    int deltaq;
+    if (roi->weight[s] == 0.0) continue;
+    deltaq = s ? compute_deltaq(cpi, i, s) : 0;
+    frame_bits_per_mb += roi->weight[s] * bits_per_mb[i + deltaq];
+  }
+  return (int)frame_bits_per_mb;
+}
+
+void brc_libvpx_vp9_roi_setup(VP9_COMP *const cpi) {
+  const VP9_COMMON *const cm = &cpi->common;
+  BrcRoi *const roi = &cpi->roi;
+  int s;
+
+  for (s = 1; s < BRC_ROI_NUM_SEGMENTS; s++) {
+    const int deltaq = compute_deltaq(cpi, cm->base_qindex, s);
+    roi->qindex_delta[s] =
+        clamp(cm->base_qindex + deltaq, 0, MAXQ) - cm->base_qindex;
+  }
+}
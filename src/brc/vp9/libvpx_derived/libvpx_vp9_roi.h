@@ -0,0 +1,32 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef LIBMEBO_BRC_VP9_ROI_H
+#define LIBMEBO_BRC_VP9_ROI_H
+
+#include "../../common/brc_roi.h"
+
+struct VP9_COMP;
+
+// Estimate the bits of the just encoded frame, incorporating the delta-q of
+// the regions of interest.
+int brc_libvpx_vp9_roi_estimate_bits_at_q(const struct VP9_COMP *cpi,
+                                          double correction_factor);
+
+// Estimate the bits per mb for a frame q = i, incorporating the delta-q the
+// regions of interest get at that q, from the bits per mb of the frame at
+// each q.
+int brc_libvpx_vp9_roi_rc_bits_per_mb(const struct VP9_COMP *cpi, int i,
+                                      const int *bits_per_mb);
+
+// Set the delta-q of the regions of interest for the frame q.
+void brc_libvpx_vp9_roi_setup(struct VP9_COMP *const cpi);
+
+#endif  // LIBMEBO_BRC_VP9_ROI_H
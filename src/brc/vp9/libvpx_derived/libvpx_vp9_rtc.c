@@ -11,6 +11,7 @@
  */
 
 #include "libvpx_vp9_rtc.h"
+#include "../../common/brc_keyframe.h"
 
 #undef ERROR
 #define ERROR(str)                  \
@@ -75,37 +76,152 @@ brc_vp9_get_loop_filter_level(BrcCodecEnginePtr engine_ptr, int *filter_level) {
   return LIBMEBO_STATUS_SUCCESS;
 }
 
+LibMeboStatus
+brc_vp9_get_loop_filter_params(BrcCodecEnginePtr engine_ptr,
+    LibMeboLoopFilterParams *params) {
+  int filter_level;
+  brc_vp9_get_loop_filter_level(engine_ptr, &filter_level);
+  params->filter_level[0] = params->filter_level[1] = filter_level;
+  params->filter_level_u = params->filter_level_v = filter_level;
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_vp9_get_segmentation_map(BrcCodecEnginePtr engine_ptr,
+    LibMeboSegmentationMap *seg_map) {
+  VP9RateControlRTC *rtc = (VP9RateControlRTC *) engine_ptr;
+  VP9_COMP *cpi_ = &rtc->cpi_;
+  VP9_COMMON *const cm = &cpi_->common;
+  const CYCLIC_REFRESH *const cr = cpi_->cyclic_refresh;
+  const uint32_t map_size = (uint32_t)(cm->mi_rows * cm->mi_cols);
+  int i;
+
+  if (cpi_->roi.apply)
+    return brc_roi_get_segmentation_map(&cpi_->roi, seg_map);
+
+  seg_map->block_size = 8;
+  seg_map->cols = cm->mi_cols;
+  seg_map->rows = cm->mi_rows;
+  memset(seg_map->delta_qp, 0, sizeof(seg_map->delta_qp));
+  if (seg_map->map && seg_map->map_size < map_size)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+
+  if (cpi_->oxcf.aq_mode != CYCLIC_REFRESH_AQ || !cr->apply_cyclic_refresh) {
+    seg_map->enabled = 0;
+    seg_map->num_segments = 1;
+    if (seg_map->map)
+      memset(seg_map->map, CR_SEGMENT_ID_BASE, map_size);
+    return LIBMEBO_STATUS_SUCCESS;
+  }
+
+  // Segment BOOST2 needs the per-block rate of the encoded frame, which is
+  // not available, so only BASE and BOOST1 are present in the map.
+  seg_map->enabled = 1;
+  seg_map->num_segments = CR_SEGMENT_ID_BOOST1 + 1;
+  for (i = 0; i < seg_map->num_segments; i++)
+    seg_map->delta_qp[i] = cr->qindex_delta[i];
+  if (seg_map->map)
+    memcpy(seg_map->map, cr->seg_map, map_size);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+LibMeboStatus
+brc_vp9_get_golden_frame_plan(BrcCodecEnginePtr engine_ptr,
+    LibMeboGoldenFramePlan *plan) {
+  VP9RateControlRTC *rtc = (VP9RateControlRTC *) engine_ptr;
+  VP9_COMP *cpi_ = &rtc->cpi_;
+  const RATE_CONTROL *const rc = cpi_->rc;
+
+  plan->refresh_golden_frame = cpi_->refresh_golden_frame;
+  plan->target_bits = rc->this_frame_target;
+  // Layered streams refresh the golden frame on key frames only.
+  if (cpi_->oxcf.gf_cbr_boost_pct && !cpi_->use_svc) {
+    plan->gf_interval = rc->baseline_gf_interval;
+    plan->frames_till_gf_update = rc->frames_till_gf_update_due;
+  }
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
+static int
+brc_vp9_key_frame_size(BrcCodecEnginePtr engine_ptr, int frames_ahead) {
+  VP9RateControlRTC *rtc = (VP9RateControlRTC *) engine_ptr;
+  return brc_libvpx_vp9_predict_key_frame_size(&rtc->cpi_, frames_ahead);
+}
+
+LibMeboStatus
+brc_vp9_get_keyframe_advice(BrcCodecEnginePtr engine_ptr, int max_interval,
+    LibMeboKeyFrameAdvice *advice) {
+  VP9RateControlRTC *rtc = (VP9RateControlRTC *) engine_ptr;
+  VP9_COMP *cpi_ = &rtc->cpi_;
+  const RATE_CONTROL *const rc = cpi_->rc;
+  BrcKeyFrameState state;
+
+  state.buffer_level = rc->buffer_level;
+  state.optimal_buffer_level = rc->optimal_buffer_level;
+  state.maximum_buffer_size = rc->maximum_buffer_size;
+  state.avg_frame_bandwidth = rc->avg_frame_bandwidth;
+  state.undershoot_pct = cpi_->oxcf.under_shoot_pct;
+  state.overshoot_pct = cpi_->oxcf.over_shoot_pct;
+  state.target_bandwidth = cpi_->oxcf.target_bandwidth;
+  return brc_keyframe_get_advice(engine_ptr, brc_vp9_key_frame_size, &state,
+                                 max_interval, advice);
+}
+
+LibMeboStatus
+brc_vp9_set_roi(BrcCodecEnginePtr engine_ptr, const LibMeboRoiConfig *roi) {
+  VP9RateControlRTC *rtc = (VP9RateControlRTC *) engine_ptr;
+  VP9_COMP *cpi_ = &rtc->cpi_;
+
+  if (roi->spatial_layer_id >= cpi_->svc.number_spatial_layers)
+    return LIBMEBO_STATUS_INVALID_PARAM;
+  return brc_roi_set(&cpi_->roi, roi);
+}
+
+LibMeboStatus
+brc_vp9_get_qdelta_by_rate(BrcCodecEnginePtr engine_ptr, double rate_ratio,
+    int *qdelta) {
+  VP9RateControlRTC *rtc = (VP9RateControlRTC *) engine_ptr;
+  VP9_COMP *cpi_ = &rtc->cpi_;
+  VP9_COMMON *const cm = &cpi_->common;
+
+  if (!engine_ptr || !qdelta)
+	  return LIBMEBO_STATUS_INVALID_PARAM;
+  *qdelta = brc_libvpx_vp9_compute_qdelta_by_rate(cpi_, cm->frame_type,
+      cm->base_qindex, rate_ratio);
+  return LIBMEBO_STATUS_SUCCESS;
+}
+
 LibMeboStatus
 brc_vp9_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_params) {
   VP9RateControlRTC *rtc = (VP9RateControlRTC *) engine_ptr;
   VP9_COMP *cpi_ = &rtc->cpi_;
   VP9_COMMON *const cm = &cpi_->common;
-  int width, height;
 
+  if (frame_params->spatial_layer_id < 0 ||
+      frame_params->spatial_layer_id >= cpi_->svc.number_spatial_layers ||
+      frame_params->temporal_layer_id < 0 ||
+      frame_params->temporal_layer_id >= cpi_->svc.number_temporal_layers)
+    return LIBMEBO_STATUS_INVALID_PARAM;
   cpi_->svc.spatial_layer_id = frame_params->spatial_layer_id;
   cpi_->svc.temporal_layer_id = frame_params->temporal_layer_id;
-  if (cpi_->svc.number_spatial_layers > 1) {
-    const int layer = LAYER_IDS_TO_IDX(cpi_->svc.spatial_layer_id,
-                                       cpi_->svc.temporal_layer_id,
-                                       cpi_->svc.number_temporal_layers);
-    LAYER_CONTEXT *lc = &cpi_->svc.layer_context[layer];
-    get_layer_resolution(cpi_->oxcf.width, cpi_->oxcf.height,
-                         lc->scaling_factor_num, lc->scaling_factor_den, &width,
-                         &height);
-    cm->width = width;
-    cm->height = height;
-  }
-  brc_libvpx_vp9_set_mb_mi(cm, cm->width, cm->height);
+  brc_libvpx_vp9_set_frame_geometry(
+      cm, &cpi_->svc.layer_geometry[cpi_->svc.spatial_layer_id]);
 
   //Fixme: Use common frame_type across the codebase
   cm->frame_type = (FRAME_TYPE)frame_params->frame_type;
   cpi_->refresh_golden_frame = (cm->frame_type == KEY_FRAME) ? 1 : 0;
+  cpi_->frame_unchanged =
+      !brc_libvpx_vp9_frame_is_intra_only(cm) &&
+      (frame_params->flags & LIBMEBO_FRAME_FLAG_UNCHANGED);
 
   cpi_->sf.use_nonrd_pick_mode = 1;
 
   if (cpi_->svc.number_spatial_layers == 1 &&
       cpi_->svc.number_temporal_layers == 1) {
     int target;
+    if (cpi_->oxcf.gf_cbr_boost_pct)
+      brc_libvpx_vp9_rc_set_golden_update(
+          cpi_, !!(frame_params->flags & LIBMEBO_FRAME_FLAG_SCENE_CHANGE));
     if (brc_libvpx_vp9_frame_is_intra_only(cm)) {
       target = brc_libvpx_vp9_calc_iframe_target_size_one_pass_cbr(cpi_);
     }
@@ -120,26 +236,99 @@ brc_vp9_compute_qp (BrcCodecEnginePtr engine_ptr, LibMeboRCFrameParams *frame_pa
     brc_libvpx_vp9_rc_get_svc_params(cpi_);
   }
 
-  int bottom_index, top_index;
-  cpi_->common.base_qindex =
-      brc_libvpx_vp9_rc_pick_q_and_bounds(cpi_, &bottom_index, &top_index);
+  // The q history of the previous scene says nothing about this one.
+  cpi_->rc->high_source_sad =
+      !!(frame_params->flags & LIBMEBO_FRAME_FLAG_SCENE_CHANGE);
+  if (cpi_->rc->high_source_sad) {
+    cpi_->rc->rc_1_frame = 0;
+    cpi_->rc->rc_2_frame = 0;
+  }
+
+  if (brc_roi_setup_frame(&cpi_->roi, cpi_->svc.spatial_layer_id,
+          8, cm->mi_cols, cm->mi_rows) !=
+      LIBMEBO_STATUS_SUCCESS)
+    return LIBMEBO_STATUS_FAILED;
+
+  if (cpi_->oxcf.aq_mode == CYCLIC_REFRESH_AQ)
+    brc_libvpx_vp9_cyclic_refresh_update_parameters(cpi_);
+
+  if (cpi_->frame_unchanged) {
+    // Nothing to code but the skip flags: bank the bits of the frame and
+    // keep the q, the next change starts from the same quality. With layers
+    // cm->base_qindex is the q of whichever layer was coded last.
+    RATE_CONTROL *const rc = cpi_->rc;
+    brc_libvpx_vp9_rc_set_frame_target(cpi_, rc->min_frame_bandwidth);
+    cpi_->common.base_qindex = VPXMAX(
+        VPXMIN(rc->last_coded_qindex, rc->worst_quality), rc->best_quality);
+  } else {
+    int bottom_index, top_index;
+    cpi_->common.base_qindex =
+        brc_libvpx_vp9_rc_pick_q_and_bounds(cpi_, &bottom_index, &top_index);
+  }
+
+  if (cpi_->roi.apply)
+    brc_libvpx_vp9_roi_setup(cpi_);
+  if (cpi_->oxcf.aq_mode == CYCLIC_REFRESH_AQ)
+    brc_libvpx_vp9_cyclic_refresh_setup(cpi_);
   return LIBMEBO_STATUS_SUCCESS;
 }
 
+LibMeboStatus brc_vp9_validate (LibMeboRateControllerConfig *cfg);
+
 LibMeboStatus
 brc_vp9_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerConfig *rc_cfg) {
   VP9RateControlRTC *rtc = (VP9RateControlRTC *) engine_ptr;
   VP9_COMP *cpi_ = &rtc->cpi_;
   VP9_COMMON *cm = &cpi_->common;
   VP9EncoderConfig *oxcf = &cpi_->oxcf;
-  RATE_CONTROL *const rc = &cpi_->rc;
+  RATE_CONTROL *rc;
+  LibMeboStatus status;
+
+  // A config update is validated like the config of the controller creation.
+  status = brc_vp9_validate (rc_cfg);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return status;
+
+  // The layer contexts are rescaled from the stream rate control below, so
+  // it takes over the state of the last coded layer rather than alias it.
+  if (cpi_->rc != &cpi_->stream_rc) {
+    cpi_->stream_rc = *cpi_->rc;
+    cpi_->rc = &cpi_->stream_rc;
+  }
+  rc = cpi_->rc;
 
   cm->width = rc_cfg->width;
   cm->height = rc_cfg->height;
   cm->MBs = (cm->width * cm->height)/ (16 * 16);
   oxcf->width = rc_cfg->width;
   oxcf->height = rc_cfg->height;
-  oxcf->bit_depth = VPX_BITS_8;
+  oxcf->bit_depth = rc_cfg->bit_depth ? (vpx_bit_depth_t)rc_cfg->bit_depth
+                                      : VPX_BITS_8;
+  cm->bit_depth = oxcf->bit_depth;
+  cm->profile = (cm->bit_depth > VPX_BITS_8) ? PROFILE_2 : PROFILE_0;
+  brc_libvpx_vp9_rc_init_rate_curves(cpi_);
+  oxcf->aq_mode = (rc_cfg->aq_mode == LIBMEBO_AQ_MODE_CYCLIC_REFRESH)
+                      ? CYCLIC_REFRESH_AQ
+                      : NO_AQ;
+  oxcf->content = (rc_cfg->content_type == LIBMEBO_CONTENT_SCREEN)
+                      ? VP9E_CONTENT_SCREEN
+                      : VP9E_CONTENT_DEFAULT;
+  if (oxcf->aq_mode == CYCLIC_REFRESH_AQ) {
+    // The segment map is allocated for the full resolution, the lower
+    // spatial layers only use a part of it.
+    const int mi_rows = (oxcf->height + 7) >> 3;
+    const int mi_cols = (oxcf->width + 7) >> 3;
+    CYCLIC_REFRESH *cr = cpi_->cyclic_refresh;
+    if (!cr || cr->map_mi_rows != mi_rows || cr->map_mi_cols != mi_cols) {
+      brc_libvpx_vp9_cyclic_refresh_free(cr);
+      cpi_->cyclic_refresh =
+          brc_libvpx_vp9_cyclic_refresh_alloc(mi_rows, mi_cols);
+      if (!cpi_->cyclic_refresh) {
+        oxcf->aq_mode = NO_AQ;
+        return LIBMEBO_STATUS_FAILED;
+      }
+    }
+  }
   if (oxcf->init_framerate > 180)
     oxcf->init_framerate = 30;
   else
@@ -154,6 +343,7 @@ brc_vp9_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerC
   oxcf->maximum_buffer_size_ms = rc_cfg->buf_sz;
   oxcf->under_shoot_pct = rc_cfg->undershoot_pct;
   oxcf->over_shoot_pct = rc_cfg->overshoot_pct;
+  oxcf->gf_cbr_boost_pct = rc_cfg->gf_cbr_boost_pct;
 
   oxcf->ss_number_layers = rc_cfg->ss_number_layers;
   oxcf->ts_number_layers = rc_cfg->ts_number_layers;
@@ -186,6 +376,8 @@ brc_vp9_update_rate_control(BrcCodecEnginePtr engine_ptr, LibMeboRateControllerC
     }
   }
 
+  vp9_svc_update_layer_geometry(cpi_);
+
   brc_libvpx_vp9_set_rc_buffer_sizes(rc, &cpi_->oxcf);
   brc_libvpx_vp9_new_framerate(cpi_, cpi_->framerate);
 
@@ -206,9 +398,8 @@ brc_init_rate_control(VP9RateControlRTC *rtc, LibMeboRateControllerConfig *rc_cf
   VP9_COMP *cpi_ = &rtc->cpi_;
   VP9_COMMON *cm = &cpi_->common;
   VP9EncoderConfig *oxcf = &cpi_->oxcf;
-  RATE_CONTROL *const rc = &cpi_->rc;
-  cm->profile = PROFILE_0;
-  cm->bit_depth = VPX_BITS_8;
+  RATE_CONTROL *const rc = &cpi_->stream_rc;
+  cpi_->rc = rc;
   cm->show_frame = 1;
   oxcf->mode = GOOD;
   oxcf->rc_mode = VPX_CBR;
@@ -260,6 +451,12 @@ brc_vp9_validate (LibMeboRateControllerConfig *cfg)
   RANGE_CHECK_HI(cfg, overshoot_pct, 100);
   RANGE_CHECK(cfg, ss_number_layers, 1, VPX_SS_MAX_LAYERS);
   RANGE_CHECK(cfg, ts_number_layers, 1, VPX_TS_MAX_LAYERS);
+  RANGE_CHECK_HI(cfg, aq_mode, LIBMEBO_AQ_MODE_CYCLIC_REFRESH);
+  RANGE_CHECK_HI(cfg, content_type, LIBMEBO_CONTENT_SCREEN);
+  RANGE_CHECK(cfg, gf_cbr_boost_pct, 0, 1000);
+  if (cfg->bit_depth != 0 && cfg->bit_depth != VPX_BITS_8 &&
+      cfg->bit_depth != VPX_BITS_10 && cfg->bit_depth != VPX_BITS_12)
+    ERROR("bit_depth must be 8, 10 or 12");
 
   if (cfg->ss_number_layers * cfg->ts_number_layers > VPX_MAX_LAYERS)
     ERROR("ss_number_layers * ts_number_layers is out of range");
@@ -300,6 +497,11 @@ brc_vp9_rate_control_init (LibMeboRateControllerConfig *cfg,
 
   memset (&rtc->cpi_, 0, sizeof (rtc->cpi_));
   brc_init_rate_control (rtc, (BrcCodecEnginePtr)cfg);
+  if (cfg->aq_mode == LIBMEBO_AQ_MODE_CYCLIC_REFRESH &&
+      !rtc->cpi_.cyclic_refresh) {
+    free (rtc);
+    return LIBMEBO_STATUS_FAILED;
+  }
 
   *brc_codec_handler = (BrcCodecEnginePtr)rtc;
   return LIBMEBO_STATUS_SUCCESS;
@@ -308,6 +510,9 @@ brc_vp9_rate_control_init (LibMeboRateControllerConfig *cfg,
 void
 brc_vp9_rate_control_free (BrcCodecEnginePtr engine_ptr) {
   VP9RateControlRTC *rtc = (VP9RateControlRTC *) engine_ptr;
-  if (rtc)
+  if (rtc) {
+    brc_libvpx_vp9_cyclic_refresh_free(rtc->cpi_.cyclic_refresh);
+    brc_roi_free(&rtc->cpi_.roi);
     free(rtc);
+  }
 }
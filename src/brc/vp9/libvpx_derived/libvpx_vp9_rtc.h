@@ -51,27 +51,55 @@ typedef struct _VP9RateControlRTC {
 
 VP9RateControlRTC * brc_vp9_rate_control_new (LibMeboRateControllerConfig *cfg);
 
-void
+LIBMEBO_API void
 brc_vp9_rate_control_free (BrcCodecEnginePtr rtc);
 
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 brc_vp9_update_rate_control(BrcCodecEnginePtr rtc_api, LibMeboRateControllerConfig *rc_cfg);
 
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 brc_vp9_compute_qp (BrcCodecEnginePtr rtc_api, LibMeboRCFrameParams *frame_params);
 
 // GetQP() needs to be called after ComputeQP() to get the latest QP
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 brc_vp9_get_qp(BrcCodecEnginePtr rtc_api, int *qp);
 
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 brc_vp9_get_loop_filter_level(BrcCodecEnginePtr rtc_api, int *lf);
 
+LIBMEBO_API LibMeboStatus
+brc_vp9_get_loop_filter_params(BrcCodecEnginePtr rtc_api,
+    LibMeboLoopFilterParams *params);
+
+// GetSegmentationMap() needs to be called after ComputeQP()
+LIBMEBO_API LibMeboStatus
+brc_vp9_get_segmentation_map(BrcCodecEnginePtr rtc_api,
+    LibMeboSegmentationMap *seg_map);
+
+// GetGoldenFramePlan() needs to be called after ComputeQP()
+LIBMEBO_API LibMeboStatus
+brc_vp9_get_golden_frame_plan(BrcCodecEnginePtr rtc_api,
+    LibMeboGoldenFramePlan *plan);
+
+// Best frame for the next key frame within max_interval frames
+LIBMEBO_API LibMeboStatus
+brc_vp9_get_keyframe_advice(BrcCodecEnginePtr rtc_api, int max_interval,
+    LibMeboKeyFrameAdvice *advice);
+
+// Regions of interest of a spatial layer, applied from the next ComputeQP()
+LIBMEBO_API LibMeboStatus
+brc_vp9_set_roi(BrcCodecEnginePtr rtc_api, const LibMeboRoiConfig *roi);
+
+// Qindex delta scaling the rate of a block of the current frame by rate_ratio
+LIBMEBO_API LibMeboStatus
+brc_vp9_get_qdelta_by_rate(BrcCodecEnginePtr rtc_api, double rate_ratio,
+    int *qdelta);
+
 // Feedback to rate control with the size of current encoded frame
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 brc_vp9_post_encode_update(BrcCodecEnginePtr rtc_api, uint64_t encoded_frame_size);
 
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 brc_vp9_rate_control_init (LibMeboRateControllerConfig *rc_cfg,
     BrcCodecEnginePtr *brc_codec_handler);
 
@@ -62,6 +62,7 @@ void vp9_init_layer_context(VP9_COMP *const cpi) {
       if (cpi->oxcf.rc_mode == VPX_CBR) {
         lc->target_bandwidth = oxcf->layer_target_bitrate[layer];
         lrc->last_q[INTER_FRAME] = oxcf->worst_allowed_q;
+        lrc->last_coded_qindex = oxcf->worst_allowed_q;
         lrc->avg_frame_qindex[INTER_FRAME] = oxcf->worst_allowed_q;
         lrc->avg_frame_qindex[KEY_FRAME] = oxcf->worst_allowed_q;
       }
@@ -69,6 +70,15 @@ void vp9_init_layer_context(VP9_COMP *const cpi) {
       lrc->buffer_level =
           oxcf->starting_buffer_level_ms * lc->target_bandwidth / 1000;
       lrc->bits_off_target = lrc->buffer_level;
+      // Initialize the cyclic refresh parameters. If spatial layers are used
+      // (i.e., ss_number_layers > 1), these need to be updated per spatial
+      // layer.
+      // Cyclic refresh is only applied on base temporal layer.
+      if (oxcf->ss_number_layers > 1 && tl == 0) {
+        lc->sb_index = 0;
+        lc->actual_num_seg1_blocks = 0;
+        lc->actual_num_seg2_blocks = 0;
+      }
     }
   }
 
@@ -83,7 +93,7 @@ void vp9_update_layer_context_change_config(VP9_COMP *const cpi,
                                             const int target_bandwidth) {
   SVC *const svc = &cpi->svc;
   const VP9EncoderConfig *const oxcf = &cpi->oxcf;
-  const RATE_CONTROL *const rc = &cpi->rc;
+  const RATE_CONTROL *const rc = cpi->rc;
   int sl, tl, layer = 0, spatial_layer_target;
   float bitrate_alloc = 1.0;
   int num_spatial_layers_nonzero_rate = 0;
@@ -199,7 +209,7 @@ void vp9_update_temporal_layer_framerate(VP9_COMP *const cpi) {
 
   lc->framerate = cpi->framerate / oxcf->ts_rate_decimator[tl];
   lrc->avg_frame_bandwidth = (int)(lc->target_bandwidth / lc->framerate);
-  lrc->max_frame_bandwidth = cpi->rc.max_frame_bandwidth;
+  lrc->max_frame_bandwidth = cpi->rc->max_frame_bandwidth;
   // Update the average layer frame size (non-cumulative per-frame-bw).
   if (tl == 0) {
     lc->avg_frame_size = lrc->avg_frame_bandwidth;
@@ -216,10 +226,10 @@ void vp9_update_temporal_layer_framerate(VP9_COMP *const cpi) {
 
 void vp9_restore_layer_context(VP9_COMP *const cpi) {
   LAYER_CONTEXT *const lc = get_layer_context(cpi);
-  const int old_frame_since_key = cpi->rc.frames_since_key;
-  const int old_frame_to_key = cpi->rc.frames_to_key;
+  const int old_frame_since_key = cpi->rc->frames_since_key;
+  const int old_frame_to_key = cpi->rc->frames_to_key;
 
-  cpi->rc = lc->rc;
+  cpi->rc = &lc->rc;
   //cpi->twopass = lc->twopass;
   cpi->oxcf.target_bandwidth = lc->target_bandwidth;
   // Check if it is one_pass_cbr_svc mode and lc->speed > 0 (real-time mode
@@ -231,8 +241,18 @@ void vp9_restore_layer_context(VP9_COMP *const cpi) {
   // before the layer restore. Keep these defined for the stream (not layer).
   if (cpi->svc.number_temporal_layers > 1 ||
       cpi->svc.number_spatial_layers > 1) {
-    cpi->rc.frames_since_key = old_frame_since_key;
-    cpi->rc.frames_to_key = old_frame_to_key;
+    cpi->rc->frames_since_key = old_frame_since_key;
+    cpi->rc->frames_to_key = old_frame_to_key;
+  }
+
+  // For spatial-svc, allow cyclic-refresh to be applied on the spatial layers,
+  // for the base temporal layer.
+  if (cpi->oxcf.aq_mode == CYCLIC_REFRESH_AQ &&
+      cpi->svc.number_spatial_layers > 1 && cpi->svc.temporal_layer_id == 0) {
+    CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+    cr->sb_index = lc->sb_index;
+    cr->actual_num_seg1_blocks = lc->actual_num_seg1_blocks;
+    cr->actual_num_seg2_blocks = lc->actual_num_seg2_blocks;
   }
 }
 
@@ -240,10 +260,20 @@ void vp9_save_layer_context(VP9_COMP *const cpi) {
   const VP9EncoderConfig *const oxcf = &cpi->oxcf;
   LAYER_CONTEXT *const lc = get_layer_context(cpi);
 
-  lc->rc = cpi->rc;
+  // cpi->rc points at lc->rc since the restore, there is nothing to copy.
   //Fixme: one one pass supported
   //lc->twopass = cpi->twopass;
   lc->target_bandwidth = (int)oxcf->target_bandwidth;
+
+  // For spatial-svc, allow cyclic-refresh to be applied on the spatial layers,
+  // for the base temporal layer.
+  if (oxcf->aq_mode == CYCLIC_REFRESH_AQ &&
+      cpi->svc.number_spatial_layers > 1 && cpi->svc.temporal_layer_id == 0) {
+    CYCLIC_REFRESH *const cr = cpi->cyclic_refresh;
+    lc->sb_index = cr->sb_index;
+    lc->actual_num_seg1_blocks = cr->actual_num_seg1_blocks;
+    lc->actual_num_seg2_blocks = cr->actual_num_seg2_blocks;
+  }
 }
 
 void get_layer_resolution(const int width_org, const int height_org,
@@ -264,6 +294,25 @@ void get_layer_resolution(const int width_org, const int height_org,
   *height_out = h;
 }
 
+void vp9_svc_update_layer_geometry(VP9_COMP *const cpi) {
+  SVC *const svc = &cpi->svc;
+  int sl;
+  for (sl = 0; sl < svc->number_spatial_layers; ++sl) {
+    const LAYER_CONTEXT *const lc =
+        &svc->layer_context[LAYER_IDS_TO_IDX(sl, 0,
+                                             svc->number_temporal_layers)];
+    FRAME_GEOMETRY *const geometry = &svc->layer_geometry[sl];
+    int width = cpi->oxcf.width;
+    int height = cpi->oxcf.height;
+    if (svc->number_spatial_layers > 1)
+      get_layer_resolution(cpi->oxcf.width, cpi->oxcf.height,
+                           lc->scaling_factor_num, lc->scaling_factor_den,
+                           &width, &height);
+    if (width != geometry->width || height != geometry->height)
+      brc_libvpx_vp9_calc_frame_geometry(geometry, width, height);
+  }
+}
+
 // Reset on key frame: reset counters, references and buffer updates.
 void vp9_svc_reset_temporal_layers(VP9_COMP *const cpi, int is_key) {
   int sl, tl;
@@ -322,7 +371,7 @@ void vp9_svc_check_spatial_layer_sync(VP9_COMP *const cpi) {
 void vp9_svc_adjust_avg_frame_qindex(VP9_COMP *const cpi) {
   VP9_COMMON *const cm = &cpi->common;
   SVC *const svc = &cpi->svc;
-  RATE_CONTROL *const rc = &cpi->rc;
+  RATE_CONTROL *const rc = cpi->rc;
   // On key frames in CBR mode: reset the avg_frame_index for base layer
   // (to level closer to worst_quality) if the overshoot is significant.
   // Reset it for all temporal layers on base spatial layer.
@@ -20,21 +20,18 @@ typedef struct {
   int spatial_layer_target_bandwidth;  // Target for the spatial layer.
   double framerate;
   int avg_frame_size;
-  int max_q;
-  int min_q;
   int scaling_factor_num;
   int scaling_factor_den;
-  // Scaling factors used for internal resize scaling for single layer SVC.
-  int scaling_factor_num_resize;
-  int scaling_factor_den_resize;
   unsigned int current_video_frame_in_layer;
   int is_key_frame;
   int frames_from_key_frame;
   FRAME_TYPE last_frame_type;
-  int alt_ref_idx;
   int gold_ref_idx;
-  int has_alt_frame;
   size_t layer_size;
+  // Cyclic refresh parameters (aq-mode=3), that need to be updated per-frame.
+  int sb_index;
+  int actual_num_seg1_blocks;
+  int actual_num_seg2_blocks;
   uint8_t speed;
 } LAYER_CONTEXT;
 
@@ -49,6 +46,8 @@ typedef struct SVC {
   // Layer context used for rate control in one pass temporal CBR mode or
   // two pass spatial mode.
   LAYER_CONTEXT layer_context[VPX_MAX_LAYERS];
+  // Frame geometry of each spatial layer, computed when the config is set.
+  FRAME_GEOMETRY layer_geometry[VPX_SS_MAX_LAYERS];
   // Indicates what sort of temporal layering is used.
   // Currently, this only works for CBR mode.
   VP9E_TEMPORAL_LAYERING_MODE temporal_layering_mode;
@@ -85,6 +84,10 @@ void get_layer_resolution(const int width_org, const int height_org,
                           const int num, const int den, int *width_out,
                           int *height_out);
 
+// Update the frame geometry of the spatial layers whose size changed with
+// the config.
+void vp9_svc_update_layer_geometry(struct VP9_COMP *const cpi);
+
 void vp9_svc_reset_temporal_layers(struct VP9_COMP *const cpi, int is_key);
 
 void vp9_svc_check_reset_layer_rc_flag(struct VP9_COMP *cpi);
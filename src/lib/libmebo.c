@@ -21,6 +21,7 @@
 #endif
 
 #include "libmebo.h"
+#include "brc/common/brc_activity_aq.h"
 #if LIBMEBO_ENABLE_VP9
 #include "brc/vp9/libvpx_derived/libvpx_vp9_rtc.h"
 #endif
@@ -30,10 +31,56 @@
 #if LIBMEBO_ENABLE_AV1
 #include "brc/av1/aom_derived/aom_av1_rtc.h"
 #endif
+#if LIBMEBO_ENABLE_HEVC
+#include "brc/hevc/brc_hevc_rtc.h"
+#endif
+#if LIBMEBO_ENABLE_H264
+#include "brc/h264/brc_h264_rtc.h"
+#endif
 
 #define GET_LAYER_INDEX(s_layer, t_layer, num_temporal_layers) \
 	((s_layer) * (num_temporal_layers) + (t_layer))
 
+#if LIBMEBO_SINGLE_CODEC
+/* Only one backend is built: the API calls it directly rather than through
+ * the function table, which lets the compiler inline the backend into the
+ * API functions, and with LTO into the caller. */
+#if LIBMEBO_ENABLE_VP8
+#define BRC_SINGLE_BACKEND(fn) brc_vp8_##fn
+#elif LIBMEBO_ENABLE_VP9
+#define BRC_SINGLE_BACKEND(fn) brc_vp9_##fn
+#define BRC_SINGLE_BACKEND_HAS_GOLDEN_FRAME_PLAN 1
+#elif LIBMEBO_ENABLE_AV1
+#define BRC_SINGLE_BACKEND(fn) brc_av1_##fn
+#elif LIBMEBO_ENABLE_HEVC
+#define BRC_SINGLE_BACKEND(fn) brc_hevc_##fn
+#elif LIBMEBO_ENABLE_H264
+#define BRC_SINGLE_BACKEND(fn) brc_h264_##fn
+#else
+#error "LIBMEBO_SINGLE_CODEC requires one enabled codec"
+#endif
+
+#define BRC_DIRECT_init BRC_SINGLE_BACKEND(rate_control_init)
+#define BRC_DIRECT_update_config BRC_SINGLE_BACKEND(update_rate_control)
+#define BRC_DIRECT_compute_qp BRC_SINGLE_BACKEND(compute_qp)
+#define BRC_DIRECT_get_qp BRC_SINGLE_BACKEND(get_qp)
+#define BRC_DIRECT_get_loop_filter BRC_SINGLE_BACKEND(get_loop_filter_level)
+#define BRC_DIRECT_get_loop_filter_params \
+	BRC_SINGLE_BACKEND(get_loop_filter_params)
+#define BRC_DIRECT_get_segmentation_map BRC_SINGLE_BACKEND(get_segmentation_map)
+#define BRC_DIRECT_get_qdelta_by_rate BRC_SINGLE_BACKEND(get_qdelta_by_rate)
+#define BRC_DIRECT_get_keyframe_advice BRC_SINGLE_BACKEND(get_keyframe_advice)
+#define BRC_DIRECT_set_roi BRC_SINGLE_BACKEND(set_roi)
+#define BRC_DIRECT_post_encode_update BRC_SINGLE_BACKEND(post_encode_update)
+#define BRC_DIRECT_free BRC_SINGLE_BACKEND(rate_control_free)
+#define BRC_DIRECT_get_golden_frame_plan \
+	BRC_SINGLE_BACKEND(get_golden_frame_plan)
+
+#define BRC_BACKEND(priv, fn) BRC_DIRECT_##fn
+#else
+#define BRC_BACKEND(priv, fn) ((priv)->brc_interface.fn)
+#endif
+
 typedef LibMeboStatus (*libmebo_brc_init_fn)(
     LibMeboRateControllerConfig *rc_config, BrcCodecEnginePtr *handler);
 
@@ -49,6 +96,24 @@ typedef LibMeboStatus (*libmebo_brc_get_qp_fn)(
 typedef LibMeboStatus (*libmebo_brc_get_loop_filter_fn)(
     BrcCodecEnginePtr handler, int *lf);
 
+typedef LibMeboStatus (*libmebo_brc_get_loop_filter_params_fn)(
+    BrcCodecEnginePtr handler, LibMeboLoopFilterParams *params);
+
+typedef LibMeboStatus (*libmebo_brc_get_segmentation_map_fn)(
+    BrcCodecEnginePtr handler, LibMeboSegmentationMap *seg_map);
+
+typedef LibMeboStatus (*libmebo_brc_get_golden_frame_plan_fn)(
+    BrcCodecEnginePtr handler, LibMeboGoldenFramePlan *plan);
+
+typedef LibMeboStatus (*libmebo_brc_get_keyframe_advice_fn)(
+    BrcCodecEnginePtr handler, int max_interval, LibMeboKeyFrameAdvice *advice);
+
+typedef LibMeboStatus (*libmebo_brc_set_roi_fn)(
+    BrcCodecEnginePtr handler, const LibMeboRoiConfig *roi);
+
+typedef LibMeboStatus (*libmebo_brc_get_qdelta_by_rate_fn)(
+    BrcCodecEnginePtr handler, double rate_ratio, int *qdelta);
+
 typedef LibMeboStatus (*libmebo_brc_post_encode_update_fn)(
     BrcCodecEnginePtr handler, uint64_t encoded_frame_size);
 
@@ -61,6 +126,12 @@ typedef struct LibMeboCodecInterface {
   libmebo_brc_compute_qp_fn compute_qp;
   libmebo_brc_get_qp_fn get_qp;
   libmebo_brc_get_loop_filter_fn get_loop_filter; 
+  libmebo_brc_get_loop_filter_params_fn get_loop_filter_params;
+  libmebo_brc_get_segmentation_map_fn get_segmentation_map;
+  libmebo_brc_get_qdelta_by_rate_fn get_qdelta_by_rate;
+  libmebo_brc_get_golden_frame_plan_fn get_golden_frame_plan;
+  libmebo_brc_get_keyframe_advice_fn get_keyframe_advice;
+  libmebo_brc_set_roi_fn set_roi;
   libmebo_brc_post_encode_update_fn post_encode_update;
   libmebo_brc_free_fn free;
 } LibMeboCodecInterface;
@@ -89,10 +160,17 @@ static const brc_algo_map algo_impl_map[] = {
       brc_vp8_compute_qp,
       brc_vp8_get_qp,
       brc_vp8_get_loop_filter_level,
+      brc_vp8_get_loop_filter_params,
+      brc_vp8_get_segmentation_map,
+      brc_vp8_get_qdelta_by_rate,
+      NULL,
+      brc_vp8_get_keyframe_advice,
+      brc_vp8_set_roi,
       brc_vp8_post_encode_update,
       brc_vp8_rate_control_free,
 #else
-      NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL,
 #endif
     },
   },
@@ -107,10 +185,17 @@ static const brc_algo_map algo_impl_map[] = {
       brc_vp9_compute_qp,
       brc_vp9_get_qp,
       brc_vp9_get_loop_filter_level,
+      brc_vp9_get_loop_filter_params,
+      brc_vp9_get_segmentation_map,
+      brc_vp9_get_qdelta_by_rate,
+      brc_vp9_get_golden_frame_plan,
+      brc_vp9_get_keyframe_advice,
+      brc_vp9_set_roi,
       brc_vp9_post_encode_update,
       brc_vp9_rate_control_free,
 #else
-      NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL,
 #endif
     },
   },
@@ -125,10 +210,67 @@ static const brc_algo_map algo_impl_map[] = {
       brc_av1_compute_qp,
       brc_av1_get_qp,
       brc_av1_get_loop_filter_level,
+      brc_av1_get_loop_filter_params,
+      brc_av1_get_segmentation_map,
+      brc_av1_get_qdelta_by_rate,
+      NULL,
+      brc_av1_get_keyframe_advice,
+      brc_av1_set_roi,
       brc_av1_post_encode_update,
       brc_av1_rate_control_free,
 #else
-      NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL,
+#endif
+    },
+  },
+  {
+    LIBMEBO_CODEC_HEVC,
+    LIBMEBO_BRC_ALGORITHM_NATIVE_HEVC,
+    "HEVC CBR algorithm",
+    {
+#if LIBMEBO_ENABLE_HEVC
+      brc_hevc_rate_control_init,
+      brc_hevc_update_rate_control,
+      brc_hevc_compute_qp,
+      brc_hevc_get_qp,
+      brc_hevc_get_loop_filter_level,
+      brc_hevc_get_loop_filter_params,
+      brc_hevc_get_segmentation_map,
+      brc_hevc_get_qdelta_by_rate,
+      NULL,
+      brc_hevc_get_keyframe_advice,
+      brc_hevc_set_roi,
+      brc_hevc_post_encode_update,
+      brc_hevc_rate_control_free,
+#else
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL,
+#endif
+    },
+  },
+  {
+    LIBMEBO_CODEC_H264,
+    LIBMEBO_BRC_ALGORITHM_NATIVE_H264,
+    "H.264 CBR algorithm",
+    {
+#if LIBMEBO_ENABLE_H264
+      brc_h264_rate_control_init,
+      brc_h264_update_rate_control,
+      brc_h264_compute_qp,
+      brc_h264_get_qp,
+      brc_h264_get_loop_filter_level,
+      brc_h264_get_loop_filter_params,
+      brc_h264_get_segmentation_map,
+      brc_h264_get_qdelta_by_rate,
+      NULL,
+      brc_h264_get_keyframe_advice,
+      brc_h264_set_roi,
+      brc_h264_post_encode_update,
+      brc_h264_rate_control_free,
+#else
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL,
 #endif
     },
   },
@@ -136,7 +278,8 @@ static const brc_algo_map algo_impl_map[] = {
     LIBMEBO_CODEC_UNKNOWN,
     LIBMEBO_BRC_ALGORITHM_UNKNOWN,
     "Unknown",
-    { NULL, NULL, NULL, NULL, NULL, NULL, NULL },
+    { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      NULL, NULL },
   },
 };
 
@@ -150,6 +293,10 @@ get_default_algorithm_id (LibMeboCodecType codec_type)
       return LIBMEBO_BRC_ALGORITHM_DERIVED_LIBVPX_VP9;
     case LIBMEBO_CODEC_AV1:
       return LIBMEBO_BRC_ALGORITHM_DERIVED_AOM_AV1;
+    case LIBMEBO_CODEC_HEVC:
+      return LIBMEBO_BRC_ALGORITHM_NATIVE_HEVC;
+    case LIBMEBO_CODEC_H264:
+      return LIBMEBO_BRC_ALGORITHM_NATIVE_H264;
     case LIBMEBO_CODEC_UNKNOWN:
       return LIBMEBO_BRC_ALGORITHM_UNKNOWN;
     default:
@@ -198,13 +345,203 @@ libmebo_rate_controller_get_loop_filter_level(LibMeboRateController *rc, int *lf
     return status;
   priv = (LibMeboRateControllerPrivate *)rc->priv;
 
-  status = priv->brc_interface.get_loop_filter (priv->brc_codec_handler, lf);
-  if (status != LIBMEBO_STATUS_SUCCESS)
+  status = BRC_BACKEND (priv, get_loop_filter) (priv->brc_codec_handler, lf);
+  if (status != LIBMEBO_STATUS_SUCCESS &&
+      status != LIBMEBO_STATUS_UNIMPLEMENTED)
     fprintf(stderr, "Failed to get the Loop filter level\n");
 
   return status;
 }
 
+/**
+ * \brief libmebo_rate_controller_get_loop_filter_params:
+ *
+ * Get the in-loop filter parameters for the current frame
+ *
+ * @param[in] rc                   LibMeboRateController to be initialized
+ * @param[out] params              Retruns proposed in-loop filter parameters for the current frame
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LibMeboStatus
+libmebo_rate_controller_get_loop_filter_params(LibMeboRateController *rc,
+    LibMeboLoopFilterParams *params)
+{
+  LibMeboStatus status = LIBMEBO_STATUS_UNKNOWN;
+  LibMeboRateControllerPrivate *priv;
+
+  if (!rc || !params)
+    return status;
+  priv = (LibMeboRateControllerPrivate *)rc->priv;
+
+  memset(params, 0, sizeof(*params));
+  status = BRC_BACKEND (priv, get_loop_filter_params) (priv->brc_codec_handler,
+		  params);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    fprintf(stderr, "Failed to get the Loop filter parameters\n");
+
+  return status;
+}
+
+/**
+ * \brief libmebo_rate_controller_get_segmentation_map:
+ *
+ * Get the segmentation map and per-segment delta-QPs for the current frame
+ *
+ * @param[in] rc                   LibMeboRateController to be initialized
+ * @param[out] seg_map             Retruns proposed segmentation for the current frame
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LibMeboStatus
+libmebo_rate_controller_get_segmentation_map(LibMeboRateController *rc,
+    LibMeboSegmentationMap *seg_map)
+{
+  LibMeboStatus status = LIBMEBO_STATUS_UNKNOWN;
+  LibMeboRateControllerPrivate *priv;
+
+  if (!rc || !seg_map)
+    return status;
+  priv = (LibMeboRateControllerPrivate *)rc->priv;
+
+  status = BRC_BACKEND (priv, get_segmentation_map) (priv->brc_codec_handler,
+		  seg_map);
+  if (status != LIBMEBO_STATUS_SUCCESS &&
+      status != LIBMEBO_STATUS_UNIMPLEMENTED)
+    fprintf(stderr, "Failed to get the Segmentation map\n");
+
+  return status;
+}
+
+/**
+ * \brief libmebo_rate_controller_get_golden_frame_plan:
+ *
+ * Get the golden frame refresh plan for the current frame
+ *
+ * @param[in] rc                   LibMeboRateController to be initialized
+ * @param[out] plan                Retruns golden frame plan for the current frame
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LibMeboStatus
+libmebo_rate_controller_get_golden_frame_plan(LibMeboRateController *rc,
+    LibMeboGoldenFramePlan *plan)
+{
+  LibMeboStatus status = LIBMEBO_STATUS_UNKNOWN;
+  LibMeboRateControllerPrivate *priv;
+
+  if (!rc || !plan)
+    return status;
+  priv = (LibMeboRateControllerPrivate *)rc->priv;
+#if LIBMEBO_SINGLE_CODEC && !BRC_SINGLE_BACKEND_HAS_GOLDEN_FRAME_PLAN
+  (void) priv;
+  return LIBMEBO_STATUS_UNIMPLEMENTED;
+#else
+#if !LIBMEBO_SINGLE_CODEC
+  if (!priv->brc_interface.get_golden_frame_plan)
+    return LIBMEBO_STATUS_UNIMPLEMENTED;
+#endif
+
+  memset(plan, 0, sizeof(*plan));
+  status = BRC_BACKEND (priv, get_golden_frame_plan) (priv->brc_codec_handler,
+		  plan);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    fprintf(stderr, "Failed to get the Golden frame plan\n");
+
+  return status;
+#endif
+}
+
+/**
+ * \brief libmebo_rate_controller_get_keyframe_advice:
+ *
+ * Get the best frame to place the next key frame and its predicted size
+ *
+ * @param[in] rc                   LibMeboRateController to be initialized
+ * @param[in] max_interval         Latest acceptable key frame, in frames from the next frame
+ * @param[out] advice              Retruns key frame placement advice
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LibMeboStatus
+libmebo_rate_controller_get_keyframe_advice(LibMeboRateController *rc,
+    int max_interval, LibMeboKeyFrameAdvice *advice)
+{
+  LibMeboStatus status = LIBMEBO_STATUS_UNKNOWN;
+  LibMeboRateControllerPrivate *priv;
+
+  if (!rc || !advice)
+    return status;
+  priv = (LibMeboRateControllerPrivate *)rc->priv;
+
+  memset(advice, 0, sizeof(*advice));
+  status = BRC_BACKEND (priv, get_keyframe_advice) (priv->brc_codec_handler,
+		  max_interval, advice);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    fprintf(stderr, "Failed to get the Key frame advice\n");
+
+  return status;
+}
+
+/**
+ * \brief libmebo_rate_controller_set_roi:
+ *
+ * Set the regions of interest of a spatial layer
+ *
+ * @param[in] rc                   LibMeboRateController to be initialized
+ * @param[in] roi                  Regions of interest of a spatial layer
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LibMeboStatus
+libmebo_rate_controller_set_roi(LibMeboRateController *rc,
+    const LibMeboRoiConfig *roi)
+{
+  LibMeboStatus status = LIBMEBO_STATUS_UNKNOWN;
+  LibMeboRateControllerPrivate *priv;
+
+  if (!rc || !roi)
+    return status;
+  priv = (LibMeboRateControllerPrivate *)rc->priv;
+
+  status = BRC_BACKEND (priv, set_roi) (priv->brc_codec_handler, roi);
+  if (status != LIBMEBO_STATUS_SUCCESS &&
+      status != LIBMEBO_STATUS_UNIMPLEMENTED)
+    fprintf(stderr, "Failed to set the Regions of interest\n");
+
+  return status;
+}
+
+/**
+ * \brief libmebo_rate_controller_compute_activity_map:
+ *
+ * Compute the activity based segmentation map for the current frame
+ *
+ * @param[in] rc                   LibMeboRateController to be initialized
+ * @param[in] activity             Block variances of the current frame
+ * @param[out] seg_map             Retruns activity segmentation for the current frame
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LibMeboStatus
+libmebo_rate_controller_compute_activity_map(LibMeboRateController *rc,
+    const LibMeboActivityInfo *activity, LibMeboSegmentationMap *seg_map)
+{
+  LibMeboStatus status = LIBMEBO_STATUS_UNKNOWN;
+  LibMeboRateControllerPrivate *priv;
+
+  if (!rc || !activity || !seg_map)
+    return status;
+  priv = (LibMeboRateControllerPrivate *)rc->priv;
+
+  status = brc_activity_aq_compute_map (priv->brc_codec_handler,
+		  BRC_BACKEND (priv, get_qdelta_by_rate), activity, seg_map);
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    fprintf(stderr, "Failed to compute the Activity map\n");
+
+  return status;
+}
+
 /**
  * \brief libmebo_rate_controller_get_qp:
  *
@@ -225,7 +562,7 @@ libmebo_rate_controller_get_qp(LibMeboRateController *rc, int *qp)
     return status;
   priv = (LibMeboRateControllerPrivate *)rc->priv;
 
-  status = priv->brc_interface.get_qp (priv->brc_codec_handler, qp);
+  status = BRC_BACKEND (priv, get_qp) (priv->brc_codec_handler, qp);
   if (status != LIBMEBO_STATUS_SUCCESS)
     fprintf(stderr, "Failed to get the QP\n");
 
@@ -254,7 +591,7 @@ libmebo_rate_controller_compute_qp (LibMeboRateController *rc,
     return status;
   priv = (LibMeboRateControllerPrivate *)rc->priv;
 
-  status = priv->brc_interface.compute_qp (priv->brc_codec_handler, &rc_frame_params);
+  status = BRC_BACKEND (priv, compute_qp) (priv->brc_codec_handler, &rc_frame_params);
   if (status != LIBMEBO_STATUS_SUCCESS)
     fprintf(stderr, "Failed to compute the QP\n");
 
@@ -284,7 +621,7 @@ libmebo_rate_controller_post_encode_update (LibMeboRateController *rc,
     return status;
   priv = (LibMeboRateControllerPrivate *)rc->priv;
   
-  status = priv->brc_interface.post_encode_update (priv->brc_codec_handler,
+  status = BRC_BACKEND (priv, post_encode_update) (priv->brc_codec_handler,
 		  encoded_frame_size);
   if (status != LIBMEBO_STATUS_SUCCESS)
     fprintf(stderr, "Failed to do the post encode update \n");
@@ -315,7 +652,7 @@ libmebo_rate_controller_update_config (LibMeboRateController *rc,
     return status;
   priv = (LibMeboRateControllerPrivate *)rc->priv;
 
-  status = priv->brc_interface.update_config (priv->brc_codec_handler, rc_config);
+  status = BRC_BACKEND (priv, update_config) (priv->brc_codec_handler, rc_config);
   if (status != LIBMEBO_STATUS_SUCCESS)
     fprintf(stderr, "Failed to Update the RateController\n");
 
@@ -345,13 +682,13 @@ libmebo_rate_controller_init (LibMeboRateController *rc,
     return status;
   priv = (LibMeboRateControllerPrivate *)rc->priv;
 
-  status = priv->brc_interface.init (rc_config, &priv->brc_codec_handler);
+  status = BRC_BACKEND (priv, init) (rc_config, &priv->brc_codec_handler);
   if (status != LIBMEBO_STATUS_SUCCESS)
     fprintf(stderr, "Failed to Initialize the RateController\n");
 
   //ToDo: Make it explicit to enforce the algorithm implementor to validate
   //the input params 
-  //brc_status = priv->brc_interface.validate (rc_config, &priv->brc_codec_handler);
+  //brc_status = BRC_BACKEND (priv, validate) (rc_config, &priv->brc_codec_handler);
  
   return status;
 }
@@ -372,7 +709,7 @@ libmebo_rate_controller_free (LibMeboRateController *rc)
 
   LibMeboRateControllerPrivate *priv = (LibMeboRateControllerPrivate *)rc->priv;
   
-  priv->brc_interface.free (priv->brc_codec_handler);
+  BRC_BACKEND (priv, free) (priv->brc_codec_handler);
   free (rc->priv);
   free (rc);
   rc = NULL;
@@ -396,7 +733,8 @@ libmebo_rate_controller_new (LibMeboCodecType codec_type,
   LibMeboRateControllerPrivate *priv;
 
   const brc_algo_map *brc_backend = get_backend_impl (codec_type, algo_id);
-  if (brc_backend == NULL) {
+  // The backends of the codecs disabled at build time have no functions.
+  if (brc_backend == NULL || brc_backend->algo_interface.init == NULL) {
     fprintf (stderr, "Error: Unsupported Codec/Algorithm \n");
     return NULL;
   }
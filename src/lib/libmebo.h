@@ -71,6 +71,7 @@
  *   }
  *
  *   //Initialize the per-frame parameters (frame_type & layer ids)
+ *   memset (&rc_frame_param, 0, sizeof (rc_frame_param));
  *   __InitializeRCFrameParams (rc_frame_param);
  *
  *   //Compute the QP
@@ -100,6 +101,13 @@
 extern "C" {
 #endif
 
+/* Symbols of the library API, the others are hidden */
+#if defined(__GNUC__) && __GNUC__ >= 4
+#define LIBMEBO_API __attribute__ ((visibility ("default")))
+#else
+#define LIBMEBO_API
+#endif
+
 typedef void* BrcCodecEnginePtr;
 
 /** 
@@ -109,6 +117,8 @@ typedef enum {
   LIBMEBO_CODEC_VP8,
   LIBMEBO_CODEC_VP9,
   LIBMEBO_CODEC_AV1,
+  LIBMEBO_CODEC_HEVC,
+  LIBMEBO_CODEC_H264,
   LIBMEBO_CODEC_UNKNOWN,
 } LibMeboCodecType;
 
@@ -121,6 +131,8 @@ typedef enum
   LIBMEBO_BRC_ALGORITHM_DERIVED_LIBVPX_VP8,
   LIBMEBO_BRC_ALGORITHM_DERIVED_LIBVPX_VP9,
   LIBMEBO_BRC_ALGORITHM_DERIVED_AOM_AV1,
+  LIBMEBO_BRC_ALGORITHM_NATIVE_HEVC,
+  LIBMEBO_BRC_ALGORITHM_NATIVE_H264,
   LIBMEBO_BRC_ALGORITHM_UNKNOWN,
 } LibMeboBrcAlgorithmID;
 
@@ -147,6 +159,22 @@ typedef enum {
   LIBMEBO_RC_VBR
 } LibMeboRateControlMode;
 
+/**
+ * Adaptive Quantization Modes
+ */
+typedef enum {
+  LIBMEBO_AQ_MODE_NONE = 0,
+  LIBMEBO_AQ_MODE_CYCLIC_REFRESH = 1,
+} LibMeboAQMode;
+
+/**
+ * Content Types
+ */
+typedef enum {
+  LIBMEBO_CONTENT_DEFAULT = 0,
+  LIBMEBO_CONTENT_SCREEN = 1,
+} LibMeboContentType;
+
 /** 
  * Frame prediction types
  */
@@ -156,16 +184,40 @@ typedef enum {
   LIBMEBO_FRAME_TYPES,
 } LibMeboFrameType;
 
+/**
+ * Frame flags
+ *
+ * LIBMEBO_FRAME_FLAG_UNCHANGED: the source frame is identical to the
+ * previous one, e.g. a static desktop during screen sharing. The inter
+ * frame gets a near-zero target and keeps the q of the previous frame,
+ * the unspent bits stay in the buffer for the next change.
+ * The flag is ignored for key frames.
+ *
+ * LIBMEBO_FRAME_FLAG_SCENE_CHANGE: the frame starts a new scene. The rate
+ * model is re-estimated from the size of this frame alone instead of
+ * converging over the next frames. A frame much larger or smaller than
+ * predicted is treated the same way without the flag.
+ */
+#define LIBMEBO_FRAME_FLAG_UNCHANGED (1 << 0)
+#define LIBMEBO_FRAME_FLAG_SCENE_CHANGE (1 << 1)
+
 /** 
  * \biref Frame parameters
  *
  * This structure conveys frame level parameters and should be sent
- * once per frame
+ * once per frame. Zero the whole structure (memset or "= { 0 }") before
+ * filling it in, fields added to the reserved space later keep their
+ * default behaviour at zero.
  */
 typedef struct _LibMeboRCFrameParams {
   LibMeboFrameType frame_type;
   int spatial_layer_id;
   int temporal_layer_id;
+  /* Bitwise OR of LIBMEBO_FRAME_FLAG_*, zero for a regular frame */
+  uint32_t flags;
+
+  /* Reserved bytes for future use, must be zero */
+  uint32_t _libmebo_frame_params_reserved[12];
 } LibMeboRCFrameParams;
 
 /* Temporal Scalability: Maximum number of coding layers.
@@ -379,10 +431,311 @@ typedef struct _LibMeboRateControllerConfig {
    */
   LibMeboRateControlMode rc_mode;
 
+  /**
+   * \brief Adaptive quantization mode
+   *
+   * LIBMEBO_AQ_MODE_CYCLIC_REFRESH enables the cyclic background refresh:
+   * a slice of the frame is coded at a lower QP on every frame, cycling
+   * through the whole picture. The segmentation map and the per-segment
+   * delta-QPs can be retrieved with
+   * libmebo_rate_controller_get_segmentation_map().
+   *
+   * It is not guaranteed that all brc algorithms will support this
+   * feature. HEVC and H.264 have no segmentation and only accept
+   * LIBMEBO_AQ_MODE_NONE.
+   */
+  LibMeboAQMode aq_mode;
+
+  /**
+   * \brief Bit depth of the coded samples: 8, 10 or 12
+   *
+   * 0 is the same as 8. High bit depths select the quantizer tables of
+   * the matching profile, e.g. VP9 profile 2 for 10 and 12 bits.
+   * The HEVC and H.264 QPs extend below 0 down to -6 * (bit_depth - 8),
+   * the min/max quantizer range scales over the extended QP range.
+   *
+   * It is not guaranteed that all brc algorithms will support this
+   * feature. The libmebo_rate_controller_init() is responsible for
+   * the codec specific parameter validation.
+   */
+  int bit_depth;
+
+  /**
+   * \brief Type of the source content
+   *
+   * LIBMEBO_CONTENT_SCREEN tunes the rate control for screen sharing:
+   * long static periods followed by sudden scroll or slide changes.
+   * Combine it with LIBMEBO_FRAME_FLAG_UNCHANGED for the static frames.
+   *
+   * It is not guaranteed that all brc algorithms will support this
+   * feature.
+   */
+  LibMeboContentType content_type;
+
+  /**
+   * \brief Golden frame boost in percent: Range: 0 - 1000
+   *
+   * Non-zero enables the golden frame plan of single layer streams: the
+   * rate control picks an interval for the golden (long-term) reference
+   * refreshes, and gives the refresh frames a target size this much
+   * larger than the other frames of the interval, and a lower QP. The
+   * plan is retrieved with libmebo_rate_controller_get_golden_frame_plan().
+   * 0 refreshes the golden frame on key frames only.
+   *
+   * It is not guaranteed that all brc algorithms will support this
+   * feature.
+   */
+  int gf_cbr_boost_pct;
+
   /* Reserved bytes for future use, must be zero */
-  uint32_t _libmebo_rc_config_reserved[32];
+  uint32_t _libmebo_rc_config_reserved[28];
 } LibMeboRateControllerConfig;
 
+/* Maximum number of segments in a segmentation map */
+#define LIBMEBO_MAX_SEGMENTS 8
+
+/**
+ * \brief Segmentation map
+ *
+ * This structure conveys the per-block segment ids and the
+ * delta-QP of each segment for the frame whose QP was last computed.
+ */
+typedef struct _LibMeboSegmentationMap {
+  /** \brief Non-zero if the segmentation should be applied to the frame */
+  int enabled;
+
+  /** \brief Size in pixels of the square block covered by one map entry */
+  int block_size;
+
+  /** \brief Number of map entries per row */
+  int cols;
+
+  /** \brief Number of map rows */
+  int rows;
+
+  /** \brief Number of segments in use, segment ids are below this value */
+  int num_segments;
+
+  /**
+   * \brief Delta-QP of each segment
+   *
+   * The values are expressed in the codec specific quantizer index
+   * units, the same units returned by libmebo_rate_controller_get_qp().
+   */
+  int delta_qp[LIBMEBO_MAX_SEGMENTS];
+
+  /**
+   * \brief Caller allocated buffer of map_size bytes
+   *
+   * On return holds rows * cols segment ids in raster order. Can be NULL
+   * to query the map dimensions only.
+   */
+  uint8_t *map;
+
+  /** \brief Size in bytes of the map buffer */
+  uint32_t map_size;
+} LibMeboSegmentationMap;
+
+/**
+ * \brief Loop restoration type of a plane
+ *
+ * Same order as the RestorationType of libaom, which differs from the
+ * lr_type coding of the AV1 frame header.
+ */
+typedef enum {
+  LIBMEBO_RESTORE_NONE,
+  LIBMEBO_RESTORE_WIENER,
+  LIBMEBO_RESTORE_SGRPROJ,
+  LIBMEBO_RESTORE_SWITCHABLE,
+} LibMeboRestorationType;
+
+/**
+ * \brief In-loop filter parameters
+ *
+ * Estimates of the in-loop filter parameters of the frame whose QP was
+ * last computed, derived from the frame QP and type. Codecs with a single
+ * deblocking level report it in all the filter_level fields, and leave
+ * the CDEF and loop restoration fields zero.
+ */
+typedef struct _LibMeboLoopFilterParams {
+  /** \brief Luma deblocking level of the vertical [0] and horizontal [1] edges */
+  int filter_level[2];
+
+  /** \brief Deblocking level of the U plane */
+  int filter_level_u;
+
+  /** \brief Deblocking level of the V plane */
+  int filter_level_v;
+
+  /** \brief Deblocking sharpness */
+  int sharpness;
+
+  /** \brief CDEF damping, cdef_damping_minus_3 + 3 of the AV1 syntax */
+  int cdef_damping;
+
+  /** \brief Number of bits of the per-superblock CDEF index */
+  int cdef_bits;
+
+  /**
+   * \brief CDEF strength of the luma and chroma planes
+   *
+   * Coded as primary strength * 4 + secondary strength, the way the AV1
+   * frame header codes cdef_y_strengths / cdef_uv_strengths.
+   */
+  int cdef_y_strength;
+  int cdef_uv_strength;
+
+  /** \brief Loop restoration type of the Y, U and V planes */
+  LibMeboRestorationType restoration_type[3];
+
+  /**
+   * \brief Deblocking offsets of the HEVC and H.264 slice headers
+   *
+   * slice_beta_offset_div2 and slice_tc_offset_div2 of HEVC, or
+   * slice_beta_offset_div2 and slice_alpha_c0_offset_div2 of H.264, in the
+   * range -6 to 6. These codecs have no deblocking level, the filter_level
+   * fields are zero.
+   */
+  int deblock_beta_offset;
+  int deblock_tc_offset;
+
+  /* Reserved bytes for future use, must be zero */
+  uint32_t _libmebo_lf_params_reserved[14];
+} LibMeboLoopFilterParams;
+
+/* Maximum number of regions of interest per spatial layer */
+#define LIBMEBO_MAX_ROIS 8
+
+/* Highest region of interest priority */
+#define LIBMEBO_MAX_ROI_PRIORITY 3
+
+/**
+ * \brief Region of interest
+ *
+ * A rectangle, in the pixels of the spatial layer it is set for, that
+ * should be coded at a higher quality than the rest of the frame.
+ */
+typedef struct _LibMeboRoi {
+  int x;
+  int y;
+  int width;
+  int height;
+
+  /**
+   * \brief Priority of the region, 1 to LIBMEBO_MAX_ROI_PRIORITY
+   *
+   * Higher priorities get a larger share of the frame bits. Where
+   * regions overlap, the highest priority applies.
+   */
+  int priority;
+} LibMeboRoi;
+
+/**
+ * \brief Regions of interest of a spatial layer
+ *
+ * The regions stay in effect for all the following frames of the
+ * spatial layer until they are replaced, num_rois = 0 clears them.
+ */
+typedef struct _LibMeboRoiConfig {
+  /** \brief Spatial layer the regions apply to */
+  int spatial_layer_id;
+
+  /** \brief Number of valid entries in rois */
+  int num_rois;
+
+  LibMeboRoi rois[LIBMEBO_MAX_ROIS];
+} LibMeboRoiConfig;
+
+/**
+ * \brief Block activity of a frame
+ *
+ * Per-block luma variances computed by the caller, used to derive
+ * an activity based (perceptual) delta-QP map.
+ */
+typedef struct _LibMeboActivityInfo {
+  /** \brief rows * cols block variances in raster order */
+  const uint32_t *variance;
+
+  /** \brief Size in pixels of the square block of each variance, e.g. 16 */
+  int block_size;
+
+  /** \brief Number of blocks per row */
+  int cols;
+
+  /** \brief Number of block rows */
+  int rows;
+
+  /**
+   * \brief Strength of the modulation
+   *
+   * At 1.0 the rate of a block is scaled by 2^-0.25 per doubling of its
+   * variance relative to the frame average. 0 selects the default of 1.0,
+   * values are capped to 4.0.
+   */
+  float strength;
+} LibMeboActivityInfo;
+
+/**
+ * \brief Golden frame plan
+ *
+ * Reference refresh recommendation of the rate control for the frame
+ * whose QP was last computed. The QP and target size of the frame
+ * already account for the boost of a refresh.
+ */
+typedef struct _LibMeboGoldenFramePlan {
+  /**
+   * \brief Non-zero if the frame should refresh the golden (long-term)
+   * reference
+   */
+  int refresh_golden_frame;
+
+  /** \brief Number of frames between two refreshes, 0 if not planned */
+  int gf_interval;
+
+  /**
+   * \brief Number of frames from this frame to the next planned refresh
+   *
+   * A refresh that falls on an unchanged frame is postponed to the next
+   * changed one, the value stays 0 until then.
+   */
+  int frames_till_gf_update;
+
+  /** \brief Target size of the frame in bits */
+  int target_bits;
+
+  /* Reserved bytes for future use, must be zero */
+  uint32_t _libmebo_gf_plan_reserved[16];
+} LibMeboGoldenFramePlan;
+
+/**
+ * \brief Key frame placement advice
+ *
+ * Projection of the rate control of the frame at which a key frame
+ * costs the least to the stream, and of the size of that key frame.
+ */
+typedef struct _LibMeboKeyFrameAdvice {
+  /**
+   * \brief Number of frames to code before the key frame
+   *
+   * 0 when the next frame can be a key frame. The earliest frame at
+   * which the decoder buffer stays above an eighth of its optimal level
+   * after the key frame, or else the one with the fullest buffer.
+   */
+  int frames_to_key;
+
+  /** \brief Predicted size of the key frame in bytes */
+  int predicted_size;
+
+  /**
+   * \brief Projected decoder buffer level after the key frame, in
+   * milliseconds. Negative if the key frame underflows the buffer.
+   */
+  int buffer_level_ms;
+
+  /* Reserved bytes for future use, must be zero */
+  uint32_t _libmebo_kf_advice_reserved[16];
+} LibMeboKeyFrameAdvice;
+
 typedef struct _LibMeboRateController {
   void *priv;
 
@@ -410,7 +763,7 @@ typedef struct _LibMeboRateController {
  * \returns  Returns a pointer to LibMeboRateController, or NULL
  *           if fails to create the controller instance.
  */
-LibMeboRateController *
+LIBMEBO_API LibMeboRateController *
 libmebo_rate_controller_new (LibMeboCodecType codec_type,
                              LibMeboBrcAlgorithmID algo_id);
 
@@ -425,7 +778,7 @@ libmebo_rate_controller_new (LibMeboCodecType codec_type,
  *
  * \returns  Returns a LibMeboStatus
  */
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 libmebo_rate_controller_init (LibMeboRateController *rc,
                               LibMeboRateControllerConfig *rc_config);
 
@@ -436,7 +789,7 @@ libmebo_rate_controller_init (LibMeboRateController *rc,
  *
  * Frees #rc and sets it to NULL
  */
-void libmebo_rate_controller_free (LibMeboRateController *rc);
+LIBMEBO_API void libmebo_rate_controller_free (LibMeboRateController *rc);
 
 /**
  * \brief libmebo_rate_controller_update_config:
@@ -449,7 +802,7 @@ void libmebo_rate_controller_free (LibMeboRateController *rc);
  *
  * \returns  Returns a LibMeboStatus
  */
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 libmebo_rate_controller_update_config (LibMeboRateController *rc,
                                        LibMeboRateControllerConfig*rc_cfg);
 
@@ -464,7 +817,7 @@ libmebo_rate_controller_update_config (LibMeboRateController *rc,
  *
  * \returns  Returns a LibMeboStatus
  */
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 libmebo_rate_controller_post_encode_update (LibMeboRateController *rc,
                                             uint64_t encoded_frame_size);
 
@@ -480,7 +833,7 @@ libmebo_rate_controller_post_encode_update (LibMeboRateController *rc,
  * \returns  Returns a LibMeboStatus
  *
  */
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 libmebo_rate_controller_compute_qp (LibMeboRateController *rc,
                                     LibMeboRCFrameParams rc_frame_params);
 
@@ -494,23 +847,144 @@ libmebo_rate_controller_compute_qp (LibMeboRateController *rc,
  *
  * \returns  LibMeboStatus code
  */
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 libmebo_rate_controller_get_qp(LibMeboRateController *rc, int *qp);
 
 /**
  * libmebo_rate_controller_get_loop_filter_level:
  *
  * Retrieve the current loop filter strength estimate
- * from libmebo instance
+ * from libmebo instance. HEVC and H.264 have no loop filter level, their
+ * controllers return LIBMEBO_STATUS_UNIMPLEMENTED, use
+ * libmebo_rate_controller_get_loop_filter_params() instead.
  *
  * \param[in]    rc               The LibMeboRateController instance
  * \param[out]   lf               Retruns proposed loop-filter level for the current frame
  *
  * \return Retruns LibMeboStatus code
  */
-LibMeboStatus
+LIBMEBO_API LibMeboStatus
 libmebo_rate_controller_get_loop_filter_level(LibMeboRateController *rc, int *lf);
 
+/**
+ * libmebo_rate_controller_get_loop_filter_params:
+ *
+ * Retrieve the estimates of the deblocking, CDEF and loop restoration
+ * parameters of the current frame from libmebo instance, so that no
+ * filter search is needed by the encoder. Must be called after
+ * libmebo_rate_controller_compute_qp().
+ *
+ * \param[in]    rc               The LibMeboRateController instance
+ * \param[out]   params           Returns the proposed in-loop filter parameters
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LIBMEBO_API LibMeboStatus
+libmebo_rate_controller_get_loop_filter_params(LibMeboRateController *rc,
+                                               LibMeboLoopFilterParams *params);
+
+/**
+ * libmebo_rate_controller_get_segmentation_map:
+ *
+ * Retrieve the segmentation map and per-segment delta-QPs for the
+ * current frame from libmebo instance. Must be called after
+ * libmebo_rate_controller_compute_qp(). HEVC and H.264 have no
+ * segmentation, their controllers return LIBMEBO_STATUS_UNIMPLEMENTED.
+ *
+ * \param[in]    rc               The LibMeboRateController instance
+ * \param[out]   seg_map          Returns the proposed segmentation map
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LIBMEBO_API LibMeboStatus
+libmebo_rate_controller_get_segmentation_map(LibMeboRateController *rc,
+                                             LibMeboSegmentationMap *seg_map);
+
+/**
+ * libmebo_rate_controller_get_golden_frame_plan:
+ *
+ * Retrieve the golden frame plan for the current frame from libmebo
+ * instance. The encoder should refresh the golden (or long-term)
+ * reference on the frames the plan asks for, the boosted QP of these
+ * frames is returned by libmebo_rate_controller_get_qp(). The plan is
+ * enabled with gf_cbr_boost_pct. Must be called after
+ * libmebo_rate_controller_compute_qp().
+ *
+ * \param[in]    rc               The LibMeboRateController instance
+ * \param[out]   plan             Returns the golden frame plan
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LIBMEBO_API LibMeboStatus
+libmebo_rate_controller_get_golden_frame_plan(LibMeboRateController *rc,
+                                              LibMeboGoldenFramePlan *plan);
+
+/**
+ * libmebo_rate_controller_get_keyframe_advice:
+ *
+ * Advise where to place the next key frame within the next
+ * max_interval + 1 frames, e.g. to schedule a key frame request of a
+ * receiver where the buffer can absorb it. The buffer is projected
+ * from its current level, with the following inter frames at their
+ * CBR targets. Layered streams are projected from the state of the
+ * layer of the last computed frame. Can be called at any time between
+ * two frames, the rate control state is not modified.
+ *
+ * \param[in]    rc               The LibMeboRateController instance
+ * \param[in]    max_interval     Latest acceptable key frame, in frames
+ *                                from the next frame
+ * \param[out]   advice           Returns the key frame placement advice
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LIBMEBO_API LibMeboStatus
+libmebo_rate_controller_get_keyframe_advice(LibMeboRateController *rc,
+                                            int max_interval,
+                                            LibMeboKeyFrameAdvice *advice);
+
+/**
+ * libmebo_rate_controller_set_roi:
+ *
+ * Set the regions of interest of a spatial layer. The blocks of the
+ * regions get a lower QP, and the frame QP is raised so the frame still
+ * meets its target size. The resulting map is returned by
+ * libmebo_rate_controller_get_segmentation_map(), where segment ids are
+ * the region priorities (0 for the background). The regions take
+ * precedence over LIBMEBO_AQ_MODE_CYCLIC_REFRESH. The regions need the
+ * segmentation, the HEVC and H.264 controllers return
+ * LIBMEBO_STATUS_UNIMPLEMENTED.
+ *
+ * \param[in]    rc               The LibMeboRateController instance
+ * \param[in]    roi              Regions of interest of a spatial layer
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LIBMEBO_API LibMeboStatus
+libmebo_rate_controller_set_roi(LibMeboRateController *rc,
+                                const LibMeboRoiConfig *roi);
+
+/**
+ * libmebo_rate_controller_compute_activity_map:
+ *
+ * Classify the blocks of the current frame by their variance relative
+ * to the frame average and return the resulting segmentation map with
+ * per-segment delta-QPs: flat blocks get a lower QP and busy blocks a
+ * higher one. The delta-QPs are chosen so the frame rate estimated by
+ * the rate model at the frame QP stays unchanged. Must be called after
+ * libmebo_rate_controller_compute_qp().
+ *
+ * \param[in]    rc               The LibMeboRateController instance
+ * \param[in]    activity         Block variances of the current frame
+ * \param[out]   seg_map          Returns the activity segmentation map,
+ *                                map and map_size must be provided
+ *
+ * \return Retruns LibMeboStatus code
+ */
+LIBMEBO_API LibMeboStatus
+libmebo_rate_controller_compute_activity_map(LibMeboRateController *rc,
+                                             const LibMeboActivityInfo *activity,
+                                             LibMeboSegmentationMap *seg_map);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,463 @@
+/*
+ *  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+/**
+ * \file libmebo.hpp
+ * \brief Header only C++ interface of LibMebo
+ *
+ * libmebo::RateController is a move-only owner of one rate controller
+ * instance of a codec and BRC algorithm fixed at compile time. It calls
+ * the backend of the algorithm directly rather than through the function
+ * table of libmebo_rate_controller_new(), and reports the status of each
+ * call in a libmebo::Expected result, std::expected when the standard
+ * library has it.
+ *
+ * \code
+ * #include <libmebo/libmebo.hpp>
+ *
+ * auto rc = libmebo::RateController<LIBMEBO_CODEC_VP9>::create (rc_config);
+ * if (!rc)
+ *   return rc.error ();
+ *
+ * while (frame_to_encode) {
+ *   rc->compute_qp (rc_frame_param);
+ *   auto qp = rc->get_qp ();
+ *   // Encode the frame with *qp
+ *   rc->post_encode_update (encoded_frame_size);
+ * }
+ * \endcode
+ *
+ * The backends of the codecs disabled at build time are not part of the
+ * library, instantiating a RateController of one of them fails to link.
+ * Requires C++17.
+ */
+
+#ifndef __LIBMEBO_HPP__
+#define __LIBMEBO_HPP__
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+#include <expected>
+#endif
+
+#include "libmebo.h"
+
+/* Entry points of the BRC backends, the ones the function table of
+ * libmebo_rate_controller_new() points to. */
+#define LIBMEBO_DECLARE_BACKEND(codec)                                        \
+  LibMeboStatus brc_##codec##_rate_control_init (                             \
+      LibMeboRateControllerConfig *rc_cfg,                                    \
+      BrcCodecEnginePtr *brc_codec_handler);                                  \
+  void brc_##codec##_rate_control_free (BrcCodecEnginePtr rtc);               \
+  LibMeboStatus brc_##codec##_update_rate_control (                           \
+      BrcCodecEnginePtr rtc_api, LibMeboRateControllerConfig *rc_cfg);        \
+  LibMeboStatus brc_##codec##_compute_qp (                                    \
+      BrcCodecEnginePtr rtc_api, LibMeboRCFrameParams *frame_params);         \
+  LibMeboStatus brc_##codec##_get_qp (BrcCodecEnginePtr rtc_api, int *qp);    \
+  LibMeboStatus brc_##codec##_get_loop_filter_level (                         \
+      BrcCodecEnginePtr rtc_api, int *lf);                                    \
+  LibMeboStatus brc_##codec##_get_loop_filter_params (                        \
+      BrcCodecEnginePtr rtc_api, LibMeboLoopFilterParams *params);            \
+  LibMeboStatus brc_##codec##_get_segmentation_map (                          \
+      BrcCodecEnginePtr rtc_api, LibMeboSegmentationMap *seg_map);            \
+  LibMeboStatus brc_##codec##_get_keyframe_advice (                           \
+      BrcCodecEnginePtr rtc_api, int max_interval,                            \
+      LibMeboKeyFrameAdvice *advice);                                         \
+  LibMeboStatus brc_##codec##_set_roi (BrcCodecEnginePtr rtc_api,             \
+                                       const LibMeboRoiConfig *roi);          \
+  LibMeboStatus brc_##codec##_get_qdelta_by_rate (                            \
+      BrcCodecEnginePtr rtc_api, double rate_ratio, int *qdelta);             \
+  LibMeboStatus brc_##codec##_post_encode_update (                            \
+      BrcCodecEnginePtr rtc_api, uint64_t encoded_frame_size);
+
+extern "C" {
+LIBMEBO_DECLARE_BACKEND (vp8)
+LIBMEBO_DECLARE_BACKEND (vp9)
+LIBMEBO_DECLARE_BACKEND (av1)
+LIBMEBO_DECLARE_BACKEND (hevc)
+LIBMEBO_DECLARE_BACKEND (h264)
+
+LibMeboStatus brc_vp9_get_golden_frame_plan (BrcCodecEnginePtr rtc_api,
+                                             LibMeboGoldenFramePlan *plan);
+
+LibMeboStatus brc_activity_aq_compute_map (
+    BrcCodecEnginePtr handler,
+    LibMeboStatus (*qdelta_by_rate) (BrcCodecEnginePtr handler,
+                                     double rate_ratio, int *qdelta),
+    const LibMeboActivityInfo *activity, LibMeboSegmentationMap *seg_map);
+}
+
+#undef LIBMEBO_DECLARE_BACKEND
+
+namespace libmebo {
+
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+
+template <typename T>
+using Expected = std::expected<T, LibMeboStatus>;
+
+using Unexpected = std::unexpected<LibMeboStatus>;
+
+#else
+
+/**
+ * \brief Error of a failed call, to construct an Expected from
+ */
+class Unexpected {
+ public:
+  constexpr explicit Unexpected (LibMeboStatus status) noexcept
+      : status_ (status) {}
+
+  constexpr LibMeboStatus error () const noexcept { return status_; }
+
+ private:
+  LibMeboStatus status_;
+};
+
+/**
+ * \brief Either the value of a successful call or its LibMeboStatus
+ *
+ * The subset of std::expected<T, LibMeboStatus> used by this interface,
+ * for the standard libraries without it.
+ */
+template <typename T>
+class Expected {
+ public:
+  Expected (const T &value) noexcept : has_value_ (true) {
+    new (&value_) T (value);
+  }
+
+  Expected (T &&value) noexcept : has_value_ (true) {
+    new (&value_) T (std::move (value));
+  }
+
+  Expected (const Unexpected &error) noexcept
+      : has_value_ (false), status_ (error.error ()) {}
+
+  Expected (Expected &&other) noexcept : has_value_ (other.has_value_) {
+    if (has_value_)
+      new (&value_) T (std::move (other.value_));
+    else
+      status_ = other.status_;
+  }
+
+  Expected (const Expected &) = delete;
+  Expected &operator= (const Expected &) = delete;
+  Expected &operator= (Expected &&) = delete;
+
+  ~Expected () {
+    if (has_value_)
+      value_.~T ();
+  }
+
+  bool has_value () const noexcept { return has_value_; }
+  explicit operator bool () const noexcept { return has_value_; }
+
+  /* The value, only valid if has_value() */
+  T &value () & noexcept { return value_; }
+  const T &value () const & noexcept { return value_; }
+  T &&value () && noexcept { return std::move (value_); }
+  T &operator* () & noexcept { return value_; }
+  const T &operator* () const & noexcept { return value_; }
+  T *operator-> () noexcept { return &value_; }
+  const T *operator-> () const noexcept { return &value_; }
+
+  T value_or (T default_value) const noexcept {
+    return has_value_ ? value_ : default_value;
+  }
+
+  /* The status, only valid if !has_value() */
+  LibMeboStatus error () const noexcept { return status_; }
+
+ private:
+  bool has_value_;
+  union {
+    T value_;
+    LibMeboStatus status_;
+  };
+};
+
+template <>
+class Expected<void> {
+ public:
+  Expected () noexcept : status_ (LIBMEBO_STATUS_SUCCESS) {}
+  Expected (const Unexpected &error) noexcept : status_ (error.error ()) {}
+
+  bool has_value () const noexcept {
+    return status_ == LIBMEBO_STATUS_SUCCESS;
+  }
+  explicit operator bool () const noexcept { return has_value (); }
+
+  LibMeboStatus error () const noexcept { return status_; }
+
+ private:
+  LibMeboStatus status_;
+};
+
+#endif
+
+namespace detail {
+
+/* Algorithm of LIBMEBO_BRC_ALGORITHM_DEFAULT, same as the C API */
+constexpr LibMeboBrcAlgorithmID
+default_algorithm (LibMeboCodecType codec)
+{
+  return codec == LIBMEBO_CODEC_VP8    ? LIBMEBO_BRC_ALGORITHM_DERIVED_LIBVPX_VP8
+         : codec == LIBMEBO_CODEC_VP9  ? LIBMEBO_BRC_ALGORITHM_DERIVED_LIBVPX_VP9
+         : codec == LIBMEBO_CODEC_AV1  ? LIBMEBO_BRC_ALGORITHM_DERIVED_AOM_AV1
+         : codec == LIBMEBO_CODEC_HEVC ? LIBMEBO_BRC_ALGORITHM_NATIVE_HEVC
+         : codec == LIBMEBO_CODEC_H264 ? LIBMEBO_BRC_ALGORITHM_NATIVE_H264
+                                       : LIBMEBO_BRC_ALGORITHM_UNKNOWN;
+}
+
+/* Backend functions of each algorithm, the compile time counterpart of
+ * the algo_impl_map of libmebo.c. */
+template <LibMeboBrcAlgorithmID Algo>
+struct Backend {
+  static constexpr bool supported = false;
+};
+
+#define LIBMEBO_BACKEND(algo, type, prefix, golden_frame_plan)              \
+  template <>                                                               \
+  struct Backend<algo> {                                                    \
+    static constexpr bool supported = true;                                 \
+    static constexpr LibMeboCodecType codec = type;                         \
+    static constexpr auto init = prefix##_rate_control_init;                \
+    static constexpr auto free = prefix##_rate_control_free;                \
+    static constexpr auto update_config = prefix##_update_rate_control;     \
+    static constexpr auto compute_qp = prefix##_compute_qp;                 \
+    static constexpr auto get_qp = prefix##_get_qp;                         \
+    static constexpr auto get_loop_filter = prefix##_get_loop_filter_level; \
+    static constexpr auto get_loop_filter_params =                          \
+        prefix##_get_loop_filter_params;                                    \
+    static constexpr auto get_segmentation_map =                            \
+        prefix##_get_segmentation_map;                                      \
+    static constexpr auto get_qdelta_by_rate = prefix##_get_qdelta_by_rate; \
+    static constexpr auto get_golden_frame_plan = golden_frame_plan;        \
+    static constexpr auto get_keyframe_advice =                             \
+        prefix##_get_keyframe_advice;                                       \
+    static constexpr auto set_roi = prefix##_set_roi;                       \
+    static constexpr auto post_encode_update = prefix##_post_encode_update; \
+  };
+
+LIBMEBO_BACKEND (LIBMEBO_BRC_ALGORITHM_DERIVED_LIBVPX_VP8, LIBMEBO_CODEC_VP8,
+                 brc_vp8, nullptr)
+LIBMEBO_BACKEND (LIBMEBO_BRC_ALGORITHM_DERIVED_LIBVPX_VP9, LIBMEBO_CODEC_VP9,
+                 brc_vp9, brc_vp9_get_golden_frame_plan)
+LIBMEBO_BACKEND (LIBMEBO_BRC_ALGORITHM_DERIVED_AOM_AV1, LIBMEBO_CODEC_AV1,
+                 brc_av1, nullptr)
+LIBMEBO_BACKEND (LIBMEBO_BRC_ALGORITHM_NATIVE_HEVC, LIBMEBO_CODEC_HEVC,
+                 brc_hevc, nullptr)
+LIBMEBO_BACKEND (LIBMEBO_BRC_ALGORITHM_NATIVE_H264, LIBMEBO_CODEC_H264,
+                 brc_h264, nullptr)
+
+#undef LIBMEBO_BACKEND
+
+inline Expected<void>
+to_expected (LibMeboStatus status) noexcept
+{
+  if (status != LIBMEBO_STATUS_SUCCESS)
+    return Unexpected (status);
+  return {};
+}
+
+}  // namespace detail
+
+/**
+ * \brief Rate controller of a codec and BRC algorithm
+ *
+ * Owns the backend instance, freed on destruction. The methods are the
+ * counterparts of the libmebo_rate_controller_* functions of the same
+ * name, without their NULL checks: a moved from RateController can only
+ * be assigned to or destroyed.
+ *
+ * \tparam Codec  LibMeboCodecType of the codec
+ * \tparam Algo   LibMeboBrcAlgorithmID of the backend implementation
+ */
+template <LibMeboCodecType Codec,
+          LibMeboBrcAlgorithmID Algo = LIBMEBO_BRC_ALGORITHM_DEFAULT>
+class RateController {
+  static constexpr LibMeboBrcAlgorithmID algorithm_ =
+      Algo == LIBMEBO_BRC_ALGORITHM_DEFAULT ? detail::default_algorithm (Codec)
+                                            : Algo;
+  using Backend = detail::Backend<algorithm_>;
+
+  static_assert (Backend::supported, "Unsupported Codec/Algorithm");
+  static_assert (Backend::codec == Codec,
+                 "The BRC algorithm is not one of the codec");
+
+ public:
+  static constexpr LibMeboCodecType codec_type = Codec;
+  static constexpr LibMeboBrcAlgorithmID algorithm_id = algorithm_;
+
+  /**
+   * \brief Creates a rate controller initialized with rc_config
+   *
+   * \param[in]  rc_config  LibMeboRateControllerConfig with pre-filled enc params
+   *
+   * \returns  The rate controller, or the LibMeboStatus of the failure
+   */
+  static Expected<RateController>
+  create (LibMeboRateControllerConfig &rc_config) noexcept
+  {
+    BrcCodecEnginePtr handler = nullptr;
+    LibMeboStatus status = Backend::init (&rc_config, &handler);
+
+    if (status != LIBMEBO_STATUS_SUCCESS)
+      return Unexpected (status);
+    return RateController (handler);
+  }
+
+  RateController (RateController &&other) noexcept
+      : handler_ (std::exchange (other.handler_, nullptr)) {}
+
+  RateController &operator= (RateController &&other) noexcept
+  {
+    if (this != &other) {
+      reset ();
+      handler_ = std::exchange (other.handler_, nullptr);
+    }
+    return *this;
+  }
+
+  RateController (const RateController &) = delete;
+  RateController &operator= (const RateController &) = delete;
+
+  ~RateController () { reset (); }
+
+  Expected<void>
+  update_config (LibMeboRateControllerConfig &rc_config) noexcept
+  {
+    return detail::to_expected (Backend::update_config (handler_, &rc_config));
+  }
+
+  Expected<void>
+  compute_qp (LibMeboRCFrameParams rc_frame_params) noexcept
+  {
+    return detail::to_expected (
+        Backend::compute_qp (handler_, &rc_frame_params));
+  }
+
+  Expected<int>
+  get_qp () const noexcept
+  {
+    int qp = 0;
+    LibMeboStatus status = Backend::get_qp (handler_, &qp);
+
+    if (status != LIBMEBO_STATUS_SUCCESS)
+      return Unexpected (status);
+    return qp;
+  }
+
+  Expected<int>
+  get_loop_filter_level () const noexcept
+  {
+    int lf = 0;
+    LibMeboStatus status = Backend::get_loop_filter (handler_, &lf);
+
+    if (status != LIBMEBO_STATUS_SUCCESS)
+      return Unexpected (status);
+    return lf;
+  }
+
+  Expected<LibMeboLoopFilterParams>
+  get_loop_filter_params () const noexcept
+  {
+    LibMeboLoopFilterParams params = {};
+    LibMeboStatus status = Backend::get_loop_filter_params (handler_, &params);
+
+    if (status != LIBMEBO_STATUS_SUCCESS)
+      return Unexpected (status);
+    return params;
+  }
+
+  /* seg_map carries the caller allocated map buffer */
+  Expected<void>
+  get_segmentation_map (LibMeboSegmentationMap &seg_map) const noexcept
+  {
+    return detail::to_expected (
+        Backend::get_segmentation_map (handler_, &seg_map));
+  }
+
+  Expected<LibMeboGoldenFramePlan>
+  get_golden_frame_plan () const noexcept
+  {
+    if constexpr (std::is_null_pointer_v<
+                      decltype (Backend::get_golden_frame_plan)>) {
+      return Unexpected (LIBMEBO_STATUS_UNIMPLEMENTED);
+    } else {
+      LibMeboGoldenFramePlan plan = {};
+      LibMeboStatus status = Backend::get_golden_frame_plan (handler_, &plan);
+
+      if (status != LIBMEBO_STATUS_SUCCESS)
+        return Unexpected (status);
+      return plan;
+    }
+  }
+
+  Expected<LibMeboKeyFrameAdvice>
+  get_keyframe_advice (int max_interval) const noexcept
+  {
+    LibMeboKeyFrameAdvice advice = {};
+    LibMeboStatus status =
+        Backend::get_keyframe_advice (handler_, max_interval, &advice);
+
+    if (status != LIBMEBO_STATUS_SUCCESS)
+      return Unexpected (status);
+    return advice;
+  }
+
+  Expected<void>
+  set_roi (const LibMeboRoiConfig &roi) noexcept
+  {
+    return detail::to_expected (Backend::set_roi (handler_, &roi));
+  }
+
+  /* seg_map carries the caller allocated map buffer */
+  Expected<void>
+  compute_activity_map (const LibMeboActivityInfo &activity,
+                        LibMeboSegmentationMap &seg_map) const noexcept
+  {
+    return detail::to_expected (brc_activity_aq_compute_map (
+        handler_, Backend::get_qdelta_by_rate, &activity, &seg_map));
+  }
+
+  Expected<void>
+  post_encode_update (uint64_t encoded_frame_size) noexcept
+  {
+    return detail::to_expected (
+        Backend::post_encode_update (handler_, encoded_frame_size));
+  }
+
+ private:
+  explicit RateController (BrcCodecEnginePtr handler) noexcept
+      : handler_ (handler) {}
+
+  void
+  reset () noexcept
+  {
+    if (handler_)
+      Backend::free (handler_);
+    handler_ = nullptr;
+  }
+
+  BrcCodecEnginePtr handler_;
+};
+
+}  // namespace libmebo
+
+#endif  // __LIBMEBO_HPP__
@@ -25,6 +25,8 @@ typedef enum CodecID
   VP8_ID = 0,
   VP9_ID = 1,
   AV1_ID = 2,
+  HEVC_ID = 3,
+  H264_ID = 4,
 } CodecID;
 
 struct EncParams {
@@ -80,6 +82,8 @@ static struct EncParams preset_list [] = {
 	{11, 1, 8192, 30, 1920, 1080, 100,1, 1, 0},
 	{12, 1, 8192, 30, 1920, 1080, 100,1, 1, 1},
 	{13, 1, 4096, 30, 1280, 720, 100, 3, 2, 0},
+	{14, 1, 2048, 30, 1280, 720, 100, 1, 3, 0},
+	{15, 1, 2048, 30, 1280, 720, 100, 1, 2, 0},
 };
 
 //heuristics to predict a decent key/intra-frame size
@@ -114,6 +118,22 @@ static struct SvcBitrateBounds svc_bitrate_bounds_intra [] = {
                         {19084, 19084, 0},
                 }
         },
+        {
+                .layer_bitrate_lower = {
+                        {20000, 20000, 20000},
+                },
+                .layer_bitrate_upper = {
+                        {35000, 35000, 35000},
+                }
+        },
+        {
+                .layer_bitrate_lower = {
+                        {20000, 20000, 0},
+                },
+                .layer_bitrate_upper = {
+                        {35000, 35000, 0},
+                }
+        },
 };
 
 //heuristics to predict a decent inter-frame size for SVC
@@ -130,6 +150,22 @@ static struct SvcBitrateBounds svc_bitrate_bounds_inter [] = {
                         {5689,  5689,  0},
                 }
         },
+        {
+                .layer_bitrate_lower = {
+                        {9500,  9500,  4700},
+                },
+                .layer_bitrate_upper = {
+                        {13000, 13000, 6700},
+                }
+        },
+        {
+                .layer_bitrate_lower = {
+                        {7000,  7000,  0},
+                },
+                .layer_bitrate_upper = {
+                        {10000, 10000, 0},
+                }
+        },
 };
 
 int layered_bitrates[MaxSpatialLayers][MaxTemporalLayers];
@@ -143,6 +179,16 @@ unsigned int dynamic_size[2] = {0, 0};
 unsigned int dynamic_bitrates[2] = {0, 0};
 
 static int verbose = 0;
+static int aq_mode = 0;
+static int activity_aq = 0;
+static int roi = 0;
+static int bit_depth = 8;
+static int screen = 0;
+static int gf_boost = 0;
+
+// Screen content: one changed frame followed by unchanged ones.
+#define SCREEN_CHANGE_PERIOD 10
+#define SCREEN_UNCHANGED_FRAME_SIZE 32
 
 static char*
 get_codec_id_string (CodecID id)
@@ -154,6 +200,10 @@ get_codec_id_string (CodecID id)
       return "VP9";
     case AV1_ID:
       return "AV1";
+    case HEVC_ID:
+      return "HEVC";
+    case H264_ID:
+      return "H264";
     default:
       return "Unknown";
   }
@@ -162,8 +212,9 @@ get_codec_id_string (CodecID id)
 static void show_help()
 {
   printf("Usage: \n"
-		  "  fake-enc [--codec=VP8|VP9|AV1] [--framecount=frame count] "
-		  "[--preset= 0 to 13] \n\n"
+		  "  fake-enc [--codec=VP8|VP9|AV1|HEVC|H264] [--framecount=frame count] "
+		  "[--preset= 0 to 15] [--aq-mode=0|1] [--activity-aq=0|1] [--roi=0|1] \n"
+		  "  [--bit-depth=8|10|12] [--screen=0|1] [--gf-boost=0 to 1000] \n\n"
 		  "    Preset0: QVGA_256kbps_30fps \n"
 		  "    Preset1: QVGA_512kbps_30fps \n"
 		  "    Preset2: QVGA_1024kbps_30fps \n"
@@ -183,11 +234,14 @@ static void show_help()
 		  //Please add any non-SVC presets here and
 		  //increment the SVC_PRESET_START_INDEX
 		  "    Preset13: SVC_HD_4096kbps_30fps_S3T2 \n"
+		  "    Preset14: SVC_HD_2048kbps_30fps_S1T3 \n"
+		  "    Preset15: SVC_HD_2048kbps_30fps_S1T2 \n"
 		 "\n");
 }
 
 #define DYNAMIC_RATE_CHAGE_PRESET_START_INDEX 12
 #define SVC_PRESET_START_INDEX 13
+#define PRESET_COUNT (sizeof (preset_list) / sizeof (preset_list[0]))
 
 static void
 parse_args(int argc, char **argv)
@@ -203,6 +257,12 @@ parse_args(int argc, char **argv)
         {"spatial-layers", required_argument, 0, 5},
         {"dynamic-rate-change", required_argument, 0, 6},
         {"verbose", required_argument, 0, 7},
+        {"aq-mode", required_argument, 0, 8},
+        {"activity-aq", required_argument, 0, 9},
+        {"roi", required_argument, 0, 10},
+        {"bit-depth", required_argument, 0, 11},
+        {"screen", required_argument, 0, 12},
+        {"gf-boost", required_argument, 0, 13},
         { NULL,  0, NULL, 0 }
   };
 
@@ -220,13 +280,17 @@ parse_args(int argc, char **argv)
 	  enc_params.id = VP8_ID;
 	else if (!strcmp (optarg, "VP9"))
 	  enc_params.id = VP9_ID;
+	else if (!strcmp (optarg, "HEVC"))
+	  enc_params.id = HEVC_ID;
+	else if (!strcmp (optarg, "H264"))
+	  enc_params.id = H264_ID;
 	else
 	  enc_params.id = AV1_ID;
         break;
       case 2: {
 	  int preset = atoi(optarg);
 	  CodecID id = enc_params.id;
-          if (preset < 0 || preset > SVC_PRESET_START_INDEX) {
+          if (preset < 0 || preset >= (int)PRESET_COUNT) {
             printf ("Unknown preset, Failed \n");
             exit(0);
 	  }
@@ -240,6 +304,24 @@ parse_args(int argc, char **argv)
       case 7:
         verbose = atoi(optarg);
 	break;
+      case 8:
+        aq_mode = atoi(optarg);
+	break;
+      case 9:
+        activity_aq = atoi(optarg);
+	break;
+      case 10:
+        roi = atoi(optarg);
+	break;
+      case 11:
+        bit_depth = atoi(optarg);
+	break;
+      case 12:
+        screen = atoi(optarg);
+	break;
+      case 13:
+        gf_boost = atoi(optarg);
+	break;
       default:
         break;
     }
@@ -307,6 +389,75 @@ GetBitratekBps (int sl_id, int tl_id)
   return layered_bitrates[sl_id][tl_id];
 }
 
+//Fake 16x16 block variances, as an encoder would compute them
+//on the source frame, to exercise the activity map
+static void
+compute_fake_activity_map (LibMeboRateController *rc)
+{
+  LibMeboActivityInfo activity = { 0 };
+  LibMeboSegmentationMap seg_map = { 0 };
+  LibMeboStatus status;
+  uint32_t *variance;
+  int i, count;
+
+  activity.block_size = 16;
+  activity.cols = (enc_params.width + 15) / 16;
+  activity.rows = (enc_params.height + 15) / 16;
+  count = activity.cols * activity.rows;
+
+  variance = malloc (count * sizeof (*variance));
+  seg_map.map = malloc (count);
+  seg_map.map_size = count;
+  assert (variance && seg_map.map);
+  for (i = 0; i < count; i++)
+    variance[i] = (rand() % 4096) >> (rand() % 12);
+  activity.variance = variance;
+
+  status = libmebo_rate_controller_compute_activity_map (rc, &activity,
+      &seg_map);
+  if (verbose && status == LIBMEBO_STATUS_SUCCESS) {
+    printf ("ActivityMap: %dx%d blocks, delta_qp =", seg_map.cols,
+        seg_map.rows);
+    for (i = 0; i < seg_map.num_segments; i++)
+      printf (" %d", seg_map.delta_qp[i]);
+    printf ("\n");
+  }
+
+  free (seg_map.map);
+  free (variance);
+}
+
+//A region of interest in the center of each spatial layer,
+//a quarter of the layer in each dimension
+static void
+set_fake_roi (LibMeboRateController *rc,
+    LibMeboRateControllerConfig *rc_config)
+{
+  LibMeboRoiConfig roi_config = { 0 };
+  LibMeboStatus status;
+  int sl;
+
+  for (sl = 0; sl < rc_config->ss_number_layers; sl++) {
+    const int width = rc_config->width * rc_config->scaling_factor_num[sl] /
+        rc_config->scaling_factor_den[sl];
+    const int height = rc_config->height * rc_config->scaling_factor_num[sl] /
+        rc_config->scaling_factor_den[sl];
+
+    roi_config.spatial_layer_id = sl;
+    roi_config.num_rois = 1;
+    roi_config.rois[0].x = width * 3 / 8;
+    roi_config.rois[0].y = height * 3 / 8;
+    roi_config.rois[0].width = width / 4;
+    roi_config.rois[0].height = height / 4;
+    roi_config.rois[0].priority = 2;
+    status = libmebo_rate_controller_set_roi (rc, &roi_config);
+    if (status == LIBMEBO_STATUS_UNIMPLEMENTED)
+      break;
+    if (status != LIBMEBO_STATUS_SUCCESS)
+      printf ("Failed to set the region of interest: %d \n", status);
+  }
+}
+
 static int
 libmebo_software_brc_init (
     LibMeboRateController *rc,
@@ -338,6 +489,11 @@ libmebo_software_brc_init (
   rc_config->max_quantizers[0] = rc_config->max_quantizer;
   rc_config->min_quantizers[0] = rc_config->min_quantizer;
 
+  rc_config->aq_mode = aq_mode;
+  rc_config->bit_depth = bit_depth;
+  rc_config->content_type =
+      screen ? LIBMEBO_CONTENT_SCREEN : LIBMEBO_CONTENT_DEFAULT;
+  rc_config->gf_cbr_boost_pct = gf_boost;
   rc_config->ss_number_layers = enc_params.num_sl;
   rc_config->ts_number_layers = enc_params.num_tl;
 
@@ -381,6 +537,9 @@ libmebo_software_brc_init (
   if (status != LIBMEBO_STATUS_SUCCESS)
     return 0;
 
+  if (roi)
+    set_fake_roi (rc, rc_config);
+
   return 1;
 }
 
@@ -547,6 +706,15 @@ start_virtual_encode (LibMeboRateController *rc)
        dyn_size = &dynamic_size[0];
      }
 
+     if (verbose && i && i % key_frame_period == 0) {
+       LibMeboKeyFrameAdvice kf_advice;
+       if (libmebo_rate_controller_get_keyframe_advice (libmebo_rc,
+               key_frame_period / enc_params.num_sl, &kf_advice) ==
+           LIBMEBO_STATUS_SUCCESS)
+         printf ("KeyFrameAdvice: frames_to_key = %d, size = %d bytes, "
+             "buffer = %d ms \n", kf_advice.frames_to_key,
+             kf_advice.predicted_size, kf_advice.buffer_level_ms);
+     }
      if (i % key_frame_period == 0) {
        libmebo_frame_type = LIBMEBO_KEY_FRAME;
        if (preset < SVC_PRESET_START_INDEX) {
@@ -588,11 +756,15 @@ start_virtual_encode (LibMeboRateController *rc)
       assert (status == LIBMEBO_STATUS_SUCCESS);
      }
 
+     memset (&rc_frame_params, 0, sizeof (rc_frame_params));
      rc_frame_params.frame_type = libmebo_frame_type;
 
      //Set spatial layer id
      rc_frame_params.spatial_layer_id =  spatial_id;
      rc_frame_params.temporal_layer_id = temporal_id;
+     if (screen && libmebo_frame_type != LIBMEBO_KEY_FRAME &&
+         (i / enc_params.num_sl) % SCREEN_CHANGE_PERIOD)
+       rc_frame_params.flags |= LIBMEBO_FRAME_FLAG_UNCHANGED;
 
      status = libmebo_rate_controller_compute_qp (rc, rc_frame_params);
      assert (status == LIBMEBO_STATUS_SUCCESS);
@@ -600,8 +772,46 @@ start_virtual_encode (LibMeboRateController *rc)
      status  = libmebo_rate_controller_get_qp (libmebo_rc, &qp);
      assert (status == LIBMEBO_STATUS_SUCCESS);
 
-     if (verbose)
+     if (verbose) {
+       LibMeboLoopFilterParams lf_params;
        printf ("QP = %d \n", qp);
+       if (libmebo_rate_controller_get_loop_filter_params (libmebo_rc,
+               &lf_params) == LIBMEBO_STATUS_SUCCESS) {
+         if (enc_params.id == HEVC_ID || enc_params.id == H264_ID)
+           printf ("DeblockOffsets: beta = %d, tc = %d \n",
+               lf_params.deblock_beta_offset, lf_params.deblock_tc_offset);
+         else
+           printf ("LoopFilterLevel = %d \n", lf_params.filter_level[0]);
+         if (lf_params.cdef_damping)
+           printf ("CdefStrength = %d/%d, CdefDamping = %d \n",
+               lf_params.cdef_y_strength, lf_params.cdef_uv_strength,
+               lf_params.cdef_damping);
+       }
+     }
+
+     if (verbose && gf_boost) {
+       LibMeboGoldenFramePlan gf_plan;
+       if (libmebo_rate_controller_get_golden_frame_plan (libmebo_rc,
+               &gf_plan) == LIBMEBO_STATUS_SUCCESS &&
+           gf_plan.refresh_golden_frame)
+         printf ("GoldenFrameRefresh: interval = %d, target = %d bits \n",
+             gf_plan.gf_interval, gf_plan.target_bits);
+     }
+
+     if (activity_aq)
+       compute_fake_activity_map (libmebo_rc);
+
+     if (verbose && (aq_mode || roi)) {
+       LibMeboSegmentationMap seg_map = { 0 };
+       status = libmebo_rate_controller_get_segmentation_map (libmebo_rc,
+           &seg_map);
+       assert (status == LIBMEBO_STATUS_SUCCESS ||
+           status == LIBMEBO_STATUS_UNIMPLEMENTED);
+       if (status == LIBMEBO_STATUS_SUCCESS && seg_map.enabled)
+         printf ("SegmentationMap: %dx%d blocks of %dx%d, delta_qp = %d \n",
+             seg_map.cols, seg_map.rows, seg_map.block_size,
+             seg_map.block_size, seg_map.delta_qp[roi ? 2 : 1]);
+     }
 
      buf_size = predicted_size;
 
@@ -610,7 +820,9 @@ start_virtual_encode (LibMeboRateController *rc)
      if (i != 0 && !prev_is_key) {
        int qp_val  = (qp == 0) ? 1 : qp;
        int size_range = upper - lower;
-       int qp_range_length = size_range / 256;
+       int qp_range_length =
+           size_range /
+           ((enc_params.id == HEVC_ID || enc_params.id == H264_ID) ? 52 : 256);
        int suggested_size = lower + (qp_val * qp_range_length);
        int new_predicted_size = 0;
 
@@ -621,6 +833,8 @@ start_virtual_encode (LibMeboRateController *rc)
 
        buf_size = new_predicted_size;
      }
+     if (rc_frame_params.flags & LIBMEBO_FRAME_FLAG_UNCHANGED)
+       buf_size = (rand() % SCREEN_UNCHANGED_FRAME_SIZE) + 1;
 
      prev_qp = qp;
 
@@ -685,6 +899,14 @@ get_codec_and_algo_id (CodecID id, int *codec_id, int *algo_id)
       *codec_id = LIBMEBO_CODEC_VP8;
       *algo_id = LIBMEBO_BRC_ALGORITHM_DERIVED_AOM_AV1;
       break;
+    case HEVC_ID:
+      *codec_id = LIBMEBO_CODEC_HEVC;
+      *algo_id = LIBMEBO_BRC_ALGORITHM_NATIVE_HEVC;
+      break;
+    case H264_ID:
+      *codec_id = LIBMEBO_CODEC_H264;
+      *algo_id = LIBMEBO_BRC_ALGORITHM_NATIVE_H264;
+      break;
     default:
       *codec_id = LIBMEBO_CODEC_UNKNOWN;
       *algo_id = LIBMEBO_BRC_ALGORITHM_UNKNOWN;
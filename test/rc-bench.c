@@ -0,0 +1,265 @@
+/*  Copyright (c) 2020 Intel Corporation. All Rights Reserved.
+ *
+ * Cost of a frame of rate control when a process serves many streams: the
+ * controllers are cycled round robin, so each frame finds the state of its
+ * controller cold in the cache, as on a host running thousands of streams.
+ * Run it under "perf stat -e cache-misses,cache-references" for the misses.
+ *
+ * sample command:
+    ./rc-bench --codec=VP9 --instances=4096 --framecount=300
+    ./rc-bench --codec=AV1 --spatial-layers=3 --temporal-layers=3
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <libmebo.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MaxSpatialLayers 3
+#define MaxTemporalLayers 3
+
+struct BenchParams {
+  const char *codec;
+  unsigned int instances;
+  unsigned int framecount;
+  unsigned int bitrate; //in kbps
+  unsigned int framerate;
+  unsigned int width;
+  unsigned int height;
+  unsigned int num_sl; //Number of Spatial Layers
+  unsigned int num_tl; //Number of Temporal Layers
+};
+
+//Default config
+static struct BenchParams bench_params =
+{
+    .codec = "VP9",
+    .instances = 4096,
+    .framecount = 300,
+    .bitrate = 1024,
+    .framerate = 30,
+    .width = 640,
+    .height = 480,
+    .num_sl = 1,
+    .num_tl = 1,
+};
+
+static void show_help ()
+{
+  printf ("Usage: \n");
+  printf ("  rc-bench [--codec=VP8|VP9|AV1|HEVC|H264] [--instances=count] "
+      "[--framecount=frame count] \n"
+      "    [--spatial-layers=1..3] [--temporal-layers=1..3] \n\n");
+  printf ("    instances: number of rate controllers cycled round robin \n");
+  printf ("    framecount: number of superframes of each controller \n");
+}
+
+static void
+parse_args(int argc, char **argv)
+{
+  int c,option_index;
+
+  static const struct option long_options[] = {
+        {"help", no_argument, 0, 0},
+        {"codec", required_argument, 0, 1},
+        {"instances", required_argument, 0, 2},
+        {"framecount", required_argument, 0, 3},
+        {"spatial-layers", required_argument, 0, 4},
+        {"temporal-layers", required_argument, 0, 5},
+        { NULL,  0, NULL, 0 }
+  };
+
+  while (1) {
+    c = getopt_long_only (argc, argv,
+		    "hcif:?",
+		    long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 1:
+        bench_params.codec = optarg;
+        break;
+      case 2:
+        bench_params.instances = atoi (optarg);
+        break;
+      case 3:
+        bench_params.framecount = atoi (optarg);
+        break;
+      case 4:
+        bench_params.num_sl = atoi (optarg);
+        break;
+      case 5:
+        bench_params.num_tl = atoi (optarg);
+        break;
+      default:
+        show_help ();
+        exit (0);
+    }
+  }
+}
+
+static int
+get_codec_and_algo_id (const char *codec, int *codec_id, int *algo_id)
+{
+  if (!strcmp (codec, "VP8")) {
+    *codec_id = LIBMEBO_CODEC_VP8;
+    *algo_id = LIBMEBO_BRC_ALGORITHM_DERIVED_LIBVPX_VP8;
+  } else if (!strcmp (codec, "VP9")) {
+    *codec_id = LIBMEBO_CODEC_VP9;
+    *algo_id = LIBMEBO_BRC_ALGORITHM_DERIVED_LIBVPX_VP9;
+  } else if (!strcmp (codec, "AV1")) {
+    *codec_id = LIBMEBO_CODEC_AV1;
+    *algo_id = LIBMEBO_BRC_ALGORITHM_DERIVED_AOM_AV1;
+  } else if (!strcmp (codec, "HEVC")) {
+    *codec_id = LIBMEBO_CODEC_HEVC;
+    *algo_id = LIBMEBO_BRC_ALGORITHM_NATIVE_HEVC;
+  } else if (!strcmp (codec, "H264")) {
+    *codec_id = LIBMEBO_CODEC_H264;
+    *algo_id = LIBMEBO_BRC_ALGORITHM_NATIVE_H264;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+static int
+brc_init (LibMeboRateController *rc)
+{
+  LibMeboRateControllerConfig rc_config;
+  unsigned int sl, tl;
+
+  memset (&rc_config, 0, sizeof (rc_config));
+  rc_config.width = bench_params.width;
+  rc_config.height = bench_params.height;
+  rc_config.max_quantizer = 63;
+  rc_config.min_quantizer = 0;
+  rc_config.target_bandwidth = bench_params.bitrate;
+  rc_config.buf_initial_sz = 500;
+  rc_config.buf_optimal_sz = 600;
+  rc_config.buf_sz = 1000;
+  rc_config.undershoot_pct = 50;
+  rc_config.overshoot_pct = 50;
+  rc_config.framerate = bench_params.framerate;
+  rc_config.ss_number_layers = bench_params.num_sl;
+  rc_config.ts_number_layers = bench_params.num_tl;
+
+  // Each spatial layer halves the resolution of the one above and gets an
+  // even share of the bitrate, split evenly among its temporal layers.
+  for (sl = 0; sl < bench_params.num_sl; sl++) {
+    int bitrate_sum = 0;
+    rc_config.scaling_factor_num[sl] = 1;
+    rc_config.scaling_factor_den[sl] = 1 << (bench_params.num_sl - sl - 1);
+    for (tl = 0; tl < bench_params.num_tl; tl++) {
+      const int layer = sl * bench_params.num_tl + tl;
+      rc_config.max_quantizers[layer] = rc_config.max_quantizer;
+      rc_config.min_quantizers[layer] = rc_config.min_quantizer;
+      bitrate_sum += bench_params.bitrate / bench_params.num_sl /
+          bench_params.num_tl;
+      rc_config.layer_target_bitrate[layer] = bitrate_sum;
+      rc_config.ts_rate_decimator[tl] = 1u << (bench_params.num_tl - tl - 1);
+    }
+  }
+
+  return libmebo_rate_controller_init (rc, &rc_config) ==
+      LIBMEBO_STATUS_SUCCESS;
+}
+
+// Temporal layer of a superframe, in the 0-2-1-2 pattern of 3 layers and
+// the 0-1 pattern of 2 layers.
+static unsigned int
+get_temporal_id (unsigned int superframe)
+{
+  switch (bench_params.num_tl) {
+    case 3:
+      return (superframe % 4 == 0) ? 0 : (superframe % 2 == 0) ? 1 : 2;
+    case 2:
+      return superframe % 2;
+    default:
+      return 0;
+  }
+}
+
+static double
+elapsed_ns (const struct timespec *start, const struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e9 +
+      (end->tv_nsec - start->tv_nsec);
+}
+
+int main (int argc,char **argv)
+{
+  LibMeboRateController **rcs;
+  LibMeboRCFrameParams rc_frame_params;
+  struct timespec start, end;
+  unsigned int i, n, sl;
+  unsigned long frames;
+  unsigned int frame_size;
+  int codec_type, algo_id, qp;
+  double ns;
+
+  parse_args(argc, (char **)argv);
+
+  if (!get_codec_and_algo_id (bench_params.codec, &codec_type, &algo_id) ||
+      !bench_params.instances || !bench_params.framecount ||
+      bench_params.num_sl < 1 || bench_params.num_sl > MaxSpatialLayers ||
+      bench_params.num_tl < 1 || bench_params.num_tl > MaxTemporalLayers) {
+    show_help ();
+    return -1;
+  }
+
+  rcs = calloc (bench_params.instances, sizeof (*rcs));
+  if (!rcs)
+    return -1;
+
+  for (n = 0; n < bench_params.instances; n++) {
+    rcs[n] = libmebo_rate_controller_new (codec_type, algo_id);
+    if (!rcs[n] || !brc_init (rcs[n])) {
+      printf ("Failed to create the rate-controller %u \n", n);
+      return -1;
+    }
+  }
+
+  // Average frame size in bytes of a layer, the frames swing around it.
+  frame_size = bench_params.bitrate * 1000 / 8 / bench_params.framerate /
+      bench_params.num_sl;
+  srand (0);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < bench_params.framecount; i++) {
+    memset (&rc_frame_params, 0, sizeof (rc_frame_params));
+    rc_frame_params.frame_type = i ? LIBMEBO_INTER_FRAME : LIBMEBO_KEY_FRAME;
+    rc_frame_params.temporal_layer_id = get_temporal_id (i);
+    for (n = 0; n < bench_params.instances; n++) {
+      for (sl = 0; sl < bench_params.num_sl; sl++) {
+        unsigned int size = frame_size / 2 + rand () % frame_size;
+        if (!i)
+          size *= 4;
+        rc_frame_params.spatial_layer_id = sl;
+        libmebo_rate_controller_compute_qp (rcs[n], rc_frame_params);
+        libmebo_rate_controller_get_qp (rcs[n], &qp);
+        libmebo_rate_controller_post_encode_update (rcs[n], size);
+      }
+    }
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+
+  ns = elapsed_ns (&start, &end);
+  frames = (unsigned long) bench_params.instances * bench_params.framecount *
+      bench_params.num_sl;
+  printf ("Codec      = %s \n"
+      "instances  = %u \n"
+      "framecount = %u \n"
+      "layers     = S%uT%u \n"
+      "ns/frame   = %.1f \n",
+      bench_params.codec, bench_params.instances, bench_params.framecount,
+      bench_params.num_sl, bench_params.num_tl, ns / frames);
+
+  for (n = 0; n < bench_params.instances; n++)
+    libmebo_rate_controller_free (rcs[n]);
+  free (rcs);
+
+  return 0;
+}